@@ -40,6 +40,7 @@
 #include "main.h"
 #include "../../../src/log.h"
 #include "../../../src/MessageHeader.h"
+#include "../../../src/StreamStatus.h"
 #include "DesktopSelectionRectangle.h"
 #include <turbojpeg.h>
 
@@ -63,8 +64,8 @@ ParallelPixelStreamSegment computeSegmentJpeg(const ParallelPixelStreamSegment &
     unsigned char * jpegBufPtr = NULL;
     jpegBuf = &jpegBufPtr;
     unsigned long jpegSize = 0;
-    int jpegSubsamp = TJSAMP_444;
-    int jpegQual = JPEG_QUALITY;
+    int jpegSubsamp = g_mainWindow->getJpegSubsampling();
+    int jpegQual = g_mainWindow->getJpegQuality();
     int flags = 0;
 
     int success = tjCompress2(handle, image.scanLine(newSegment.parameters.y) + newSegment.parameters.x * image.depth()/8, newSegment.parameters.width, image.bytesPerLine(), newSegment.parameters.height, pixelFormat, jpegBuf, &jpegSize, jpegSubsamp, jpegQual, flags);
@@ -134,6 +135,7 @@ MainWindow::MainWindow()
     layout->addRow("Height", &heightSpinBox_);
     layout->addRow("Max frame rate", &frameRateSpinBox_);
     layout->addRow("Actual frame rate", &frameRateLabel_);
+    layout->addRow("Compression", &compressionLabel_);
 
     // share desktop action
     shareDesktopAction_ = new QAction("Share Desktop", this);
@@ -156,6 +158,13 @@ MainWindow::MainWindow()
     setParallelStreamingAction->setChecked(parallelStreaming_);
     connect(setParallelStreamingAction, SIGNAL(toggled(bool)), this, SLOT(setParallelStreaming(bool)));
 
+    // set adaptive quality action
+    QAction * setAdaptiveQualityAction = new QAction("Enable Adaptive Quality", this);
+    setAdaptiveQualityAction->setStatusTip("Adapt compression quality to reach the max frame rate");
+    setAdaptiveQualityAction->setCheckable(true);
+    setAdaptiveQualityAction->setChecked(false);
+    connect(setAdaptiveQualityAction, SIGNAL(toggled(bool)), this, SLOT(setAdaptiveQuality(bool)));
+
     // create toolbar
     QToolBar * toolbar = addToolBar("toolbar");
 
@@ -168,6 +177,7 @@ MainWindow::MainWindow()
 
     // add actions to options menu
     optionsMenu->addAction(setParallelStreamingAction);
+    optionsMenu->addAction(setAdaptiveQualityAction);
 
     // timer will trigger updating of the desktop image
     connect(&shareDesktopUpdateTimer_, SIGNAL(timeout()), this, SLOT(shareDesktopUpdate()));
@@ -204,6 +214,24 @@ QImage MainWindow::getImage()
     return image_;
 }
 
+int MainWindow::getJpegQuality()
+{
+    return rateController_.getJpegQuality();
+}
+
+int MainWindow::getJpegSubsampling()
+{
+    switch(rateController_.getChromaSubsampling())
+    {
+        case SUBSAMPLING_422:
+            return TJSAMP_422;
+        case SUBSAMPLING_420:
+            return TJSAMP_420;
+        default:
+            return TJSAMP_444;
+    }
+}
+
 void MainWindow::shareDesktop(bool set)
 {
     if(set == true)
@@ -285,6 +313,11 @@ void MainWindow::setParallelStreaming(bool set)
     parallelStreaming_ = set;
 }
 
+void MainWindow::setAdaptiveQuality(bool set)
+{
+    rateController_.setEnabled(set);
+}
+
 void MainWindow::shareDesktopUpdate()
 {
     // time the frame
@@ -343,6 +376,9 @@ void MainWindow::shareDesktopUpdate()
             mh.uri[len] = '\0';
 
             // send the header
+            QTime sendTime;
+            sendTime.start();
+
             int sent = tcpSocket_.write((const char *)&mh, sizeof(MessageHeader));
 
             while(sent < (int)sizeof(MessageHeader))
@@ -361,14 +397,7 @@ void MainWindow::shareDesktopUpdate()
             updatedDimensions_ = false;
 
             // wait for acknowledgment
-            while(tcpSocket_.waitForReadyRead() && tcpSocket_.bytesAvailable() < 3)
-            {
-    #ifndef _WIN32
-                usleep(10);
-    #endif
-            }
-
-            tcpSocket_.read(3);
+            waitForAck(sendTime);
         }
     }
     else
@@ -396,6 +425,9 @@ void MainWindow::shareDesktopUpdate()
     // frame rate limiting
     int maxFrameRate = frameRateSpinBox_.value();
 
+    // the rate controller aims for the max frame rate
+    rateController_.setTargetFrameRate(maxFrameRate);
+
     int desiredFrameTime = (int)(1000. * 1. / (float)maxFrameRate);
 
     int sleepTime = desiredFrameTime - elapsedFrameTime;
@@ -421,6 +453,13 @@ void MainWindow::shareDesktopUpdate()
         float fps = (float)frameSentTimes_.size() / (float)frameSentTimes_.front().msecsTo(frameSentTimes_.back()) * 1000.;
 
         frameRateLabel_.setText(QString::number(fps) + QString(" fps"));
+
+        // show the current compression settings
+        DcStreamRateStatistics statistics = rateController_.getStatistics();
+
+        const char * subsampling[] = { "4:4:4", "4:2:2", "4:2:0" };
+
+        compressionLabel_.setText(QString("quality ") + QString::number(statistics.jpegQuality) + QString(", ") + QString(subsampling[statistics.chromaSubsampling]) + QString(", ") + QString::number(statistics.bytesPerFrame / 1024., 'f', 0) + QString(" KB / frame"));
     }
 }
 
@@ -475,6 +514,10 @@ void MainWindow::updateCoordinates()
 
 bool MainWindow::serialStream()
 {
+    // time compression and sending for rate control
+    QTime frameTime;
+    frameTime.start();
+
     // use libjpeg-turbo for JPEG conversion
     tjhandle handle = tjInitCompress();
     int pixelFormat = TJPF_BGRX;
@@ -482,8 +525,8 @@ bool MainWindow::serialStream()
     unsigned char * jpegBufPtr = NULL;
     jpegBuf = &jpegBufPtr;
     unsigned long jpegSize = 0;
-    int jpegSubsamp = TJSAMP_444;
-    int jpegQual = JPEG_QUALITY;
+    int jpegSubsamp = getJpegSubsampling();
+    int jpegQual = getJpegQuality();
     int flags = 0;
 
     int success = tjCompress2(handle, image_.scanLine(0), image_.width(), image_.bytesPerLine(), image_.height(), pixelFormat, jpegBuf, &jpegSize, jpegSubsamp, jpegQual, flags);
@@ -511,6 +554,9 @@ bool MainWindow::serialStream()
         mh.uri[len] = '\0';
 
         // send the header
+        QTime sendTime;
+        sendTime.start();
+
         int sent = tcpSocket_.write((const char *)&mh, sizeof(MessageHeader));
 
         while(sent < (int)sizeof(MessageHeader))
@@ -529,14 +575,9 @@ bool MainWindow::serialStream()
         previousImageData_ = byteArray;
 
         // wait for acknowledgment
-        while(tcpSocket_.waitForReadyRead() && tcpSocket_.bytesAvailable() < 3)
-        {
-#ifndef _WIN32
-            usleep(10);
-#endif
-        }
+        waitForAck(sendTime);
 
-        tcpSocket_.read(3);
+        rateController_.recordFrame(frameTime.elapsed(), byteArray.size(), 1, true);
     }
 
     return true;
@@ -547,6 +588,12 @@ bool MainWindow::parallelStream()
     // frame index
     static int frameIndex = 0;
 
+    // time compression and sending for rate control
+    QTime frameTime;
+    frameTime.start();
+
+    int frameBytes = 0;
+
     // create JPEGs for each segment, in parallel
     std::vector<ParallelPixelStreamSegment> segments = QtConcurrent::blockingMapped<std::vector<ParallelPixelStreamSegment> >(segments_, &computeSegmentJpeg);
 
@@ -567,6 +614,9 @@ bool MainWindow::parallelStream()
         mh.uri[len] = '\0';
 
         // send the header
+        QTime sendTime;
+        sendTime.start();
+
         int sent = tcpSocket_.write((const char *)&mh, sizeof(MessageHeader));
 
         while(sent < (int)sizeof(MessageHeader))
@@ -592,17 +642,14 @@ bool MainWindow::parallelStream()
             sent += tcpSocket_.write((const char *)segments[i].imageData.data() + sent, segments[i].imageData.size() - sent);
         }
 
-        // wait for acknowledgment
-        while(tcpSocket_.waitForReadyRead() && tcpSocket_.bytesAvailable() < 3)
-        {
-#ifndef _WIN32
-            usleep(10);
-#endif
-        }
+        frameBytes += segments[i].imageData.size();
 
-        tcpSocket_.read(3);
+        // wait for acknowledgment
+        waitForAck(sendTime);
     }
 
+    rateController_.recordFrame(frameTime.elapsed(), frameBytes, segments.size(), true);
+
     // update segments vector
     segments_ = segments;
 
@@ -611,3 +658,42 @@ bool MainWindow::parallelStream()
 
     return true;
 }
+
+void MainWindow::waitForAck(const QTime & sendTime)
+{
+    // read the acknowledgment header
+    while(tcpSocket_.bytesAvailable() < (int)sizeof(MessageHeader))
+    {
+        if(tcpSocket_.waitForReadyRead() != true)
+        {
+            put_flog(LOG_ERROR, "no acknowledgment received");
+            return;
+        }
+    }
+
+    MessageHeader mh;
+    tcpSocket_.read((char *)&mh, sizeof(MessageHeader));
+
+    // read the acknowledgment payload, which may include the stream status
+    QByteArray message;
+
+    while(message.size() < mh.size)
+    {
+        if(tcpSocket_.bytesAvailable() == 0 && tcpSocket_.waitForReadyRead() != true)
+        {
+            put_flog(LOG_ERROR, "incomplete acknowledgment received");
+            return;
+        }
+
+        message.append(tcpSocket_.read(mh.size - message.size()));
+    }
+
+    StreamStatus * streamStatus = NULL;
+
+    if(message.size() >= (int)sizeof(StreamStatus))
+    {
+        streamStatus = (StreamStatus *)(message.data());
+    }
+
+    rateController_.recordAck(sendTime.elapsed(), streamStatus);
+}
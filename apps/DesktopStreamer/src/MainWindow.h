@@ -39,15 +39,14 @@
 #ifndef MAIN_WINDOW_H
 #define MAIN_WINDOW_H
 
-#define SUPPORTED_NETWORK_PROTOCOL_VERSION 5
+#define SUPPORTED_NETWORK_PROTOCOL_VERSION 7
 
 #define SHARE_DESKTOP_UPDATE_DELAY 1
 
 #define FRAME_RATE_AVERAGE_NUM_FRAMES 10
 
-#define JPEG_QUALITY 75
-
 #include "../../../src/ParallelPixelStream.h"
+#include "../../../src/lib/DcRateController.h"
 #include <QtGui>
 #include <QtNetwork/QTcpSocket>
 #include <string>
@@ -66,11 +65,16 @@ class MainWindow : public QMainWindow {
 
         QImage getImage();
 
+        // current compression settings (libjpeg-turbo values)
+        int getJpegQuality();
+        int getJpegSubsampling();
+
     public slots:
 
         void shareDesktop(bool set);
         void showDesktopSelectionWindow(bool set);
         void setParallelStreaming(bool set);
+        void setAdaptiveQuality(bool set);
         void shareDesktopUpdate();
         void updateCoordinates();
 
@@ -86,6 +90,7 @@ class MainWindow : public QMainWindow {
         QSpinBox heightSpinBox_;
         QSpinBox frameRateSpinBox_;
         QLabel frameRateLabel_;
+        QLabel compressionLabel_;
 
         QAction * shareDesktopAction_;
         QAction * showDesktopSelectionWindowAction_;
@@ -115,8 +120,14 @@ class MainWindow : public QMainWindow {
 
         QTcpSocket tcpSocket_;
 
+        // adjusts compression settings to reach the max frame rate
+        DcRateController rateController_;
+
         bool serialStream();
         bool parallelStream();
+
+        // wait for an acknowledgment of a message sent at sendTime
+        void waitForAck(const QTime & sendTime);
 };
 
 #endif
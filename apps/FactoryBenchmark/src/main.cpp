@@ -0,0 +1,377 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "Factory.hpp"
+#include <QtCore>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdlib.h>
+
+#define FACTORY_BENCHMARK_DEFAULT_OBJECTS 1000
+#define FACTORY_BENCHMARK_DEFAULT_LOOKUPS 1000000
+#define FACTORY_BENCHMARK_DEFAULT_THREADS 8
+
+// Factory.hpp refers to the frame count to find stale objects
+long g_frameCount = 0;
+
+// stands in for the content objects held by factories
+class BenchmarkObject {
+
+    public:
+
+        BenchmarkObject(std::string uri)
+        {
+            // defaults
+            renderedFrameCount_ = g_frameCount;
+        }
+
+        void updateRenderedFrameCount()
+        {
+            renderedFrameCount_ = g_frameCount;
+        }
+
+        long getRenderedFrameCount()
+        {
+            return renderedFrameCount_;
+        }
+
+    private:
+
+        long renderedFrameCount_;
+};
+
+// the factory before sharding: every lookup locks one mutex, and iteration copies the whole map under it
+template <class T>
+class LockedFactory {
+
+    public:
+
+        boost::shared_ptr<T> getObject(std::string uri)
+        {
+            QMutexLocker locker(&mapMutex_);
+
+            // see if we need to create the object
+            if(map_.count(uri) == 0)
+            {
+                boost::shared_ptr<T> t(new T(uri));
+
+                map_[uri] = t;
+            }
+
+            return map_[uri];
+        }
+
+        void touchObject(std::string uri)
+        {
+            QMutexLocker locker(&mapMutex_);
+
+            typename std::map<std::string, boost::shared_ptr<T> >::iterator it = map_.find(uri);
+
+            if(it != map_.end())
+            {
+                it->second->updateRenderedFrameCount();
+            }
+        }
+
+        std::map<std::string, boost::shared_ptr<T> > getMap()
+        {
+            QMutexLocker locker(&mapMutex_);
+
+            return map_;
+        }
+
+        void clearStaleObjects()
+        {
+            QMutexLocker locker(&mapMutex_);
+
+            typename std::map<std::string, boost::shared_ptr<T> >::iterator it = map_.begin();
+
+            while(it != map_.end())
+            {
+                if(g_frameCount - it->second->getRenderedFrameCount() > 1)
+                {
+                    map_.erase(it++);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+
+    private:
+
+        QMutex mapMutex_;
+        std::map<std::string, boost::shared_ptr<T> > map_;
+};
+
+// iterate all objects the way each factory is iterated by DisplayGroupManager, marking the content objects
+// (URIs starting with '/') rendered; the object created each frame is not, so it goes stale
+void renderObjects(LockedFactory<BenchmarkObject> & factory)
+{
+    std::map<std::string, boost::shared_ptr<BenchmarkObject> > map = factory.getMap();
+
+    for(std::map<std::string, boost::shared_ptr<BenchmarkObject> >::iterator it = map.begin(); it != map.end(); it++)
+    {
+        if(it->first[0] == '/')
+        {
+            it->second->updateRenderedFrameCount();
+        }
+    }
+}
+
+void renderObjects(Factory<BenchmarkObject> & factory)
+{
+    FactorySnapshot<BenchmarkObject> snapshot = factory.getSnapshot();
+
+    for(FactorySnapshot<BenchmarkObject>::const_iterator it = snapshot.begin(); it != snapshot.end(); it++)
+    {
+        if(it->first[0] == '/')
+        {
+            it->second->updateRenderedFrameCount();
+        }
+    }
+}
+
+// looks up and touches random objects, as content rendering and the network threads do
+template <class F>
+class LookupThread : public QThread {
+
+    public:
+
+        LookupThread(F & factory, const std::vector<std::string> & uris, int numLookups, unsigned int seed) : factory_(factory), uris_(uris)
+        {
+            // defaults
+            numLookups_ = numLookups;
+            seed_ = seed;
+        }
+
+    protected:
+
+        void run()
+        {
+            unsigned int random = seed_;
+
+            for(int i=0; i<numLookups_; i++)
+            {
+                // linear congruential generator, so threads don't share the state of rand()
+                random = random * 1103515245 + 12345;
+
+                const std::string & uri = uris_[(random >> 8) % uris_.size()];
+
+                if(i % 2 == 0)
+                {
+                    factory_.getObject(uri);
+                }
+                else
+                {
+                    factory_.touchObject(uri);
+                }
+            }
+        }
+
+    private:
+
+        F & factory_;
+        const std::vector<std::string> & uris_;
+        int numLookups_;
+        unsigned int seed_;
+};
+
+// returns lookups per second; frames is set to the number of frames rendered by the main thread meanwhile
+template <class F>
+double benchmarkFactory(const std::vector<std::string> & uris, int numThreads, int numLookups, long & frames)
+{
+    F factory;
+
+    for(unsigned int i=0; i<uris.size(); i++)
+    {
+        factory.getObject(uris[i]);
+    }
+
+    std::vector<LookupThread<F> *> threads;
+
+    for(int i=0; i<numThreads; i++)
+    {
+        threads.push_back(new LookupThread<F>(factory, uris, numLookups, i + 1));
+    }
+
+    QTime timer;
+    timer.start();
+
+    for(int i=0; i<numThreads; i++)
+    {
+        threads[i]->start();
+    }
+
+    // render frames while the lookups run: iterate, create an object that goes stale, and clear stale objects
+    frames = 0;
+
+    bool running = true;
+
+    while(running == true)
+    {
+        renderObjects(factory);
+
+        std::ostringstream uri;
+        uri << "frame" << frames;
+
+        factory.getObject(uri.str());
+
+        g_frameCount++;
+        factory.clearStaleObjects();
+
+        frames++;
+
+        running = false;
+
+        for(int i=0; i<numThreads; i++)
+        {
+            if(threads[i]->isFinished() != true)
+            {
+                running = true;
+            }
+        }
+    }
+
+    for(int i=0; i<numThreads; i++)
+    {
+        threads[i]->wait();
+        delete threads[i];
+    }
+
+    int elapsed = std::max(timer.elapsed(), 1);
+
+    return 1000. * (double)numThreads * (double)numLookups / (double)elapsed;
+}
+
+void syntax(char * app);
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int numObjects = FACTORY_BENCHMARK_DEFAULT_OBJECTS;
+    int numLookups = FACTORY_BENCHMARK_DEFAULT_LOOKUPS;
+    int maxThreads = FACTORY_BENCHMARK_DEFAULT_THREADS;
+
+    // read command-line arguments
+    for(int i=1; i<argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            switch(argv[i][1])
+            {
+                case 'o':
+                    if(i+1 < argc)
+                    {
+                        numObjects = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 'n':
+                    if(i+1 < argc)
+                    {
+                        numLookups = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 't':
+                    if(i+1 < argc)
+                    {
+                        maxThreads = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                default:
+                    syntax(argv[0]);
+            }
+        }
+        else
+        {
+            syntax(argv[0]);
+        }
+    }
+
+    if(numObjects <= 0 || numLookups <= 0 || maxThreads <= 0)
+    {
+        syntax(argv[0]);
+    }
+
+    std::vector<std::string> uris;
+
+    for(int i=0; i<numObjects; i++)
+    {
+        std::ostringstream uri;
+        uri << "/data/content/image" << i << ".jpg";
+
+        uris.push_back(uri.str());
+    }
+
+    std::cout << numObjects << " objects, " << numLookups << " lookups per thread, " << QThread::idealThreadCount() << " cores" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(20) << "locked lookups/s" << std::setw(16) << "locked frames" << std::setw(20) << "sharded lookups/s" << std::setw(16) << "sharded frames" << std::setw(10) << "speedup" << std::endl;
+
+    for(int numThreads=1; numThreads<=maxThreads; numThreads*=2)
+    {
+        long lockedFrames, shardedFrames;
+
+        double locked = benchmarkFactory<LockedFactory<BenchmarkObject> >(uris, numThreads, numLookups, lockedFrames);
+        double sharded = benchmarkFactory<Factory<BenchmarkObject> >(uris, numThreads, numLookups, shardedFrames);
+
+        std::cout << std::setw(8) << numThreads << std::setw(20) << std::fixed << std::setprecision(0) << locked << std::setw(16) << lockedFrames << std::setw(20) << sharded << std::setw(16) << shardedFrames << std::setw(10) << std::setprecision(2) << sharded / locked << std::endl;
+    }
+
+    return 0;
+}
+
+void syntax(char * app)
+{
+    std::cerr << "syntax: " << app << " [options]" << std::endl;
+    std::cerr << "compares lookups per second, with the main thread rendering frames meanwhile, of the factory" << std::endl;
+    std::cerr << "with one mutex against the sharded factory with lock-free lookups, for 1 to the maximum number of threads" << std::endl;
+    std::cerr << "options:" << std::endl;
+    std::cerr << " -o <objects>         set number of objects (default " << FACTORY_BENCHMARK_DEFAULT_OBJECTS << ")" << std::endl;
+    std::cerr << " -n <lookups>         set number of lookups per thread (default " << FACTORY_BENCHMARK_DEFAULT_LOOKUPS << ")" << std::endl;
+    std::cerr << " -t <threads>         set maximum number of lookup threads (default " << FACTORY_BENCHMARK_DEFAULT_THREADS << ")" << std::endl;
+
+    exit(1);
+}
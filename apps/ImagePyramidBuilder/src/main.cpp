@@ -0,0 +1,180 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ImagePyramidBuilder.h"
+#include "ImagePyramidContainer.h"
+#include <QtCore>
+#include <string>
+#include <iostream>
+#include <stdlib.h>
+
+void syntax(char * app);
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    char * imageFilename = NULL;
+    char * imagePyramidPath = NULL;
+    char * containerFilename = NULL;
+    int tileSize = IMAGE_PYRAMID_BUILDER_DEFAULT_TILE_SIZE;
+    int jpegQuality = -1;
+    int maxThreads = QThread::idealThreadCount();
+
+    // read command-line arguments
+    for(int i=1; i<argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            switch(argv[i][1])
+            {
+                case 's':
+                    if(i+1 < argc)
+                    {
+                        tileSize = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 'q':
+                    if(i+1 < argc)
+                    {
+                        jpegQuality = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 'c':
+                    if(i+1 < argc)
+                    {
+                        containerFilename = argv[i+1];
+                        i++;
+                    }
+                    break;
+                case 't':
+                    if(i+1 < argc)
+                    {
+                        maxThreads = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                default:
+                    syntax(argv[0]);
+            }
+        }
+        else if(imageFilename == NULL)
+        {
+            imageFilename = argv[i];
+        }
+        else if(imagePyramidPath == NULL)
+        {
+            imagePyramidPath = argv[i];
+        }
+        else
+        {
+            syntax(argv[0]);
+        }
+    }
+
+    if(imageFilename == NULL || ImagePyramidContainer::isValidTileSize(tileSize) != true || maxThreads <= 0)
+    {
+        syntax(argv[0]);
+    }
+
+    // an existing pyramid (.pyr metadata file) is only converted to a container
+    std::string metadataFilename;
+
+    if(QString(imageFilename).endsWith(".pyr"))
+    {
+        if(containerFilename == NULL)
+        {
+            syntax(argv[0]);
+        }
+
+        metadataFilename = imageFilename;
+    }
+    else
+    {
+        // default to the same location used by the DisplayCluster GUI
+        std::string pyramidPath;
+
+        if(imagePyramidPath != NULL)
+        {
+            pyramidPath = imagePyramidPath;
+        }
+        else
+        {
+            pyramidPath = std::string(imageFilename) + ".pyramid/";
+        }
+
+        ImagePyramidBuilder builder(imageFilename, pyramidPath, tileSize);
+        builder.setJpegQuality(jpegQuality);
+        builder.setMaxThreads(maxThreads);
+
+        if(builder.build() != true)
+        {
+            std::cerr << "failed to build image pyramid for " << imageFilename << std::endl;
+            return 1;
+        }
+
+        metadataFilename = pyramidPath + "/pyramid.pyr";
+    }
+
+    if(containerFilename != NULL)
+    {
+        if(ImagePyramidContainer::convert(metadataFilename, containerFilename) != true)
+        {
+            std::cerr << "failed to write image pyramid container " << containerFilename << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void syntax(char * app)
+{
+    std::cerr << "syntax: " << app << " [options] <image> [pyramid path]" << std::endl;
+    std::cerr << "        " << app << " -c <container> <pyramid .pyr file>" << std::endl;
+    std::cerr << "options:" << std::endl;
+    std::cerr << " -s <tile size>       set tile size: 256, 512, 1024 or 2048 (default " << IMAGE_PYRAMID_BUILDER_DEFAULT_TILE_SIZE << ")" << std::endl;
+    std::cerr << " -q <quality>         set JPEG quality, 0-100 (default Qt default)" << std::endl;
+    std::cerr << " -c <container>       also write a single-file .dcpyr container" << std::endl;
+    std::cerr << " -t <threads>         set number of worker threads (default number of cores)" << std::endl;
+    std::cerr << "the pyramid path defaults to <image>.pyramid/" << std::endl;
+
+    exit(1);
+}
@@ -0,0 +1,241 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#include "RenderBenchmark.h"
+#include <QtGui>
+#include <QGLWidget>
+#include <iostream>
+#include <vector>
+
+// textures drawn, and quads per tile
+#define CONTEXT_BENCHMARK_NUM_TEXTURES 16
+#define CONTEXT_BENCHMARK_TEXTURE_SIZE 512
+#define CONTEXT_BENCHMARK_GRID_SIZE 8
+
+static std::vector<GLuint> createTextures()
+{
+    std::vector<GLuint> textureIds(CONTEXT_BENCHMARK_NUM_TEXTURES);
+
+    glGenTextures(textureIds.size(), &textureIds[0]);
+
+    std::vector<GLubyte> image(CONTEXT_BENCHMARK_TEXTURE_SIZE * CONTEXT_BENCHMARK_TEXTURE_SIZE * 4);
+
+    for(unsigned int i=0; i<textureIds.size(); i++)
+    {
+        for(unsigned int j=0; j<image.size(); j++)
+        {
+            image[j] = (GLubyte)((j * (i + 1)) % 256);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, textureIds[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, CONTEXT_BENCHMARK_TEXTURE_SIZE, CONTEXT_BENCHMARK_TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image[0]);
+    }
+
+    return textureIds;
+}
+
+// a grid of textured quads over the current viewport, standing in for a tile's contents
+static void drawTile(std::vector<GLuint> & textureIds)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0., 1., 1., 0., -1., 1.);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    glEnable(GL_TEXTURE_2D);
+
+    double size = 1. / (double)CONTEXT_BENCHMARK_GRID_SIZE;
+
+    for(int i=0; i<CONTEXT_BENCHMARK_GRID_SIZE; i++)
+    {
+        for(int j=0; j<CONTEXT_BENCHMARK_GRID_SIZE; j++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textureIds[(i * CONTEXT_BENCHMARK_GRID_SIZE + j) % textureIds.size()]);
+
+            glBegin(GL_QUADS);
+
+            glTexCoord2f(0.,0.);
+            glVertex2f(i * size, j * size);
+
+            glTexCoord2f(1.,0.);
+            glVertex2f((i + 1) * size, j * size);
+
+            glTexCoord2f(1.,1.);
+            glVertex2f((i + 1) * size, (j + 1) * size);
+
+            glTexCoord2f(0.,1.);
+            glVertex2f(i * size, (j + 1) * size);
+
+            glEnd();
+        }
+    }
+
+    glDisable(GL_TEXTURE_2D);
+}
+
+// without vsync, so swaps measure the work instead of the refresh rate
+static QGLFormat getBenchmarkFormat()
+{
+    QGLFormat format;
+    format.setSwapInterval(0);
+
+    return format;
+}
+
+// one window and context per tile, as in the default mode; the contexts share textures
+static double benchmarkWindowPerTile(int width, int height, int numTiles, int iterations)
+{
+    std::vector<QGLWidget *> widgets;
+
+    for(int i=0; i<numTiles; i++)
+    {
+        QGLWidget * widget = new QGLWidget(getBenchmarkFormat(), 0, i > 0 ? widgets[0] : 0);
+        widget->setAutoBufferSwap(false);
+        widget->setGeometry(i * width, 0, width, height);
+        widget->show();
+
+        widgets.push_back(widget);
+    }
+
+    QApplication::processEvents();
+
+    widgets[0]->makeCurrent();
+
+    std::vector<GLuint> textureIds = createTextures();
+
+    QTime time;
+    time.start();
+
+    for(int n=0; n<iterations; n++)
+    {
+        for(int i=0; i<numTiles; i++)
+        {
+            widgets[i]->makeCurrent();
+
+            glViewport(0, 0, width, height);
+
+            drawTile(textureIds);
+        }
+
+        for(int i=0; i<numTiles; i++)
+        {
+            widgets[i]->swapBuffers();
+        }
+    }
+
+    for(int i=0; i<numTiles; i++)
+    {
+        widgets[i]->makeCurrent();
+        glFinish();
+    }
+
+    double frameMs = (double)time.elapsed() / (double)iterations;
+
+    widgets[0]->makeCurrent();
+    glDeleteTextures(textureIds.size(), &textureIds[0]);
+
+    for(int i=0; i<numTiles; i++)
+    {
+        delete widgets[i];
+    }
+
+    return frameMs;
+}
+
+// one window and context spanning all tiles, with a viewport and scissor rectangle per tile, as in single context mode
+static double benchmarkSingleContext(int width, int height, int numTiles, int iterations)
+{
+    QGLWidget widget(getBenchmarkFormat());
+    widget.setAutoBufferSwap(false);
+    widget.setGeometry(0, 0, numTiles * width, height);
+    widget.show();
+
+    QApplication::processEvents();
+
+    widget.makeCurrent();
+
+    std::vector<GLuint> textureIds = createTextures();
+
+    QTime time;
+    time.start();
+
+    for(int n=0; n<iterations; n++)
+    {
+        glEnable(GL_SCISSOR_TEST);
+
+        for(int i=0; i<numTiles; i++)
+        {
+            glViewport(i * width, 0, width, height);
+            glScissor(i * width, 0, width, height);
+
+            drawTile(textureIds);
+        }
+
+        glDisable(GL_SCISSOR_TEST);
+
+        widget.swapBuffers();
+    }
+
+    glFinish();
+
+    double frameMs = (double)time.elapsed() / (double)iterations;
+
+    glDeleteTextures(textureIds.size(), &textureIds[0]);
+
+    return frameMs;
+}
+
+int benchmarkContext(int width, int height, int numTiles, int iterations)
+{
+    std::cout << "contexts for " << numTiles << " tiles of " << width << " x " << height << ", " << CONTEXT_BENCHMARK_GRID_SIZE * CONTEXT_BENCHMARK_GRID_SIZE << " textured quads per tile, " << iterations << " iterations" << std::endl;
+
+    double windowPerTileMs = benchmarkWindowPerTile(width, height, numTiles, iterations);
+
+    std::cout << "window per tile: " << windowPerTileMs << " ms per frame" << std::endl;
+
+    double singleContextMs = benchmarkSingleContext(width, height, numTiles, iterations);
+
+    std::cout << "single context: " << singleContextMs << " ms per frame" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef RENDER_BENCHMARK_H
+#define RENDER_BENCHMARK_H
+
+// default window size and number of timed iterations
+#define RENDER_BENCHMARK_DEFAULT_WIDTH 1920
+#define RENDER_BENCHMARK_DEFAULT_HEIGHT 1080
+#define RENDER_BENCHMARK_DEFAULT_ITERATIONS 100
+
+class QGLWidget;
+
+// show the widget at the given size and make its context current, with a projection in window pixels
+void makeBenchmarkWidgetCurrent(QGLWidget & widget, int width, int height);
+
+// DynamicTexture level of detail traversal cost versus tree size: the CPU traversal
+// of DynamicTextureLOD, against the previous traversal that queried the OpenGL
+// matrices and viewport and called gluProject() for every node. the view is zoomed
+// from the whole image to full resolution, so the traversal grows to maxDepth levels.
+// returns a process exit code.
+int benchmarkTraversal(int width, int height, int tileSize, int maxDepth, int iterations);
+
+// DynamicTexture tile sizes of 256 to 2048, without and with mipmaps, on the same image
+// of 256 * 2^maxDepth pixels: the JPEG decode and texture upload time per tile, and, as
+// the view is zoomed from the whole image to full resolution, the tiles drawn, the draw
+// time per frame, and the time to load the view's tiles with one loader thread.
+// returns a process exit code.
+int benchmarkTileSize(int width, int height, int maxDepth, int iterations);
+
+// rendering numTiles tiles of width x height from a window and OpenGL context per tile,
+// against one window spanning the tiles with a viewport per tile (single context mode).
+// swaps are not synchronized to the display refresh. returns a process exit code.
+int benchmarkContext(int width, int height, int numTiles, int iterations);
+
+#endif
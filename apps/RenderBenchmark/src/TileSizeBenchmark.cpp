@@ -0,0 +1,250 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#include "RenderBenchmark.h"
+#include "DynamicTextureLOD.h"
+#include <QtGui>
+#include <QGLWidget>
+#include <iostream>
+#include <vector>
+
+// textures kept for drawing; more tiles than this reuse them
+#define TILE_SIZE_BENCHMARK_MAX_TEXTURES 16
+
+// the quadrants of a tile, in its (0,0,1,1) coordinates
+static const QRectF g_tileQuadrants[4] = { QRectF(0.,0.,0.5,0.5), QRectF(0.5,0.,0.5,0.5), QRectF(0.5,0.5,0.5,0.5), QRectF(0.,0.5,0.5,0.5) };
+
+// the tiles DynamicTexture::traverse() draws, as window rectangles clipped to the window
+static void getTileRects(const QRectF & pixelRect, const QRectF & windowRect, int depth, int tileSize, int imageSize, std::vector<QRectF> & tileRects)
+{
+    if(DynamicTextureLOD::getDrawChildren(pixelRect, windowRect, tileSize, depth, imageSize, imageSize) == true)
+    {
+        for(int i=0; i<4; i++)
+        {
+            getTileRects(DynamicTextureLOD::mapRect(pixelRect, g_tileQuadrants[i]), windowRect, depth+1, tileSize, imageSize, tileRects);
+        }
+    }
+    else if(DynamicTextureLOD::getProjectedPixelArea(pixelRect, windowRect, true) > 0.)
+    {
+        tileRects.push_back(pixelRect);
+    }
+}
+
+// a tile with detail at all scales, so JPEG sizes and minification are realistic
+static QImage createTileImage(int tileSize)
+{
+    QImage image(tileSize, tileSize, QImage::Format_RGB32);
+
+    qsrand(tileSize);
+
+    for(int y=0; y<tileSize; y++)
+    {
+        QRgb * line = (QRgb *)image.scanLine(y);
+
+        for(int x=0; x<tileSize; x++)
+        {
+            line[x] = qRgb((x * 255 / tileSize + qrand() % 32) % 256, (y * 255 / tileSize + qrand() % 32) % 256, ((x ^ y) & 255));
+        }
+    }
+
+    return image;
+}
+
+static GLuint uploadTile(QImage & glImage, bool mipmaps)
+{
+    GLuint textureId;
+
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    // the texture parameters of DynamicTexture::uploadTexture()
+    if(mipmaps == true)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    else
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, glImage.width(), glImage.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, glImage.bits());
+
+    return textureId;
+}
+
+static void drawTiles(std::vector<QRectF> & tileRects, std::vector<GLuint> & textureIds)
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glEnable(GL_TEXTURE_2D);
+
+    for(unsigned int i=0; i<tileRects.size(); i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textureIds[i % textureIds.size()]);
+
+        const QRectF & rect = tileRects[i];
+
+        glBegin(GL_QUADS);
+
+        glTexCoord2f(0.,0.);
+        glVertex2f(rect.left(), rect.top());
+
+        glTexCoord2f(1.,0.);
+        glVertex2f(rect.right(), rect.top());
+
+        glTexCoord2f(1.,1.);
+        glVertex2f(rect.right(), rect.bottom());
+
+        glTexCoord2f(0.,1.);
+        glVertex2f(rect.left(), rect.bottom());
+
+        glEnd();
+    }
+
+    glDisable(GL_TEXTURE_2D);
+}
+
+int benchmarkTileSize(int width, int height, int maxDepth, int iterations)
+{
+    QGLWidget widget;
+    makeBenchmarkWidgetCurrent(widget, width, height);
+
+    // the same image for all tile sizes; the smallest tiles have maxDepth levels below the root
+    int imageSize = 256 * (1 << maxDepth);
+
+    QRectF windowRect(0., 0., (double)width, (double)height);
+
+    std::cout << "tile sizes for a " << imageSize << " x " << imageSize << " image in a " << width << " x " << height << " window, " << iterations << " iterations" << std::endl;
+
+    for(int tileSize=256; tileSize<=2048; tileSize*=2)
+    {
+        QImage image = createTileImage(tileSize);
+
+        QByteArray jpeg;
+        QBuffer buffer(&jpeg);
+        buffer.open(QIODevice::WriteOnly);
+
+        if(image.save(&buffer, "jpg") != true)
+        {
+            std::cerr << "could not encode JPEG tile" << std::endl;
+            return 1;
+        }
+
+        // the loader thread's work per tile: decode and convert to the OpenGL format
+        QImage glImage;
+
+        QTime decodeTime;
+        decodeTime.start();
+
+        for(int i=0; i<iterations; i++)
+        {
+            QImage decoded;
+            decoded.loadFromData(jpeg, "jpg");
+
+            glImage = QGLWidget::convertToGLFormat(decoded);
+        }
+
+        double decodeMs = (double)decodeTime.elapsed() / (double)iterations;
+
+        for(int mipmaps=0; mipmaps<2; mipmaps++)
+        {
+            std::vector<GLuint> textureIds;
+
+            glFinish();
+
+            QTime uploadTime;
+            uploadTime.start();
+
+            for(int i=0; i<iterations; i++)
+            {
+                GLuint textureId = uploadTile(glImage, mipmaps == 1);
+
+                if(textureIds.size() < TILE_SIZE_BENCHMARK_MAX_TEXTURES)
+                {
+                    textureIds.push_back(textureId);
+                }
+                else
+                {
+                    glDeleteTextures(1, &textureId);
+                }
+            }
+
+            glFinish();
+
+            double uploadMs = (double)uploadTime.elapsed() / (double)iterations;
+
+            std::cout << "tile size " << tileSize << ", mipmaps " << (mipmaps == 1 ? "on" : "off") << ": ";
+            std::cout << "JPEG " << jpeg.size() / 1024 << " KB, decode " << decodeMs << " ms, upload " << uploadMs << " ms per tile" << std::endl;
+
+            // zoom from the whole image fitting the window height to full resolution, centered on the window
+            for(int level=0; (double)height * (double)(1 << level) <= 2. * (double)imageSize; level++)
+            {
+                double size = (double)height * (double)(1 << level);
+
+                QRectF pixelRect(0.5 * ((double)width - size), 0.5 * ((double)height - size), size, size);
+
+                std::vector<QRectF> tileRects;
+                getTileRects(pixelRect, windowRect, 0, tileSize, imageSize, tileRects);
+
+                QTime drawTime;
+                drawTime.start();
+
+                for(int i=0; i<iterations; i++)
+                {
+                    drawTiles(tileRects, textureIds);
+
+                    glFinish();
+                }
+
+                double drawMs = (double)drawTime.elapsed() / (double)iterations;
+
+                std::cout << "  zoom " << (1 << level) << ": " << tileRects.size() << " tiles, ";
+                std::cout << "draw " << drawMs << " ms per frame, ";
+                std::cout << "load " << (double)tileRects.size() * (decodeMs + uploadMs) << " ms" << std::endl;
+            }
+
+            glDeleteTextures(textureIds.size(), &textureIds[0]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "RenderBenchmark.h"
+#include "DynamicTextureLOD.h"
+#include "vector.h"
+#include <QtGui>
+#include <QGLWidget>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+#if __APPLE__
+    #include <OpenGL/glu.h>
+#else
+    #include <GL/glu.h>
+#endif
+
+// the quadrants of a tile, in its (0,0,1,1) coordinates
+static const QRectF g_quadrants[4] = { QRectF(0.,0.,0.5,0.5), QRectF(0.5,0.,0.5,0.5), QRectF(0.5,0.5,0.5,0.5), QRectF(0.,0.5,0.5,0.5) };
+
+struct TraversalCounts {
+
+    int numNodes;
+    int numTiles;
+};
+
+// the traversal of DynamicTexture::traverse(), without loading or drawing
+static void traverseCPU(const QRectF & pixelRect, const QRectF & windowRect, int depth, int tileSize, int imageSize, TraversalCounts & counts)
+{
+    counts.numNodes++;
+
+    if(DynamicTextureLOD::getDrawChildren(pixelRect, windowRect, tileSize, depth, imageSize, imageSize) == true)
+    {
+        for(int i=0; i<4; i++)
+        {
+            traverseCPU(DynamicTextureLOD::mapRect(pixelRect, g_quadrants[i]), windowRect, depth+1, tileSize, imageSize, counts);
+        }
+    }
+    else if(DynamicTextureLOD::getProjectedPixelArea(pixelRect, windowRect, true) > 0.)
+    {
+        counts.numTiles++;
+    }
+}
+
+// the previous DynamicTexture::getProjectedPixelArea(), which projected the tile corners with the current OpenGL state
+static double getProjectedPixelAreaGL(int width, int height, bool onScreenOnly)
+{
+    double x[4][3] = { {0.,0.,0.}, {1.,0.,0.}, {1.,1.,0.}, {0.,1.,0.} };
+
+    GLdouble modelview[16];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+
+    GLdouble projection[16];
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    GLdouble xWin[4][3];
+
+    for(int i=0; i<4; i++)
+    {
+        gluProject(x[i][0], x[i][1], x[i][2], modelview, projection, viewport, &xWin[i][0], &xWin[i][1], &xWin[i][2]);
+
+        if(onScreenOnly == true)
+        {
+            xWin[i][0] = std::min(std::max(xWin[i][0], 0.), (double)width);
+            xWin[i][1] = std::min(std::max(xWin[i][1], 0.), (double)height);
+        }
+    }
+
+    // area from two triangles
+    double vec1[3] = { xWin[1][0] - xWin[0][0], xWin[1][1] - xWin[0][1], xWin[1][2] - xWin[0][2] };
+    double vec2[3] = { xWin[2][0] - xWin[0][0], xWin[2][1] - xWin[0][1], xWin[2][2] - xWin[0][2] };
+    double vec3[3] = { xWin[3][0] - xWin[0][0], xWin[3][1] - xWin[0][1], xWin[3][2] - xWin[0][2] };
+
+    double cp[3];
+
+    vectorCrossProduct(vec1, vec2, cp);
+    double A1 = 0.5 * vectorMagnitude(cp);
+
+    vectorCrossProduct(vec1, vec3, cp);
+    double A2 = 0.5 * vectorMagnitude(cp);
+
+    return A1 + A2;
+}
+
+// the previous traversal, with each tile's transform on the OpenGL matrix stack
+static void traverseGL(int width, int height, int depth, int tileSize, int imageSize, TraversalCounts & counts)
+{
+    counts.numNodes++;
+
+    double onScreenArea = getProjectedPixelAreaGL(width, height, true);
+
+    if(onScreenArea > 0. && getProjectedPixelAreaGL(width, height, false) > (double)tileSize * (double)tileSize && imageSize / pow(2,depth) > tileSize)
+    {
+        for(int i=0; i<4; i++)
+        {
+            glPushMatrix();
+            glTranslatef(g_quadrants[i].x(), g_quadrants[i].y(), 0.);
+            glScalef(g_quadrants[i].width(), g_quadrants[i].height(), 1.);
+
+            traverseGL(width, height, depth+1, tileSize, imageSize, counts);
+
+            glPopMatrix();
+        }
+    }
+    else if(onScreenArea > 0.)
+    {
+        counts.numTiles++;
+    }
+}
+
+int benchmarkTraversal(int width, int height, int tileSize, int maxDepth, int iterations)
+{
+    // a current context for the OpenGL queries
+    QGLWidget widget;
+    makeBenchmarkWidgetCurrent(widget, width, height);
+
+    int imageSize = tileSize * (1 << maxDepth);
+
+    QRectF windowRect(0., 0., (double)width, (double)height);
+
+    std::cout << "traversal of a " << imageSize << " x " << imageSize << " image with " << tileSize << " pixel tiles in a " << width << " x " << height << " window, " << iterations << " iterations" << std::endl;
+
+    // zoom from the whole image fitting the window height to full resolution, centered on the window
+    for(int level=0; level<=maxDepth; level++)
+    {
+        double size = (double)height * (double)(1 << level);
+
+        QRectF pixelRect(0.5 * ((double)width - size), 0.5 * ((double)height - size), size, size);
+
+        TraversalCounts cpuCounts;
+        TraversalCounts glCounts;
+
+        QTime cpuTime;
+        cpuTime.start();
+
+        for(int i=0; i<iterations; i++)
+        {
+            cpuCounts.numNodes = cpuCounts.numTiles = 0;
+
+            traverseCPU(pixelRect, windowRect, 0, tileSize, imageSize, cpuCounts);
+        }
+
+        int cpuElapsed = cpuTime.elapsed();
+
+        glLoadIdentity();
+        glTranslatef(pixelRect.x(), pixelRect.y(), 0.);
+        glScalef(pixelRect.width(), pixelRect.height(), 1.);
+
+        QTime glTime;
+        glTime.start();
+
+        for(int i=0; i<iterations; i++)
+        {
+            glCounts.numNodes = glCounts.numTiles = 0;
+
+            traverseGL(width, height, 0, tileSize, imageSize, glCounts);
+        }
+
+        int glElapsed = glTime.elapsed();
+
+        std::cout << "zoom " << (1 << level) << ": " << cpuCounts.numNodes << " nodes, " << cpuCounts.numTiles << " tiles; ";
+        std::cout << "CPU " << 1000. * (double)cpuElapsed / (double)iterations << " us, ";
+        std::cout << "OpenGL queries " << 1000. * (double)glElapsed / (double)iterations << " us per traversal";
+
+        // both traversals should select the same tiles, up to rounding in the projection
+        if(glCounts.numNodes != cpuCounts.numNodes || glCounts.numTiles != cpuCounts.numTiles)
+        {
+            std::cout << " (OpenGL queries traversal: " << glCounts.numNodes << " nodes, " << glCounts.numTiles << " tiles)";
+        }
+
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
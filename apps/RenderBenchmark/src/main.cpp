@@ -0,0 +1,181 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "RenderBenchmark.h"
+#include <QtGui>
+#include <QGLWidget>
+#include <string>
+#include <iostream>
+#include <stdlib.h>
+
+void syntax(char * app);
+
+int main(int argc, char **argv)
+{
+    QApplication app(argc, argv);
+
+    char * benchmark = NULL;
+    int width = RENDER_BENCHMARK_DEFAULT_WIDTH;
+    int height = RENDER_BENCHMARK_DEFAULT_HEIGHT;
+    int tileSize = 512;
+    int maxDepth = 6;
+    int numTiles = 2;
+    int iterations = RENDER_BENCHMARK_DEFAULT_ITERATIONS;
+
+    // read command-line arguments
+    for(int i=1; i<argc; i++)
+    {
+        if(argv[i][0] == '-')
+        {
+            switch(argv[i][1])
+            {
+                case 'w':
+                    if(i+1 < argc)
+                    {
+                        width = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 'h':
+                    if(i+1 < argc)
+                    {
+                        height = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 's':
+                    if(i+1 < argc)
+                    {
+                        tileSize = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 'd':
+                    if(i+1 < argc)
+                    {
+                        maxDepth = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 't':
+                    if(i+1 < argc)
+                    {
+                        numTiles = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                case 'n':
+                    if(i+1 < argc)
+                    {
+                        iterations = atoi(argv[i+1]);
+                        i++;
+                    }
+                    break;
+                default:
+                    syntax(argv[0]);
+            }
+        }
+        else if(benchmark == NULL)
+        {
+            benchmark = argv[i];
+        }
+        else
+        {
+            syntax(argv[0]);
+        }
+    }
+
+    if(benchmark == NULL || width <= 0 || height <= 0 || tileSize <= 0 || maxDepth < 0 || maxDepth > 16 || numTiles <= 0 || iterations <= 0)
+    {
+        syntax(argv[0]);
+    }
+
+    if(std::string(benchmark) == "traversal")
+    {
+        return benchmarkTraversal(width, height, tileSize, maxDepth, iterations);
+    }
+    else if(std::string(benchmark) == "tilesize")
+    {
+        return benchmarkTileSize(width, height, maxDepth, iterations);
+    }
+    else if(std::string(benchmark) == "context")
+    {
+        return benchmarkContext(width, height, numTiles, iterations);
+    }
+
+    syntax(argv[0]);
+
+    return 1;
+}
+
+void syntax(char * app)
+{
+    std::cerr << "syntax: " << app << " [options] <benchmark>" << std::endl;
+    std::cerr << "benchmarks:" << std::endl;
+    std::cerr << " traversal            DynamicTexture level of detail traversal on the CPU versus with OpenGL queries, by tree size" << std::endl;
+    std::cerr << " tilesize             DynamicTexture tile sizes 256-2048 without and with mipmaps: decode, upload, draw and load time" << std::endl;
+    std::cerr << " context              window and OpenGL context per tile versus one window with a viewport per tile" << std::endl;
+    std::cerr << "options:" << std::endl;
+    std::cerr << " -w <width>           set window width (default " << RENDER_BENCHMARK_DEFAULT_WIDTH << ")" << std::endl;
+    std::cerr << " -h <height>          set window height (default " << RENDER_BENCHMARK_DEFAULT_HEIGHT << ")" << std::endl;
+    std::cerr << " -s <tile size>       set tile size for traversal (default 512)" << std::endl;
+    std::cerr << " -d <depth>           set image pyramid depth, 0-16 (default 6)" << std::endl;
+    std::cerr << " -t <tiles>           set number of tiles for context (default 2)" << std::endl;
+    std::cerr << " -n <iterations>      set number of timed iterations (default " << RENDER_BENCHMARK_DEFAULT_ITERATIONS << ")" << std::endl;
+
+    exit(1);
+}
+
+void makeBenchmarkWidgetCurrent(QGLWidget & widget, int width, int height)
+{
+    widget.resize(width, height);
+    widget.show();
+
+    QApplication::processEvents();
+
+    widget.makeCurrent();
+
+    glViewport(0, 0, width, height);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0., (double)width, (double)height, 0., -1., 1.);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
@@ -16,6 +16,7 @@ std::string dcStreamName = "SimpleStreamer";
 bool dcParallelStreaming = false;
 int dcSegmentSize = 512;
 bool dcInteraction = false;
+float dcTargetFrameRate = 0.;
 char * dcHostname = NULL;
 DcSocket * dcSocket = NULL;
 
@@ -52,6 +53,13 @@ int main(int argc, char **argv)
                 case 'i':
                     dcInteraction = true;
                     break;
+                case 'r':
+                    if(i+1 < argc)
+                    {
+                        dcTargetFrameRate = atof(argv[i+1]);
+                        i++;
+                    }
+                    break;
                 default:
                     syntax(argv[0]);
             }
@@ -97,6 +105,11 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if(dcTargetFrameRate > 0.)
+    {
+        dcStreamSetRateControl(dcSocket, true, dcTargetFrameRate);
+    }
+
     if(dcInteraction == true)
     {
         bool success = dcStreamBindInteraction(dcSocket, dcStreamName);
@@ -123,6 +136,7 @@ void syntax(char * app)
     std::cerr << " -p                   enable parallel streaming (default disabled)" << std::endl;
     std::cerr << " -s <segment size>    set parallel streaming segment size (default 512)" << std::endl;
     std::cerr << " -i                   enable interaction events (default disabled)" << std::endl;
+    std::cerr << " -r <frame rate>      enable adaptive rate control for the target frame rate (default disabled)" << std::endl;
 
     exit(1);
 }
@@ -170,8 +184,21 @@ void display()
 
     if(dcParallelStreaming == true)
     {
-        // use a streaming segment size of roughly <dcSegmentSize> x <dcSegmentSize> pixels
-        std::vector<DcStreamParameters> parameters = dcStreamGenerateParameters(dcStreamName, 0, dcSegmentSize,dcSegmentSize, 0,0,windowWidth,windowHeight, windowWidth,windowHeight);
+        // use a streaming segment size of roughly <dcSegmentSize> x <dcSegmentSize> pixels,
+        // or larger segments if recommended by the rate controller
+        static int segmentSize = dcSegmentSize;
+
+        int recommendedSegmentSize = dcStreamGetRecommendedSegmentSize(dcSocket, dcSegmentSize);
+
+        if(recommendedSegmentSize != segmentSize)
+        {
+            // reset the stream since we'll have a different number of segments now
+            dcStreamReset(dcSocket);
+
+            segmentSize = recommendedSegmentSize;
+        }
+
+        std::vector<DcStreamParameters> parameters = dcStreamGenerateParameters(dcStreamName, 0, segmentSize,segmentSize, 0,0,windowWidth,windowHeight, windowWidth,windowHeight);
 
         // finally, send it to DisplayCluster
         success = dcStreamSend(dcSocket, imageData, 0,0,windowWidth,0,windowHeight, RGBA, parameters);
@@ -193,6 +220,17 @@ void display()
 
     dcStreamIncrementFrameIndex();
 
+    // periodically report rate control decisions
+    if(dcTargetFrameRate > 0.)
+    {
+        DcStreamRateStatistics statistics = dcStreamGetRateStatistics(dcSocket);
+
+        if(statistics.numFrames % 100 == 0)
+        {
+            std::cout << "rate control: frame time " << statistics.frameTime << " ms, ack latency " << statistics.ackLatency << " ms, " << statistics.bytesPerFrame << " bytes / frame, backlog " << statistics.segmentBacklog << " segments, server buffer " << statistics.bufferedBytes << " / " << statistics.bufferBudget << " bytes" << (statistics.throttled == true ? " (throttled)" : "") << "; quality " << statistics.jpegQuality << ", subsampling " << statistics.chromaSubsampling << ", segment size factor " << statistics.segmentSizeFactor << " (" << statistics.numDecreases << " decreases, " << statistics.numIncreases << " increases)" << std::endl;
+        }
+    }
+
     // and free the allocated image data
     free(imageData);
 
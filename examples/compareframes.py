@@ -0,0 +1,106 @@
+#!/usr/bin/python
+
+# compare frames dumped by the retained and immediate rendering paths.
+#
+# each GLWindow saves its back buffer every frame to the directory named by
+# DISPLAYCLUSTER_DUMP_FRAMES, as frame-<rank>-<tile>-<frame>-<retained|immediate>.png.
+# run the same static scene twice, once with "Enable Retained Rendering" off and
+# once with it on, dumping to the same directory or to two directories, then:
+#
+#   compareframes.py [-t <tolerance>] <directory> [<retained directory>]
+#
+# frames of the same rank, tile and frame number are compared. a pair fails if
+# any channel differs by more than the tolerance (default 2, for rounding
+# differences between the fixed function and shader paths). the exit status is
+# 1 if any pair fails or no pairs are found.
+
+import os
+import re
+import sys
+from PIL import Image, ImageChops
+
+framePattern = re.compile(r'^frame-(\d+)-(\d+)-(\d+)-(retained|immediate)\.png$')
+
+def getFrames(directory, path):
+
+    frames = {}
+
+    for filename in os.listdir(directory):
+
+        match = framePattern.match(filename)
+
+        if match is not None and match.group(4) == path:
+            frames[(int(match.group(1)), int(match.group(2)), int(match.group(3)))] = os.path.join(directory, filename)
+
+    return frames
+
+def compare(immediateFilename, retainedFilename, tolerance):
+
+    immediate = Image.open(immediateFilename).convert('RGB')
+    retained = Image.open(retainedFilename).convert('RGB')
+
+    if immediate.size != retained.size:
+        return (None, None)
+
+    difference = ImageChops.difference(immediate, retained)
+
+    maxDifference = max([extrema[1] for extrema in difference.getextrema()])
+
+    # pixels with any channel over the tolerance
+    over = difference.point(lambda v: 255 if v > tolerance else 0).convert('L').point(lambda v: 255 if v > 0 else 0)
+    numPixels = over.histogram()[255]
+
+    return (maxDifference, numPixels)
+
+def syntax():
+
+    print('syntax: compareframes.py [-t <tolerance>] <directory> [<retained directory>]')
+    sys.exit(2)
+
+if __name__ == '__main__':
+
+    tolerance = 2
+    directories = []
+
+    args = sys.argv[1:]
+
+    while len(args) > 0:
+
+        arg = args.pop(0)
+
+        if arg == '-t' and len(args) > 0:
+            tolerance = int(args.pop(0))
+        elif arg.startswith('-'):
+            syntax()
+        else:
+            directories.append(arg)
+
+    if len(directories) < 1 or len(directories) > 2:
+        syntax()
+
+    immediateFrames = getFrames(directories[0], 'immediate')
+    retainedFrames = getFrames(directories[-1], 'retained')
+
+    keys = sorted(set(immediateFrames.keys()) & set(retainedFrames.keys()))
+
+    if len(keys) == 0:
+        print('no frames dumped by both rendering paths')
+        sys.exit(1)
+
+    numFailed = 0
+
+    for key in keys:
+
+        (maxDifference, numPixels) = compare(immediateFrames[key], retainedFrames[key], tolerance)
+
+        if maxDifference is None:
+            print('rank %i tile %i frame %i: different sizes' % key)
+            numFailed += 1
+        elif maxDifference > tolerance:
+            print('rank %i tile %i frame %i: max difference %i, %i pixels over tolerance' % (key + (maxDifference, numPixels)))
+            numFailed += 1
+
+    print('%i of %i frames differ by more than %i' % (numFailed, len(keys), tolerance))
+
+    if numFailed > 0:
+        sys.exit(1)
@@ -0,0 +1,58 @@
+import time
+from pydc import *
+
+# scripted pan / zoom replay over an image pyramid, for measuring time-to-sharp.
+# the render processes log "time to sharp" after each move settles.
+#
+# usage from the Python console:
+#   execfile(os.environ['DISPLAYCLUSTER_DIR'] + "/examples/panreplay.py")
+#   openContent("/path/to/image.pyr")
+#   replay()
+
+cw = None
+
+def openContent(uri):
+
+    global cw
+
+    c = pyContent(uri)
+    cw = pyContentWindowManager(c)
+    dg = pyDisplayGroupPython()
+    dg.addContentWindowManager(cw)
+
+    cw.setCoordinates(0.0, 0.0, 1.0, 1.0)
+
+# move the view center linearly to (centerX, centerY) and zoom exponentially to zoom
+def move(centerX, centerY, zoom, seconds=1.0, sleepInterval=1.0/30.0):
+
+    c = cw.getCenter()
+    z = cw.getZoom()
+
+    steps = max(int(seconds / sleepInterval), 1)
+
+    for i in range(1, steps+1):
+        f = float(i) / float(steps)
+
+        cw.setZoom(z * pow(zoom / z, f))
+        cw.setCenter(c[0] + (centerX - c[0]) * f, c[1] + (centerY - c[1]) * f)
+
+        time.sleep(sleepInterval)
+
+# a fixed sequence of zooms and pans, each followed by a pause to let the view sharpen
+def replay(pause=3.0):
+
+    moves = [
+        (0.5, 0.5, 1.0),
+        (0.5, 0.5, 8.0),
+        (0.2, 0.2, 8.0),
+        (0.8, 0.2, 8.0),
+        (0.8, 0.8, 8.0),
+        (0.2, 0.8, 8.0),
+        (0.3, 0.7, 32.0),
+        (0.7, 0.3, 32.0),
+        (0.5, 0.5, 1.0)
+    ]
+
+    for m in moves:
+        move(m[0], m[1], m[2])
+        time.sleep(pause)
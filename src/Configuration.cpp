@@ -37,6 +37,7 @@
 /*********************************************************************/
 
 #include "Configuration.h"
+#include "ImagePyramidContainer.h"
 #include "log.h"
 #include "main.h"
 
@@ -92,8 +93,194 @@ Configuration::Configuration(const char * filename)
         fullscreen_ = 0;
     }
 
+    // get stream buffering parameters (optional)
+    query_.setQuery("string(/configuration/streaming/@bufferSize)");
+
+    int streamBufferBudgetMB = 0;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        streamBufferBudgetMB = qstring.toInt();
+    }
+
+    if(streamBufferBudgetMB <= 0)
+    {
+        streamBufferBudgetMB = STREAM_BUFFER_DEFAULT_BUDGET_MB;
+    }
+
+    // the budget is kept in an int of bytes
+    if(streamBufferBudgetMB > 2047)
+    {
+        streamBufferBudgetMB = 2047;
+    }
+
+    streamBufferBudget_ = streamBufferBudgetMB * 1024 * 1024;
+
+    query_.setQuery("string(/configuration/streaming/@bufferPolicy)");
+
+    // default to dropping the oldest segments
+    streamBufferPolicy_ = STREAM_BUFFER_DROP_OLDEST;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        qstring = qstring.trimmed();
+
+        if(qstring == "drop-non-keyframe")
+        {
+            streamBufferPolicy_ = STREAM_BUFFER_DROP_NON_KEYFRAME;
+        }
+        else if(qstring == "block-sender")
+        {
+            streamBufferPolicy_ = STREAM_BUFFER_BLOCK_SENDER;
+        }
+        else if(qstring.isEmpty() != true && qstring != "drop-oldest")
+        {
+            put_flog(LOG_WARN, "unknown stream buffer policy %s, using drop-oldest", qstring.toStdString().c_str());
+        }
+    }
+
+    put_flog(LOG_INFO, "stream buffers: budget = %i MB, policy = %i", streamBufferBudget_ / (1024 * 1024), streamBufferPolicy_);
+
+    // get pixel stream decoder parameters (optional)
+    query_.setQuery("string(/configuration/decoder/@threads)");
+
+    decoderThreads_ = 0;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        decoderThreads_ = qstring.toInt();
+
+        if(decoderThreads_ < 0)
+        {
+            decoderThreads_ = 0;
+        }
+    }
+
+    // cpus is a comma-separated list of CPUs or CPU ranges, e.g. "0-3,8-11"
+    query_.setQuery("string(/configuration/decoder/@cpus)");
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        QStringList cpuRanges = qstring.trimmed().split(",", QString::SkipEmptyParts);
+
+        for(int i=0; i<cpuRanges.size(); i++)
+        {
+            QStringList bounds = cpuRanges[i].split("-");
+
+            bool firstValid = false;
+            bool lastValid = true;
+
+            int first = bounds[0].trimmed().toInt(&firstValid);
+            int last = first;
+
+            if(bounds.size() > 1)
+            {
+                last = bounds[1].trimmed().toInt(&lastValid);
+            }
+
+            if(firstValid != true || lastValid != true || bounds.size() > 2 || first < 0 || last < first)
+            {
+                put_flog(LOG_WARN, "invalid decoder CPU range %s", cpuRanges[i].toStdString().c_str());
+                continue;
+            }
+
+            for(int cpu=first; cpu<=last; cpu++)
+            {
+                decoderCpus_.push_back(cpu);
+            }
+        }
+    }
+
+    put_flog(LOG_INFO, "decoder: threads = %i, cpus = %i", decoderThreads_, (int)decoderCpus_.size());
+
+    // get DynamicTexture cache budgets (optional)
+    query_.setQuery("string(/configuration/textureCache/@textureMemory)");
+
+    int textureCacheTextureBudgetMB = 0;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        textureCacheTextureBudgetMB = qstring.toInt();
+    }
+
+    if(textureCacheTextureBudgetMB <= 0)
+    {
+        textureCacheTextureBudgetMB = TEXTURE_CACHE_DEFAULT_TEXTURE_BUDGET_MB;
+    }
+
+    textureCacheTextureBudget_ = (qint64)textureCacheTextureBudgetMB * 1024 * 1024;
+
+    query_.setQuery("string(/configuration/textureCache/@imageMemory)");
+
+    int textureCacheImageBudgetMB = 0;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        textureCacheImageBudgetMB = qstring.toInt();
+    }
+
+    if(textureCacheImageBudgetMB <= 0)
+    {
+        textureCacheImageBudgetMB = TEXTURE_CACHE_DEFAULT_IMAGE_BUDGET_MB;
+    }
+
+    textureCacheImageBudget_ = (qint64)textureCacheImageBudgetMB * 1024 * 1024;
+
+    put_flog(LOG_INFO, "texture cache: texture memory = %i MB, image memory = %i MB", textureCacheTextureBudgetMB, textureCacheImageBudgetMB);
+
+    // get image reader memory cap (optional)
+    query_.setQuery("string(/configuration/imageReader/@memory)");
+
+    int imageReaderMemoryBudgetMB = 0;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        imageReaderMemoryBudgetMB = qstring.toInt();
+    }
+
+    if(imageReaderMemoryBudgetMB <= 0)
+    {
+        imageReaderMemoryBudgetMB = IMAGE_READER_DEFAULT_MEMORY_BUDGET_MB;
+    }
+
+    imageReaderMemoryBudget_ = (qint64)imageReaderMemoryBudgetMB * 1024 * 1024;
+
+    put_flog(LOG_INFO, "image reader: memory = %i MB", imageReaderMemoryBudgetMB);
+
+    // get DynamicTexture tile size and mipmapping (optional)
+    query_.setQuery("string(/configuration/dynamicTexture/@tileSize)");
+
+    dynamicTextureTileSize_ = DYNAMIC_TEXTURE_DEFAULT_TILE_SIZE;
+
+    if(query_.evaluateTo(&qstring) == true && qstring.isEmpty() != true)
+    {
+        int tileSize = qstring.toInt();
+
+        if(ImagePyramidContainer::isValidTileSize(tileSize) == true)
+        {
+            dynamicTextureTileSize_ = tileSize;
+        }
+        else
+        {
+            put_flog(LOG_WARN, "unsupported dynamic texture tile size %i, using %i", tileSize, dynamicTextureTileSize_);
+        }
+    }
+
+    query_.setQuery("string(/configuration/dynamicTexture/@mipmaps)");
+
+    dynamicTextureMipmaps_ = false;
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        dynamicTextureMipmaps_ = (qstring.toInt() != 0);
+    }
+
+    put_flog(LOG_INFO, "dynamic texture: tile size = %i, mipmaps = %i", dynamicTextureTileSize_, dynamicTextureMipmaps_);
+
     put_flog(LOG_INFO, "dimensions: numTilesWidth = %i, numTilesHeight = %i, screenWidth = %i, screenHeight = %i, mullionWidth = %i, mullionHeight = %i. fullscreen = %i", numTilesWidth_, numTilesHeight_, screenWidth_, screenHeight_, mullionWidth_, mullionHeight_, fullscreen_);
 
+    singleContext_ = false;
+
     // get tile parameters (if we're not rank 0)
     if(g_mpiRank > 0)
     {
@@ -118,13 +305,22 @@ Configuration::Configuration(const char * filename)
             display_ = std::string("default (:0)"); // the default
         }
 
+        // get single context mode (optional attribute)
+        sprintf(string, "string(//process[%i]/@singleContext)", processIndex);
+        query_.setQuery(string);
+
+        if(query_.evaluateTo(&qstring) == true)
+        {
+            singleContext_ = (qstring.toInt() != 0);
+        }
+
         // get number of tiles for my process
         sprintf(string, "string(count(//process[%i]/screen))", processIndex);
         query_.setQuery(string);
         query_.evaluateTo(&qstring);
         myNumTiles_ = qstring.toInt();
 
-        put_flog(LOG_INFO, "rank %i: %i tiles", processIndex, myNumTiles_);
+        put_flog(LOG_INFO, "rank %i: %i tiles, single context = %i", processIndex, myNumTiles_, singleContext_);
 
         // populate parameters for each tile
         for(int i=1; i<=myNumTiles_; i++)
@@ -224,6 +420,11 @@ std::string Configuration::getMyDisplay()
     return display_;
 }
 
+bool Configuration::getMySingleContext()
+{
+    return singleContext_;
+}
+
 int Configuration::getMyNumTiles()
 {
     return myNumTiles_;
@@ -248,3 +449,48 @@ int Configuration::getTileJ(int i)
 {
     return tileJ_[i];
 }
+
+int Configuration::getStreamBufferBudget()
+{
+    return streamBufferBudget_;
+}
+
+STREAM_BUFFER_POLICY Configuration::getStreamBufferPolicy()
+{
+    return streamBufferPolicy_;
+}
+
+int Configuration::getDecoderThreads()
+{
+    return decoderThreads_;
+}
+
+std::vector<int> Configuration::getDecoderCpus()
+{
+    return decoderCpus_;
+}
+
+qint64 Configuration::getTextureCacheTextureBudget()
+{
+    return textureCacheTextureBudget_;
+}
+
+qint64 Configuration::getTextureCacheImageBudget()
+{
+    return textureCacheImageBudget_;
+}
+
+qint64 Configuration::getImageReaderMemoryBudget()
+{
+    return imageReaderMemoryBudget_;
+}
+
+int Configuration::getDynamicTextureTileSize()
+{
+    return dynamicTextureTileSize_;
+}
+
+bool Configuration::getDynamicTextureMipmaps()
+{
+    return dynamicTextureMipmaps_;
+}
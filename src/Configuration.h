@@ -42,6 +42,22 @@
 #include <QtGui>
 #include <QtXmlPatterns>
 
+// default per-stream buffer budget, in megabytes
+#define STREAM_BUFFER_DEFAULT_BUDGET_MB 256
+
+// default DynamicTexture cache budgets, in megabytes
+#define TEXTURE_CACHE_DEFAULT_TEXTURE_BUDGET_MB 512
+#define TEXTURE_CACHE_DEFAULT_IMAGE_BUDGET_MB 1024
+
+// default per-process memory cap for decoding source images, in megabytes
+#define IMAGE_READER_DEFAULT_MEMORY_BUDGET_MB 2048
+
+// default DynamicTexture tile size, for images that aren't pyramids and new pyramids
+#define DYNAMIC_TEXTURE_DEFAULT_TILE_SIZE 512
+
+// what to do when a stream's buffered segments exceed the budget
+enum STREAM_BUFFER_POLICY { STREAM_BUFFER_DROP_OLDEST, STREAM_BUFFER_DROP_NON_KEYFRAME, STREAM_BUFFER_BLOCK_SENDER };
+
 class Configuration {
 
     public:
@@ -61,12 +77,37 @@ class Configuration {
         std::string getMyHost();
         std::string getMyDisplay();
 
+        // whether all tiles of this process are rendered to viewports of one window and OpenGL context,
+        // instead of a window per tile. tiles that aren't contiguous on one X screen get a window each anyway
+        bool getMySingleContext();
+
         int getMyNumTiles();
         int getTileX(int i);
         int getTileY(int i);
         int getTileI(int i);
         int getTileJ(int i);
 
+        // per-stream buffer budget in bytes, and policy when it is exceeded
+        int getStreamBufferBudget();
+        STREAM_BUFFER_POLICY getStreamBufferPolicy();
+
+        // number of pixel stream decoder threads (0 for the default), and the CPUs they
+        // should run on (empty for no affinity)
+        int getDecoderThreads();
+        std::vector<int> getDecoderCpus();
+
+        // DynamicTexture cache budgets in bytes, for textures (GPU memory) and decoded
+        // images (host memory)
+        qint64 getTextureCacheTextureBudget();
+        qint64 getTextureCacheImageBudget();
+
+        // memory cap in bytes for decoding source images, shared by all images in the process
+        qint64 getImageReaderMemoryBudget();
+
+        // DynamicTexture tile size (256, 512, 1024 or 2048) and whether tiles are mipmapped
+        int getDynamicTextureTileSize();
+        bool getDynamicTextureMipmaps();
+
     private:
 
         QXmlQuery query_;
@@ -79,8 +120,23 @@ class Configuration {
         int mullionHeight_;
         int fullscreen_;
 
+        int streamBufferBudget_;
+        STREAM_BUFFER_POLICY streamBufferPolicy_;
+
+        int decoderThreads_;
+        std::vector<int> decoderCpus_;
+
+        qint64 textureCacheTextureBudget_;
+        qint64 textureCacheImageBudget_;
+
+        qint64 imageReaderMemoryBudget_;
+
+        int dynamicTextureTileSize_;
+        bool dynamicTextureMipmaps_;
+
         std::string host_;
         std::string display_;
+        bool singleContext_;
 
         int myNumTiles_;
         std::vector<int> tileX_;
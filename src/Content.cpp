@@ -96,6 +96,9 @@ void Content::render(boost::shared_ptr<ContentWindowManager> window)
     glTranslatef(x, y, 0.);
     glScalef(w, h, 1.);
 
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+    glWindow->pushContentTransform(x, y, w, h);
+
     // render the factory object
     renderFactoryObject(tX, tY, tW, tH);
 
@@ -115,51 +118,90 @@ void Content::render(boost::shared_ptr<ContentWindowManager> window)
         glTranslatef(padding, 1. - sizeFactor - padding, deltaZ);
         glScalef(sizeFactor, sizeFactor, 1.);
 
+        glWindow->pushContentTransform(padding, 1. - sizeFactor - padding, sizeFactor, sizeFactor, deltaZ);
+
+        bool retainedRendering = glWindow->getRetainedRendering();
+        RenderList & renderList = glWindow->getRenderList();
+
         // render border rectangle
         glColor4f(1,1,1,1);
+        renderList.setColor(1,1,1,1);
 
-        glLineWidth(borderPixels);
+        if(retainedRendering == true)
+        {
+            renderList.addLineLoop(QRectF(0., 0., 1., 1.), borderPixels);
+        }
+        else
+        {
+            glLineWidth(borderPixels);
 
-        glBegin(GL_LINE_LOOP);
+            glBegin(GL_LINE_LOOP);
 
-        glVertex2d(0., 0.);
-        glVertex2d(1., 0.);
-        glVertex2d(1., 1.);
-        glVertex2d(0., 1.);
+            glVertex2d(0., 0.);
+            glVertex2d(1., 0.);
+            glVertex2d(1., 1.);
+            glVertex2d(0., 1.);
 
-        glEnd();
+            glEnd();
+        }
 
         // render the factory object (full view)
         glTranslatef(0., 0., deltaZ);
+        glWindow->pushContentTransform(0., 0., 1., 1., deltaZ);
+
         renderFactoryObject(0., 0., 1., 1.);
 
         // draw context rectangle border
         glTranslatef(0., 0., deltaZ);
+        glWindow->pushContentTransform(0., 0., 1., 1., deltaZ);
 
-        glLineWidth(borderPixels);
+        if(retainedRendering == true)
+        {
+            renderList.addLineLoop(QRectF(tX, tY, tW, tH), borderPixels);
+        }
+        else
+        {
+            glLineWidth(borderPixels);
 
-        glBegin(GL_LINE_LOOP);
+            glBegin(GL_LINE_LOOP);
 
-        glVertex2d(tX, tY);
-        glVertex2d(tX + tW, tY);
-        glVertex2d(tX + tW, tY + tH);
-        glVertex2d(tX, tY + tH);
+            glVertex2d(tX, tY);
+            glVertex2d(tX + tW, tY);
+            glVertex2d(tX + tW, tY + tH);
+            glVertex2d(tX, tY + tH);
 
-        glEnd();
+            glEnd();
+        }
 
         // draw context rectangle blended
         glTranslatef(0., 0., deltaZ);
+        glWindow->pushContentTransform(0., 0., 1., 1., deltaZ);
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        if(retainedRendering == true)
+        {
+            renderList.setColor(1.,1.,1., alpha);
+            renderList.addQuad(QRectF(tX, tY, tW, tH), true);
+        }
+        else
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        glColor4f(1.,1.,1., alpha);
-        GLWindow::drawRectangle(tX, tY, tW, tH);
+            glColor4f(1.,1.,1., alpha);
+            GLWindow::drawRectangle(tX, tY, tW, tH);
+        }
+
+        for(int i=0; i<4; i++)
+        {
+            glWindow->popContentTransform();
+        }
 
         glPopMatrix();
         glPopAttrib();
     }
 
+    glWindow->popContentTransform();
+
     glPopMatrix();
 }
 
@@ -225,7 +267,7 @@ boost::shared_ptr<Content> Content::getContent(std::string uri)
         return c;
     }
     // see if this is an image pyramid
-    else if(fileTypeString.endsWith(".pyr"))
+    else if(fileTypeString.endsWith(".pyr") || fileTypeString.endsWith(".dcpyr"))
     {
         boost::shared_ptr<Content> c(new DynamicTextureContent(uri));
 
@@ -68,6 +68,10 @@ class Content : public QObject {
         virtual void getFactoryObjectDimensions(int &width, int &height) = 0;
         void render(boost::shared_ptr<ContentWindowManager> window);
 
+        // keep the factory object, if any, when the window isn't rendered because it was culled;
+        // parallel pixel streams also create theirs
+        virtual void touchFactoryObject() = 0;
+
         // virtual method for implementing actions on advancing to a new frame
         // useful when a process has multiple GLWindows
         virtual void advance(boost::shared_ptr<ContentWindowManager>) { }
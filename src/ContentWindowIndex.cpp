@@ -0,0 +1,122 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ContentWindowIndex.h"
+#include <algorithm>
+#include <cmath>
+
+ContentWindowIndex::ContentWindowIndex()
+{
+    cells_.resize(CONTENT_WINDOW_INDEX_GRID_SIZE * CONTENT_WINDOW_INDEX_GRID_SIZE);
+}
+
+void ContentWindowIndex::build(const std::vector<QRectF> & rects)
+{
+    rects_ = rects;
+
+    for(unsigned int i=0; i<cells_.size(); i++)
+    {
+        cells_[i].clear();
+    }
+
+    for(unsigned int n=0; n<rects_.size(); n++)
+    {
+        int i0, j0, i1, j1;
+        getCellRange(rects_[n], i0, j0, i1, j1);
+
+        for(int j=j0; j<=j1; j++)
+        {
+            for(int i=i0; i<=i1; i++)
+            {
+                cells_[j * CONTENT_WINDOW_INDEX_GRID_SIZE + i].push_back(n);
+            }
+        }
+    }
+}
+
+std::vector<int> ContentWindowIndex::query(const QRectF & rect)
+{
+    std::vector<int> indices;
+
+    int i0, j0, i1, j1;
+    getCellRange(rect, i0, j0, i1, j1);
+
+    // a rectangle can be in several cells; only test each once
+    std::vector<bool> tested(rects_.size(), false);
+
+    for(int j=j0; j<=j1; j++)
+    {
+        for(int i=i0; i<=i1; i++)
+        {
+            std::vector<int> & cell = cells_[j * CONTENT_WINDOW_INDEX_GRID_SIZE + i];
+
+            for(unsigned int k=0; k<cell.size(); k++)
+            {
+                int n = cell[k];
+
+                if(tested[n] == true)
+                {
+                    continue;
+                }
+
+                tested[n] = true;
+
+                if(rects_[n].intersects(rect) == true)
+                {
+                    indices.push_back(n);
+                }
+            }
+        }
+    }
+
+    std::sort(indices.begin(), indices.end());
+
+    return indices;
+}
+
+void ContentWindowIndex::getCellRange(const QRectF & rect, int & i0, int & j0, int & i1, int & j1)
+{
+    QRectF r = rect.normalized();
+
+    int last = CONTENT_WINDOW_INDEX_GRID_SIZE - 1;
+
+    i0 = std::max(0, std::min(last, (int)floor(r.left() * CONTENT_WINDOW_INDEX_GRID_SIZE)));
+    i1 = std::max(0, std::min(last, (int)floor(r.right() * CONTENT_WINDOW_INDEX_GRID_SIZE)));
+    j0 = std::max(0, std::min(last, (int)floor(r.top() * CONTENT_WINDOW_INDEX_GRID_SIZE)));
+    j1 = std::max(0, std::min(last, (int)floor(r.bottom() * CONTENT_WINDOW_INDEX_GRID_SIZE)));
+}
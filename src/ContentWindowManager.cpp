@@ -107,6 +107,11 @@ void ContentWindowManager::setDisplayGroupManager(boost::shared_ptr<DisplayGroup
         connect(this, SIGNAL(windowStateChanged(ContentWindowInterface::WindowState, ContentWindowInterface *)), displayGroupManager.get(), SLOT(sendDisplayGroup()));
         connect(this, SIGNAL(interactionStateChanged(InteractionState, ContentWindowInterface *)), displayGroupManager.get(), SLOT(sendDisplayGroup()));
 
+        // window moves and resizes invalidate the display group's spatial index of windows
+        connect(this, SIGNAL(coordinatesChanged(double, double, double, double, ContentWindowInterface *)), displayGroupManager.get(), SLOT(invalidateContentWindowIndex()));
+        connect(this, SIGNAL(positionChanged(double, double, ContentWindowInterface *)), displayGroupManager.get(), SLOT(invalidateContentWindowIndex()));
+        connect(this, SIGNAL(sizeChanged(double, double, ContentWindowInterface *)), displayGroupManager.get(), SLOT(invalidateContentWindowIndex()));
+
         // we don't call sendDisplayGroup() on movedToFront() or destroyed() since it happens already
     }
 }
@@ -135,6 +140,8 @@ void ContentWindowManager::render()
 {
     content_->render(shared_from_this());
 
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+
     // optionally render the border
     bool showWindowBorders = true;
 
@@ -157,29 +164,33 @@ void ContentWindowManager::render()
 
         double verticalBorder = (double)g_configuration->getTotalHeight() / (double)g_configuration->getTotalWidth() * horizontalBorder;
 
-        glPushAttrib(GL_CURRENT_BIT);
-
         // color the border based on window state
-        if(windowState_ == UNSELECTED)
+        float borderColor[4] = { 1, 1, 1, 1 };
+
+        if(windowState_ == SELECTED)
         {
-            glColor4f(1,1,1,1);
+            borderColor[1] = borderColor[2] = 0;
         }
-        else if(windowState_ == SELECTED)
+        else if(windowState_ == INTERACTION)
         {
-            glColor4f(1,0,0,1);
+            borderColor[0] = borderColor[2] = 0;
         }
-        else if(windowState_ == INTERACTION)
+
+        if(glWindow->getRetainedRendering() == true)
         {
-            glColor4f(0,1,0,1);
+            glWindow->getRenderList().setColor(borderColor[0], borderColor[1], borderColor[2], borderColor[3]);
+            glWindow->getRenderList().addQuad(QRectF(x_-verticalBorder,y_-horizontalBorder,w_+2.*verticalBorder,h_+2.*horizontalBorder));
         }
         else
         {
-            glColor4f(1,1,1,1);
-        }
+            glPushAttrib(GL_CURRENT_BIT);
 
-        GLWindow::drawRectangle(x_-verticalBorder,y_-horizontalBorder,w_+2.*verticalBorder,h_+2.*horizontalBorder);
+            glColor4fv(borderColor);
 
-        glPopAttrib();
+            GLWindow::drawRectangle(x_-verticalBorder,y_-horizontalBorder,w_+2.*verticalBorder,h_+2.*horizontalBorder);
+
+            glPopAttrib();
+        }
     }
 
     glPushAttrib(GL_CURRENT_BIT);
@@ -212,14 +223,44 @@ void ContentWindowManager::render()
         // we need this to be slightly in front of the rest of the window
         glPushMatrix();
         glTranslatef(0,0,0.001);
+        glWindow->pushContentTransform(0.,0.,1.,1.,0.001);
 
         // button dimensions
         float buttonWidth, buttonHeight;
         getButtonDimensions(buttonWidth, buttonHeight);
 
-        // draw close button
         QRectF closeRect(x_ + w_ - buttonWidth, y_, buttonWidth, buttonHeight);
+        QRectF resizeRect(x_ + w_ - buttonWidth, y_ + h_ - buttonHeight, buttonWidth, buttonHeight);
 
+        if(glWindow->getRetainedRendering() == true)
+        {
+            RenderList & renderList = glWindow->getRenderList();
+
+            // close button: semi-transparent background, border, and cross
+            renderList.setColor(1,0,0,0.125);
+            renderList.addQuad(closeRect, true, false);
+
+            renderList.setColor(1,0,0,1);
+            renderList.addLineLoop(closeRect);
+            renderList.addLine(closeRect.topLeft(), closeRect.bottomRight());
+            renderList.addLine(closeRect.topRight(), closeRect.bottomLeft());
+
+            // resize indicator: semi-transparent background, border, and diagonal
+            renderList.setColor(0.5,0.5,0.5,0.25);
+            renderList.addQuad(resizeRect, true, false);
+
+            renderList.setColor(0.5,0.5,0.5,1);
+            renderList.addLineLoop(resizeRect);
+            renderList.addLine(resizeRect.topRight(), resizeRect.bottomLeft());
+
+            glWindow->popContentTransform();
+            glPopMatrix();
+            glPopAttrib();
+
+            return;
+        }
+
+        // draw close button
         // semi-transparent background
         glColor4f(1,0,0,0.125);
 
@@ -254,8 +295,6 @@ void ContentWindowManager::render()
         glEnd();
 
         // resize indicator
-        QRectF resizeRect(x_ + w_ - buttonWidth, y_ + h_ - buttonHeight, buttonWidth, buttonHeight);
-
         // semi-transparent background
         glColor4f(0.5,0.5,0.5,0.25);
 
@@ -287,6 +326,7 @@ void ContentWindowManager::render()
         glVertex2f(resizeRect.x(), resizeRect.y() + resizeRect.height());
         glEnd();
 
+        glWindow->popContentTransform();
         glPopMatrix();
     }
 
@@ -39,6 +39,8 @@
 #include "DisplayGroupGraphicsScene.h"
 #include "main.h"
 #include "Marker.h"
+#include "FrameStatistics.h"
+#include <algorithm>
 
 DisplayGroupGraphicsScene::DisplayGroupGraphicsScene()
 {
@@ -106,6 +108,92 @@ void DisplayGroupGraphicsScene::refreshTileRects()
             tileRects_.push_back(addRect(left, bottom, right-left, top-bottom, pen, brush));
         }
     }
+
+    refreshTileStatistics();
+}
+
+void DisplayGroupGraphicsScene::refreshTileStatistics()
+{
+    // tile rects are ordered by column, then row
+    int numTilesHeight = g_configuration->getNumTilesHeight();
+
+    // default border, fill color / opacity
+    QPen pen;
+    pen.setColor(QColor(0,0,0));
+
+    for(unsigned int i=0; i<tileRects_.size(); i++)
+    {
+        tileRects_[i]->setPen(pen);
+        tileRects_[i]->setBrush(QBrush(QColor(0, 0, 0, 32)));
+        tileRects_[i]->setToolTip(QString());
+    }
+
+    // the straggler's tiles are outlined in red, whether or not frame statistics are shown
+    QPen stragglerPen;
+    stragglerPen.setColor(QColor(255,0,0));
+    stragglerPen.setWidth(3);
+    stragglerPen.setCosmetic(true);
+
+    int stragglerRank = g_frameStatistics->getStragglerRank();
+
+    std::vector<FrameStatisticsReport> reports = g_frameStatistics->getReports();
+
+    for(unsigned int i=0; i<reports.size(); i++)
+    {
+        if(reports[i].rank == stragglerRank)
+        {
+            for(unsigned int j=0; j<reports[i].tileI.size(); j++)
+            {
+                unsigned int index = reports[i].tileI[j] * numTilesHeight + reports[i].tileJ[j];
+
+                if(index < tileRects_.size())
+                {
+                    tileRects_[index]->setPen(stragglerPen);
+                }
+            }
+        }
+
+        if(g_displayGroupManager->getOptions()->getShowFrameStatistics() != true)
+        {
+            continue;
+        }
+
+        // green at or under the target frame time, to red at twice the target
+        double busyTime = reports[i].getBusyTime();
+        double t = std::max(0., std::min(1., busyTime / FRAME_STATISTICS_TARGET_FRAME_TIME - 1.));
+
+        QColor color = QColor::fromHsvF((1. - t) / 3., 1., 1., 0.5);
+
+        QString toolTip = "Rank " + QString::number(reports[i].rank) + " (" + QString(reports[i].host.c_str()) + "): " + QString::number(busyTime, 'f', 2) + " ms";
+
+        for(unsigned int j=0; j<reports[i].phaseTimes.size(); j++)
+        {
+            toolTip += "\n" + QString(FrameStatistics::getPhaseName((FRAME_PHASE)j)) + ": " + QString::number(reports[i].phaseTimes[j], 'f', 2) + " ms";
+        }
+
+        toolTip += "\ntime to barrier: " + QString::number(reports[i].timeToBarrier, 'f', 2) + " ms (max " + QString::number(reports[i].maxTimeToBarrier, 'f', 2) + " ms)";
+
+        if(reports[i].rank == stragglerRank)
+        {
+            toolTip += "\nstraggler, rendering:";
+
+            for(unsigned int j=0; j<reports[i].contentURIs.size(); j++)
+            {
+                toolTip += "\n" + QString(reports[i].contentURIs[j].c_str());
+            }
+        }
+
+        for(unsigned int j=0; j<reports[i].tileI.size(); j++)
+        {
+            unsigned int index = reports[i].tileI[j] * numTilesHeight + reports[i].tileJ[j];
+
+            if(index < tileRects_.size())
+            {
+                tileRects_[index]->setBrush(QBrush(color));
+                tileRects_[index]->setToolTip(toolTip);
+            }
+        }
+    }
 }
 
 void DisplayGroupGraphicsScene::mouseMoveEvent(QGraphicsSceneMouseEvent * event)
@@ -53,6 +53,9 @@ class DisplayGroupGraphicsScene : public QGraphicsScene {
 
         void refreshTileRects();
 
+        // color the tiles by the frame time of their render processes, if the option is enabled
+        void refreshTileStatistics();
+
     protected:
 
         void mouseMoveEvent(QGraphicsSceneMouseEvent * event);
@@ -42,6 +42,8 @@
 #include "DisplayGroupManager.h"
 #include "ContentWindowManager.h"
 #include "ContentWindowGraphicsItem.h"
+#include "FrameStatistics.h"
+#include "main.h"
 
 DisplayGroupGraphicsViewProxy::DisplayGroupGraphicsViewProxy(boost::shared_ptr<DisplayGroupManager> displayGroupManager) : DisplayGroupInterface(displayGroupManager)
 {
@@ -50,6 +52,9 @@ DisplayGroupGraphicsViewProxy::DisplayGroupGraphicsViewProxy(boost::shared_ptr<D
 
     // connect Options updated signal
     connect(displayGroupManager->getOptions().get(), SIGNAL(updated()), this, SLOT(optionsUpdated()));
+
+    // connect frame statistics reports of the render processes
+    connect(g_frameStatistics, SIGNAL(reportsUpdated()), this, SLOT(frameStatisticsUpdated()));
 }
 
 DisplayGroupGraphicsViewProxy::~DisplayGroupGraphicsViewProxy()
@@ -123,3 +128,8 @@ void DisplayGroupGraphicsViewProxy::optionsUpdated()
     // mullion compensation may have been enabled or disabled, so refresh the tiled display rectangles
     ((DisplayGroupGraphicsScene *)(graphicsView_->scene()))->refreshTileRects();
 }
+
+void DisplayGroupGraphicsViewProxy::frameStatisticsUpdated()
+{
+    ((DisplayGroupGraphicsScene *)(graphicsView_->scene()))->refreshTileStatistics();
+}
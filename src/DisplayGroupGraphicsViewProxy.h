@@ -62,6 +62,7 @@ class DisplayGroupGraphicsViewProxy : public DisplayGroupInterface {
     public slots:
 
         void optionsUpdated();
+        void frameStatisticsUpdated();
 
     private:
 
@@ -47,6 +47,8 @@
 #include "ParallelPixelStreamContent.h"
 #include "SVGStreamSource.h"
 #include "SVGContent.h"
+#include "FrameStatistics.h"
+#include "ParallelPixelStreamSynchronizer.h"
 #include <sstream>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/shared_ptr.hpp>
@@ -59,6 +61,8 @@
 
 DisplayGroupManager::DisplayGroupManager()
 {
+    contentWindowIndexValid_ = false;
+
     // create new Options object
     boost::shared_ptr<Options> options(new Options());
     options_ = options;
@@ -127,6 +131,8 @@ void DisplayGroupManager::addContentWindowManager(boost::shared_ptr<ContentWindo
 {
     DisplayGroupInterface::addContentWindowManager(contentWindowManager, source);
 
+    invalidateContentWindowIndex();
+
     if(source != this)
     {
         // set display group in content window manager object
@@ -143,6 +149,8 @@ void DisplayGroupManager::removeContentWindowManager(boost::shared_ptr<ContentWi
 {
     DisplayGroupInterface::removeContentWindowManager(contentWindowManager, source);
 
+    invalidateContentWindowIndex();
+
     if(source != this)
     {
         // set null display group in content window manager object
@@ -156,12 +164,39 @@ void DisplayGroupManager::moveContentWindowManagerToFront(boost::shared_ptr<Cont
 {
     DisplayGroupInterface::moveContentWindowManagerToFront(contentWindowManager, source);
 
+    invalidateContentWindowIndex();
+
     if(source != this)
     {
         sendDisplayGroup();
     }
 }
 
+std::vector<int> DisplayGroupManager::findContentWindowManagers(QRectF rect)
+{
+    if(contentWindowIndexValid_ != true)
+    {
+        // the largest border ContentWindowManager::render() draws: 20 pixels when highlighted
+        double horizontalBorder = 20. / (double)g_configuration->getTotalHeight();
+        double verticalBorder = (double)g_configuration->getTotalHeight() / (double)g_configuration->getTotalWidth() * horizontalBorder;
+
+        std::vector<QRectF> rects;
+
+        for(unsigned int i=0; i<contentWindowManagers_.size(); i++)
+        {
+            double x, y, w, h;
+            contentWindowManagers_[i]->getCoordinates(x, y, w, h);
+
+            rects.push_back(QRectF(x-verticalBorder, y-horizontalBorder, w+2.*verticalBorder, h+2.*horizontalBorder));
+        }
+
+        contentWindowIndex_.build(rects);
+        contentWindowIndexValid_ = true;
+    }
+
+    return contentWindowIndex_.query(rect);
+}
+
 void DisplayGroupManager::calibrateTimestampOffset()
 {
     // can't calibrate timestamps unless we have at least 2 processes
@@ -502,6 +537,8 @@ void DisplayGroupManager::receiveMessages()
         exit(-1);
     }
 
+    FrameStatisticsTimer timer(FRAME_PHASE_MESSAGES);
+
     // check to see if we have a message (non-blocking)
     int flag;
     MPI_Status status;
@@ -649,12 +686,12 @@ void DisplayGroupManager::sendContentsDimensionsRequest()
 void DisplayGroupManager::sendPixelStreams()
 {
     // iterate through all pixel streams and send updates if needed
-    std::map<std::string, boost::shared_ptr<PixelStreamSource> > map = g_pixelStreamSourceFactory.getMap();
+    FactorySnapshot<PixelStreamSource> snapshot = g_pixelStreamSourceFactory.getSnapshot();
 
-    for(std::map<std::string, boost::shared_ptr<PixelStreamSource> >::iterator it = map.begin(); it != map.end(); it++)
+    for(FactorySnapshot<PixelStreamSource>::const_iterator it = snapshot.begin(); it != snapshot.end(); it++)
     {
-        std::string uri = (*it).first;
-        boost::shared_ptr<PixelStreamSource> pixelStreamSource = (*it).second;
+        const std::string & uri = (*it).first;
+        const boost::shared_ptr<PixelStreamSource> & pixelStreamSource = (*it).second;
 
         // get buffer
         bool updated;
@@ -718,24 +755,32 @@ void DisplayGroupManager::sendPixelStreams()
 
 void DisplayGroupManager::sendParallelPixelStreams()
 {
+    // buffer state of the render processes, reported in the stream status
+    ParallelPixelStreamSynchronizer::receiveStreamStatus();
+
     // iterate through all parallel pixel streams and send updates if needed
-    std::map<std::string, boost::shared_ptr<ParallelPixelStream> > map = g_parallelPixelStreamSourceFactory.getMap();
+    FactorySnapshot<ParallelPixelStream> snapshot = g_parallelPixelStreamSourceFactory.getSnapshot();
 
-    for(std::map<std::string, boost::shared_ptr<ParallelPixelStream> >::iterator it = map.begin(); it != map.end(); it++)
+    for(FactorySnapshot<ParallelPixelStream>::const_iterator it = snapshot.begin(); it != snapshot.end(); it++)
     {
-        std::string uri = (*it).first;
-        boost::shared_ptr<ParallelPixelStream> parallelPixelStreamSource = (*it).second;
+        const std::string & uri = (*it).first;
+        const boost::shared_ptr<ParallelPixelStream> & parallelPixelStreamSource = (*it).second;
 
         // get updated segments
         // if streaming synchronization is enabled, we need to send all segments; otherwise just the latest segments
         std::vector<ParallelPixelStreamSegment> segments;
 
+        // drop segments if we're over the buffer budget
+        parallelPixelStreamSource->enforceBufferBudget();
+
         if(options_->getEnableStreamingSynchronization() == true)
         {
+            parallelPixelStreamSource->setSegmentConsumptionMode(SEGMENT_CONSUMPTION_ALL);
             segments = parallelPixelStreamSource->getAndPopAllSegments();
         }
         else
         {
+            parallelPixelStreamSource->setSegmentConsumptionMode(SEGMENT_CONSUMPTION_LATEST);
             segments = parallelPixelStreamSource->getAndPopLatestSegments();
         }
 
@@ -811,16 +856,17 @@ void DisplayGroupManager::sendParallelPixelStreams()
 void DisplayGroupManager::sendSVGStreams()
 {
     // iterate through all SVG streams and send updates if needed
-    std::map<std::string, boost::shared_ptr<SVGStreamSource> > map = g_SVGStreamSourceFactory.getMap();
+    FactorySnapshot<SVGStreamSource> snapshot = g_SVGStreamSourceFactory.getSnapshot();
 
-    for(std::map<std::string, boost::shared_ptr<SVGStreamSource> >::iterator it = map.begin(); it != map.end(); it++)
+    for(FactorySnapshot<SVGStreamSource>::const_iterator it = snapshot.begin(); it != snapshot.end(); it++)
     {
-        std::string uri = (*it).first;
-        boost::shared_ptr<SVGStreamSource> svgStreamSource = (*it).second;
+        const std::string & uri = (*it).first;
+        const boost::shared_ptr<SVGStreamSource> & svgStreamSource = (*it).second;
 
         // get buffer
         bool updated;
-        QByteArray imageData = svgStreamSource->getImageData(updated);
+        int newWidth, newHeight;
+        QByteArray imageData = svgStreamSource->getImageData(updated, newWidth, newHeight);
 
         if(updated == true)
         {
@@ -838,18 +884,7 @@ void DisplayGroupManager::sendSVGStreams()
                 addContentWindowManager(cwm);
             }
 
-            // check for updated dimensions
-            QSvgRenderer svgRenderer;
-
-            if(svgRenderer.load(imageData) != true || svgRenderer.isValid() == false)
-            {
-                put_flog(LOG_ERROR, "error loading %s", uri.c_str());
-                continue;
-            }
-
-            int newWidth = svgRenderer.defaultSize().width();
-            int newHeight = svgRenderer.defaultSize().height();
-
+            // check for updated dimensions, read by the SVG stream source when it received the image data
             boost::shared_ptr<ContentWindowManager> cwm = getContentWindowManager(uri, CONTENT_TYPE_SVG);
 
             if(cwm != NULL)
@@ -897,6 +932,8 @@ void DisplayGroupManager::sendFrameClockUpdate()
         return;
     }
 
+    FrameStatisticsTimer timer(FRAME_PHASE_FRAME_CLOCK);
+
     boost::shared_ptr<boost::posix_time::ptime> timestamp(new boost::posix_time::ptime(boost::posix_time::microsec_clock::universal_time()));
 
     // serialize state
@@ -938,6 +975,8 @@ void DisplayGroupManager::receiveFrameClockUpdate()
         return;
     }
 
+    FrameStatisticsTimer timer(FRAME_PHASE_FRAME_CLOCK);
+
     // receive the message header
     MessageHeader messageHeader;
     MPI_Status status;
@@ -992,6 +1031,8 @@ void DisplayGroupManager::sendQuit()
 
 void DisplayGroupManager::advanceContents()
 {
+    FrameStatisticsTimer timer(FRAME_PHASE_ADVANCE);
+
     // note that if we have multiple ContentWindowManagers corresponding to a single Content object,
     // we will call advance() multiple times per frame on that Content object...
     for(unsigned int i=0; i<contentWindowManagers_.size(); i++)
@@ -1000,6 +1041,11 @@ void DisplayGroupManager::advanceContents()
     }
 }
 
+void DisplayGroupManager::invalidateContentWindowIndex()
+{
+    contentWindowIndexValid_ = false;
+}
+
 #if ENABLE_SKELETON_SUPPORT
 void DisplayGroupManager::setSkeletons(std::vector< boost::shared_ptr<SkeletonState> > skeletons)
 {
@@ -1090,8 +1136,21 @@ void DisplayGroupManager::receivePixelStreams(MessageHeader messageHeader)
     // URI
     std::string uri = std::string(messageHeader.uri);
 
+    // decoding priority is the window's area
+    float area = 1.;
+
+    boost::shared_ptr<ContentWindowManager> cwm = getContentWindowManager(uri, CONTENT_TYPE_PIXEL_STREAM);
+
+    if(cwm != NULL)
+    {
+        double x, y, w, h;
+        cwm->getCoordinates(x, y, w, h);
+
+        area = (float)(w * h);
+    }
+
     // de-serialize...
-    g_mainWindow->getGLWindow()->getPixelStreamFactory().getObject(uri)->setImageData(QByteArray(buf, messageHeader.size));
+    g_mainWindow->getGLWindow()->getPixelStreamFactory().getObject(uri)->setImageData(QByteArray(buf, messageHeader.size), area);
 
     // free mpi buffer
     delete [] buf;
@@ -1123,14 +1182,29 @@ void DisplayGroupManager::receiveParallelPixelStreams(MessageHeader messageHeade
     boost::archive::binary_iarchive ia(iss);
     ia >> segments;
 
+    boost::shared_ptr<ParallelPixelStream> parallelPixelStream = g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(uri);
+
+    // synchronized streams need all segments, otherwise only the latest segments are used
+    if(options_->getEnableStreamingSynchronization() == true)
+    {
+        parallelPixelStream->setSegmentConsumptionMode(SEGMENT_CONSUMPTION_ALL);
+    }
+    else
+    {
+        parallelPixelStream->setSegmentConsumptionMode(SEGMENT_CONSUMPTION_LATEST);
+    }
+
     // now, insert all segments
     for(unsigned int i=0; i<segments.size(); i++)
     {
-        g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(uri)->insertSegment(segments[i]);
+        parallelPixelStream->insertSegment(segments[i]);
     }
 
+    // drop segments if we're falling behind and over the buffer budget
+    parallelPixelStream->enforceBufferBudget();
+
     // update pixel streams corresponding to new segments
-    g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(uri)->updatePixelStreams();
+    parallelPixelStream->updatePixelStreams();
 
     // free mpi buffer
     delete [] buf;
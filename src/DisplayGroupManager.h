@@ -43,6 +43,7 @@
 #include "DisplayGroupInterface.h"
 #include "Options.h"
 #include "Marker.h"
+#include "ContentWindowIndex.h"
 #include "config.h"
 #include <QtGui>
 #include <vector>
@@ -81,6 +82,10 @@ class DisplayGroupManager : public DisplayGroupInterface, public boost::enable_s
         void removeContentWindowManager(boost::shared_ptr<ContentWindowManager> contentWindowManager, DisplayGroupInterface * source=NULL);
         void moveContentWindowManagerToFront(boost::shared_ptr<ContentWindowManager> contentWindowManager, DisplayGroupInterface * source=NULL);
 
+        // indices, in depth order, of the content window managers whose windows (including borders) intersect rect
+        // uses a spatial index, rebuilt after content windows are added, removed, reordered or moved
+        std::vector<int> findContentWindowManagers(QRectF rect);
+
         // find the offset between the rank 0 clock and the rank 1 clock. recall the rank 1 clock is used across rank 1 - n.
         void calibrateTimestampOffset();
 
@@ -105,6 +110,8 @@ class DisplayGroupManager : public DisplayGroupInterface, public boost::enable_s
 
         void advanceContents();
 
+        void invalidateContentWindowIndex();
+
 #if ENABLE_SKELETON_SUPPORT
         void setSkeletons(std::vector<boost::shared_ptr<SkeletonState> > skeletons);
 #endif
@@ -141,6 +148,10 @@ class DisplayGroupManager : public DisplayGroupInterface, public boost::enable_s
         // rank 1 - rank 0 timestamp offset
         boost::posix_time::time_duration timestampOffset_;
 
+        // spatial index of content windows; not serialized, and rebuilt on demand
+        ContentWindowIndex contentWindowIndex_;
+        bool contentWindowIndexValid_;
+
         void receiveDisplayGroup(MessageHeader messageHeader);
         void receiveContentsDimensionsRequest(MessageHeader messageHeader);
         void receivePixelStreams(MessageHeader messageHeader);
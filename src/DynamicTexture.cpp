@@ -37,30 +37,30 @@
 /*********************************************************************/
 
 #include "DynamicTexture.h"
+#include "DynamicTextureLOD.h"
 #include "main.h"
-#include "vector.h"
 #include "log.h"
 #include <algorithm>
-#include <fstream>
 #include <string>
-#include <boost/tokenizer.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
-#ifdef __APPLE__
-    #include <OpenGL/glu.h>
-#else
-    #include <GL/glu.h>
-#endif
+long DynamicTexture::traversalCounts_[DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS];
+double DynamicTexture::traversalNodes_[DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS];
+double DynamicTexture::traversalTimes_[DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS];
 
 DynamicTexture::DynamicTexture(std::string uri, boost::shared_ptr<DynamicTexture> parent, float parentX, float parentY, float parentW, float parentH, int childIndex)
 {
     // defaults
     depth_ = 0;
     useImagePyramid_ = false;
-    threadCount_ = 0;
-    loadImageThreadStarted_ = false;
+    tileSize_ = DYNAMIC_TEXTURE_DEFAULT_TILE_SIZE;
+    mipmaps_ = false;
+    loadState_ = LOAD_IDLE;
     imageWidth_ = 0;
     imageHeight_ = 0;
     textureBound_ = false;
+    atlasSlot_ = -1;
+    textureBytes_ = 0;
 
     // assign values
     uri_ = uri;
@@ -75,9 +75,14 @@ DynamicTexture::DynamicTexture(std::string uri, boost::shared_ptr<DynamicTexture
     {
         depth_ = parent->depth_ + 1;
 
+        tileSize_ = parent->tileSize_;
+        mipmaps_ = parent->mipmaps_;
+
         // append childIndex to parent's path to form this object's path
         treePath_ = parent->treePath_;
         treePath_.push_back(childIndex);
+
+        cacheKey_ = parent->cacheKey_ + "-" + QString::number(childIndex).toStdString();
     }
 
     // if we're the top-level object
@@ -86,45 +91,53 @@ DynamicTexture::DynamicTexture(std::string uri, boost::shared_ptr<DynamicTexture
         // this is the top-level object, so its path is 0
         treePath_.push_back(0);
 
-        // see if this is an image pyramid metadata filename
-        if(uri.find(".pyr") != std::string::npos)
+        cacheKey_ = uri + "#0";
+
+        if(g_configuration != NULL)
         {
-            std::ifstream ifs(uri.c_str());
+            tileSize_ = g_configuration->getDynamicTextureTileSize();
+            mipmaps_ = g_configuration->getDynamicTextureMipmaps();
+        }
 
-            // read the whole line
-            std::string lineString;
-            getline(ifs, lineString);
+        // see if this is a single-file image pyramid container
+        if(uri.find(".dcpyr") != std::string::npos)
+        {
+            imagePyramidContainer_ = boost::shared_ptr<ImagePyramidContainer>(new ImagePyramidContainer(uri));
 
-            // parse the arguments, allowing escaped characters, quotes, etc., and assign them to a vector
-            std::string separator1("\\"); // allow escaped characters
-            std::string separator2(" "); // split on spaces
-            std::string separator3("\"\'"); // allow quoted arguments
+            if(imagePyramidContainer_->isValid() != true)
+            {
+                return;
+            }
 
-            boost::escaped_list_separator<char> els(separator1, separator2, separator3);
-            boost::tokenizer<boost::escaped_list_separator<char> > tok(lineString, els);
+            imageWidth_ = imagePyramidContainer_->getImageWidth();
+            imageHeight_ = imagePyramidContainer_->getImageHeight();
+            tileSize_ = imagePyramidContainer_->getTileSize();
 
-            std::vector<std::string> tokVector;
-            tokVector.assign(tok.begin(), tok.end());
+            useImagePyramid_ = true;
 
-            if(tokVector.size() < 3)
+            put_flog(LOG_DEBUG, "got image pyramid container %s, imageWidth = %i, imageHeight = %i, tileSize = %i", uri.c_str(), imageWidth_, imageHeight_, tileSize_);
+        }
+        // see if this is an image pyramid metadata filename
+        else if(uri.find(".pyr") != std::string::npos)
+        {
+            if(ImagePyramidContainer::readMetadata(uri, imagePyramidPath_, imageWidth_, imageHeight_, tileSize_) != true)
             {
-                put_flog(LOG_ERROR, "require 3 arguments, got %i", tokVector.size());
                 return;
             }
 
-            imagePyramidPath_ = tokVector[0];
-            imageWidth_ = atoi(tokVector[1].c_str());
-            imageHeight_ = atoi(tokVector[2].c_str());
-
             useImagePyramid_ = true;
 
-            put_flog(LOG_DEBUG, "got image pyramid path %s, imageWidth = %i, imageHeight = %i", imagePyramidPath_.c_str(), imageWidth_, imageHeight_);
+            put_flog(LOG_DEBUG, "got image pyramid path %s, imageWidth = %i, imageHeight = %i, tileSize = %i", imagePyramidPath_.c_str(), imageWidth_, imageHeight_, tileSize_);
+        }
+
+        if(useImagePyramid_ == true)
+        {
+            prefetcher_ = boost::shared_ptr<DynamicTexturePrefetcher>(new DynamicTexturePrefetcher(cacheKey_, imagePyramidPath_, imagePyramidContainer_, imageWidth_, imageHeight_, tileSize_));
         }
 
         // always load image for top-level object
-        incrementThreadCount();
+        loadState_ = LOAD_RUNNING;
         loadImageThread_ = QtConcurrent::run(loadImageThread, this);
-        loadImageThreadStarted_ = true;
     }
 }
 
@@ -133,8 +146,9 @@ DynamicTexture::~DynamicTexture()
     // delete bound texture
     if(textureBound_ == true)
     {
-        // let the OpenGL window delete the texture, so the destructor can occur in any thread...
-        g_mainWindow->getGLWindow()->insertPurgeTextureId(textureId_);
+        // give the texture to the cache, which will delete it when it is evicted
+        // this can occur in any thread, since the OpenGL window does the actual deletion
+        g_mainWindow->getGLWindow()->getDynamicTextureCache().insertTexture(cacheKey_, textureId_, atlasSlot_, textureBytes_);
 
         textureBound_ = false;
     }
@@ -157,123 +171,72 @@ void DynamicTexture::loadImage(bool convertToGLFormat)
 
     if(root->useImagePyramid_ == true)
     {
-        // form filename
-        std::string filename = root->imagePyramidPath_ + '/';
-
-        for(unsigned int i=0; i<treePath_.size(); i++)
+        if(loadImagePyramidTile(root->imagePyramidPath_, root->imagePyramidContainer_, treePath_, scaledImage_) != true)
         {
-            filename += QString::number(treePath_[i]).toStdString();
-
-            if(i != treePath_.size() - 1)
-            {
-                filename += "-";
-            }
+            put_flog(LOG_ERROR, "could not load image pyramid tile at depth %i", depth_);
         }
-
-        filename += ".jpg";
-
-        scaledImage_.load(QString(filename.c_str()), "jpg");
     }
     else
     {
-        // root node
         if(depth_ == 0)
         {
-            image_.load(uri_.c_str());
+            imageRegionReader_ = boost::shared_ptr<ImageRegionReader>(new ImageRegionReader(uri_));
 
-            if(image_.isNull() == true)
+            if(imageRegionReader_->isValid() != true)
             {
-                put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
+                put_flog(LOG_ERROR, "image cannot be read. aborting.");
+                exit(-1);
+                return;
             }
         }
-        else
+
+        boost::shared_ptr<ImageRegionReader> imageRegionReader = root->imageRegionReader_;
+
+        // get image rectangle for this object in the root's coordinates
+        QRect rootRect;
+
+        if(depth_ == 0)
         {
-            // get image from parent
-            boost::shared_ptr<DynamicTexture> parent = parent_.lock();
-            image_ = parent->getImageFromParent(parentX_, parentY_, parentW_, parentH_, this);
+            rootRect = QRect(0,0, imageRegionReader->getWidth(), imageRegionReader->getHeight());
         }
-
-        // if we managed to get a valid image, go ahead and scale it
-        // otherwise, we'll need to read it in differently...
-        if(image_.isNull() != true)
+        else
         {
-            // save image dimensions for later use; recall image may be deleted
-            imageWidth_ = image_.width();
-            imageHeight_ = image_.height();
+            rootRect = getRootImageCoordinates(0., 0., 1., 1.);
+        }
 
-            // compute the scaled image
-            scaledImage_ = image_.scaled(TEXTURE_SIZE, TEXTURE_SIZE);
+        // save the image dimensions (in terms of the root image) that this object represents
+        imageWidth_ = rootRect.width();
+        imageHeight_ = rootRect.height();
 
-            // only the root needs to keep the non-scaled image in this case
-            // we only want to keep the top-most valid image_ in the tree for memory efficiency
-            if(depth_ != 0)
+        if(imageRegionReader->supportsRegions() == true)
+        {
+            // decode only this object's region, at texture resolution
+            imageRegionReader->read(rootRect, QSize(tileSize_, tileSize_), scaledImage_);
+        }
+        else if(depth_ == 0)
+        {
+            // the whole image must be decoded to read any part of it, so the root keeps it for its descendants
+            if(imageRegionReader->readImage(image_) == true)
             {
-                image_ = QImage();
+                scaledImage_ = image_.scaled(tileSize_, tileSize_);
             }
         }
         else
         {
-            // we could not get a valid image_ from a parent
-            // try alternative methods of reading it using QImageReader
-            QImageReader imageReader(root->uri_.c_str());
+            // get image from the root
+            boost::shared_ptr<DynamicTexture> parent = parent_.lock();
+            QImage image = parent->getImageFromParent(parentX_, parentY_, parentW_, parentH_, this);
 
-            if(imageReader.canRead() == true)
+            if(image.isNull() != true)
             {
-                put_flog(LOG_DEBUG, "image can be read. trying alternate methods.");
-
-                // get image rectangle for this object in the root's coordinates
-                QRect rootRect;
-
-                if(depth_ == 0)
-                {
-                    rootRect = QRect(0,0, imageReader.size().width(), imageReader.size().height());
-                }
-                else
-                {
-                    rootRect = getRootImageCoordinates(0., 0., 1., 1.);
-                }
-
-                // save the image dimensions (in terms of the root image) that this object represents
-                imageWidth_ = rootRect.width();
-                imageHeight_ = rootRect.height();
-
-                put_flog(LOG_DEBUG, "reading clipped region of image");
-
-                imageReader.setClipRect(rootRect);
-                image_ = imageReader.read();
-
-                if(image_.isNull() != true)
-                {
-                    // successfully loaded clipped image
-                    // compute the scaled image
-                    scaledImage_ = image_.scaled(TEXTURE_SIZE, TEXTURE_SIZE);
-                }
-                else
-                {
-                    // failed to load the clipped image
-                    put_flog(LOG_DEBUG, "failed to read clipped region of image; attempting to read clipped and scaled region of image");
-
-                    QImageReader imageScaledReader(root->uri_.c_str());
-                    imageScaledReader.setClipRect(rootRect);
-                    imageScaledReader.setScaledSize(QSize(TEXTURE_SIZE, TEXTURE_SIZE));
-                    scaledImage_ = imageScaledReader.read();
-                }
-
-                // this means we couldn't get a scaled image by any means
-                if(scaledImage_.isNull() == true)
-                {
-                    put_flog(LOG_ERROR, "failed to read the image. aborting.");
-                    exit(-1);
-                    return;
-                }
-            }
-            else
-            {
-                put_flog(LOG_ERROR, "image cannot be read. aborting.");
-                exit(-1);
-                return;
+                scaledImage_ = image.scaled(tileSize_, tileSize_);
             }
         }
+
+        if(scaledImage_.isNull() == true)
+        {
+            put_flog(LOG_ERROR, "could not read image %s at depth %i", root->uri_.c_str(), depth_);
+        }
     }
 
     // optionally convert the image to OpenGL format
@@ -282,135 +245,122 @@ void DynamicTexture::loadImage(bool convertToGLFormat)
     if(convertToGLFormat == true)
     {
         scaledImage_ = QGLWidget::convertToGLFormat(scaledImage_);
+
+        // keep a copy in host memory in case the texture is evicted
+        g_mainWindow->getGLWindow()->getDynamicTextureCache().insertImage(cacheKey_, scaledImage_);
+    }
+}
+
+bool DynamicTexture::loadImagePyramidTile(std::string imagePyramidPath, boost::shared_ptr<ImagePyramidContainer> imagePyramidContainer, const std::vector<int> & treePath, QImage & image)
+{
+    if(imagePyramidContainer != NULL)
+    {
+        return imagePyramidContainer->loadTile(treePath, image);
+    }
+
+    // form filename
+    std::string filename = imagePyramidPath + '/';
+
+    for(unsigned int i=0; i<treePath.size(); i++)
+    {
+        filename += QString::number(treePath[i]).toStdString();
+
+        if(i != treePath.size() - 1)
+        {
+            filename += "-";
+        }
     }
+
+    filename += ".jpg";
+
+    return image.load(QString(filename.c_str()), "jpg");
 }
 
 void DynamicTexture::getDimensions(int &width, int &height)
 {
     // if we don't have a width and height, and the load image thread is running, wait for it to finish
-    if(imageWidth_ == 0 && imageHeight_ == 0 && loadImageThreadStarted_ == true)
+    if(imageWidth_ == 0 && imageHeight_ == 0)
     {
-        loadImageThread_.waitForFinished();
+        waitForImage();
     }
 
     width = imageWidth_;
     height = imageHeight_;
 }
 
-void DynamicTexture::render(float tX, float tY, float tW, float tH, bool computeOnDemand, bool considerChildren)
+void DynamicTexture::render(float tX, float tY, float tW, float tH)
 {
-    if(depth_ == 0)
-    {
-        updateRenderedFrameCount();
-    }
+    // only called on the root; the tiles to draw are found by a traversal of the tree computed on the CPU,
+    // from the window geometry and the content transform, and then drawn
+    updateRenderedFrameCount();
 
-    if(considerChildren == true && getProjectedPixelArea(true) > 0. && getProjectedPixelArea(false) > TEXTURE_SIZE*TEXTURE_SIZE && (getRoot()->imageWidth_ / pow(2,depth_) > TEXTURE_SIZE || getRoot()->imageHeight_ / pow(2,depth_) > TEXTURE_SIZE))
-    {
-        // mark this object as having rendered children in this frame
-        renderChildrenFrameCount_ = g_frameCount;
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
 
-        renderChildren(tX,tY,tW,tH);
-    }
-    else
+    DynamicTextureTraversal traversal;
+    traversal.root = this;
+    traversal.windowRect = QRectF(0., 0., (double)glWindow->getViewportWidth(), (double)glWindow->getViewportHeight());
+    traversal.numNodes = 0;
+
+    // window rectangle of this object's (0,0,1,1) rectangle
+    QRectF pixelRect = glWindow->getContentPixelRect();
+
+    if(prefetcher_ != NULL)
     {
-        // want to render this object
+        prefetcher_->update(g_frameCount, QRectF(tX,tY,tW,tH), DynamicTextureLOD::getScreenRect(pixelRect, traversal.windowRect), DynamicTextureLOD::getProjectedPixelArea(pixelRect, traversal.windowRect, false));
+    }
 
-        // see if we need to start loading the image
-        if(computeOnDemand == true && loadImageThreadStarted_ == false)
-        {
-            // only start the thread if this DynamicTexture tree has one available
-            // each DynamicTexture tree is limited to (maxThreads - 2) threads, where the max is determined by the global QThreadPool instance
-            // we increase responsiveness / interactivity by not queuing up image loading
-            // todo: this doesn't perform well with too many threads; restricting to 1 thread for now
-            int maxThreads = std::max(QThreadPool::globalInstance()->maxThreadCount() - 2, 1);
+    boost::posix_time::ptime traversalStart = boost::posix_time::microsec_clock::universal_time();
 
-            if(getThreadCount() < maxThreads)
-            {
-                incrementThreadCount();
+    traverse(QRectF(tX,tY,tW,tH), pixelRect, QRectF(0.,0.,1.,1.), traversal);
 
-                // give the thread shared_ptr's to all of this object's parents to prevent their destruction during thread execution
-                std::vector<boost::shared_ptr<DynamicTexture> > objects;
-                getObjectsAscending(objects);
+    boost::posix_time::ptime traversalEnd = boost::posix_time::microsec_clock::universal_time();
 
-                loadImageThread_ = QtConcurrent::run(loadImageThread, shared_from_this(), objects);
-                loadImageThreadStarted_ = true;
-            }
-        }
+    recordTraversal(traversal.numNodes, (double)(traversalEnd - traversalStart).total_microseconds());
 
-        // see if we need to load the texture
-        if(loadImageThreadStarted_ == true && loadImageThread_.isFinished() == true && textureBound_ == false)
-        {
-            uploadTexture();
-        }
+    if(glWindow->getRetainedRendering() == true)
+    {
+        RenderList & renderList = glWindow->getRenderList();
 
-        // if we don't yet have a texture, try to render from parent's texture
-        // however, we won't force an image/texture computation on the parent
-        if(textureBound_ == false)
+        // atlas quads, as x, y, s, t at each corner
+        for(std::map<GLuint, std::vector<GLfloat> >::iterator it=traversal.atlasVertices.begin(); it!=traversal.atlasVertices.end(); it++)
         {
-            // render from parent if we can
-            boost::shared_ptr<DynamicTexture> parent = parent_.lock();
+            std::vector<GLfloat> & pageVertices = it->second;
 
-            if(parent != NULL)
+            for(unsigned int i=0; i+16<=pageVertices.size(); i+=16)
             {
-                float pX = parentX_ + tX * parentW_;
-                float pY = parentY_ + tY * parentH_;
-                float pW = tW * parentW_;
-                float pH = tH * parentH_;
+                QRectF rect(pageVertices[i], pageVertices[i+1], pageVertices[i+8] - pageVertices[i], pageVertices[i+9] - pageVertices[i+1]);
+                QRectF textureRect(pageVertices[i+2], pageVertices[i+3], pageVertices[i+10] - pageVertices[i+2], pageVertices[i+11] - pageVertices[i+3]);
 
-                parent->render(pX, pY, pW, pH, false, false);
+                renderList.addTexturedQuad(it->first, rect, textureRect);
             }
         }
-        else
-        {
-#ifdef DYNAMIC_TEXTURE_SHOW_BORDER
-            // draw the border
-            glPushAttrib(GL_CURRENT_BIT);
-
-            glColor4f(0.,1.,0.,1.);
-
-            glBegin(GL_LINE_LOOP);
-            glVertex2f(0.,0.);
-            glVertex2f(1.,0.);
-            glVertex2f(1.,1.);
-            glVertex2f(0.,1.);
-            glEnd();
-
-            glPopAttrib();
-#endif
 
-            // draw the texture
-            glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
-
-            glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, textureId_);
-
-            // linear min / max filtering
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated)
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            glBegin(GL_QUADS);
+        for(unsigned int i=0; i<traversal.items.size(); i++)
+        {
+            QRectF textureRect = traversal.items[i].textureRect;
 
             // note we need to flip the y coordinate since the textures are loaded upside down
-            glTexCoord2f(tX,1.-tY);
-            glVertex2f(0.,0.);
+            renderList.addTexturedQuad(traversal.items[i].dynamicTexture->textureId_, traversal.items[i].rect, QRectF(textureRect.x(), 1.-textureRect.y(), textureRect.width(), -textureRect.height()));
+        }
 
-            glTexCoord2f(tX+tW,1.-tY);
-            glVertex2f(1.,0.);
+        return;
+    }
 
-            glTexCoord2f(tX+tW,1.-(tY+tH));
-            glVertex2f(1.,1.);
+    // tiles in the atlas are drawn with one draw call per atlas page
+    g_mainWindow->getGLWindow()->getDynamicTextureAtlas().draw(traversal.atlasVertices);
 
-            glTexCoord2f(tX,1.-(tY+tH));
-            glVertex2f(0.,1.);
+    // tiles with their own textures
+    for(unsigned int i=0; i<traversal.items.size(); i++)
+    {
+        QRectF rect = traversal.items[i].rect;
 
-            glEnd();
+        glPushMatrix();
+        glTranslatef(rect.x(), rect.y(), 0.);
+        glScalef(rect.width(), rect.height(), 1.);
 
-            glPopAttrib();
-        }
+        traversal.items[i].dynamicTexture->drawTexture(traversal.items[i].textureRect);
+
+        glPopMatrix();
     }
 }
 
@@ -429,112 +379,9 @@ void DynamicTexture::clearOldChildren(long minFrameCount)
     }
 }
 
-void DynamicTexture::computeImagePyramid(std::string imagePyramidPath)
-{
-    if(depth_ == 0)
-    {
-        // make directory if necessary
-        if(QDir(imagePyramidPath.c_str()).exists() != true)
-        {
-            bool success = QDir().mkdir(imagePyramidPath.c_str());
-
-            if(success != true)
-            {
-                put_flog(LOG_ERROR, "error creating directory %s", imagePyramidPath.c_str());
-                return;
-            }
-        }
-
-        // wait for initial image load to finish thread
-        loadImageThread_.waitForFinished();
-
-        // write metadata file
-        std::string metadataFilename = imagePyramidPath + "/pyramid.pyr";
-
-        std::ofstream ofs(metadataFilename.c_str());
-        ofs << "\"" << imagePyramidPath << "\" " << imageWidth_ << " " << imageHeight_;
-
-        // write a more conveniently named metadata file in the same directory as the original image, if possible
-        // path ends with ".pyramid"; the new metadata file will end with ".pyr"
-        QString secondMetadataFilename = QString(imagePyramidPath.c_str());
-        int amidLastIndex = secondMetadataFilename.lastIndexOf("amid");
-
-        secondMetadataFilename.truncate(amidLastIndex);
-
-        std::ofstream secondOfs(secondMetadataFilename.toStdString().c_str());
-
-        if(secondOfs.good() == true)
-        {
-            secondOfs << "\"" << imagePyramidPath << "\" " << imageWidth_ << " " << imageHeight_;
-        }
-        else
-        {
-            put_flog(LOG_WARN, "could not write second metadata file %s", secondMetadataFilename.toStdString().c_str());
-        }
-    }
-
-    // generate this object's image and write to disk
-
-    // this will give us scaledImage_
-    // don't convert scaledImage_ to the GL format; we need to be able to save it
-    // note that for depth_ == 0 we already have scaledImage_, but it is in the OpenGL format
-    // so, we need to load it again in the non-OpenGL format so we're able to save it
-    // todo: in the future it might be nice not to require the re-loading of the image for depth_ == 0
-    loadImage(false);
-
-    // form filename
-    std::string filename = imagePyramidPath + '/';
-
-    for(unsigned int i=0; i<treePath_.size(); i++)
-    {
-        filename += QString::number(treePath_[i]).toStdString();
-
-        if(i != treePath_.size() - 1)
-        {
-            filename += "-";
-        }
-    }
-
-    filename += ".jpg";
-
-    put_flog(LOG_DEBUG, "saving %s", filename.c_str());
-
-    scaledImage_.save(QString(filename.c_str()), "jpg");
-
-    // no longer need scaled image
-    scaledImage_ = QImage();
-
-    // if we need to descend further...
-    if(getRoot()->imageWidth_ / pow(2,depth_) > TEXTURE_SIZE || getRoot()->imageHeight_ / pow(2,depth_) > TEXTURE_SIZE)
-    {
-        // image rectangle a child quadrant contains
-        QRectF imageBounds[4];
-        imageBounds[0] = QRectF(0.,0.,0.5,0.5);
-        imageBounds[1] = QRectF(0.5,0.,0.5,0.5);
-        imageBounds[2] = QRectF(0.5,0.5,0.5,0.5);
-        imageBounds[3] = QRectF(0.,0.5,0.5,0.5);
-
-        // generate and compute children
-        for(unsigned int i=0; i<4; i++)
-        {
-            boost::shared_ptr<DynamicTexture> c(new DynamicTexture("", shared_from_this(), imageBounds[i].x(), imageBounds[i].y(), imageBounds[i].width(), imageBounds[i].height(), i));
-
-            c->computeImagePyramid(imagePyramidPath);
-        }
-    }
-}
-
-void DynamicTexture::decrementThreadCount()
+std::string DynamicTexture::getCacheKey()
 {
-    if(depth_ == 0)
-    {
-        QMutexLocker locker(&threadCountMutex_);
-        threadCount_ = threadCount_ - 1;
-    }
-    else
-    {
-        return getRoot()->decrementThreadCount();
-    }
+    return cacheKey_;
 }
 
 boost::shared_ptr<DynamicTexture> DynamicTexture::getRoot()
@@ -570,10 +417,7 @@ QRect DynamicTexture::getRootImageCoordinates(float x, float y, float w, float h
     if(depth_ == 0)
     {
         // if necessary, block and wait for image loading to complete
-        if(loadImageThreadStarted_ == true && loadImageThread_.isFinished() == false)
-        {
-            loadImageThread_.waitForFinished();
-        }
+        waitForImage();
 
         QRect rect = QRect(x*imageWidth_, y*imageHeight_, w*imageWidth_, h*imageHeight_);
         return rect;
@@ -612,11 +456,8 @@ QImage DynamicTexture::getImageFromParent(float x, float y, float w, float h, Dy
         return parent->getImageFromParent(pX, pY, pW, pH, start);
     }
 
-    // wait for the load image thread to complete if it's in progress
-    if(loadImageThreadStarted_ == true && loadImageThread_.isFinished() == false)
-    {
-        loadImageThread_.waitForFinished();
-    }
+    // wait for the image load to complete if it's in progress
+    waitForImage();
 
     if(image_.isNull() != true)
     {
@@ -649,24 +490,134 @@ QImage DynamicTexture::getImageFromParent(float x, float y, float w, float h, Dy
 
 void DynamicTexture::uploadTexture()
 {
-    // generate new texture
-    // no need to compute mipmaps
-    // note that scaledImage_ is already in the GL format so we can use glTexImage2D directly
-    glGenTextures(1, &textureId_);
-    glBindTexture(GL_TEXTURE_2D, textureId_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scaledImage_.width(), scaledImage_.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledImage_.bits());
+    DynamicTextureAtlas & atlas = g_mainWindow->getGLWindow()->getDynamicTextureAtlas();
+
+    // tiles go in the atlas if they fit a slot and one is free; otherwise they get their own texture
+    // mipmapped tiles always get their own texture, since mipmaps of the atlas pages would mix neighboring slots
+    if(mipmaps_ == true || scaledImage_.width() != atlas.getSlotSize() || scaledImage_.height() != atlas.getSlotSize() || atlas.upload(scaledImage_, textureId_, atlasSlot_) != true)
+    {
+        atlasSlot_ = -1;
+
+        // generate new texture
+        // note that scaledImage_ is already in the GL format so we can use glTexImage2D directly
+        glGenTextures(1, &textureId_);
+        glBindTexture(GL_TEXTURE_2D, textureId_);
+
+        if(mipmaps_ == true)
+        {
+            // mipmaps are generated on upload
+            glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+        else
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scaledImage_.width(), scaledImage_.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledImage_.bits());
+    }
 
     textureBound_ = true;
 
+    // tiles in the atlas are charged to the texture budget with their page
+    if(atlasSlot_ >= 0)
+    {
+        textureBytes_ = 0;
+    }
+    else
+    {
+        textureBytes_ = (qint64)scaledImage_.width() * (qint64)scaledImage_.height() * 4;
+
+        // the mipmap levels add a third
+        if(mipmaps_ == true)
+        {
+            textureBytes_ = textureBytes_ * 4 / 3;
+        }
+    }
+
+    g_mainWindow->getGLWindow()->getDynamicTextureCache().addTextureInUse(textureBytes_);
+
     // no longer need the scaled image
     scaledImage_ = QImage();
 }
 
-void DynamicTexture::renderChildren(float tX, float tY, float tW, float tH)
+void DynamicTexture::traverse(QRectF textureRect, QRectF pixelRect, QRectF rect, DynamicTextureTraversal & traversal)
 {
-    // texture rectangle we're showing with this parent object
-    QRectF textureRect(tX,tY,tW,tH);
+    traversal.numNodes++;
+
+    DynamicTexture * root = traversal.root;
+
+    double onScreenArea = DynamicTextureLOD::getProjectedPixelArea(pixelRect, traversal.windowRect, true);
+
+    // descend while this tile would be magnified and there is more resolution
+    if(DynamicTextureLOD::getDrawChildren(pixelRect, traversal.windowRect, tileSize_, depth_, root->imageWidth_, root->imageHeight_) == true)
+    {
+        // mark this object as having rendered children in this frame
+        renderChildrenFrameCount_ = g_frameCount;
+
+        traverseChildren(textureRect, pixelRect, rect, traversal);
+
+        return;
+    }
+
+    // want to render this object
+
+    int loadState = loadState_.fetchAndAddAcquire(0);
+
+    // see if we need to start loading the image
+    if(loadState == LOAD_IDLE && textureBound_ == false)
+    {
+        DynamicTextureCache & cache = g_mainWindow->getGLWindow()->getDynamicTextureCache();
 
+        // the texture or image may still be cached from an earlier time this tile was shown
+        if(cache.takeTexture(cacheKey_, textureId_, atlasSlot_, textureBytes_) == true)
+        {
+            textureBound_ = true;
+        }
+        else if(cache.getImage(cacheKey_, scaledImage_) == true)
+        {
+            uploadTexture();
+        }
+        else
+        {
+            cache.recordMiss();
+        }
+    }
+
+    // request the image every frame we're visible, with our current on-screen area
+    // requests not renewed in a frame are dropped by the loader, so tiles off the screen age out of the queue
+    if((loadState == LOAD_IDLE || loadState == LOAD_QUEUED) && textureBound_ == false && onScreenArea > 0.)
+    {
+        g_dynamicTextureLoader->load(shared_from_this(), onScreenArea, g_frameCount);
+    }
+
+    updateTexture();
+
+    if(textureBound_ == true)
+    {
+        addDrawItem(textureRect, rect, traversal);
+    }
+    else
+    {
+        if(root->prefetcher_ != NULL)
+        {
+            root->prefetcher_->recordBlurryTile();
+        }
+
+        // if we don't yet have a texture, try to render from an ancestor's texture
+        // however, we won't force an image/texture computation on the ancestors
+        traverseAncestors(textureRect, rect, traversal);
+    }
+}
+
+void DynamicTexture::traverseChildren(QRectF textureRect, QRectF pixelRect, QRectF rect, DynamicTextureTraversal & traversal)
+{
     // children rectangles
     float inf = 1000000.;
 
@@ -694,7 +645,6 @@ void DynamicTexture::renderChildren(float tX, float tY, float tW, float tH)
         }
     }
 
-    // render children
     for(unsigned int i=0; i<children_.size(); i++)
     {
         // portion of texture for this child
@@ -709,103 +659,160 @@ void DynamicTexture::renderChildren(float tX, float tY, float tW, float tH)
         // recall the parent object (this one) is rendered as a (0,0,1,1) rectangle
         QRectF renderRect((childTextureRect.x()-textureRect.x()) / textureRect.width(), (childTextureRect.y()-textureRect.y()) / textureRect.height(), childTextureRect.width() / textureRect.width(), childTextureRect.height() / textureRect.height());
 
-        glPushMatrix();
-        glTranslatef(renderRect.x(), renderRect.y(), 0.);
-        glScalef(renderRect.width(), renderRect.height(), 1.);
+        // this replaces the glTranslatef() / glScalef() of renderRect for the child
+        children_[i]->traverse(childTextureRectTranslatedAndScaled, DynamicTextureLOD::mapRect(pixelRect, renderRect), DynamicTextureLOD::mapRect(rect, renderRect), traversal);
+    }
+}
 
-        children_[i]->render(childTextureRectTranslatedAndScaled.x(), childTextureRectTranslatedAndScaled.y(), childTextureRectTranslatedAndScaled.width(), childTextureRectTranslatedAndScaled.height());
+void DynamicTexture::traverseAncestors(QRectF textureRect, QRectF rect, DynamicTextureTraversal & traversal)
+{
+    boost::shared_ptr<DynamicTexture> parent = parent_.lock();
 
-        glPopMatrix();
+    if(parent == NULL)
+    {
+        return;
+    }
+
+    QRectF parentTextureRect(parentX_ + textureRect.x() * parentW_, parentY_ + textureRect.y() * parentH_, textureRect.width() * parentW_, textureRect.height() * parentH_);
+
+    parent->updateTexture();
+
+    if(parent->textureBound_ == true)
+    {
+        parent->addDrawItem(parentTextureRect, rect, traversal);
+    }
+    else
+    {
+        parent->traverseAncestors(parentTextureRect, rect, traversal);
     }
 }
 
-double DynamicTexture::getProjectedPixelArea(bool onScreenOnly)
+void DynamicTexture::addDrawItem(QRectF textureRect, QRectF rect, DynamicTextureTraversal & traversal)
 {
-    // get four corners in object space (recall we're in normalized 0->1 dimensions)
-    double x[4][3];
+    if(atlasSlot_ >= 0)
+    {
+        g_mainWindow->getGLWindow()->getDynamicTextureAtlas().appendQuad(atlasSlot_, textureRect, rect, traversal.atlasVertices[textureId_]);
+    }
+    else
+    {
+        // the tree holds this object for the rest of the frame
+        DynamicTextureDrawItem item;
+        item.dynamicTexture = this;
+        item.textureRect = textureRect;
+        item.rect = rect;
 
-    x[0][0] = 0.;
-    x[0][1] = 0.;
-    x[0][2] = 0.;
+        traversal.items.push_back(item);
+    }
+}
 
-    x[1][0] = 1.;
-    x[1][1] = 0.;
-    x[1][2] = 0.;
+void DynamicTexture::updateTexture()
+{
+    // see if we need to load the texture
+    if(loadState_.fetchAndAddAcquire(0) == LOAD_DONE && textureBound_ == false)
+    {
+        // the root always loads its image, but its texture may still be cached
+        if(g_mainWindow->getGLWindow()->getDynamicTextureCache().takeTexture(cacheKey_, textureId_, atlasSlot_, textureBytes_) == true)
+        {
+            textureBound_ = true;
+            scaledImage_ = QImage();
+        }
+        else
+        {
+            uploadTexture();
+        }
+    }
+}
 
-    x[2][0] = 1.;
-    x[2][1] = 1.;
-    x[2][2] = 0.;
+void DynamicTexture::drawTexture(QRectF textureRect)
+{
+    float tX = textureRect.x();
+    float tY = textureRect.y();
+    float tW = textureRect.width();
+    float tH = textureRect.height();
 
-    x[3][0] = 0.;
-    x[3][1] = 1.;
-    x[3][2] = 0.;
+#ifdef DYNAMIC_TEXTURE_SHOW_BORDER
+    // draw the border
+    glPushAttrib(GL_CURRENT_BIT);
 
-    // get four corners in screen space
-    GLdouble modelview[16];
-    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glColor4f(0.,1.,0.,1.);
 
-    GLdouble projection[16];
-    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glBegin(GL_LINE_LOOP);
+    glVertex2f(0.,0.);
+    glVertex2f(1.,0.);
+    glVertex2f(1.,1.);
+    glVertex2f(0.,1.);
+    glEnd();
 
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    glPopAttrib();
+#endif
 
-    GLdouble xWin[4][3];
+    // draw the texture
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
 
-    for(int i=0; i<4; i++)
-    {
-        gluProject(x[i][0], x[i][1], x[i][2], modelview, projection, viewport, &xWin[i][0], &xWin[i][1], &xWin[i][2]);
+    // filtering and wrapping were set on upload
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, textureId_);
 
-        if(onScreenOnly == true)
-        {
-            // clamp to on-screen portion
-            if(xWin[i][0] < 0.)
-                xWin[i][0] = 0.;
+    glBegin(GL_QUADS);
 
-            if(xWin[i][0] > (double)g_mainWindow->getGLWindow()->width())
-                xWin[i][0] = (double)g_mainWindow->getGLWindow()->width();
+    // note we need to flip the y coordinate since the textures are loaded upside down
+    glTexCoord2f(tX,1.-tY);
+    glVertex2f(0.,0.);
 
-            if(xWin[i][1] < 0.)
-                xWin[i][1] = 0.;
+    glTexCoord2f(tX+tW,1.-tY);
+    glVertex2f(1.,0.);
 
-            if(xWin[i][1] > (double)g_mainWindow->getGLWindow()->height())
-                xWin[i][1] = (double)g_mainWindow->getGLWindow()->height();
-        }
-    }
+    glTexCoord2f(tX+tW,1.-(tY+tH));
+    glVertex2f(1.,1.);
 
-    // get area from two triangles
-    // use this method to accomodate warped / transformed views in screen space
-    double vec1[3];
-    vec1[0] = xWin[1][0] - xWin[0][0];
-    vec1[1] = xWin[1][1] - xWin[0][1];
-    vec1[2] = xWin[1][2] - xWin[0][2];
+    glTexCoord2f(tX,1.-(tY+tH));
+    glVertex2f(0.,1.);
 
-    double vec2[3];
-    vec2[0] = xWin[2][0] - xWin[0][0];
-    vec2[1] = xWin[2][1] - xWin[0][1];
-    vec2[2] = xWin[2][2] - xWin[0][2];
+    glEnd();
 
-    double vec3[3];
-    vec3[0] = xWin[3][0] - xWin[0][0];
-    vec3[1] = xWin[3][1] - xWin[0][1];
-    vec3[2] = xWin[3][2] - xWin[0][2];
+    glPopAttrib();
+}
 
-    double cp[3];
+void DynamicTexture::recordTraversal(int numNodes, double microseconds)
+{
+    // bucket by log2 of the number of nodes visited
+    int bucket = 0;
 
-    vectorCrossProduct(vec1, vec2, cp);
-    double A1 = 0.5 * vectorMagnitude(cp);
+    while((numNodes >> (bucket + 1)) > 0 && bucket < DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS - 1)
+    {
+        bucket++;
+    }
 
-    vectorCrossProduct(vec1, vec3, cp);
-    double A2 = 0.5 * vectorMagnitude(cp);
+    traversalCounts_[bucket]++;
+    traversalNodes_[bucket] += (double)numNodes;
+    traversalTimes_[bucket] += microseconds;
+}
 
-    double A = A1 + A2;
+void DynamicTexture::logTraversalStatistics(long frameCount)
+{
+    if(frameCount % DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_INTERVAL != 0)
+    {
+        return;
+    }
 
-    return A;
+    for(int i=0; i<DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS; i++)
+    {
+        if(traversalCounts_[i] > 0)
+        {
+            put_flog(LOG_DEBUG, "dynamic texture traversal of %i-%i nodes: %li traversals, mean %f us, %f us / node", 1 << i, (1 << (i+1)) - 1, traversalCounts_[i], traversalTimes_[i] / (double)traversalCounts_[i], traversalTimes_[i] / traversalNodes_[i]);
+        }
+
+        traversalCounts_[i] = 0;
+        traversalNodes_[i] = 0.;
+        traversalTimes_[i] = 0.;
+    }
 }
 
 bool DynamicTexture::getThreadsDoneDescending()
 {
-    if(loadImageThread_.isFinished() == false)
+    int loadState = loadState_.fetchAndAddAcquire(0);
+
+    if(loadState == LOAD_QUEUED || loadState == LOAD_RUNNING)
     {
         return false;
     }
@@ -821,41 +828,21 @@ bool DynamicTexture::getThreadsDoneDescending()
     return true;
 }
 
-int DynamicTexture::getThreadCount()
-{
-    if(depth_ == 0)
-    {
-        QMutexLocker locker(&threadCountMutex_);
-        return threadCount_;
-    }
-    else
-    {
-        return getRoot()->getThreadCount();
-    }
-}
-
-void DynamicTexture::incrementThreadCount()
+void DynamicTexture::waitForImage()
 {
     if(depth_ == 0)
     {
-        QMutexLocker locker(&threadCountMutex_);
-        threadCount_ = threadCount_ + 1;
+        loadImageThread_.waitForFinished();
     }
     else
     {
-        return getRoot()->incrementThreadCount();
+        g_dynamicTextureLoader->waitForLoad(this);
     }
 }
 
-void loadImageThread(boost::shared_ptr<DynamicTexture> dynamicTexture, std::vector<boost::shared_ptr<DynamicTexture> > objects)
-{
-    loadImageThread(dynamicTexture.get());
-    return;
-}
-
 void loadImageThread(DynamicTexture * dynamicTexture)
 {
     dynamicTexture->loadImage();
-    dynamicTexture->decrementThreadCount();
+    dynamicTexture->loadState_.fetchAndStoreRelease(LOAD_DONE);
     return;
 }
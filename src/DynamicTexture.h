@@ -39,18 +39,55 @@
 #ifndef DYNAMIC_TEXTURE_H
 #define DYNAMIC_TEXTURE_H
 
-// todo: get this dynamically
-#define TEXTURE_SIZE 512
-
 // define this to show borders around image tiles
 #undef DYNAMIC_TEXTURE_SHOW_BORDER
 
+// log traversal timings every this many frames, by log2 of the number of nodes visited
+#define DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_INTERVAL 600
+#define DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS 16
+
 #include "FactoryObject.h"
+#include "ImagePyramidContainer.h"
+#include "ImageRegionReader.h"
+#include "DynamicTexturePrefetcher.h"
+#include "DynamicTextureLoader.h"
 #include <QGLWidget>
 #include <QtConcurrentRun>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <map>
+#include <vector>
+
+enum DYNAMIC_TEXTURE_LOAD_STATE { LOAD_IDLE, LOAD_QUEUED, LOAD_RUNNING, LOAD_DONE };
+
+class DynamicTexture;
+
+// a tile to draw: the object whose texture is drawn, the texture coordinates within it,
+// and the rectangle it is drawn in within the root's (0,0,1,1) rectangle
+struct DynamicTextureDrawItem {
+
+    DynamicTexture * dynamicTexture;
+    QRectF textureRect;
+    QRectF rect;
+};
+
+// state of one traversal of a tree, computed once per frame per window
+struct DynamicTextureTraversal {
+
+    DynamicTexture * root;
+
+    // the window, in pixels
+    QRectF windowRect;
+
+    // tiles with their own textures
+    std::vector<DynamicTextureDrawItem> items;
+
+    // vertices of tiles in the DynamicTextureAtlas, by atlas page
+    std::map<GLuint, std::vector<GLfloat> > atlasVertices;
+
+    int numNodes;
+};
 
 class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, public FactoryObject {
 
@@ -61,13 +98,23 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
 
         void loadImage(bool convertToGLFormat=true); // thread needs access to this method
         void getDimensions(int &width, int &height);
-        void render(float tX, float tY, float tW, float tH, bool computeOnDemand=true, bool considerChildren=true);
+        void render(float tX, float tY, float tW, float tH);
         void clearOldChildren(long minFrameCount); // clear children of nodes with renderChildrenFrameCount_ < minFrameCount
-        void computeImagePyramid(std::string imagePyramidPath);
-        void decrementThreadCount(); // thread needs access to this method
+
+        // identifies this tile in the DynamicTextureCache
+        std::string getCacheKey();
+
+        // load a tile from an image pyramid directory or container; thread-safe
+        static bool loadImagePyramidTile(std::string imagePyramidPath, boost::shared_ptr<ImagePyramidContainer> imagePyramidContainer, const std::vector<int> & treePath, QImage & image);
+
+        // log traversal timings every DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_INTERVAL frames
+        static void logTraversalStatistics(long frameCount);
 
     private:
 
+        friend class DynamicTextureLoader;
+        friend void loadImageThread(DynamicTexture * dynamicTexture);
+
         int depth_;
 
         // for root only: image location
@@ -77,9 +124,18 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         std::string imagePyramidPath_;
         bool useImagePyramid_;
 
-        // thread count
-        int threadCount_;
-        QMutex threadCountMutex_;
+        // for all objects: tile width and height, from the pyramid or the configuration, and whether textures are mipmapped
+        int tileSize_;
+        bool mipmaps_;
+
+        // single-file image pyramid, if used
+        boost::shared_ptr<ImagePyramidContainer> imagePyramidContainer_;
+
+        // for root only: reads regions of the image, if not an image pyramid
+        boost::shared_ptr<ImageRegionReader> imageRegionReader_;
+
+        // for root only: prefetches image pyramid tiles ahead of pans and zooms
+        boost::shared_ptr<DynamicTexturePrefetcher> prefetcher_;
 
         // for children:
 
@@ -94,11 +150,17 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         // path through the tree
         std::vector<int> treePath_;
 
-        // thread for loading images
+        // root uri and tree path; computed at construction, since the parent may no longer exist at destruction
+        std::string cacheKey_;
+
+        // for root only: thread for loading the image, started at construction
         QFuture<void> loadImageThread_;
-        bool loadImageThreadStarted_;
 
-        // full scale image and dimensions; image may be deleted, but dimensions are necessary for later use
+        // DYNAMIC_TEXTURE_LOAD_STATE; children are loaded by the DynamicTextureLoader
+        QAtomicInt loadState_;
+
+        // full scale image, kept by the root only for formats that can't be read by region;
+        // and dimensions, in terms of the root image
         QImage image_;
         int imageWidth_;
         int imageHeight_;
@@ -108,7 +170,9 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
 
         // texture information
         bool textureBound_;
-        GLuint textureId_;
+        GLuint textureId_; // atlas page if atlasSlot_ >= 0
+        int atlasSlot_;
+        qint64 textureBytes_;
 
         // children
         std::vector<boost::shared_ptr<DynamicTexture> > children_;
@@ -116,21 +180,31 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         // last children render frame count
         long renderChildrenFrameCount_;
 
+        // traversal statistics by log2 of the number of nodes visited; times in microseconds
+        static long traversalCounts_[DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS];
+        static double traversalNodes_[DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS];
+        static double traversalTimes_[DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_BUCKETS];
+
         boost::shared_ptr<DynamicTexture> getRoot();
         void getObjectsAscending(std::vector<boost::shared_ptr<DynamicTexture> > &objects);
         QRect getRootImageCoordinates(float x, float y, float w, float h);
         QImage getImageFromParent(float x, float y, float w, float h, DynamicTexture * start);
         void uploadTexture();
-        void renderChildren(float tX, float tY, float tW, float tH);
-        double getProjectedPixelArea(bool onScreenOnly);
+
+        // pixelRect and rect are the window rectangle and the rectangle within the root of this object's (0,0,1,1) rectangle
+        void traverse(QRectF textureRect, QRectF pixelRect, QRectF rect, DynamicTextureTraversal & traversal);
+        void traverseChildren(QRectF textureRect, QRectF pixelRect, QRectF rect, DynamicTextureTraversal & traversal);
+        void traverseAncestors(QRectF textureRect, QRectF rect, DynamicTextureTraversal & traversal);
+        void addDrawItem(QRectF textureRect, QRectF rect, DynamicTextureTraversal & traversal);
+        void updateTexture();
+        void drawTexture(QRectF textureRect);
+
+        static void recordTraversal(int numNodes, double microseconds);
+
         bool getThreadsDoneDescending();
-        int getThreadCount();
-        void incrementThreadCount();
+        void waitForImage();
 };
 
-// this wrapper is used by child objects to prevent its ancestors from being destructed during thread execution.
-extern void loadImageThread(boost::shared_ptr<DynamicTexture> dynamicTexture, std::vector<boost::shared_ptr<DynamicTexture> > objects);
-
 extern void loadImageThread(DynamicTexture * dynamicTexture);
 
 #endif
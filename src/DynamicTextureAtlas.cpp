@@ -0,0 +1,282 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DynamicTextureAtlas.h"
+#include "main.h"
+#include "log.h"
+
+DynamicTextureAtlas::DynamicTextureAtlas() : vertexBuffer_(QGLBuffer::VertexBuffer)
+{
+    vertexBuffer_.setUsagePattern(QGLBuffer::StreamDraw);
+}
+
+DynamicTextureAtlas::~DynamicTextureAtlas()
+{
+
+}
+
+int DynamicTextureAtlas::getSlotSize()
+{
+    return DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE;
+}
+
+bool DynamicTextureAtlas::upload(QImage & image, GLuint & textureId, int & slot)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(freeSlots_.size() == 0)
+    {
+        // the cache frees the slot of a cached tile or charges a new page to the texture budget
+        // it calls freeSlot(), so don't hold the lock
+        locker.unlock();
+
+        bool newPage = g_mainWindow->getGLWindow()->getDynamicTextureCache().reserveAtlasPage(getPageBytes());
+
+        locker.relock();
+
+        if(freeSlots_.size() == 0)
+        {
+            if(newPage != true)
+            {
+                return false;
+            }
+
+            // create a new page
+            GLuint page;
+
+            glGenTextures(1, &page);
+            glBindTexture(GL_TEXTURE_2D, page);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE, DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            int firstSlot = (int)pages_.size() * getSlotsPerPage();
+
+            pages_.push_back(page);
+
+            // lowest slots are used first
+            for(int i=getSlotsPerPage()-1; i>=0; i--)
+            {
+                freeSlots_.push_back(firstSlot + i);
+            }
+
+            put_flog(LOG_DEBUG, "created atlas page %i", (int)pages_.size());
+        }
+        else if(newPage == true)
+        {
+            // a cached tile's slot was freed meanwhile; uploads are only done in the OpenGL thread, so it is still free
+            locker.unlock();
+            g_mainWindow->getGLWindow()->getDynamicTextureCache().releaseAtlasPages(getPageBytes());
+            locker.relock();
+        }
+    }
+
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+
+    textureId = pages_[slot / getSlotsPerPage()];
+
+    int slotsPerRow = DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE / DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE;
+    int pageSlot = slot % getSlotsPerPage();
+
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (pageSlot % slotsPerRow) * DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE, (pageSlot / slotsPerRow) * DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE, image.width(), image.height(), GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+
+    return true;
+}
+
+void DynamicTextureAtlas::freeSlot(int slot)
+{
+    QMutexLocker locker(&mutex_);
+
+    // the page may have been deleted by clear()
+    if(slot / getSlotsPerPage() < (int)pages_.size())
+    {
+        freeSlots_.push_back(slot);
+    }
+}
+
+QRectF DynamicTextureAtlas::getSlotTextureRect(int slot)
+{
+    int slotsPerRow = DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE / DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE;
+    int pageSlot = slot % getSlotsPerPage();
+
+    double pageSize = (double)DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE;
+
+    // inset by half a texel, so linear filtering doesn't sample neighboring slots
+    double x = ((double)((pageSlot % slotsPerRow) * DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE) + 0.5) / pageSize;
+    double y = ((double)((pageSlot / slotsPerRow) * DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE) + 0.5) / pageSize;
+    double size = ((double)DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE - 1.) / pageSize;
+
+    return QRectF(x, y, size, size);
+}
+
+void DynamicTextureAtlas::appendQuad(int slot, QRectF textureRect, QRectF rect, std::vector<GLfloat> & vertices)
+{
+    QRectF clippedTextureRect = textureRect.intersected(QRectF(0.,0.,1.,1.));
+
+    if(clippedTextureRect.isEmpty() == true)
+    {
+        return;
+    }
+
+    // the part of rect the clipped texture rectangle covers
+    QRectF clippedRect(rect.x() + (clippedTextureRect.x() - textureRect.x()) / textureRect.width() * rect.width(), rect.y() + (clippedTextureRect.y() - textureRect.y()) / textureRect.height() * rect.height(), clippedTextureRect.width() / textureRect.width() * rect.width(), clippedTextureRect.height() / textureRect.height() * rect.height());
+
+    QRectF slotRect = getSlotTextureRect(slot);
+
+    // note we need to flip the y coordinate since the textures are loaded upside down
+    GLfloat s0 = slotRect.x() + clippedTextureRect.left() * slotRect.width();
+    GLfloat s1 = slotRect.x() + clippedTextureRect.right() * slotRect.width();
+    GLfloat t0 = slotRect.y() + (1. - clippedTextureRect.top()) * slotRect.height();
+    GLfloat t1 = slotRect.y() + (1. - clippedTextureRect.bottom()) * slotRect.height();
+
+    GLfloat x0 = clippedRect.left();
+    GLfloat x1 = clippedRect.right();
+    GLfloat y0 = clippedRect.top();
+    GLfloat y1 = clippedRect.bottom();
+
+    GLfloat quad[16] = { x0,y0, s0,t0,
+                         x1,y0, s1,t0,
+                         x1,y1, s1,t1,
+                         x0,y1, s0,t1 };
+
+    vertices.insert(vertices.end(), quad, quad + 16);
+}
+
+void DynamicTextureAtlas::draw(std::map<GLuint, std::vector<GLfloat> > & vertices)
+{
+    if(vertices.size() == 0)
+    {
+        return;
+    }
+
+    if(vertexBuffer_.isCreated() != true && vertexBuffer_.create() != true)
+    {
+        put_flog(LOG_ERROR, "could not create vertex buffer");
+        return;
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    glEnable(GL_TEXTURE_2D);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    vertexBuffer_.bind();
+
+    for(std::map<GLuint, std::vector<GLfloat> >::iterator it=vertices.begin(); it!=vertices.end(); it++)
+    {
+        std::vector<GLfloat> & pageVertices = it->second;
+
+        if(pageVertices.size() == 0)
+        {
+            continue;
+        }
+
+        vertexBuffer_.allocate(&pageVertices[0], (int)(pageVertices.size() * sizeof(GLfloat)));
+
+        glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (GLvoid *)0);
+        glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), (GLvoid *)(2 * sizeof(GLfloat)));
+
+        glBindTexture(GL_TEXTURE_2D, it->first);
+
+        glDrawArrays(GL_QUADS, 0, (GLsizei)(pageVertices.size() / 4));
+
+#ifdef DYNAMIC_TEXTURE_SHOW_BORDER
+        // draw the borders
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+
+        glDisable(GL_TEXTURE_2D);
+        glColor4f(0.,1.,0.,1.);
+
+        for(unsigned int i=0; i<pageVertices.size() / 16; i++)
+        {
+            glDrawArrays(GL_LINE_LOOP, i*4, 4);
+        }
+
+        glPopAttrib();
+#endif
+    }
+
+    vertexBuffer_.release();
+
+    glPopClientAttrib();
+    glPopAttrib();
+}
+
+void DynamicTextureAtlas::clear()
+{
+    QMutexLocker locker(&mutex_);
+
+    for(unsigned int i=0; i<pages_.size(); i++)
+    {
+        glDeleteTextures(1, &pages_[i]);
+    }
+
+    qint64 bytes = (qint64)pages_.size() * getPageBytes();
+
+    pages_.clear();
+    freeSlots_.clear();
+
+    if(vertexBuffer_.isCreated() == true)
+    {
+        vertexBuffer_.destroy();
+    }
+
+    locker.unlock();
+
+    g_mainWindow->getGLWindow()->getDynamicTextureCache().releaseAtlasPages(bytes);
+}
+
+int DynamicTextureAtlas::getSlotsPerPage()
+{
+    int slotsPerRow = DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE / DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE;
+
+    return slotsPerRow * slotsPerRow;
+}
+
+qint64 DynamicTextureAtlas::getPageBytes()
+{
+    return (qint64)DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE * DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE * 4;
+}
@@ -0,0 +1,105 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DYNAMIC_TEXTURE_ATLAS_H
+#define DYNAMIC_TEXTURE_ATLAS_H
+
+// atlas page width and height, and slot width and height (the default DynamicTexture tile size)
+#define DYNAMIC_TEXTURE_ATLAS_PAGE_SIZE 4096
+#define DYNAMIC_TEXTURE_ATLAS_SLOT_SIZE 512
+
+#include <QtGui>
+#include <QGLWidget>
+#include <QGLBuffer>
+#include <map>
+#include <vector>
+
+// large textures (pages) holding many DynamicTexture tiles each, so visible tiles can
+// be drawn with one draw call per page instead of one bind and draw per tile.
+//
+// pages are divided into fixed-size slots. pages are created as needed and charged to
+// the DynamicTextureCache's texture budget, together with the tiles' own textures. when
+// all slots are in use, the slot of a cached tile is reused, or a page is added if the
+// budget allows; otherwise tiles fall back to their own textures. slots are freed, from
+// any thread, when the DynamicTextureCache evicts a tile's texture.
+class DynamicTextureAtlas {
+
+    public:
+
+        DynamicTextureAtlas();
+        ~DynamicTextureAtlas();
+
+        int getSlotSize();
+
+        // upload an image of getSlotSize() x getSlotSize() in OpenGL format to a free slot,
+        // getting the page texture and slot. returns false if no slots are free.
+        // must be called in the OpenGL thread
+        bool upload(QImage & image, GLuint & textureId, int & slot);
+
+        // thread-safe
+        void freeSlot(int slot);
+
+        // texture coordinates of a slot's (0,0,1,1) rectangle in its page
+        QRectF getSlotTextureRect(int slot);
+
+        // append a textured quad to vertices (x, y, s, t per vertex), drawing the textureRect part of the slot's
+        // (0,0,1,1) rectangle in rect. the texture is clamped to the slot, so the quad is clipped to it
+        void appendQuad(int slot, QRectF textureRect, QRectF rect, std::vector<GLfloat> & vertices);
+
+        // draw the quads of each page with one draw call, from a vertex buffer
+        // must be called in the OpenGL thread
+        void draw(std::map<GLuint, std::vector<GLfloat> > & vertices);
+
+        // delete all pages; must be called in the OpenGL thread
+        void clear();
+
+    private:
+
+        QMutex mutex_;
+
+        std::vector<GLuint> pages_;
+        std::vector<int> freeSlots_;
+
+        // vertex buffer for draw(), created in the first draw
+        QGLBuffer vertexBuffer_;
+
+        int getSlotsPerPage();
+        qint64 getPageBytes();
+};
+
+#endif
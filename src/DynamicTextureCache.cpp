@@ -0,0 +1,343 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DynamicTextureCache.h"
+#include "main.h"
+#include "log.h"
+#include <sstream>
+
+DynamicTextureCache::DynamicTextureCache()
+{
+    // defaults
+    textureBudget_ = (qint64)TEXTURE_CACHE_DEFAULT_TEXTURE_BUDGET_MB * 1024 * 1024;
+    imageBudget_ = (qint64)TEXTURE_CACHE_DEFAULT_IMAGE_BUDGET_MB * 1024 * 1024;
+    textureBytes_ = 0;
+    textureInUseBytes_ = 0;
+    atlasBytes_ = 0;
+    imageBytes_ = 0;
+    textureHits_ = 0;
+    imageHits_ = 0;
+    misses_ = 0;
+    textureEvictions_ = 0;
+    imageEvictions_ = 0;
+
+    // assign values
+    if(g_configuration != NULL)
+    {
+        textureBudget_ = g_configuration->getTextureCacheTextureBudget();
+        imageBudget_ = g_configuration->getTextureCacheImageBudget();
+    }
+}
+
+DynamicTextureCache::~DynamicTextureCache()
+{
+
+}
+
+bool DynamicTextureCache::takeTexture(std::string key, GLuint & textureId, int & atlasSlot, qint64 & bytes)
+{
+    QMutexLocker locker(&mutex_);
+
+    std::map<std::string, std::list<DynamicTextureCacheTexture>::iterator>::iterator it = textureMap_.find(key);
+
+    if(it == textureMap_.end())
+    {
+        return false;
+    }
+
+    textureId = it->second->textureId;
+    atlasSlot = it->second->atlasSlot;
+    bytes = it->second->bytes;
+
+    // the texture is now in use rather than cached
+    textureBytes_ -= bytes;
+    textureInUseBytes_ += bytes;
+
+    textures_.erase(it->second);
+    textureMap_.erase(it);
+
+    textureHits_++;
+
+    return true;
+}
+
+void DynamicTextureCache::insertTexture(std::string key, GLuint textureId, int atlasSlot, qint64 bytes)
+{
+    QMutexLocker locker(&mutex_);
+
+    textureInUseBytes_ -= bytes;
+
+    std::map<std::string, std::list<DynamicTextureCacheTexture>::iterator>::iterator it = textureMap_.find(key);
+
+    if(it != textureMap_.end())
+    {
+        removeTexture(it->second);
+    }
+
+    DynamicTextureCacheTexture texture;
+    texture.key = key;
+    texture.textureId = textureId;
+    texture.atlasSlot = atlasSlot;
+    texture.bytes = bytes;
+
+    textures_.push_front(texture);
+    textureMap_[key] = textures_.begin();
+    textureBytes_ += bytes;
+
+    evictTextures();
+}
+
+void DynamicTextureCache::addTextureInUse(qint64 bytes)
+{
+    QMutexLocker locker(&mutex_);
+
+    textureInUseBytes_ += bytes;
+
+    // make room for the new texture
+    evictTextures();
+}
+
+bool DynamicTextureCache::reserveAtlasPage(qint64 bytes)
+{
+    QMutexLocker locker(&mutex_);
+
+    // reuse the slot of a cached tile before adding texture memory
+    std::list<DynamicTextureCacheTexture>::iterator it = textures_.end();
+
+    while(it != textures_.begin())
+    {
+        it--;
+
+        if(it->atlasSlot >= 0)
+        {
+            removeTexture(it);
+
+            textureEvictions_++;
+
+            return false;
+        }
+    }
+
+    // cached textures can be evicted, but textures in use and existing pages can't
+    if(textureInUseBytes_ + atlasBytes_ + bytes > textureBudget_)
+    {
+        return false;
+    }
+
+    atlasBytes_ += bytes;
+
+    evictTextures();
+
+    return true;
+}
+
+void DynamicTextureCache::releaseAtlasPages(qint64 bytes)
+{
+    QMutexLocker locker(&mutex_);
+
+    atlasBytes_ -= bytes;
+}
+
+bool DynamicTextureCache::getImage(std::string key, QImage & image)
+{
+    QMutexLocker locker(&mutex_);
+
+    std::map<std::string, std::list<DynamicTextureCacheImage>::iterator>::iterator it = imageMap_.find(key);
+
+    if(it == imageMap_.end())
+    {
+        return false;
+    }
+
+    // move to the front of the list
+    images_.splice(images_.begin(), images_, it->second);
+
+    image = it->second->image;
+
+    imageHits_++;
+
+    return true;
+}
+
+void DynamicTextureCache::insertImage(std::string key, QImage image)
+{
+    if(image.isNull() == true)
+    {
+        return;
+    }
+
+    QMutexLocker locker(&mutex_);
+
+    std::map<std::string, std::list<DynamicTextureCacheImage>::iterator>::iterator it = imageMap_.find(key);
+
+    if(it != imageMap_.end())
+    {
+        removeImage(it->second);
+    }
+
+    DynamicTextureCacheImage cacheImage;
+    cacheImage.key = key;
+    cacheImage.image = image;
+    cacheImage.bytes = (qint64)image.bytesPerLine() * image.height();
+
+    images_.push_front(cacheImage);
+    imageMap_[key] = images_.begin();
+    imageBytes_ += cacheImage.bytes;
+
+    evictImages();
+}
+
+bool DynamicTextureCache::contains(std::string key)
+{
+    QMutexLocker locker(&mutex_);
+
+    return (textureMap_.count(key) > 0 || imageMap_.count(key) > 0);
+}
+
+void DynamicTextureCache::recordMiss()
+{
+    QMutexLocker locker(&mutex_);
+
+    misses_++;
+}
+
+void DynamicTextureCache::clear()
+{
+    QMutexLocker locker(&mutex_);
+
+    while(textures_.size() > 0)
+    {
+        removeTexture(textures_.begin());
+    }
+
+    while(images_.size() > 0)
+    {
+        removeImage(images_.begin());
+    }
+}
+
+std::string DynamicTextureCache::getStatistics()
+{
+    QMutexLocker locker(&mutex_);
+
+    std::stringstream ss;
+
+    ss << "textures: " << textures_.size() << " cached (" << textureBytes_ / (1024 * 1024) << " MB), ";
+    ss << textureInUseBytes_ / (1024 * 1024) << " MB in use, ";
+    ss << atlasBytes_ / (1024 * 1024) << " MB atlas pages, ";
+    ss << textureBudget_ / (1024 * 1024) << " MB budget, ";
+    ss << textureHits_ << " hits, " << textureEvictions_ << " evictions; ";
+
+    ss << "images: " << images_.size() << " cached (" << imageBytes_ / (1024 * 1024) << " MB), ";
+    ss << imageBudget_ / (1024 * 1024) << " MB budget, ";
+    ss << imageHits_ << " hits, " << imageEvictions_ << " evictions; ";
+
+    ss << misses_ << " misses";
+
+    return ss.str();
+}
+
+void DynamicTextureCache::logStatistics(long frameCount)
+{
+    if(frameCount % DYNAMIC_TEXTURE_CACHE_STATISTICS_INTERVAL == 0)
+    {
+        put_flog(LOG_DEBUG, "%s", getStatistics().c_str());
+    }
+}
+
+void DynamicTextureCache::evictTextures()
+{
+    // textures in use can't be evicted; they are released when their DynamicTexture objects are cleared
+    // tiles in atlas slots are skipped, since evicting them doesn't free texture memory
+    std::list<DynamicTextureCacheTexture>::iterator it = textures_.end();
+
+    while(it != textures_.begin() && textureBytes_ + textureInUseBytes_ + atlasBytes_ > textureBudget_)
+    {
+        it--;
+
+        if(it->atlasSlot < 0)
+        {
+            // continue from the next more recently used texture
+            std::list<DynamicTextureCacheTexture>::iterator evicted = it;
+            it++;
+
+            removeTexture(evicted);
+
+            textureEvictions_++;
+        }
+    }
+}
+
+void DynamicTextureCache::evictImages()
+{
+    while(images_.size() > 0 && imageBytes_ > imageBudget_)
+    {
+        std::list<DynamicTextureCacheImage>::iterator it = images_.end();
+        it--;
+
+        removeImage(it);
+
+        imageEvictions_++;
+    }
+}
+
+void DynamicTextureCache::removeTexture(std::list<DynamicTextureCacheTexture>::iterator it)
+{
+    if(it->atlasSlot >= 0)
+    {
+        g_mainWindow->getGLWindow()->getDynamicTextureAtlas().freeSlot(it->atlasSlot);
+    }
+    else
+    {
+        // let the OpenGL window delete the texture, so this can occur in any thread
+        g_mainWindow->getGLWindow()->insertPurgeTextureId(it->textureId);
+    }
+
+    textureBytes_ -= it->bytes;
+
+    textureMap_.erase(it->key);
+    textures_.erase(it);
+}
+
+void DynamicTextureCache::removeImage(std::list<DynamicTextureCacheImage>::iterator it)
+{
+    imageBytes_ -= it->bytes;
+
+    imageMap_.erase(it->key);
+    images_.erase(it);
+}
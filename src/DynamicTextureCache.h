@@ -0,0 +1,158 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DYNAMIC_TEXTURE_CACHE_H
+#define DYNAMIC_TEXTURE_CACHE_H
+
+// log cache statistics every this many frames
+#define DYNAMIC_TEXTURE_CACHE_STATISTICS_INTERVAL 600
+
+#include <QtGui>
+#include <QGLWidget>
+#include <list>
+#include <map>
+#include <string>
+
+struct DynamicTextureCacheTexture {
+
+    std::string key;
+    GLuint textureId;
+    int atlasSlot; // -1 if not in the DynamicTextureAtlas
+    qint64 bytes;
+};
+
+struct DynamicTextureCacheImage {
+
+    std::string key;
+    QImage image;
+    qint64 bytes;
+};
+
+// per-process cache of DynamicTexture tiles, shared by all DynamicTexture trees.
+//
+// textures of tiles that are no longer displayed (their DynamicTexture objects were
+// cleared) are kept on the GPU instead of being deleted, and decoded tile images are
+// kept in host memory, so a tile panned or zoomed away from and back to is not
+// reloaded from disk. both are evicted least recently used first: textures when the
+// cached textures, the textures in use and the DynamicTextureAtlas pages exceed the
+// texture budget, images when they exceed the image budget.
+//
+// tiles in atlas slots have no texture memory of their own, since their page is
+// charged to the budget as a whole. cached tiles in atlas slots are evicted when the
+// atlas needs their slots.
+//
+// tiles are identified by DynamicTexture::getCacheKey(). all methods are thread-safe.
+class DynamicTextureCache {
+
+    public:
+
+        DynamicTextureCache();
+        ~DynamicTextureCache();
+
+        // take ownership of a cached texture or atlas slot; returns false on a miss
+        bool takeTexture(std::string key, GLuint & textureId, int & atlasSlot, qint64 & bytes);
+
+        // give a texture or atlas slot (atlasSlot >= 0) no longer in use to the cache; this is the only way
+        // textures in use are released, so its bytes move from in use to cached
+        void insertTexture(std::string key, GLuint textureId, int atlasSlot, qint64 bytes);
+
+        // account for a texture uploaded by a DynamicTexture object; it is released with insertTexture()
+        void addTextureInUse(qint64 bytes);
+
+        // for the DynamicTextureAtlas, when all its slots are in use: evict the least recently used cached tile
+        // in an atlas slot, freeing the slot, and return false. if there is none, charge a new page of bytes to
+        // the texture budget, evicting cached textures to make room, and return true; return false if the
+        // textures in use and the pages leave no room for it
+        bool reserveAtlasPage(qint64 bytes);
+
+        // release the charge for deleted atlas pages
+        void releaseAtlasPages(qint64 bytes);
+
+        // get a cached image; returns false on a miss
+        bool getImage(std::string key, QImage & image);
+
+        void insertImage(std::string key, QImage image);
+
+        // see if a texture or image is cached, without counting a hit or miss
+        bool contains(std::string key);
+
+        // count a lookup that missed both textures and images
+        void recordMiss();
+
+        // delete all cached textures and images
+        void clear();
+
+        std::string getStatistics();
+
+        // log statistics every DYNAMIC_TEXTURE_CACHE_STATISTICS_INTERVAL frames
+        void logStatistics(long frameCount);
+
+    private:
+
+        QMutex mutex_;
+
+        qint64 textureBudget_;
+        qint64 imageBudget_;
+
+        // most recently used first, with an index by key
+        std::list<DynamicTextureCacheTexture> textures_;
+        std::map<std::string, std::list<DynamicTextureCacheTexture>::iterator> textureMap_;
+
+        std::list<DynamicTextureCacheImage> images_;
+        std::map<std::string, std::list<DynamicTextureCacheImage>::iterator> imageMap_;
+
+        qint64 textureBytes_;
+        qint64 textureInUseBytes_;
+        qint64 atlasBytes_;
+        qint64 imageBytes_;
+
+        // statistics
+        long textureHits_;
+        long imageHits_;
+        long misses_;
+        long textureEvictions_;
+        long imageEvictions_;
+
+        // must be called with mutex_ locked
+        void evictTextures();
+        void evictImages();
+        void removeTexture(std::list<DynamicTextureCacheTexture>::iterator it);
+        void removeImage(std::list<DynamicTextureCacheImage>::iterator it);
+};
+
+#endif
@@ -58,6 +58,11 @@ void DynamicTextureContent::getFactoryObjectDimensions(int &width, int &height)
     g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(getURI())->getDimensions(width, height);
 }
 
+void DynamicTextureContent::touchFactoryObject()
+{
+    g_mainWindow->getGLWindow()->getDynamicTextureFactory().touchObject(getURI());
+}
+
 void DynamicTextureContent::renderFactoryObject(float tX, float tY, float tW, float tH)
 {
     g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(getURI())->render(tX, tY, tW, tH);
@@ -0,0 +1,84 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DynamicTextureLOD.h"
+#include <math.h>
+
+QRectF DynamicTextureLOD::mapRect(const QRectF & outer, const QRectF & inner)
+{
+    // inner is given in outer's (0,0,1,1) coordinates; the views are orthographic, so this is just a scale and translation
+    return QRectF(outer.x() + inner.x() * outer.width(), outer.y() + inner.y() * outer.height(), inner.width() * outer.width(), inner.height() * outer.height());
+}
+
+double DynamicTextureLOD::getProjectedPixelArea(const QRectF & pixelRect, const QRectF & windowRect, bool onScreenOnly)
+{
+    if(onScreenOnly == true)
+    {
+        // clamp to on-screen portion
+        QRectF onScreenRect = pixelRect.intersected(windowRect);
+
+        return onScreenRect.width() * onScreenRect.height();
+    }
+
+    return fabs(pixelRect.width() * pixelRect.height());
+}
+
+QRectF DynamicTextureLOD::getScreenRect(const QRectF & pixelRect, const QRectF & windowRect)
+{
+    if(pixelRect.width() == 0. || pixelRect.height() == 0.)
+    {
+        return QRectF();
+    }
+
+    // window edges in object coordinates
+    QRectF rect((windowRect.x() - pixelRect.x()) / pixelRect.width(), (windowRect.y() - pixelRect.y()) / pixelRect.height(), windowRect.width() / pixelRect.width(), windowRect.height() / pixelRect.height());
+
+    return rect.intersected(QRectF(0.,0.,1.,1.));
+}
+
+bool DynamicTextureLOD::getDrawChildren(const QRectF & pixelRect, const QRectF & windowRect, int tileSize, int depth, int imageWidth, int imageHeight)
+{
+    double tileArea = (double)tileSize * (double)tileSize;
+
+    if(getProjectedPixelArea(pixelRect, windowRect, true) <= 0. || getProjectedPixelArea(pixelRect, windowRect, false) <= tileArea)
+    {
+        return false;
+    }
+
+    return (imageWidth / pow(2,depth) > tileSize || imageHeight / pow(2,depth) > tileSize);
+}
@@ -0,0 +1,67 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DYNAMIC_TEXTURE_LOD_H
+#define DYNAMIC_TEXTURE_LOD_H
+
+#include <QtGui>
+
+// level of detail selection for DynamicTexture trees, computed on the CPU.
+//
+// the views are orthographic, so a tile's window rectangle (pixelRect) is found from its
+// parent's by a scale and translation, with no OpenGL state queries. this has no other
+// dependencies, so it can also be used by the benchmarks.
+class DynamicTextureLOD {
+
+    public:
+
+        // the rectangle inner, given in outer's (0,0,1,1) coordinates, in outer's coordinates
+        static QRectF mapRect(const QRectF & outer, const QRectF & inner);
+
+        // area in pixels of a tile with window rectangle pixelRect, optionally only its portion in windowRect
+        static double getProjectedPixelArea(const QRectF & pixelRect, const QRectF & windowRect, bool onScreenOnly);
+
+        // the portion of a tile with window rectangle pixelRect in windowRect, in the tile's (0,0,1,1) coordinates
+        static QRectF getScreenRect(const QRectF & pixelRect, const QRectF & windowRect);
+
+        // whether to draw the children of a tile at depth instead of the tile: it is on the screen, it would be
+        // magnified, i.e. cover more than tileSize x tileSize pixels, and the image has more resolution
+        static bool getDrawChildren(const QRectF & pixelRect, const QRectF & windowRect, int tileSize, int depth, int imageWidth, int imageHeight);
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DynamicTextureLoader.h"
+#include "DynamicTexture.h"
+#include "DynamicTexturePrefetcher.h"
+#include "main.h"
+#include "log.h"
+#include <algorithm>
+#include <sstream>
+
+DynamicTextureLoaderThread::DynamicTextureLoaderThread(DynamicTextureLoader * loader)
+{
+    loader_ = loader;
+}
+
+void DynamicTextureLoaderThread::run()
+{
+    loader_->runThread();
+}
+
+DynamicTextureLoader::DynamicTextureLoader()
+{
+    // defaults
+    stopping_ = false;
+    numLoaded_ = 0;
+    numPrefetched_ = 0;
+    numCanceled_ = 0;
+    totalWaitTime_ = 0.;
+    totalLoadTime_ = 0.;
+    maxWaitTime_ = 0;
+    maxLoadTime_ = 0;
+
+    // leave cores for the global thread pool and pixel stream decoders
+    int numThreads = std::max(QThread::idealThreadCount() - 2, 1);
+
+    put_flog(LOG_INFO, "starting %i dynamic texture loader threads", numThreads);
+
+    for(int i=0; i<numThreads; i++)
+    {
+        DynamicTextureLoaderThread * thread = new DynamicTextureLoaderThread(this);
+        thread->start();
+
+        threads_.push_back(thread);
+    }
+}
+
+DynamicTextureLoader::~DynamicTextureLoader()
+{
+    std::list<DynamicTextureLoadRequest> queue;
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        stopping_ = true;
+        condition_.wakeAll();
+
+        for(std::list<DynamicTextureLoadRequest>::iterator it = queue_.begin(); it != queue_.end(); it++)
+        {
+            if(it->dynamicTexture != NULL)
+            {
+                it->dynamicTexture->loadState_.fetchAndStoreRelease(LOAD_IDLE);
+            }
+        }
+
+        // release the objects without holding the lock, since their destructors may be called
+        queue.swap(queue_);
+        queueIndex_.clear();
+        prefetchQueueIndex_.clear();
+    }
+
+    for(unsigned int i=0; i<threads_.size(); i++)
+    {
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+
+    put_flog(LOG_DEBUG, "%s", getStatistics().c_str());
+}
+
+void DynamicTextureLoader::load(boost::shared_ptr<DynamicTexture> dynamicTexture, float priority, long frameCount)
+{
+    QMutexLocker locker(&mutex_);
+
+    int loadState = dynamicTexture->loadState_.fetchAndAddAcquire(0);
+
+    if(loadState == LOAD_QUEUED)
+    {
+        std::map<DynamicTexture *, std::list<DynamicTextureLoadRequest>::iterator>::iterator it = queueIndex_.find(dynamicTexture.get());
+
+        if(it != queueIndex_.end())
+        {
+            it->second->priority = priority;
+            it->second->frameCount = frameCount;
+        }
+    }
+    else if(loadState == LOAD_IDLE && stopping_ != true)
+    {
+        DynamicTextureLoadRequest request;
+        request.dynamicTexture = dynamicTexture;
+        dynamicTexture->getObjectsAscending(request.objects);
+        request.root = request.objects[0].get();
+        request.priority = priority;
+        request.depth = dynamicTexture->depth_;
+        request.frameCount = frameCount;
+        request.queuedTime.start();
+
+        queue_.push_back(request);
+        queueIndex_[dynamicTexture.get()] = --queue_.end();
+
+        dynamicTexture->loadState_.fetchAndStoreRelease(LOAD_QUEUED);
+
+        condition_.wakeOne();
+    }
+}
+
+bool DynamicTextureLoader::prefetch(boost::shared_ptr<DynamicTexturePrefetcher> prefetcher, std::string cacheKey, std::vector<int> treePath, long frameCount)
+{
+    QMutexLocker locker(&mutex_);
+
+    std::map<std::string, std::list<DynamicTextureLoadRequest>::iterator>::iterator it = prefetchQueueIndex_.find(cacheKey);
+
+    if(it != prefetchQueueIndex_.end())
+    {
+        it->second->frameCount = frameCount;
+        return true;
+    }
+    else if(runningPrefetches_.count(cacheKey) == 0 && stopping_ != true)
+    {
+        DynamicTextureLoadRequest request;
+        request.prefetcher = prefetcher;
+        request.cacheKey = cacheKey;
+        request.treePath = treePath;
+        request.root = prefetcher.get();
+        request.priority = 0.;
+        request.depth = (int)treePath.size();
+        request.frameCount = frameCount;
+        request.queuedTime.start();
+
+        queue_.push_back(request);
+        prefetchQueueIndex_[cacheKey] = --queue_.end();
+
+        condition_.wakeOne();
+
+        return true;
+    }
+
+    return false;
+}
+
+void DynamicTextureLoader::prune(long frameCount)
+{
+    std::list<DynamicTextureLoadRequest> canceled;
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        std::list<DynamicTextureLoadRequest>::iterator it = queue_.begin();
+
+        while(it != queue_.end())
+        {
+            std::list<DynamicTextureLoadRequest>::iterator next = it;
+            next++;
+
+            if(it->frameCount < frameCount)
+            {
+                if(it->dynamicTexture != NULL)
+                {
+                    it->dynamicTexture->loadState_.fetchAndStoreRelease(LOAD_IDLE);
+                    queueIndex_.erase(it->dynamicTexture.get());
+                }
+                else
+                {
+                    prefetchQueueIndex_.erase(it->cacheKey);
+                }
+
+                canceled.splice(canceled.end(), queue_, it);
+            }
+
+            it = next;
+        }
+
+        numCanceled_ += canceled.size();
+    }
+
+    // the prefetchers take their own locks
+    for(std::list<DynamicTextureLoadRequest>::iterator it = canceled.begin(); it != canceled.end(); it++)
+    {
+        if(it->prefetcher != NULL)
+        {
+            it->prefetcher->cancelRequest(it->cacheKey);
+        }
+    }
+
+    // the canceled requests may hold the last references to their objects, which are
+    // destructed here without holding the lock
+}
+
+void DynamicTextureLoader::waitForLoad(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    while(dynamicTexture->loadState_.fetchAndAddAcquire(0) == LOAD_RUNNING)
+    {
+        loadedCondition_.wait(&mutex_);
+    }
+}
+
+std::string DynamicTextureLoader::getStatistics()
+{
+    QMutexLocker locker(&mutex_);
+
+    std::stringstream ss;
+
+    ss << "dynamic texture loader: " << numLoaded_ << " loaded, " << numPrefetched_ << " prefetched, " << numCanceled_ << " canceled, " << queue_.size() << " queued";
+
+    if(numLoaded_ > 0)
+    {
+        ss << "; wait mean " << totalWaitTime_ / (double)numLoaded_ << " ms, max " << maxWaitTime_ << " ms";
+        ss << "; load mean " << totalLoadTime_ / (double)numLoaded_ << " ms, max " << maxLoadTime_ << " ms";
+    }
+
+    return ss.str();
+}
+
+void DynamicTextureLoader::logStatistics(long frameCount)
+{
+    if(frameCount % DYNAMIC_TEXTURE_LOADER_STATISTICS_INTERVAL == 0)
+    {
+        put_flog(LOG_DEBUG, "%s", getStatistics().c_str());
+    }
+}
+
+void DynamicTextureLoader::runThread()
+{
+    QMutexLocker locker(&mutex_);
+
+    while(true)
+    {
+        while(queue_.size() == 0 && stopping_ != true)
+        {
+            condition_.wait(&mutex_);
+        }
+
+        if(stopping_ == true)
+        {
+            break;
+        }
+
+        std::list<DynamicTextureLoadRequest>::iterator next = getNextRequest();
+
+        DynamicTextureLoadRequest request = *next;
+        queue_.erase(next);
+
+        if(request.dynamicTexture != NULL)
+        {
+            queueIndex_.erase(request.dynamicTexture.get());
+            request.dynamicTexture->loadState_.fetchAndStoreRelease(LOAD_RUNNING);
+        }
+        else
+        {
+            prefetchQueueIndex_.erase(request.cacheKey);
+            runningPrefetches_.insert(request.cacheKey);
+        }
+
+        numRunning_[request.root]++;
+
+        int waitTime = request.queuedTime.elapsed();
+
+        // load without holding the lock
+        locker.unlock();
+
+        QTime loadTime;
+        loadTime.start();
+
+        if(request.dynamicTexture != NULL)
+        {
+            request.dynamicTexture->loadImage();
+        }
+        else
+        {
+            request.prefetcher->processRequest(request.cacheKey, request.treePath);
+        }
+
+        int elapsed = loadTime.elapsed();
+
+        locker.relock();
+
+        if(request.dynamicTexture != NULL)
+        {
+            request.dynamicTexture->loadState_.fetchAndStoreRelease(LOAD_DONE);
+
+            numLoaded_++;
+            totalWaitTime_ += (double)waitTime;
+            totalLoadTime_ += (double)elapsed;
+            maxWaitTime_ = std::max(maxWaitTime_, waitTime);
+            maxLoadTime_ = std::max(maxLoadTime_, elapsed);
+        }
+        else
+        {
+            runningPrefetches_.erase(request.cacheKey);
+
+            numPrefetched_++;
+        }
+
+        numRunning_[request.root]--;
+
+        if(numRunning_[request.root] == 0)
+        {
+            numRunning_.erase(request.root);
+        }
+
+        loadedCondition_.wakeAll();
+
+        // release the objects without holding the lock, since their destructors may be called
+        locker.unlock();
+        request = DynamicTextureLoadRequest();
+        locker.relock();
+    }
+}
+
+std::list<DynamicTextureLoadRequest>::iterator DynamicTextureLoader::getNextRequest()
+{
+    std::list<DynamicTextureLoadRequest>::iterator best = queue_.begin();
+    int bestNumRunning = 0;
+
+    for(std::list<DynamicTextureLoadRequest>::iterator it = queue_.begin(); it != queue_.end(); it++)
+    {
+        int numRunning = 0;
+
+        std::map<const void *, int>::iterator runningIt = numRunning_.find(it->root);
+
+        if(runningIt != numRunning_.end())
+        {
+            numRunning = runningIt->second;
+        }
+
+        // requests made with load() before prefetch requests, then fewest loads in progress for the
+        // image, then largest on-screen area, then shallowest
+        bool isPrefetch = (it->dynamicTexture == NULL);
+        bool bestIsPrefetch = (best->dynamicTexture == NULL);
+
+        bool better = false;
+
+        if(it == queue_.begin() || (isPrefetch != true && bestIsPrefetch == true))
+        {
+            better = true;
+        }
+        else if(isPrefetch != bestIsPrefetch)
+        {
+            better = false;
+        }
+        else if(numRunning < bestNumRunning)
+        {
+            better = true;
+        }
+        else if(numRunning == bestNumRunning)
+        {
+            if(it->priority > best->priority)
+            {
+                better = true;
+            }
+            else if(it->priority == best->priority && it->depth < best->depth)
+            {
+                better = true;
+            }
+        }
+
+        if(better == true)
+        {
+            best = it;
+            bestNumRunning = numRunning;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,175 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DYNAMIC_TEXTURE_LOADER_H
+#define DYNAMIC_TEXTURE_LOADER_H
+
+// log loader statistics every this many frames
+#define DYNAMIC_TEXTURE_LOADER_STATISTICS_INTERVAL 600
+
+#include <QtGui>
+#include <QThread>
+#include <boost/shared_ptr.hpp>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class DynamicTexture;
+class DynamicTextureLoader;
+class DynamicTexturePrefetcher;
+
+class DynamicTextureLoaderThread : public QThread {
+
+    public:
+
+        DynamicTextureLoaderThread(DynamicTextureLoader * loader);
+
+    protected:
+
+        void run();
+
+    private:
+
+        DynamicTextureLoader * loader_;
+};
+
+struct DynamicTextureLoadRequest {
+
+    boost::shared_ptr<DynamicTexture> dynamicTexture;
+
+    // the object and its ancestors, kept alive while the request is queued or running
+    std::vector<boost::shared_ptr<DynamicTexture> > objects;
+
+    // set instead of dynamicTexture for prefetch requests, which load the tile at treePath
+    // into the DynamicTextureCache under cacheKey
+    boost::shared_ptr<DynamicTexturePrefetcher> prefetcher;
+    std::string cacheKey;
+    std::vector<int> treePath;
+
+    // root of the tree (the prefetcher for prefetch requests), for fairness between images
+    const void * root;
+
+    // on-screen area in pixels; deeper tiles are loaded after shallower ones of the same area
+    float priority;
+    int depth;
+
+    // last frame the tile was requested in
+    long frameCount;
+
+    QTime queuedTime;
+};
+
+// loads DynamicTexture tiles on a dedicated set of threads.
+//
+// render() requests every visible tile that isn't loaded each frame, with its on-screen
+// area. waiting tiles are loaded largest first, and shallower first among equals, taking
+// the next tile from the image with the fewest loads in progress so that one large image
+// can't starve the others. tiles not requested again in a frame have left the screen, and
+// are dropped from the queue by prune().
+//
+// DynamicTexturePrefetcher requests tiles predicted to come on screen through prefetch().
+// these are only loaded when no requests made with load() are waiting, and are renewed
+// and pruned the same way.
+class DynamicTextureLoader {
+
+    public:
+
+        DynamicTextureLoader();
+        ~DynamicTextureLoader();
+
+        // request a tile be loaded, or update the request if it is already queued
+        void load(boost::shared_ptr<DynamicTexture> dynamicTexture, float priority, long frameCount);
+
+        // request a tile be prefetched into the DynamicTextureCache, or renew the request if it is already
+        // queued. depth orders prefetch requests among themselves. the prefetcher's processRequest() is
+        // called to load the tile, and cancelRequest() if the request is pruned. returns false if the
+        // request was not queued, since the tile is already being loaded or the loader is stopping
+        bool prefetch(boost::shared_ptr<DynamicTexturePrefetcher> prefetcher, std::string cacheKey, std::vector<int> treePath, long frameCount);
+
+        // drop queued requests last made before frameCount
+        void prune(long frameCount);
+
+        // wait for a load of dynamicTexture in progress to finish
+        void waitForLoad(DynamicTexture * dynamicTexture);
+
+        std::string getStatistics();
+
+        // log statistics every DYNAMIC_TEXTURE_LOADER_STATISTICS_INTERVAL frames
+        void logStatistics(long frameCount);
+
+        // for use by DynamicTextureLoaderThread
+        void runThread();
+
+    private:
+
+        QMutex mutex_;
+        QWaitCondition condition_;
+        QWaitCondition loadedCondition_;
+
+        bool stopping_;
+
+        std::vector<DynamicTextureLoaderThread *> threads_;
+
+        std::list<DynamicTextureLoadRequest> queue_;
+
+        // the queued request of each object, so requests are renewed without searching the queue
+        std::map<DynamicTexture *, std::list<DynamicTextureLoadRequest>::iterator> queueIndex_;
+
+        // the same for prefetch requests, by cache key, and the cache keys of prefetches in progress
+        std::map<std::string, std::list<DynamicTextureLoadRequest>::iterator> prefetchQueueIndex_;
+        std::set<std::string> runningPrefetches_;
+
+        // loads in progress, per root
+        std::map<const void *, int> numRunning_;
+
+        // statistics; times in milliseconds
+        long numLoaded_;
+        long numPrefetched_;
+        long numCanceled_;
+        double totalWaitTime_;
+        double totalLoadTime_;
+        int maxWaitTime_;
+        int maxLoadTime_;
+
+        // the next request to load; called with mutex_ locked
+        std::list<DynamicTextureLoadRequest>::iterator getNextRequest();
+};
+
+#endif
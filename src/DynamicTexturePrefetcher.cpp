@@ -0,0 +1,333 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DynamicTexturePrefetcher.h"
+#include "DynamicTexture.h"
+#include "DynamicTextureLoader.h"
+#include "main.h"
+#include "log.h"
+#include <cmath>
+
+DynamicTexturePrefetcher::DynamicTexturePrefetcher(std::string rootCacheKey, std::string imagePyramidPath, boost::shared_ptr<ImagePyramidContainer> imagePyramidContainer, int imageWidth, int imageHeight, int tileSize)
+{
+    // defaults
+    maxDepth_ = 0;
+    lastFrameCount_ = -1;
+    lastTime_ = 0;
+    hasLastView_ = false;
+    velocityX_ = 0.;
+    velocityY_ = 0.;
+    velocityZoom_ = 0.;
+    viewChanged_ = false;
+    frameTime_ = 0;
+    lastViewChangeTime_ = 0;
+    waitingForSharp_ = false;
+    frameSharp_ = true;
+    numTimeToSharp_ = 0;
+    totalTimeToSharp_ = 0.;
+    numRequested_ = 0;
+    numLoaded_ = 0;
+    numCanceled_ = 0;
+
+    // assign values
+    rootCacheKey_ = rootCacheKey;
+    imagePyramidPath_ = imagePyramidPath;
+    imagePyramidContainer_ = imagePyramidContainer;
+    imageWidth_ = imageWidth;
+    imageHeight_ = imageHeight;
+    tileSize_ = tileSize;
+
+    // same criterion DynamicTexture::render() uses to stop descending the tree
+    while(imageWidth_ / pow(2,maxDepth_) > tileSize_ || imageHeight_ / pow(2,maxDepth_) > tileSize_)
+    {
+        maxDepth_++;
+    }
+
+    time_.start();
+}
+
+void DynamicTexturePrefetcher::update(long frameCount, QRectF view, QRectF screenRect, double windowArea)
+{
+    // first window rendered this frame
+    if(frameCount != lastFrameCount_)
+    {
+        // see if the previous frame was the first sharp one since the view changed
+        if(waitingForSharp_ == true && frameSharp_ == true && viewChanged_ != true)
+        {
+            int timeToSharp = frameTime_ - lastViewChangeTime_;
+
+            numTimeToSharp_++;
+            totalTimeToSharp_ += (double)timeToSharp;
+            waitingForSharp_ = false;
+
+            put_flog(LOG_INFO, "%s: time to sharp %i ms (mean %f ms over %i), prefetch requested %i, loaded %i, canceled %i", rootCacheKey_.c_str(), timeToSharp, totalTimeToSharp_ / (double)numTimeToSharp_, numTimeToSharp_, numRequested_, numLoaded_, numCanceled_);
+        }
+
+        lastFrameCount_ = frameCount;
+        frameTime_ = time_.elapsed();
+        frameSharp_ = true;
+
+        updateMotion(view);
+
+        // tiles requested in the last frame stay wanted until the end of this one
+        QMutexLocker locker(&mutex_);
+
+        wanted_.swap(nextWanted_);
+        nextWanted_.clear();
+    }
+
+    // only prefetch while the view is changing; otherwise the visible tiles are loaded on demand
+    if(viewChanged_ != true || screenRect.isEmpty() == true)
+    {
+        return;
+    }
+
+    // portion of the predicted view that would be on this screen
+    QRectF region(predictedView_.x() + screenRect.x() * predictedView_.width(), predictedView_.y() + screenRect.y() * predictedView_.height(), screenRect.width() * predictedView_.width(), screenRect.height() * predictedView_.height());
+
+    // tree depth rendered for the predicted view: the first where a tile would cover no more than tileSize_ x tileSize_ pixels
+    double imageArea = windowArea / (predictedView_.width() * predictedView_.height());
+    int depth = (int)ceil(log(imageArea / ((double)tileSize_ * (double)tileSize_)) / log(4.));
+
+    if(depth < 0)
+    {
+        depth = 0;
+    }
+    else if(depth > maxDepth_)
+    {
+        depth = maxDepth_;
+    }
+
+    requestTiles(region, depth);
+}
+
+void DynamicTexturePrefetcher::recordBlurryTile()
+{
+    frameSharp_ = false;
+}
+
+void DynamicTexturePrefetcher::processRequest(std::string key, std::vector<int> treePath)
+{
+    // the view may have changed since the request was made
+    bool wanted = isWanted(key);
+
+    if(wanted == true)
+    {
+        QImage image;
+
+        if(DynamicTexture::loadImagePyramidTile(imagePyramidPath_, imagePyramidContainer_, treePath, image) == true)
+        {
+            // same format DynamicTexture::loadImage() produces
+            image = QGLWidget::convertToGLFormat(image);
+
+            g_mainWindow->getGLWindow()->getDynamicTextureCache().insertImage(key, image);
+        }
+    }
+
+    QMutexLocker locker(&mutex_);
+
+    if(wanted == true)
+    {
+        numLoaded_++;
+    }
+    else
+    {
+        numCanceled_++;
+    }
+
+    pending_.erase(key);
+}
+
+void DynamicTexturePrefetcher::cancelRequest(std::string key)
+{
+    QMutexLocker locker(&mutex_);
+
+    numCanceled_++;
+
+    pending_.erase(key);
+}
+
+void DynamicTexturePrefetcher::updateMotion(QRectF view)
+{
+    int now = time_.elapsed();
+
+    if(hasLastView_ == true && now > lastTime_)
+    {
+        double dt = (double)(now - lastTime_) / 1000.;
+
+        double velocityX = (view.center().x() - lastView_.center().x()) / dt;
+        double velocityY = (view.center().y() - lastView_.center().y()) / dt;
+        double velocityZoom = log(lastView_.width() / view.width()) / dt;
+
+        velocityX_ = DYNAMIC_TEXTURE_PREFETCH_SMOOTHING * velocityX + (1. - DYNAMIC_TEXTURE_PREFETCH_SMOOTHING) * velocityX_;
+        velocityY_ = DYNAMIC_TEXTURE_PREFETCH_SMOOTHING * velocityY + (1. - DYNAMIC_TEXTURE_PREFETCH_SMOOTHING) * velocityY_;
+        velocityZoom_ = DYNAMIC_TEXTURE_PREFETCH_SMOOTHING * velocityZoom + (1. - DYNAMIC_TEXTURE_PREFETCH_SMOOTHING) * velocityZoom_;
+    }
+
+    viewChanged_ = (hasLastView_ == true && view != lastView_);
+
+    if(viewChanged_ == true)
+    {
+        lastViewChangeTime_ = now;
+        waitingForSharp_ = true;
+    }
+
+    lastView_ = view;
+    lastTime_ = now;
+    hasLastView_ = true;
+
+    // extrapolate the view, keeping it within the image like ContentWindowInterface does
+    double w = view.width() * exp(-velocityZoom_ * DYNAMIC_TEXTURE_PREFETCH_LOOKAHEAD);
+    double h = view.height() * exp(-velocityZoom_ * DYNAMIC_TEXTURE_PREFETCH_LOOKAHEAD);
+
+    if(w > 1.)
+    {
+        w = 1.;
+    }
+
+    if(h > 1.)
+    {
+        h = 1.;
+    }
+
+    double centerX = view.center().x() + velocityX_ * DYNAMIC_TEXTURE_PREFETCH_LOOKAHEAD;
+    double centerY = view.center().y() + velocityY_ * DYNAMIC_TEXTURE_PREFETCH_LOOKAHEAD;
+
+    if(centerX < 0.5 * w)
+    {
+        centerX = 0.5 * w;
+    }
+    else if(centerX > 1. - 0.5 * w)
+    {
+        centerX = 1. - 0.5 * w;
+    }
+
+    if(centerY < 0.5 * h)
+    {
+        centerY = 0.5 * h;
+    }
+    else if(centerY > 1. - 0.5 * h)
+    {
+        centerY = 1. - 0.5 * h;
+    }
+
+    predictedView_ = QRectF(centerX - 0.5 * w, centerY - 0.5 * h, w, h);
+}
+
+void DynamicTexturePrefetcher::requestTiles(QRectF region, int depth)
+{
+    int numTiles = 1 << depth;
+
+    int i0 = std::max((int)floor(region.left() * numTiles), 0);
+    int i1 = std::min((int)ceil(region.right() * numTiles), numTiles);
+    int j0 = std::max((int)floor(region.top() * numTiles), 0);
+    int j1 = std::min((int)ceil(region.bottom() * numTiles), numTiles);
+
+    if(g_dynamicTextureLoader == NULL)
+    {
+        return;
+    }
+
+    DynamicTextureCache & cache = g_mainWindow->getGLWindow()->getDynamicTextureCache();
+
+    for(int j=j0; j<j1; j++)
+    {
+        for(int i=i0; i<i1; i++)
+        {
+            // path through the tree, with quadrants ordered as in DynamicTexture::renderChildren()
+            std::vector<int> treePath(1, 0);
+            std::string key = rootCacheKey_;
+
+            for(int level=depth-1; level>=0; level--)
+            {
+                int x = (i >> level) & 1;
+                int y = (j >> level) & 1;
+
+                int childIndex = (y == 0) ? x : 3 - x;
+
+                treePath.push_back(childIndex);
+                key += "-" + QString::number(childIndex).toStdString();
+            }
+
+            bool pending;
+
+            {
+                QMutexLocker locker(&mutex_);
+
+                nextWanted_.insert(key);
+
+                pending = (pending_.count(key) > 0);
+
+                if(pending != true && (int)pending_.size() >= DYNAMIC_TEXTURE_PREFETCH_MAX_PENDING)
+                {
+                    continue;
+                }
+            }
+
+            if(pending != true)
+            {
+                if(cache.contains(key) == true)
+                {
+                    continue;
+                }
+
+                QMutexLocker locker(&mutex_);
+
+                pending_.insert(key);
+                numRequested_++;
+            }
+
+            // queue the request, or renew it so it isn't pruned at the end of this frame
+            if(g_dynamicTextureLoader->prefetch(shared_from_this(), key, treePath, lastFrameCount_) != true && pending != true)
+            {
+                // a previous request for the tile is still finishing
+                QMutexLocker locker(&mutex_);
+
+                pending_.erase(key);
+                numRequested_--;
+            }
+        }
+    }
+}
+
+bool DynamicTexturePrefetcher::isWanted(std::string key)
+{
+    QMutexLocker locker(&mutex_);
+
+    return (wanted_.count(key) > 0 || nextWanted_.count(key) > 0);
+}
@@ -0,0 +1,138 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DYNAMIC_TEXTURE_PREFETCHER_H
+#define DYNAMIC_TEXTURE_PREFETCHER_H
+
+// how far ahead (seconds) to predict the view
+#define DYNAMIC_TEXTURE_PREFETCH_LOOKAHEAD 0.5
+
+// smoothing factor for the view velocity
+#define DYNAMIC_TEXTURE_PREFETCH_SMOOTHING 0.5
+
+// maximum number of prefetch requests queued or loading at once, per image
+#define DYNAMIC_TEXTURE_PREFETCH_MAX_PENDING 16
+
+#include "ImagePyramidContainer.h"
+#include <QtGui>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+// prefetches image pyramid tiles for a DynamicTexture root into the DynamicTextureCache.
+//
+// the root reports the view rectangle it renders every frame; the prefetcher tracks the
+// pan and zoom velocity of the view and requests the tiles that would be rendered for
+// the view predicted DYNAMIC_TEXTURE_PREFETCH_LOOKAHEAD seconds ahead from the
+// DynamicTextureLoader, which loads them after all on-demand loads. pending requests are
+// renewed every frame their tiles are still predicted, and pruned by the loader otherwise.
+//
+// it also measures time-to-sharp: the time from the last change of the view until a
+// frame is rendered without any tile falling back to a lower resolution parent.
+class DynamicTexturePrefetcher : public boost::enable_shared_from_this<DynamicTexturePrefetcher> {
+
+    public:
+
+        DynamicTexturePrefetcher(std::string rootCacheKey, std::string imagePyramidPath, boost::shared_ptr<ImagePyramidContainer> imagePyramidContainer, int imageWidth, int imageHeight, int tileSize);
+
+        // called by the root for each window it is rendered in, with the view rectangle in
+        // image coordinates, the on-screen portion of the window in window coordinates
+        // [0,1], and the projected area of the window in pixels
+        void update(long frameCount, QRectF view, QRectF screenRect, double windowArea);
+
+        // a tile had to be rendered from a parent in this frame
+        void recordBlurryTile();
+
+        // called by the DynamicTextureLoader to load a requested tile
+        void processRequest(std::string key, std::vector<int> treePath);
+
+        // called by the DynamicTextureLoader when a request is pruned
+        void cancelRequest(std::string key);
+
+    private:
+
+        std::string rootCacheKey_;
+        std::string imagePyramidPath_;
+        boost::shared_ptr<ImagePyramidContainer> imagePyramidContainer_;
+        int imageWidth_;
+        int imageHeight_;
+        int tileSize_;
+
+        // deepest level of the tree
+        int maxDepth_;
+
+        QTime time_;
+
+        // view and smoothed velocity, in image coordinates and log zoom per second
+        long lastFrameCount_;
+        int lastTime_;
+        QRectF lastView_;
+        bool hasLastView_;
+        double velocityX_;
+        double velocityY_;
+        double velocityZoom_;
+        QRectF predictedView_;
+        bool viewChanged_;
+
+        // tiles predicted in the previous and current frame, and requests not yet finished
+        QMutex mutex_;
+        std::set<std::string> wanted_;
+        std::set<std::string> nextWanted_;
+        std::set<std::string> pending_;
+
+        // time-to-sharp
+        int frameTime_;
+        int lastViewChangeTime_;
+        bool waitingForSharp_;
+        bool frameSharp_;
+        int numTimeToSharp_;
+        double totalTimeToSharp_;
+
+        // statistics
+        int numRequested_;
+        int numLoaded_;
+        int numCanceled_;
+
+        void updateMotion(QRectF view);
+        void requestTiles(QRectF region, int depth);
+        bool isWanted(std::string key);
+};
+
+#endif
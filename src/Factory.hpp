@@ -39,73 +39,412 @@
 #ifndef FACTORY_HPP
 #define FACTORY_HPP
 
+// objects are divided into this many shards by URI hash, each with its own locks
+#define FACTORY_NUM_SHARDS 16
+
 #include <map>
 #include <string>
+#include <vector>
+#include <sstream>
 #include <boost/shared_ptr.hpp>
+#include <boost/functional/hash.hpp>
 #include <QtGui>
 
 extern long g_frameCount;
 
+// the objects of one shard. the published map is never modified, only replaced by a modified copy. readers
+// don't take a lock: they count themselves in numReaders for the current epoch while using the published
+// map. a replaced map is retired, and deleted by a later writer once no reader can still be using it
+template <class T>
+struct FactoryShard {
+
+    // held while creating or removing objects, so object construction doesn't block readers
+    QMutex writeMutex;
+
+    // reference to the published map, replaced with writeMutex held
+    QAtomicPointer<const boost::shared_ptr<const std::map<std::string, boost::shared_ptr<T> > > > map;
+
+    // readers using the published map, counted under the parity of the epoch they started in
+    QAtomicInt epoch;
+    QAtomicInt numReaders[2];
+
+    // the rest is protected by writeMutex
+
+    // epoch flips, and flips after which the readers of the previous epoch were seen to have finished
+    long numFlips;
+    long numFinishedFlips;
+
+    // replaced maps and the number of flips when they were replaced
+    std::vector<std::pair<long, const boost::shared_ptr<const std::map<std::string, boost::shared_ptr<T> > > *> > retiredMaps;
+
+    long numReplacements;
+};
+
+// the objects of all shards at one point in time, iterated in shard order and then URI order; since the
+// URI hash is deterministic, the order is the same on all processes
+template <class T>
+class FactorySnapshot {
+
+    public:
+
+        typedef std::map<std::string, boost::shared_ptr<T> > ObjectMap;
+
+        class const_iterator {
+
+            public:
+
+                const_iterator(const FactorySnapshot * snapshot, unsigned int shard)
+                {
+                    snapshot_ = snapshot;
+                    shard_ = shard;
+
+                    if(shard_ < snapshot_->maps_.size())
+                    {
+                        it_ = snapshot_->maps_[shard_]->begin();
+                        skipEmptyShards();
+                    }
+                }
+
+                const typename ObjectMap::value_type & operator*() const
+                {
+                    return *it_;
+                }
+
+                const typename ObjectMap::value_type * operator->() const
+                {
+                    return &(*it_);
+                }
+
+                const_iterator & operator++()
+                {
+                    it_++;
+                    skipEmptyShards();
+
+                    return *this;
+                }
+
+                const_iterator operator++(int)
+                {
+                    const_iterator it = *this;
+                    ++(*this);
+
+                    return it;
+                }
+
+                bool operator==(const const_iterator & other) const
+                {
+                    return shard_ == other.shard_ && (shard_ >= snapshot_->maps_.size() || it_ == other.it_);
+                }
+
+                bool operator!=(const const_iterator & other) const
+                {
+                    return !(*this == other);
+                }
+
+            private:
+
+                const FactorySnapshot * snapshot_;
+                unsigned int shard_;
+                typename ObjectMap::const_iterator it_;
+
+                void skipEmptyShards()
+                {
+                    while(it_ == snapshot_->maps_[shard_]->end())
+                    {
+                        shard_++;
+
+                        if(shard_ >= snapshot_->maps_.size())
+                        {
+                            return;
+                        }
+
+                        it_ = snapshot_->maps_[shard_]->begin();
+                    }
+                }
+        };
+
+        const_iterator begin() const
+        {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(this, maps_.size());
+        }
+
+        void addMap(boost::shared_ptr<const ObjectMap> map)
+        {
+            maps_.push_back(map);
+        }
+
+    private:
+
+        // the published map of each shard
+        std::vector<boost::shared_ptr<const ObjectMap> > maps_;
+};
+
 template <class T>
 class Factory {
 
     public:
 
+        typedef std::map<std::string, boost::shared_ptr<T> > ObjectMap;
+        typedef boost::shared_ptr<const ObjectMap> MapReference;
+
+        Factory()
+        {
+            for(int i=0; i<FACTORY_NUM_SHARDS; i++)
+            {
+                shards_[i].map = new MapReference(new ObjectMap());
+                shards_[i].numFlips = 0;
+                shards_[i].numFinishedFlips = 0;
+                shards_[i].numReplacements = 0;
+            }
+        }
+
+        ~Factory()
+        {
+            for(int i=0; i<FACTORY_NUM_SHARDS; i++)
+            {
+                for(unsigned int j=0; j<shards_[i].retiredMaps.size(); j++)
+                {
+                    delete shards_[i].retiredMaps[j].second;
+                }
+
+                delete (const MapReference *)shards_[i].map;
+            }
+        }
+
         boost::shared_ptr<T> getObject(std::string uri)
         {
-            QMutexLocker locker(&mapMutex_);
+            FactoryShard<T> & shard = getShard(uri);
+
+            {
+                int parity = beginRead(shard);
+
+                const ObjectMap & map = **(const MapReference *)shard.map;
+
+                typename ObjectMap::const_iterator it = map.find(uri);
+
+                boost::shared_ptr<T> t;
+
+                if(it != map.end())
+                {
+                    t = it->second;
+                }
+
+                endRead(shard, parity);
 
-            // see if we need to create the object
-            if(map_.count(uri) == 0)
+                if(t != NULL)
+                {
+                    return t;
+                }
+            }
+
+            // create the object, unless another thread created it first
+            QMutexLocker locker(&shard.writeMutex);
+
+            MapReference map = getMap(shard);
+
+            typename ObjectMap::const_iterator it = map->find(uri);
+
+            if(it != map->end())
             {
-                boost::shared_ptr<T> t(new T(uri));
+                return it->second;
+            }
+
+            boost::shared_ptr<T> t(new T(uri));
+
+            boost::shared_ptr<ObjectMap> newMap(new ObjectMap(*map));
+            (*newMap)[uri] = t;
+
+            setMap(shard, newMap);
+
+            return t;
+        }
+
+        // keep an existing object from being cleared this frame, as if it was rendered; does not create the object
+        void touchObject(std::string uri)
+        {
+            FactoryShard<T> & shard = getShard(uri);
+
+            int parity = beginRead(shard);
+
+            const ObjectMap & map = **(const MapReference *)shard.map;
+
+            typename ObjectMap::const_iterator it = map.find(uri);
 
-                map_[uri] = t;
+            if(it != map.end())
+            {
+                it->second->updateRenderedFrameCount();
             }
 
-            return map_[uri];
+            endRead(shard, parity);
         }
 
-        std::map<std::string, boost::shared_ptr<T> > getMap()
+        // all objects, without copying them; objects removed after the snapshot is taken live until it is destroyed
+        FactorySnapshot<T> getSnapshot()
         {
-            QMutexLocker locker(&mapMutex_);
+            FactorySnapshot<T> snapshot;
+
+            for(int i=0; i<FACTORY_NUM_SHARDS; i++)
+            {
+                int parity = beginRead(shards_[i]);
+
+                snapshot.addMap(*(const MapReference *)shards_[i].map);
+
+                endRead(shards_[i], parity);
+            }
 
-            return map_;
+            return snapshot;
         }
 
         void clear()
         {
-            QMutexLocker locker(&mapMutex_);
+            for(int i=0; i<FACTORY_NUM_SHARDS; i++)
+            {
+                QMutexLocker locker(&shards_[i].writeMutex);
+
+                setMap(shards_[i], MapReference(new ObjectMap()));
+
+                // objects are destroyed now, rather than by a later writer
+                while(shards_[i].retiredMaps.empty() != true)
+                {
+                    QThread::yieldCurrentThread();
 
-            map_.clear();
+                    deleteRetiredMaps(shards_[i]);
+                }
+            }
         }
 
         void clearStaleObjects()
         {
-            QMutexLocker locker(&mapMutex_);
+            for(int i=0; i<FACTORY_NUM_SHARDS; i++)
+            {
+                QMutexLocker locker(&shards_[i].writeMutex);
 
-            typename std::map<std::string, boost::shared_ptr<T> >::iterator it = map_.begin();
+                MapReference map = getMap(shards_[i]);
 
-            while(it != map_.end())
-            {
-                if(g_frameCount - it->second->getRenderedFrameCount() > 1)
+                // only replace the map if it has stale objects
+                boost::shared_ptr<ObjectMap> newMap;
+
+                for(typename ObjectMap::const_iterator it = map->begin(); it != map->end(); it++)
                 {
-                    map_.erase(it++);  // note the post increment; increments the iterator but returns original value for erase
+                    if(g_frameCount - it->second->getRenderedFrameCount() > 1)
+                    {
+                        if(newMap == NULL)
+                        {
+                            newMap = boost::shared_ptr<ObjectMap>(new ObjectMap(*map));
+                        }
+
+                        newMap->erase(it->first);
+                    }
+                }
+
+                if(newMap != NULL)
+                {
+                    setMap(shards_[i], newMap);
                 }
                 else
                 {
-                    it++;
+                    deleteRetiredMaps(shards_[i]);
                 }
             }
         }
 
+        // map replacements since the last call, and replaced maps not yet deleted because readers may be using them
+        std::string getStatistics()
+        {
+            long numReplacements = 0;
+            long numRetiredMaps = 0;
+
+            for(int i=0; i<FACTORY_NUM_SHARDS; i++)
+            {
+                QMutexLocker locker(&shards_[i].writeMutex);
+
+                numReplacements += shards_[i].numReplacements;
+                numRetiredMaps += shards_[i].retiredMaps.size();
+
+                shards_[i].numReplacements = 0;
+            }
+
+            std::ostringstream statistics;
+            statistics << numReplacements << " map replacements, " << numRetiredMaps << " replaced maps awaiting readers";
+
+            return statistics.str();
+        }
+
     private:
 
-        // mutex for thread-safe access to map
-        QMutex mapMutex_;
+        FactoryShard<T> shards_[FACTORY_NUM_SHARDS];
 
-        // all existing objects
-        std::map<std::string, boost::shared_ptr<T> > map_;
+        FactoryShard<T> & getShard(const std::string & uri)
+        {
+            return shards_[boost::hash<std::string>()(uri) % FACTORY_NUM_SHARDS];
+        }
+
+        // the published map may only be used between these; returns the parity to pass to endRead()
+        int beginRead(FactoryShard<T> & shard)
+        {
+            int parity = (int)shard.epoch & 1;
+
+            shard.numReaders[parity].ref();
+
+            return parity;
+        }
+
+        void endRead(FactoryShard<T> & shard, int parity)
+        {
+            shard.numReaders[parity].deref();
+        }
+
+        // only called with writeMutex held, so the published map can't be deleted meanwhile
+        MapReference getMap(FactoryShard<T> & shard)
+        {
+            return *(const MapReference *)shard.map;
+        }
+
+        // only called with writeMutex held
+        void setMap(FactoryShard<T> & shard, MapReference map)
+        {
+            const MapReference * previousMap = shard.map.fetchAndStoreOrdered(new MapReference(map));
+
+            shard.retiredMaps.push_back(std::pair<long, const MapReference *>(shard.numFlips, previousMap));
+            shard.numReplacements++;
+
+            deleteRetiredMaps(shard);
+        }
+
+        // only called with writeMutex held. doesn't wait for readers: if the readers of the previous epoch have
+        // finished, the epoch is flipped. a map retired after flip n may be in use by readers counted under
+        // either parity, so it is deleted once the readers of the epochs before flips n+1 and n+2 have finished
+        void deleteRetiredMaps(FactoryShard<T> & shard)
+        {
+            int parity = (int)shard.epoch & 1;
+
+            if(shard.numReaders[parity ^ 1].fetchAndAddOrdered(0) != 0)
+            {
+                return;
+            }
+
+            shard.numFinishedFlips = shard.numFlips;
+
+            shard.epoch.fetchAndStoreOrdered(parity ^ 1);
+            shard.numFlips++;
+
+            unsigned int numDeleted = 0;
+
+            while(numDeleted < shard.retiredMaps.size() && shard.retiredMaps[numDeleted].first + 2 <= shard.numFinishedFlips)
+            {
+                // this may destroy objects, unless a snapshot still refers to the map
+                delete shard.retiredMaps[numDeleted].second;
+
+                numDeleted++;
+            }
+
+            shard.retiredMaps.erase(shard.retiredMaps.begin(), shard.retiredMaps.begin() + numDeleted);
+        }
 };
 
 #endif
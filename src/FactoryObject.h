@@ -47,6 +47,8 @@ class FactoryObject {
 
     protected:
 
+        template <class T> friend class Factory;
+
         void updateRenderedFrameCount();
 
         // frame count object was last rendered
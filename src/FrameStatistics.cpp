@@ -0,0 +1,530 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "FrameStatistics.h"
+#include "main.h"
+#include "log.h"
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+// layout of MPI_DOUBLE_INT
+struct FrameStatisticsTimeToBarrier {
+    double value;
+    int rank;
+};
+
+double FrameStatisticsReport::getBusyTime()
+{
+    double busyTime = 0.;
+
+    for(unsigned int i=0; i<phaseTimes.size(); i++)
+    {
+        if(i != FRAME_PHASE_BARRIER)
+        {
+            busyTime += phaseTimes[i];
+        }
+    }
+
+    return busyTime;
+}
+
+FrameStatistics::FrameStatistics()
+{
+    // defaults
+    numFrames_ = 0;
+    sending_ = false;
+    timeToBarrierTotal_ = 0.;
+    timeToBarrierMax_ = 0.;
+    slowestRank_ = -1;
+    stragglerIntervals_ = 0;
+    stragglerRank_ = -1;
+
+    phaseTotals_ = std::vector<double>(FRAME_PHASE_COUNT, 0.);
+    phaseTimes_ = std::vector<double>(FRAME_PHASE_COUNT, 0.);
+}
+
+FrameStatistics::~FrameStatistics()
+{
+    // rank 0 may no longer be receiving
+    if(sending_ == true)
+    {
+        for(int i=0; i<2; i++)
+        {
+            MPI_Cancel(&sendRequests_[i]);
+            MPI_Wait(&sendRequests_[i], MPI_STATUS_IGNORE);
+        }
+    }
+}
+
+qint64 FrameStatistics::getTimestamp()
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+    return (qint64)(boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+void FrameStatistics::record(FRAME_PHASE phase, int index, qint64 start, int duration)
+{
+    FrameStatisticsThreadBuffer * threadBuffer = getThreadBuffer();
+
+    FrameStatisticsSample sample;
+    sample.rank = g_mpiRank;
+    sample.thread = threadBuffer->thread;
+    sample.phase = (int)phase;
+    sample.index = index;
+    sample.frame = g_frameCount;
+    sample.start = start;
+    sample.duration = duration;
+
+    if(threadBuffer->samples->push(sample) != true)
+    {
+        numDropped_.ref();
+    }
+}
+
+void FrameStatistics::recordTimeToBarrier(double timeToBarrier)
+{
+    timeToBarrierTotal_ += timeToBarrier;
+    timeToBarrierMax_ = std::max(timeToBarrierMax_, timeToBarrier);
+}
+
+void FrameStatistics::update(long frameCount)
+{
+    // drain the thread buffers
+    {
+        QMutexLocker locker(&threadBuffersMutex_);
+
+        for(unsigned int i=0; i<threadBuffers_.size(); i++)
+        {
+            RingBuffer<FrameStatisticsSample> & buffer = *(threadBuffers_[i].samples);
+
+            unsigned int count = buffer.size();
+
+            for(unsigned int j=0; j<count; j++)
+            {
+                FrameStatisticsSample & sample = buffer.peek(j);
+
+                phaseTotals_[sample.phase] += (double)sample.duration / 1000.;
+                samples_.push_back(sample);
+            }
+
+            buffer.pop(count);
+        }
+    }
+
+    numFrames_++;
+
+    if(numFrames_ < FRAME_STATISTICS_REPORT_INTERVAL)
+    {
+        return;
+    }
+
+    for(int i=0; i<FRAME_PHASE_COUNT; i++)
+    {
+        phaseTimes_[i] = phaseTotals_[i] / (double)numFrames_;
+        phaseTotals_[i] = 0.;
+    }
+
+    double timeToBarrier = timeToBarrierTotal_ / (double)numFrames_;
+
+    numFrames_ = 0;
+    timeToBarrierTotal_ = 0.;
+
+    // find the render process last to reach the barrier on average, and the mean over all render processes,
+    // from one gather of every render process's time
+    FrameStatisticsTimeToBarrier local, slowest;
+
+    local.value = timeToBarrier;
+    local.rank = g_mpiRank;
+
+    int numRenderProcesses;
+    MPI_Comm_size(g_mpiRenderComm, &numRenderProcesses);
+
+    std::vector<FrameStatisticsTimeToBarrier> timesToBarrier(numRenderProcesses);
+
+    MPI_Allgather(&local, 1, MPI_DOUBLE_INT, &timesToBarrier[0], 1, MPI_DOUBLE_INT, g_mpiRenderComm);
+
+    // ties go to the lowest rank, as with MPI_MAXLOC
+    slowest = timesToBarrier[0];
+    double totalTimeToBarrier = 0.;
+
+    for(int i=0; i<numRenderProcesses; i++)
+    {
+        if(timesToBarrier[i].value > slowest.value || (timesToBarrier[i].value == slowest.value && timesToBarrier[i].rank < slowest.rank))
+        {
+            slowest = timesToBarrier[i];
+        }
+
+        totalTimeToBarrier += timesToBarrier[i].value;
+    }
+
+    double meanTimeToBarrier = totalTimeToBarrier / (double)numRenderProcesses;
+
+    // the result is the same on all render processes, so they all count the intervals the same way
+    if(slowest.value > (1. + FRAME_STATISTICS_STRAGGLER_MARGIN) * meanTimeToBarrier)
+    {
+        if(slowest.rank == slowestRank_)
+        {
+            stragglerIntervals_++;
+        }
+        else
+        {
+            stragglerIntervals_ = 1;
+        }
+    }
+    else
+    {
+        stragglerIntervals_ = 0;
+    }
+
+    slowestRank_ = slowest.rank;
+
+    int numDropped = numDropped_.fetchAndStoreOrdered(0);
+
+    if(numDropped > 0)
+    {
+        put_flog(LOG_WARN, "dropped %i frame statistics samples at frame %li, thread buffers were full", numDropped, frameCount);
+    }
+
+    sendReport(timeToBarrier, slowest.value, meanTimeToBarrier);
+
+    timeToBarrierMax_ = 0.;
+}
+
+double FrameStatistics::getPhaseTime(FRAME_PHASE phase)
+{
+    return phaseTimes_[phase];
+}
+
+int FrameStatistics::getStragglerRank()
+{
+    return stragglerRank_;
+}
+
+std::vector<FrameStatisticsReport> FrameStatistics::getReports()
+{
+    std::vector<FrameStatisticsReport> reports;
+
+    for(std::map<int, FrameStatisticsReport>::iterator it=reports_.begin(); it!=reports_.end(); it++)
+    {
+        reports.push_back(it->second);
+    }
+
+    return reports;
+}
+
+bool FrameStatistics::saveTrace(std::string filename)
+{
+    std::ofstream ofs(filename.c_str());
+
+    if(ofs.good() != true)
+    {
+        put_flog(LOG_ERROR, "could not write trace file %s", filename.c_str());
+        return false;
+    }
+
+    ofs << "{\"traceEvents\":[" << std::endl;
+
+    // name the processes
+    bool first = true;
+
+    for(std::map<int, FrameStatisticsReport>::iterator it=reports_.begin(); it!=reports_.end(); it++)
+    {
+        if(first != true)
+        {
+            ofs << "," << std::endl;
+        }
+
+        first = false;
+
+        ofs << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << it->first << ",\"args\":{\"name\":\"rank " << it->first << " (" << it->second.host << ")\"}}";
+    }
+
+    // complete events; timestamps are on each process' clock
+    for(unsigned int i=0; i<traceSamples_.size(); i++)
+    {
+        FrameStatisticsSample & sample = traceSamples_[i];
+
+        if(first != true)
+        {
+            ofs << "," << std::endl;
+        }
+
+        first = false;
+
+        ofs << "{\"name\":\"" << getPhaseName((FRAME_PHASE)sample.phase) << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":" << sample.rank << ",\"tid\":" << sample.thread << ",\"ts\":" << sample.start << ",\"dur\":" << sample.duration << ",\"args\":{\"frame\":" << sample.frame << ",\"index\":" << sample.index << "}}";
+    }
+
+    ofs << std::endl << "]}" << std::endl;
+
+    put_flog(LOG_INFO, "saved %i samples to trace file %s", (int)traceSamples_.size(), filename.c_str());
+
+    return true;
+}
+
+const char * FrameStatistics::getPhaseName(FRAME_PHASE phase)
+{
+    static const char * names[FRAME_PHASE_COUNT] = { "messages", "frame clock", "paint", "advance", "gpu", "cleanup", "barrier", "swap" };
+
+    return names[phase];
+}
+
+void FrameStatistics::receiveReports()
+{
+    bool updated = false;
+
+    while(true)
+    {
+        // check to see if we have a report (non-blocking)
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, FRAME_STATISTICS_MPI_TAG, MPI_COMM_WORLD, &flag, &status);
+
+        if(flag == 0)
+        {
+            break;
+        }
+
+        int source = status.MPI_SOURCE;
+
+        MessageHeader mh;
+        MPI_Recv((void *)&mh, sizeof(MessageHeader), MPI_BYTE, source, FRAME_STATISTICS_MPI_TAG, MPI_COMM_WORLD, &status);
+
+        // receive serialized data
+        char * buf = new char[mh.size];
+
+        // read message into the buffer
+        MPI_Recv((void *)buf, mh.size, MPI_BYTE, source, FRAME_STATISTICS_MPI_TAG, MPI_COMM_WORLD, &status);
+
+        // de-serialize...
+        std::istringstream iss(std::istringstream::binary);
+
+        if(iss.rdbuf()->pubsetbuf(buf, mh.size) == NULL)
+        {
+            put_flog(LOG_FATAL, "rank %i: error setting stream buffer", g_mpiRank);
+            exit(-1);
+        }
+
+        FrameStatisticsReport report;
+
+        {
+            boost::archive::binary_iarchive ia(iss);
+            ia >> report;
+        }
+
+        // free mpi buffer
+        delete [] buf;
+
+        // keep the samples for the trace, and the rest of the report for the heat map
+        traceSamples_.insert(traceSamples_.end(), report.samples.begin(), report.samples.end());
+        report.samples.clear();
+
+        reports_[report.rank] = report;
+
+        // every report has the straggler of its interval
+        int stragglerRank = -1;
+
+        if(report.stragglerIntervals >= FRAME_STATISTICS_STRAGGLER_INTERVALS)
+        {
+            stragglerRank = report.slowestRank;
+        }
+
+        if(stragglerRank != stragglerRank_)
+        {
+            if(stragglerRank != -1)
+            {
+                // contents the straggler was rendering, from its own last report
+                std::string host;
+                std::string contents;
+
+                if(reports_.count(stragglerRank) > 0)
+                {
+                    host = reports_[stragglerRank].host;
+
+                    std::vector<std::string> & contentURIs = reports_[stragglerRank].contentURIs;
+
+                    for(unsigned int i=0; i<contentURIs.size(); i++)
+                    {
+                        contents += (i > 0 ? ", " : "") + contentURIs[i];
+                    }
+                }
+
+                put_flog(LOG_WARN, "rank %i (%s) is consistently the last to reach the swap barrier: %f ms vs. mean %f ms over the last %i report intervals, rendering contents: %s", stragglerRank, host.c_str(), report.slowestTimeToBarrier, report.meanTimeToBarrier, report.stragglerIntervals, contents.c_str());
+            }
+            else
+            {
+                put_flog(LOG_INFO, "rank %i is no longer the straggler", stragglerRank_);
+            }
+
+            stragglerRank_ = stragglerRank;
+        }
+
+        updated = true;
+    }
+
+    while(traceSamples_.size() > FRAME_STATISTICS_TRACE_MAX_SAMPLES)
+    {
+        traceSamples_.pop_front();
+    }
+
+    if(updated == true)
+    {
+        emit(reportsUpdated());
+    }
+}
+
+FrameStatisticsThreadBuffer * FrameStatistics::getThreadBuffer()
+{
+    if(threadBuffer_.hasLocalData() != true)
+    {
+        FrameStatisticsThreadBuffer * threadBuffer = new FrameStatisticsThreadBuffer();
+
+        // the copy in threadBuffers_ keeps the samples after the thread exits and its local data is deleted
+        QMutexLocker locker(&threadBuffersMutex_);
+
+        // reuse the buffer of an exited thread, which only threadBuffers_ refers to; samples it still
+        // holds are drained as usual, and the new thread's samples keep its thread number in the trace
+        for(unsigned int i=0; i<threadBuffers_.size(); i++)
+        {
+            if(threadBuffers_[i].samples.unique() == true)
+            {
+                *threadBuffer = threadBuffers_[i];
+                break;
+            }
+        }
+
+        if(threadBuffer->samples == NULL)
+        {
+            threadBuffer->samples = boost::shared_ptr<RingBuffer<FrameStatisticsSample> >(new RingBuffer<FrameStatisticsSample>(FRAME_STATISTICS_THREAD_BUFFER_SIZE));
+            threadBuffer->thread = (int)threadBuffers_.size();
+
+            threadBuffers_.push_back(*threadBuffer);
+        }
+
+        threadBuffer_.setLocalData(threadBuffer);
+    }
+
+    return threadBuffer_.localData();
+}
+
+void FrameStatistics::sendReport(double timeToBarrier, double slowestTimeToBarrier, double meanTimeToBarrier)
+{
+    // don't wait for rank 0; if it hasn't received the last report yet, skip this one
+    if(sending_ == true)
+    {
+        int done;
+        MPI_Testall(2, sendRequests_, &done, MPI_STATUSES_IGNORE);
+
+        if(done == 0)
+        {
+            put_flog(LOG_WARN, "rank 0 hasn't received the last frame statistics report, skipping a report");
+
+            samples_.clear();
+            return;
+        }
+
+        sending_ = false;
+    }
+
+    FrameStatisticsReport report;
+    report.rank = g_mpiRank;
+    report.host = g_configuration->getMyHost();
+    report.phaseTimes = phaseTimes_;
+    report.timeToBarrier = timeToBarrier;
+    report.maxTimeToBarrier = timeToBarrierMax_;
+    report.slowestRank = slowestRank_;
+    report.slowestTimeToBarrier = slowestTimeToBarrier;
+    report.meanTimeToBarrier = meanTimeToBarrier;
+    report.stragglerIntervals = stragglerIntervals_;
+    report.samples.swap(samples_);
+
+    for(int i=0; i<g_configuration->getMyNumTiles(); i++)
+    {
+        report.tileI.push_back(g_configuration->getTileI(i));
+        report.tileJ.push_back(g_configuration->getTileJ(i));
+    }
+
+    std::vector<boost::shared_ptr<GLWindow> > glWindows = g_mainWindow->getGLWindows();
+
+    for(unsigned int i=0; i<glWindows.size(); i++)
+    {
+        std::vector<std::string> contentURIs = glWindows[i]->getVisibleContentURIs();
+
+        report.contentURIs.insert(report.contentURIs.end(), contentURIs.begin(), contentURIs.end());
+    }
+
+    // serialize
+    std::ostringstream oss(std::ostringstream::binary);
+
+    // brace this so destructor is called on archive before we use the stream
+    {
+        boost::archive::binary_oarchive oa(oss);
+        oa << report;
+    }
+
+    // serialized data to string
+    sendBuffer_ = oss.str();
+
+    // send the header and the message
+    sendHeader_.size = sendBuffer_.size();
+    sendHeader_.type = MESSAGE_TYPE_FRAME_STATISTICS;
+
+    MPI_Isend((void *)&sendHeader_, sizeof(MessageHeader), MPI_BYTE, 0, FRAME_STATISTICS_MPI_TAG, MPI_COMM_WORLD, &sendRequests_[0]);
+    MPI_Isend((void *)sendBuffer_.data(), sendHeader_.size, MPI_BYTE, 0, FRAME_STATISTICS_MPI_TAG, MPI_COMM_WORLD, &sendRequests_[1]);
+
+    sending_ = true;
+}
+
+FrameStatisticsTimer::FrameStatisticsTimer(FRAME_PHASE phase, int index)
+{
+    phase_ = phase;
+    index_ = index;
+    start_ = FrameStatistics::getTimestamp();
+}
+
+FrameStatisticsTimer::~FrameStatisticsTimer()
+{
+    if(g_frameStatistics != NULL)
+    {
+        g_frameStatistics->record(phase_, index_, start_, (int)(FrameStatistics::getTimestamp() - start_));
+    }
+}
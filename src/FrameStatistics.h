@@ -0,0 +1,274 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef FRAME_STATISTICS_H
+#define FRAME_STATISTICS_H
+
+// number of timing samples buffered per thread between reports
+#define FRAME_STATISTICS_THREAD_BUFFER_SIZE 4096
+
+// render processes send a report to rank 0 every this many frames
+#define FRAME_STATISTICS_REPORT_INTERVAL 60
+
+// MPI tag of reports, so they aren't confused with other messages to rank 0
+#define FRAME_STATISTICS_MPI_TAG 1
+
+// frame time in milliseconds shown as green in the heat map; twice this and more is red
+#define FRAME_STATISTICS_TARGET_FRAME_TIME (1000. / 60.)
+
+// a render process is the straggler of a report interval if it is the last to reach the swap barrier,
+// taking at least this fraction longer than the mean of all render processes
+#define FRAME_STATISTICS_STRAGGLER_MARGIN 0.2
+
+// rank 0 alerts when the same render process is the straggler for this many consecutive report intervals
+#define FRAME_STATISTICS_STRAGGLER_INTERVALS 5
+
+// samples kept on rank 0 for the trace
+#define FRAME_STATISTICS_TRACE_MAX_SAMPLES 1000000
+
+#include "RingBuffer.hpp"
+#include "MessageHeader.h"
+#include <QtGui>
+#include <boost/shared_ptr.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/string.hpp>
+#include <mpi.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+// phases of a frame on the render processes
+enum FRAME_PHASE { FRAME_PHASE_MESSAGES, FRAME_PHASE_FRAME_CLOCK, FRAME_PHASE_PAINT, FRAME_PHASE_ADVANCE, FRAME_PHASE_GPU, FRAME_PHASE_CLEANUP, FRAME_PHASE_BARRIER, FRAME_PHASE_SWAP, FRAME_PHASE_COUNT };
+
+struct FrameStatisticsSample {
+
+    int rank;
+    int thread;
+    int phase;
+
+    // e.g. the tile index of a GLWindow for FRAME_PHASE_PAINT
+    int index;
+
+    long frame;
+
+    // microseconds; the start is on the recording process' clock
+    qint64 start;
+    int duration;
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int)
+    {
+        ar & rank;
+        ar & thread;
+        ar & phase;
+        ar & index;
+        ar & frame;
+        ar & start;
+        ar & duration;
+    }
+};
+
+// timing of a render process over the last FRAME_STATISTICS_REPORT_INTERVAL frames
+struct FrameStatisticsReport {
+
+    int rank;
+    std::string host;
+
+    // tiles of the process
+    std::vector<int> tileI;
+    std::vector<int> tileJ;
+
+    // mean time per frame of each phase, in milliseconds
+    std::vector<double> phaseTimes;
+
+    // mean and maximum time in milliseconds from the frame clock update to the swap barrier
+    double timeToBarrier;
+    double maxTimeToBarrier;
+
+    // the same for all render processes: the last to reach the barrier on average, its mean time and the
+    // mean over all processes, and the number of consecutive report intervals it has been the straggler
+    int slowestRank;
+    double slowestTimeToBarrier;
+    double meanTimeToBarrier;
+    int stragglerIntervals;
+
+    // contents rendered in the last frame
+    std::vector<std::string> contentURIs;
+
+    std::vector<FrameStatisticsSample> samples;
+
+    // mean time per frame in milliseconds not spent waiting for the other render processes
+    double getBusyTime();
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int)
+    {
+        ar & rank;
+        ar & host;
+        ar & tileI;
+        ar & tileJ;
+        ar & phaseTimes;
+        ar & timeToBarrier;
+        ar & maxTimeToBarrier;
+        ar & slowestRank;
+        ar & slowestTimeToBarrier;
+        ar & meanTimeToBarrier;
+        ar & stragglerIntervals;
+        ar & contentURIs;
+        ar & samples;
+    }
+};
+
+// samples of one thread. only that thread pushes to the buffer, and only the main thread reads it
+struct FrameStatisticsThreadBuffer {
+
+    int thread;
+    boost::shared_ptr<RingBuffer<FrameStatisticsSample> > samples;
+};
+
+// times phases of each frame on the render processes.
+//
+// FrameStatisticsTimer objects record a sample when they go out of scope. samples are pushed
+// to a ring buffer of the recording thread, so recording never takes a lock. once a frame the
+// main thread drains the buffers, and every FRAME_STATISTICS_REPORT_INTERVAL frames sends a
+// report to rank 0 without waiting for it to be received. rank 0 keeps the latest report of
+// each process, for the heat map of the tiles in the display group view, and the samples, for
+// a trace that can be saved in the Chrome trace event format.
+class FrameStatistics : public QObject {
+    Q_OBJECT
+
+    public:
+
+        FrameStatistics();
+        ~FrameStatistics();
+
+        // microseconds since the epoch
+        static qint64 getTimestamp();
+
+        // record a sample; may be called from any thread
+        void record(FRAME_PHASE phase, int index, qint64 start, int duration);
+
+        // render processes: called from the main thread when the process enters the swap barrier (its frame has
+        // finished on the GPU and it has cleaned up), with the time in milliseconds since the frame clock update
+        void recordTimeToBarrier(double timeToBarrier);
+
+        // render processes: called from the main thread after each frame
+        // every FRAME_STATISTICS_REPORT_INTERVAL frames this is collective over the render processes
+        void update(long frameCount);
+
+        // render processes: mean time per frame in milliseconds of a phase, over the last report interval
+        double getPhaseTime(FRAME_PHASE phase);
+
+        // rank 0: latest report of each render process
+        std::vector<FrameStatisticsReport> getReports();
+
+        // rank 0: render process consistently last to reach the swap barrier, or -1
+        int getStragglerRank();
+
+        // rank 0: save the received samples in the Chrome trace event format (chrome://tracing)
+        bool saveTrace(std::string filename);
+
+        static const char * getPhaseName(FRAME_PHASE phase);
+
+    public slots:
+
+        // rank 0: receive waiting reports from the render processes, without blocking
+        void receiveReports();
+
+    signals:
+
+        void reportsUpdated();
+
+    private:
+
+        // buffer of each thread that has recorded samples. a thread's local data shares the ring buffer; once the
+        // thread exits and its local data is deleted, the buffer is reused by the next new thread, so there are
+        // no more buffers than threads recording at once
+        QMutex threadBuffersMutex_;
+        std::vector<FrameStatisticsThreadBuffer> threadBuffers_;
+        QThreadStorage<FrameStatisticsThreadBuffer *> threadBuffer_;
+
+        // samples dropped since the buffer of the recording thread was full
+        QAtomicInt numDropped_;
+
+        // render processes: samples and phase totals since the last report
+        std::vector<FrameStatisticsSample> samples_;
+        std::vector<double> phaseTotals_;
+        int numFrames_;
+
+        // render processes: phase times of the last report
+        std::vector<double> phaseTimes_;
+
+        // render processes: time to barrier since the last report, and the straggler of the previous intervals
+        double timeToBarrierTotal_;
+        double timeToBarrierMax_;
+        int slowestRank_;
+        int stragglerIntervals_;
+
+        // render processes: report being sent; the buffers must stay valid until the sends complete
+        MessageHeader sendHeader_;
+        std::string sendBuffer_;
+        MPI_Request sendRequests_[2];
+        bool sending_;
+
+        // rank 0: latest report of each render process, and samples for the trace
+        std::map<int, FrameStatisticsReport> reports_;
+        std::deque<FrameStatisticsSample> traceSamples_;
+        int stragglerRank_;
+
+        FrameStatisticsThreadBuffer * getThreadBuffer();
+        void sendReport(double timeToBarrier, double slowestTimeToBarrier, double meanTimeToBarrier);
+};
+
+// records the time from construction to destruction as a sample of a phase
+class FrameStatisticsTimer {
+
+    public:
+
+        FrameStatisticsTimer(FRAME_PHASE phase, int index=0);
+        ~FrameStatisticsTimer();
+
+    private:
+
+        FRAME_PHASE phase_;
+        int index_;
+        qint64 start_;
+};
+
+#endif
@@ -40,9 +40,11 @@
 #include "main.h"
 #include "Marker.h"
 #include "ContentWindowManager.h"
+#include "FrameStatistics.h"
 #include "log.h"
 #include <QtOpenGL>
 #include <boost/shared_ptr.hpp>
+#include <algorithm>
 
 #ifdef __APPLE__
     #include <OpenGL/glu.h>
@@ -50,9 +52,36 @@
     #include <GL/glu.h>
 #endif
 
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+    #define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+    #define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_TIMEOUT_EXPIRED
+    #define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+
+#ifndef GL_WAIT_FAILED
+    #define GL_WAIT_FAILED 0x911D
+#endif
+
+// timeout for each wait on a frame fence, in nanoseconds
+#define GL_WINDOW_FRAME_FENCE_TIMEOUT 1000000000
+
 GLWindow::GLWindow(int tileIndex)
 {
+    tileIndices_.push_back(tileIndex);
     tileIndex_ = tileIndex;
+    retainedRendering_ = false;
+    fenceSync_ = NULL;
+    clientWaitSync_ = NULL;
+    deleteSync_ = NULL;
+    frameFence_ = NULL;
+    numVisibleContentWindows_ = 0;
+    numCulledContentWindows_ = 0;
 
     // disable automatic buffer swapping
     setAutoBufferSwap(false);
@@ -60,7 +89,41 @@ GLWindow::GLWindow(int tileIndex)
 
 GLWindow::GLWindow(int tileIndex, QRect windowRect, QGLWidget * shareWidget) : QGLWidget(0, shareWidget)
 {
+    tileIndices_.push_back(tileIndex);
     tileIndex_ = tileIndex;
+    windowPosition_ = windowRect.topLeft();
+    retainedRendering_ = false;
+    fenceSync_ = NULL;
+    clientWaitSync_ = NULL;
+    deleteSync_ = NULL;
+    frameFence_ = NULL;
+    numVisibleContentWindows_ = 0;
+    numCulledContentWindows_ = 0;
+    setGeometry(windowRect);
+
+    // make sure sharing succeeded
+    if(shareWidget != 0 && isSharing() != true)
+    {
+        put_flog(LOG_FATAL, "failed to share OpenGL context");
+        exit(-1);
+    }
+
+    // disable automatic buffer swapping
+    setAutoBufferSwap(false);
+}
+
+GLWindow::GLWindow(std::vector<int> tileIndices, QRect windowRect, QGLWidget * shareWidget) : QGLWidget(0, shareWidget)
+{
+    tileIndices_ = tileIndices;
+    tileIndex_ = tileIndices[0];
+    windowPosition_ = windowRect.topLeft();
+    retainedRendering_ = false;
+    fenceSync_ = NULL;
+    clientWaitSync_ = NULL;
+    deleteSync_ = NULL;
+    frameFence_ = NULL;
+    numVisibleContentWindows_ = 0;
+    numCulledContentWindows_ = 0;
     setGeometry(windowRect);
 
     // make sure sharing succeeded
@@ -109,6 +172,101 @@ Factory<ParallelPixelStream> & GLWindow::getParallelPixelStreamFactory()
     return parallelPixelStreamFactory_;
 }
 
+DynamicTextureCache & GLWindow::getDynamicTextureCache()
+{
+    return dynamicTextureCache_;
+}
+
+DynamicTextureAtlas & GLWindow::getDynamicTextureAtlas()
+{
+    return dynamicTextureAtlas_;
+}
+
+PixelBufferUploader & GLWindow::getPixelBufferUploader()
+{
+    return pixelBufferUploader_;
+}
+
+bool GLWindow::getRetainedRendering()
+{
+    return retainedRendering_;
+}
+
+RenderList & GLWindow::getRenderList()
+{
+    return renderList_;
+}
+
+int GLWindow::getNumTiles()
+{
+    return (int)tileIndices_.size();
+}
+
+int GLWindow::getViewportWidth()
+{
+    return tileRect_.width();
+}
+
+int GLWindow::getViewportHeight()
+{
+    return tileRect_.height();
+}
+
+int GLWindow::getNumVisibleContentWindows()
+{
+    return numVisibleContentWindows_;
+}
+
+int GLWindow::getNumCulledContentWindows()
+{
+    return numCulledContentWindows_;
+}
+
+std::vector<std::string> GLWindow::getVisibleContentURIs()
+{
+    return visibleContentURIs_;
+}
+
+void GLWindow::insertFrameFence()
+{
+    makeCurrent();
+
+    if(fenceSync_ != NULL && frameFence_ == NULL)
+    {
+        frameFence_ = fenceSync_(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    glFlush();
+}
+
+void GLWindow::waitFrameFence()
+{
+    makeCurrent();
+
+    if(frameFence_ == NULL)
+    {
+        // no fence support
+        glFinish();
+        return;
+    }
+
+    GLenum result = GL_TIMEOUT_EXPIRED;
+
+    while(result == GL_TIMEOUT_EXPIRED)
+    {
+        result = clientWaitSync_(frameFence_, GL_SYNC_FLUSH_COMMANDS_BIT, GL_WINDOW_FRAME_FENCE_TIMEOUT);
+    }
+
+    if(result == GL_WAIT_FAILED)
+    {
+        put_flog(LOG_ERROR, "waiting on frame fence failed");
+        glFinish();
+    }
+
+    deleteSync_(frameFence_);
+    frameFence_ = NULL;
+}
+
 void GLWindow::insertPurgeTextureId(GLuint textureId)
 {
     QMutexLocker locker(&purgeTexturesMutex_);
@@ -134,12 +292,117 @@ void GLWindow::initializeGL()
     // enable depth testing; disable lighting
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_LIGHTING);
+
+    // dump frames for comparing the retained and immediate rendering paths, e.g. under Mesa offscreen
+    // see examples/compareframes.py
+    if(getenv("DISPLAYCLUSTER_DUMP_FRAMES") != NULL)
+    {
+        dumpFramesDirectory_ = QString(getenv("DISPLAYCLUSTER_DUMP_FRAMES"));
+
+        put_flog(LOG_INFO, "dumping frames to %s", dumpFramesDirectory_.toStdString().c_str());
+    }
+
+    // frame fences, if supported
+    // sync objects are core in OpenGL 3.2 and otherwise need GL_ARB_sync; function pointers alone don't show driver support
+    bool syncSupported = false;
+
+    int majorVersion = 0;
+    int minorVersion = 0;
+
+    const char * version = (const char *)glGetString(GL_VERSION);
+
+    if(version != NULL && sscanf(version, "%d.%d", &majorVersion, &minorVersion) == 2 && (majorVersion > 3 || (majorVersion == 3 && minorVersion >= 2)))
+    {
+        syncSupported = true;
+    }
+
+    // the extension string is NULL in core profiles, which are 3.2 or later
+    const char * extensions = (const char *)glGetString(GL_EXTENSIONS);
+
+    if(extensions != NULL && QString(extensions).split(' ').contains("GL_ARB_sync") == true)
+    {
+        syncSupported = true;
+    }
+
+    if(syncSupported == true)
+    {
+        fenceSync_ = (GLWindowFenceSyncFunction)context()->getProcAddress("glFenceSync");
+        clientWaitSync_ = (GLWindowClientWaitSyncFunction)context()->getProcAddress("glClientWaitSync");
+        deleteSync_ = (GLWindowDeleteSyncFunction)context()->getProcAddress("glDeleteSync");
+    }
+
+    if(syncSupported != true || fenceSync_ == NULL || clientWaitSync_ == NULL || deleteSync_ == NULL)
+    {
+        put_flog(LOG_INFO, "GL_ARB_sync not supported, waiting for frames with glFinish()");
+
+        fenceSync_ = NULL;
+    }
 }
 
 void GLWindow::paintGL()
+{
+    FrameStatisticsTimer timer(FRAME_PHASE_PAINT, tileIndices_[0]);
+
+    // render each tile to its viewport; with several tiles, the scissor rectangle restricts clearing to the tile
+    if(tileIndices_.size() > 1)
+    {
+        glEnable(GL_SCISSOR_TEST);
+    }
+
+    int numVisibleContentWindows = 0;
+    int numCulledContentWindows = 0;
+
+    visibleContentURIs_.clear();
+
+    for(unsigned int i=0; i<tileIndices_.size(); i++)
+    {
+        tileIndex_ = tileIndices_[i];
+
+        if(tileIndices_.size() > 1)
+        {
+            tileRect_ = QRect(g_configuration->getTileX(tileIndex_) - windowPosition_.x(), g_configuration->getTileY(tileIndex_) - windowPosition_.y(), g_configuration->getScreenWidth(), g_configuration->getScreenHeight());
+        }
+        else
+        {
+            tileRect_ = QRect(0, 0, width(), height());
+        }
+
+        // the viewport's origin is the lower-left corner of the window
+        int viewportY = height() - (tileRect_.y() + tileRect_.height());
+
+        glViewport(tileRect_.x(), viewportY, tileRect_.width(), tileRect_.height());
+        glScissor(tileRect_.x(), viewportY, tileRect_.width(), tileRect_.height());
+
+        paintTile();
+
+        numVisibleContentWindows += numVisibleContentWindows_;
+        numCulledContentWindows += numCulledContentWindows_;
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+
+    numVisibleContentWindows_ = numVisibleContentWindows;
+    numCulledContentWindows_ = numCulledContentWindows;
+
+    if(dumpFramesDirectory_.isEmpty() != true)
+    {
+        dumpFrame();
+    }
+}
+
+void GLWindow::paintTile()
 {
     setOrthographicView();
 
+    contentTransforms_.clear();
+    contentDepths_.clear();
+
+    retainedRendering_ = g_displayGroupManager->getOptions()->getEnableRetainedRendering();
+    renderList_.clear();
+
+    numVisibleContentWindows_ = 0;
+    numCulledContentWindows_ = 0;
+
     // if the show test pattern option is enabled, render the test pattern and return
     if(g_displayGroupManager->getOptions()->getShowTestPattern() == true)
     {
@@ -150,15 +413,51 @@ void GLWindow::paintGL()
     // render content windows
     std::vector<boost::shared_ptr<ContentWindowManager> > contentWindowManagers = g_displayGroupManager->getContentWindowManagers();
 
+    // cull windows not intersecting this tile
+    std::vector<int> visibleIndices = g_displayGroupManager->findContentWindowManagers(QRectF(left_, bottom_, right_-left_, top_-bottom_));
+
+    numVisibleContentWindows_ = (int)visibleIndices.size();
+    numCulledContentWindows_ = (int)contentWindowManagers.size() - numVisibleContentWindows_;
+
+    // culled windows aren't rendered, so keep their factory objects from being cleared
+    std::vector<bool> visible(contentWindowManagers.size(), false);
+
+    for(unsigned int i=0; i<visibleIndices.size(); i++)
+    {
+        visible[visibleIndices[i]] = true;
+    }
+
     for(unsigned int i=0; i<contentWindowManagers.size(); i++)
     {
+        if(visible[i] != true)
+        {
+            contentWindowManagers[i]->getContent()->touchFactoryObject();
+        }
+    }
+
+    for(unsigned int n=0; n<visibleIndices.size(); n++)
+    {
+        unsigned int i = visibleIndices[n];
+
+        // a content may be visible on several tiles of this window
+        std::string uri = contentWindowManagers[i]->getContent()->getURI();
+
+        if(std::find(visibleContentURIs_.begin(), visibleContentURIs_.end(), uri) == visibleContentURIs_.end())
+        {
+            visibleContentURIs_.push_back(uri);
+        }
+
         // manage depth order
         // the visible depths seem to be in the range (-1,1); make the content window depths be in the range (-1,0)
+        float depth = -((float)contentWindowManagers.size() - (float)i) / ((float)contentWindowManagers.size() + 1.);
+
         glPushMatrix();
-        glTranslatef(0.,0.,-((float)contentWindowManagers.size() - (float)i) / ((float)contentWindowManagers.size() + 1.));
+        glTranslatef(0.,0.,depth);
+        pushContentTransform(0.,0.,1.,1.,depth);
 
         contentWindowManagers[i]->render();
 
+        popContentTransform();
         glPopMatrix();
     }
 
@@ -171,6 +470,11 @@ void GLWindow::paintGL()
         markers[i]->render();
     }
 
+    if(retainedRendering_ == true)
+    {
+        renderList_.draw(left_, right_, bottom_, top_);
+    }
+
 #if ENABLE_SKELETON_SUPPORT
     if(g_displayGroupManager->getOptions()->getShowSkeletons() == true)
     {
@@ -227,41 +531,12 @@ void GLWindow::setOrthographicView()
     glScalef(1.,-1.,1.);
 
     // compute view bounds
-    if(g_mpiRank == 0)
-    {
-        left_ = 0.;
-        right_ = 1.;
-        bottom_ = 0.;
-        top_ = 1.;
-    }
-    else
-    {
-        // tiled display parameters
-        double tileI = (double)g_configuration->getTileI(tileIndex_);
-        double numTilesWidth = (double)g_configuration->getNumTilesWidth();
-        double screenWidth = (double)g_configuration->getScreenWidth();
-        double mullionWidth = (double)g_configuration->getMullionWidth();
-
-        double tileJ = (double)g_configuration->getTileJ(tileIndex_);
-        double numTilesHeight = (double)g_configuration->getNumTilesHeight();
-        double screenHeight = (double)g_configuration->getScreenHeight();
-        double mullionHeight = (double)g_configuration->getMullionHeight();
-
-        // border calculations
-        left_ = tileI / numTilesWidth * ( numTilesWidth * screenWidth ) + tileI * mullionWidth;
-        right_ = left_ + screenWidth;
-        bottom_ = tileJ / numTilesHeight * ( numTilesHeight * screenHeight ) + tileJ * mullionHeight;
-        top_ = bottom_ + screenHeight;
+    QRectF tileRect = getTileRect(tileIndex_);
 
-        // normalize to 0->1
-        double totalWidth = (double)g_configuration->getTotalWidth();
-        double totalHeight = (double)g_configuration->getTotalHeight();
-
-        left_ /= totalWidth;
-        right_ /= totalWidth;
-        bottom_ /= totalHeight;
-        top_ /= totalHeight;
-    }
+    left_ = tileRect.left();
+    right_ = tileRect.right();
+    bottom_ = tileRect.top();
+    top_ = tileRect.bottom();
 
     gluOrtho2D(left_, right_, bottom_, top_);
     glPushMatrix();
@@ -274,6 +549,35 @@ void GLWindow::setOrthographicView()
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+QRectF GLWindow::getTileRect(int tileIndex)
+{
+    if(g_mpiRank == 0)
+    {
+        return QRectF(0., 0., 1., 1.);
+    }
+
+    // tiled display parameters
+    double tileI = (double)g_configuration->getTileI(tileIndex);
+    double numTilesWidth = (double)g_configuration->getNumTilesWidth();
+    double screenWidth = (double)g_configuration->getScreenWidth();
+    double mullionWidth = (double)g_configuration->getMullionWidth();
+
+    double tileJ = (double)g_configuration->getTileJ(tileIndex);
+    double numTilesHeight = (double)g_configuration->getNumTilesHeight();
+    double screenHeight = (double)g_configuration->getScreenHeight();
+    double mullionHeight = (double)g_configuration->getMullionHeight();
+
+    // border calculations
+    double left = tileI / numTilesWidth * ( numTilesWidth * screenWidth ) + tileI * mullionWidth;
+    double bottom = tileJ / numTilesHeight * ( numTilesHeight * screenHeight ) + tileJ * mullionHeight;
+
+    // normalize to 0->1
+    double totalWidth = (double)g_configuration->getTotalWidth();
+    double totalHeight = (double)g_configuration->getTotalHeight();
+
+    return QRectF(left / totalWidth, bottom / totalHeight, screenWidth / totalWidth, screenHeight / totalHeight);
+}
+
 bool GLWindow::setPerspectiveView(double x, double y, double w, double h)
 {
     // we want a perspective view for an area over the entire display bounded by (x,y,w,h)
@@ -293,10 +597,11 @@ bool GLWindow::setPerspectiveView(double x, double y, double w, double h)
     {
         // x,y for viewport is lower-left corner
         // the y coordinate needs to be shifted from the top of the screen to the bottom, and y-direction inverted
-        int viewPortX = (int)((boundRect.x() - screenRect.x()) / screenRect.width() * width());
-        int viewPortY = (int)((screenRect.height() - (boundRect.y() + boundRect.height() - screenRect.y())) / screenRect.height() * height());
-        int viewPortW = (int)(boundRect.width() / screenRect.width() * width());
-        int viewPortH = (int)(boundRect.height() / screenRect.height() * height());
+        // both are offset by the current tile's viewport in the window
+        int viewPortX = tileRect_.x() + (int)((boundRect.x() - screenRect.x()) / screenRect.width() * tileRect_.width());
+        int viewPortY = height() - (tileRect_.y() + tileRect_.height()) + (int)((screenRect.height() - (boundRect.y() + boundRect.height() - screenRect.y())) / screenRect.height() * tileRect_.height());
+        int viewPortW = (int)(boundRect.width() / screenRect.width() * tileRect_.width());
+        int viewPortH = (int)(boundRect.height() / screenRect.height() * tileRect_.height());
 
         glViewport(viewPortX, viewPortY, viewPortW, viewPortH);
     }
@@ -366,22 +671,74 @@ bool GLWindow::isScreenRectangleVisible(double x, double y, double w, double h)
 {
     // works in "screen space" where the rectangle for the entire tiled display is (0,0,1,1)
 
-    // screen rectangle
-    QRectF screenRect(left_, bottom_, right_-left_, top_-bottom_);
-
     // the given rectangle
     QRectF rect(x, y, w, h);
 
-    if(screenRect.intersects(rect) == true)
+    // visible if it intersects any of this window's tiles
+    for(unsigned int i=0; i<tileIndices_.size(); i++)
     {
-        return true;
+        if(getTileRect(tileIndices_[i]).intersects(rect) == true)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GLWindow::pushContentTransform(double x, double y, double w, double h, double z)
+{
+    QRectF rect(x, y, w, h);
+    double depth = z;
+
+    if(contentTransforms_.size() > 0)
+    {
+        QRectF & parent = contentTransforms_.back();
+
+        rect = QRectF(parent.x() + x * parent.width(), parent.y() + y * parent.height(), w * parent.width(), h * parent.height());
+        depth += contentDepths_.back();
+    }
+
+    contentTransforms_.push_back(rect);
+    contentDepths_.push_back(depth);
+
+    renderList_.setTransform(rect, depth);
+}
+
+void GLWindow::popContentTransform()
+{
+    if(contentTransforms_.size() > 0)
+    {
+        contentTransforms_.pop_back();
+        contentDepths_.pop_back();
+    }
+
+    if(contentTransforms_.size() > 0)
+    {
+        renderList_.setTransform(contentTransforms_.back(), contentDepths_.back());
     }
     else
     {
-        return false;
+        renderList_.setTransform(QRectF(0., 0., 1., 1.), 0.);
     }
 }
 
+QRectF GLWindow::getContentPixelRect()
+{
+    QRectF rect(0., 0., 1., 1.);
+
+    if(contentTransforms_.size() > 0)
+    {
+        rect = contentTransforms_.back();
+    }
+
+    // the orthographic view maps (left_, bottom_) to the upper-left corner of the viewport and (right_, top_) to the lower-right
+    double xScale = (double)getViewportWidth() / (right_ - left_);
+    double yScale = (double)getViewportHeight() / (top_ - bottom_);
+
+    return QRectF((rect.x() - left_) * xScale, (rect.y() - bottom_) * yScale, rect.width() * xScale, rect.height() * yScale);
+}
+
 bool GLWindow::isRectangleVisible(double x, double y, double w, double h)
 {
     // get four corners in object space
@@ -420,8 +777,8 @@ bool GLWindow::isRectangleVisible(double x, double y, double w, double h)
         gluProject(xObj[i][0], xObj[i][1], xObj[i][2], modelview, projection, viewport, &xWin[i][0], &xWin[i][1], &xWin[i][2]);
     }
 
-    // screen rectangle
-    QRectF screenRect(0.,0., (double)g_mainWindow->getGLWindow()->width(), (double)g_mainWindow->getGLWindow()->height());
+    // screen rectangle, the viewport of the current tile
+    QRectF screenRect((double)viewport[0], (double)viewport[1], (double)viewport[2], (double)viewport[3]);
 
     // the given rectangle
     QRectF rect(xWin[0][0], xWin[0][1], xWin[2][0]-xWin[0][0], xWin[2][1]-xWin[0][1]);
@@ -457,7 +814,33 @@ void GLWindow::finalize()
     pixelStreamFactory_.clear();
     parallelPixelStreamFactory_.clear();
 
+    // after the factories, since DynamicTexture objects give their textures to the cache
+    dynamicTextureCache_.clear();
+
+    // after the cache, which frees its atlas slots
+    dynamicTextureAtlas_.clear();
+
+    // after the factories, which cancel their pending uploads
+    pixelBufferUploader_.clear();
+
     purgeTextures();
+
+    if(frameFence_ != NULL)
+    {
+        deleteSync_(frameFence_);
+        frameFence_ = NULL;
+    }
+}
+
+void GLWindow::dumpFrame()
+{
+    QString filename = QString("%1/frame-%2-%3-%4-%5.png").arg(dumpFramesDirectory_).arg(g_mpiRank).arg(tileIndices_[0]).arg(g_frameCount).arg(retainedRendering_ == true ? "retained" : "immediate");
+
+    // the back buffer, before swapping
+    if(grabFrameBuffer().save(filename) != true)
+    {
+        put_flog(LOG_ERROR, "could not save frame %s", filename.toStdString().c_str());
+    }
 }
 
 void GLWindow::renderTestPattern()
@@ -510,12 +893,16 @@ void GLWindow::renderTestPattern()
 
     glColor3f(1.,1.,1.);
 
-    renderText(50, 1*fontSize, label1, font);
-    renderText(50, 2*fontSize, label2, font);
-    renderText(50, 3*fontSize, label3, font);
-    renderText(50, 4*fontSize, label4, font);
-    renderText(50, 5*fontSize, label5, font);
-    renderText(50, 6*fontSize, label6, font);
+    // window coordinates, offset by the current tile's viewport
+    int x = tileRect_.x() + 50;
+    int y = tileRect_.y();
+
+    renderText(x, y + 1*fontSize, label1, font);
+    renderText(x, y + 2*fontSize, label2, font);
+    renderText(x, y + 3*fontSize, label3, font);
+    renderText(x, y + 4*fontSize, label4, font);
+    renderText(x, y + 5*fontSize, label5, font);
+    renderText(x, y + 6*fontSize, label6, font);
 
     glPopMatrix();
     glPopAttrib();
@@ -42,12 +42,21 @@
 #include "Factory.hpp"
 #include "Texture.h"
 #include "DynamicTexture.h"
+#include "DynamicTextureCache.h"
+#include "DynamicTextureAtlas.h"
+#include "PixelBufferUploader.h"
 #include "SVG.h"
 #include "Movie.h"
 #include "PixelStream.h"
 #include "ParallelPixelStream.h"
+#include "RenderList.h"
 #include <QGLWidget>
 
+// GL_ARB_sync entry points, resolved at runtime since they may not be in the OpenGL headers
+typedef void * (*GLWindowFenceSyncFunction)(GLenum condition, GLbitfield flags);
+typedef GLenum (*GLWindowClientWaitSyncFunction)(void * sync, GLbitfield flags, quint64 timeout);
+typedef void (*GLWindowDeleteSyncFunction)(void * sync);
+
 class GLWindow : public QGLWidget
 {
 
@@ -55,6 +64,9 @@ class GLWindow : public QGLWidget
 
         GLWindow(int tileIndex);
         GLWindow(int tileIndex, QRect windowRect, QGLWidget * shareWidget = 0);
+
+        // one window for several tiles of the same display, each rendered to its own viewport
+        GLWindow(std::vector<int> tileIndices, QRect windowRect, QGLWidget * shareWidget = 0);
         ~GLWindow();
 
         Factory<Texture> & getTextureFactory();
@@ -64,6 +76,33 @@ class GLWindow : public QGLWidget
         Factory<PixelStream> & getPixelStreamFactory();
         Factory<ParallelPixelStream> & getParallelPixelStreamFactory();
 
+        DynamicTextureCache & getDynamicTextureCache();
+        DynamicTextureAtlas & getDynamicTextureAtlas();
+        PixelBufferUploader & getPixelBufferUploader();
+
+        // when retained rendering is enabled for the current frame, contents add their primitives
+        // to the render list instead of drawing them; the list is drawn at the end of paintGL()
+        bool getRetainedRendering();
+        RenderList & getRenderList();
+
+        // content windows rendered and culled in the last paintGL()
+        int getNumVisibleContentWindows();
+        int getNumCulledContentWindows();
+
+        // URIs of the contents rendered in the last paintGL()
+        std::vector<std::string> getVisibleContentURIs();
+
+        int getNumTiles();
+
+        // size in pixels of the viewport of the tile being rendered
+        int getViewportWidth();
+        int getViewportHeight();
+
+        // fence after this window's rendering commands for the frame, and wait until the GPU has executed them
+        // the OpenGL commands are flushed when the fence is inserted, so other work can overlap their execution
+        void insertFrameFence();
+        void waitFrameFence();
+
         void insertPurgeTextureId(GLuint textureId);
         void purgeTextures();
 
@@ -73,8 +112,20 @@ class GLWindow : public QGLWidget
         void setOrthographicView();
         bool setPerspectiveView(double x=0., double y=0., double w=1., double h=1.);
 
+        // rectangle of a tile in the (0,0,1,1) display coordinate system
+        QRectF getTileRect(int tileIndex);
+
+        // whether the rectangle is visible on any of this window's tiles
         bool isScreenRectangleVisible(double x, double y, double w, double h);
 
+        // CPU-side stack of the translate / scale transforms applied to contents in the orthographic view,
+        // so contents can find their on-screen size without querying OpenGL. z is the depth translation
+        void pushContentTransform(double x, double y, double w, double h, double z=0.);
+        void popContentTransform();
+
+        // window rectangle, in pixels from the upper-left corner, of the current content's (0,0,1,1) rectangle
+        QRectF getContentPixelRect();
+
         static bool isRectangleVisible(double x, double y, double w, double h);
         static void drawRectangle(double x, double y, double w, double h);
 
@@ -82,13 +133,39 @@ class GLWindow : public QGLWidget
 
     private:
 
+        // tiles rendered by this window, and the one currently being rendered
+        std::vector<int> tileIndices_;
         int tileIndex_;
 
+        // upper-left corner of the window on the display, and rectangle of the current tile in window pixels
+        QPoint windowPosition_;
+        QRect tileRect_;
+
         double left_;
         double right_;
         double bottom_;
         double top_;
 
+        // rectangles in the (0,0,1,1) display coordinate system of each content transform's (0,0,1,1) rectangle
+        std::vector<QRectF> contentTransforms_;
+        std::vector<double> contentDepths_;
+
+        bool retainedRendering_;
+        RenderList renderList_;
+
+        // directory frames are dumped to, from DISPLAYCLUSTER_DUMP_FRAMES (empty if not dumping)
+        QString dumpFramesDirectory_;
+
+        // GL_ARB_sync functions (NULL if not supported) and the fence of the current frame
+        GLWindowFenceSyncFunction fenceSync_;
+        GLWindowClientWaitSyncFunction clientWaitSync_;
+        GLWindowDeleteSyncFunction deleteSync_;
+        void * frameFence_;
+
+        int numVisibleContentWindows_;
+        int numCulledContentWindows_;
+        std::vector<std::string> visibleContentURIs_;
+
         Factory<Texture> textureFactory_;
         Factory<DynamicTexture> dynamicTextureFactory_;
         Factory<SVG> svgFactory_;
@@ -96,12 +173,23 @@ class GLWindow : public QGLWidget
         Factory<PixelStream> pixelStreamFactory_;
         Factory<ParallelPixelStream> parallelPixelStreamFactory_;
 
+        // textures and images of DynamicTexture tiles no longer displayed
+        DynamicTextureCache dynamicTextureCache_;
+
+        // textures of DynamicTexture tiles, in use or cached
+        DynamicTextureAtlas dynamicTextureAtlas_;
+
+        // texture uploads of Texture and SVG objects
+        PixelBufferUploader pixelBufferUploader_;
+
         // mutex and vector of texture id's to purge
         // this allows other threads to trigger deletion of a texture during the main OpenGL thread execution
         QMutex purgeTexturesMutex_;
         std::vector<GLuint> purgeTextureIds_;
 
+        void paintTile();
         void renderTestPattern();
+        void dumpFrame();
 };
 
 #endif
@@ -0,0 +1,536 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ImagePyramidBuilder.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+ImagePyramidBuilder::ImagePyramidBuilder(std::string imageFilename, std::string imagePyramidPath, int tileSize)
+{
+    // defaults
+    jpegQuality_ = -1;
+    canceled_ = false;
+    imageWidth_ = 0;
+    imageHeight_ = 0;
+    depth_ = 0;
+    numLeafTiles_ = 1;
+    readFullImage_ = false;
+    stripFirstRow_ = 0;
+    stripNumRows_ = 0;
+    numTiles_ = 0;
+    totalTiles_ = 0;
+    lastProgressPercent_ = -1;
+
+    // assign values
+    imageFilename_ = imageFilename;
+    imagePyramidPath_ = imagePyramidPath;
+    tileSize_ = tileSize;
+}
+
+ImagePyramidBuilder::~ImagePyramidBuilder()
+{
+    threadPool_.waitForDone();
+}
+
+void ImagePyramidBuilder::setJpegQuality(int quality)
+{
+    jpegQuality_ = quality;
+}
+
+void ImagePyramidBuilder::setMaxThreads(int maxThreads)
+{
+    if(maxThreads > 0)
+    {
+        threadPool_.setMaxThreadCount(maxThreads);
+    }
+}
+
+bool ImagePyramidBuilder::build()
+{
+    QTime time;
+    time.start();
+
+    QImageReader imageReader(imageFilename_.c_str());
+
+    if(imageReader.canRead() != true)
+    {
+        put_flog(LOG_ERROR, "cannot read image %s", imageFilename_.c_str());
+        return false;
+    }
+
+    imageWidth_ = imageReader.size().width();
+    imageHeight_ = imageReader.size().height();
+
+    // some formats can't tell us the size without reading the image
+    if(imageWidth_ <= 0 || imageHeight_ <= 0 || imageReader.supportsOption(QImageIOHandler::ClipRect) != true)
+    {
+        put_flog(LOG_INFO, "image format does not support reading strips, reading full image");
+
+        readFullImage_ = true;
+        fullImage_ = imageReader.read();
+
+        if(fullImage_.isNull() == true)
+        {
+            put_flog(LOG_ERROR, "error reading image %s", imageFilename_.c_str());
+            return false;
+        }
+
+        imageWidth_ = fullImage_.width();
+        imageHeight_ = fullImage_.height();
+    }
+
+    // tiles are subdivided while the image at that level is larger than a tile
+    depth_ = 0;
+
+    while(imageWidth_ / pow(2.,depth_) > tileSize_ || imageHeight_ / pow(2.,depth_) > tileSize_)
+    {
+        depth_++;
+    }
+
+    numLeafTiles_ = 1 << depth_;
+
+    totalTiles_ = 0;
+
+    for(int i=0; i<=depth_; i++)
+    {
+        totalTiles_ += (1 << i) * (1 << i);
+    }
+
+    put_flog(LOG_INFO, "building image pyramid for %s: %i x %i, %i levels, %i tiles", imageFilename_.c_str(), imageWidth_, imageHeight_, depth_ + 1, totalTiles_);
+
+    // make directory if necessary
+    if(QDir(imagePyramidPath_.c_str()).exists() != true && QDir().mkpath(imagePyramidPath_.c_str()) != true)
+    {
+        put_flog(LOG_ERROR, "error creating directory %s", imagePyramidPath_.c_str());
+        return false;
+    }
+
+    if(writeMetadata() != true)
+    {
+        return false;
+    }
+
+    levelRows_.clear();
+    levelRows_.resize(depth_);
+
+    numTiles_ = 0;
+    lastProgressPercent_ = -1;
+    updateProgress(0);
+
+    for(int i=0; i<numLeafTiles_; i++)
+    {
+        if(processLeafRow(i) != true)
+        {
+            return false;
+        }
+    }
+
+    fullImage_ = QImage();
+    strip_ = QImage();
+
+    put_flog(LOG_INFO, "built image pyramid in %f s", (float)time.elapsed() / 1000.);
+
+    return true;
+}
+
+void ImagePyramidBuilder::cancel()
+{
+    canceled_ = true;
+}
+
+bool ImagePyramidBuilder::writeMetadata()
+{
+    std::string metadataFilename = imagePyramidPath_ + "/pyramid.pyr";
+
+    std::ofstream ofs(metadataFilename.c_str());
+
+    if(ofs.good() != true)
+    {
+        put_flog(LOG_ERROR, "could not write metadata file %s", metadataFilename.c_str());
+        return false;
+    }
+
+    ofs << "\"" << imagePyramidPath_ << "\" " << imageWidth_ << " " << imageHeight_ << " " << tileSize_;
+
+    // write a more conveniently named metadata file in the same directory as the original image, if possible
+    // path ends with ".pyramid"; the new metadata file will end with ".pyr"
+    QString secondMetadataFilename = QString(imagePyramidPath_.c_str());
+    int amidLastIndex = secondMetadataFilename.lastIndexOf("amid");
+
+    if(amidLastIndex != -1)
+    {
+        secondMetadataFilename.truncate(amidLastIndex);
+
+        std::ofstream secondOfs(secondMetadataFilename.toStdString().c_str());
+
+        if(secondOfs.good() == true)
+        {
+            secondOfs << "\"" << imagePyramidPath_ << "\" " << imageWidth_ << " " << imageHeight_ << " " << tileSize_;
+        }
+        else
+        {
+            put_flog(LOG_WARN, "could not write second metadata file %s", secondMetadataFilename.toStdString().c_str());
+        }
+    }
+
+    return true;
+}
+
+bool ImagePyramidBuilder::readStrip(int row)
+{
+    if(strip_.isNull() != true && row >= stripFirstRow_ && row < stripFirstRow_ + stripNumRows_)
+    {
+        return true;
+    }
+
+    // free the previous strip first
+    strip_ = QImage();
+
+    int y0, y1;
+    getLeafRowBounds(row, y0, y1);
+
+    // read as many rows as fit in the strip size limit: most formats are decoded
+    // from the top for each read, so fewer reads are faster
+    stripFirstRow_ = row;
+    stripNumRows_ = 1;
+
+    if(readFullImage_ != true)
+    {
+        double rowBytes = 4. * (double)imageWidth_ * (double)(y1 - y0);
+
+        stripNumRows_ = std::max((int)((double)IMAGE_PYRAMID_BUILDER_MAX_STRIP_BYTES / std::max(rowBytes, 1.)), 1);
+        stripNumRows_ = std::min(stripNumRows_, numLeafTiles_ - row);
+    }
+
+    int lastY0;
+    getLeafRowBounds(row + stripNumRows_ - 1, lastY0, y1);
+
+    QRect rect(0, y0, imageWidth_, y1 - y0);
+
+    if(readFullImage_ == true)
+    {
+        strip_ = fullImage_.copy(rect);
+    }
+    else
+    {
+        // a new reader is needed for each read
+        QImageReader imageReader(imageFilename_.c_str());
+        imageReader.setClipRect(rect);
+
+        strip_ = imageReader.read();
+
+        if(strip_.isNull() == true)
+        {
+            put_flog(LOG_ERROR, "error reading strip %i - %i of %s: %s", y0, y1, imageFilename_.c_str(), imageReader.errorString().toStdString().c_str());
+        }
+    }
+
+    return strip_.isNull() != true;
+}
+
+void ImagePyramidBuilder::getLeafRowBounds(int row, int & y0, int & y1)
+{
+    y0 = (int)((double)row * (double)imageHeight_ / (double)numLeafTiles_);
+    y1 = (int)((double)(row + 1) * (double)imageHeight_ / (double)numLeafTiles_);
+}
+
+bool ImagePyramidBuilder::processLeafRow(int row)
+{
+    if(canceled_ == true)
+    {
+        put_flog(LOG_INFO, "canceled");
+        return false;
+    }
+
+    std::vector<ImagePyramidTileJob *> jobs;
+
+    // when resuming, rows that were already written don't need the source image
+    bool rowExists = true;
+
+    for(int i=0; i<numLeafTiles_; i++)
+    {
+        if(QFile::exists(getTileFilename(depth_, i, row).c_str()) != true)
+        {
+            rowExists = false;
+            break;
+        }
+    }
+
+    if(rowExists == true)
+    {
+        for(int i=0; i<numLeafTiles_; i++)
+        {
+            jobs.push_back(new ImagePyramidTileJob(getTileFilename(depth_, i, row), QImage(), tileSize_, jpegQuality_));
+        }
+
+        if(runJobs(depth_, row, jobs) == true)
+        {
+            return true;
+        }
+
+        // some existing tiles could not be read; remove them and build the row from the source image
+        for(int i=0; i<numLeafTiles_; i++)
+        {
+            QImage tile(getTileFilename(depth_, i, row).c_str());
+
+            if(tile.isNull() == true)
+            {
+                put_flog(LOG_WARN, "removing unreadable tile %s", getTileFilename(depth_, i, row).c_str());
+                QFile::remove(getTileFilename(depth_, i, row).c_str());
+            }
+        }
+    }
+
+    if(readStrip(row) != true)
+    {
+        return false;
+    }
+
+    // image rectangle of the row, and its offset in the strip
+    int y0, y1;
+    getLeafRowBounds(row, y0, y1);
+
+    int stripY0, stripY1;
+    getLeafRowBounds(stripFirstRow_, stripY0, stripY1);
+
+    for(int i=0; i<numLeafTiles_; i++)
+    {
+        int x0 = (int)((double)i * (double)imageWidth_ / (double)numLeafTiles_);
+        int x1 = (int)((double)(i + 1) * (double)imageWidth_ / (double)numLeafTiles_);
+
+        jobs.push_back(new ImagePyramidTileJob(getTileFilename(depth_, i, row), strip_.copy(x0, y0 - stripY0, x1 - x0, y1 - y0), tileSize_, jpegQuality_));
+    }
+
+    return runJobs(depth_, row, jobs);
+}
+
+bool ImagePyramidBuilder::processLevelRow(int level, int row)
+{
+    if(canceled_ == true)
+    {
+        put_flog(LOG_INFO, "canceled");
+        return false;
+    }
+
+    std::vector<ImagePyramidTileJob *> jobs;
+
+    for(unsigned int i=0; i<levelRows_[level].size(); i++)
+    {
+        jobs.push_back(new ImagePyramidTileJob(getTileFilename(level, i, row), levelRows_[level][i], tileSize_, jpegQuality_));
+    }
+
+    levelRows_[level].clear();
+
+    return runJobs(level, row, jobs);
+}
+
+bool ImagePyramidBuilder::runJobs(int level, int row, std::vector<ImagePyramidTileJob *> & jobs)
+{
+    for(unsigned int i=0; i<jobs.size(); i++)
+    {
+        jobs[i]->setAutoDelete(false);
+        threadPool_.start(jobs[i]);
+    }
+
+    threadPool_.waitForDone();
+
+    bool success = true;
+
+    for(unsigned int i=0; i<jobs.size(); i++)
+    {
+        success = success && jobs[i]->success;
+    }
+
+    if(success == true && level > 0)
+    {
+        // assemble the half-size tiles into the tiles of the level above
+        std::vector<QImage> & parentRow = levelRows_[level - 1];
+
+        if(parentRow.size() == 0)
+        {
+            for(unsigned int i=0; i<(jobs.size() + 1) / 2; i++)
+            {
+                QImage tile(tileSize_, tileSize_, QImage::Format_RGB32);
+                tile.fill(0);
+
+                parentRow.push_back(tile);
+            }
+        }
+
+        int halfTileSize = tileSize_ / 2;
+
+        for(unsigned int i=0; i<jobs.size(); i++)
+        {
+            QPainter painter(&parentRow[i / 2]);
+            painter.drawImage(QPoint((i % 2) * halfTileSize, (row % 2) * halfTileSize), jobs[i]->halfImage);
+        }
+    }
+
+    for(unsigned int i=0; i<jobs.size(); i++)
+    {
+        delete jobs[i];
+    }
+
+    jobs.clear();
+
+    if(success != true)
+    {
+        return false;
+    }
+
+    updateProgress(numTiles_ + (1 << level));
+
+    // the row of the level above is complete after its second row of children
+    if(level > 0 && row % 2 == 1)
+    {
+        return processLevelRow(level - 1, row / 2);
+    }
+
+    return true;
+}
+
+std::string ImagePyramidBuilder::getTileFilename(int level, int x, int y)
+{
+    // the path through the tree; the root is 0 and its children are numbered
+    // 0 (top-left), 1 (top-right), 2 (bottom-right), 3 (bottom-left)
+    std::string filename = imagePyramidPath_ + "/0";
+
+    for(int i=level-1; i>=0; i--)
+    {
+        int quadrantX = (x >> i) & 1;
+        int quadrantY = (y >> i) & 1;
+
+        int childIndex = 0;
+
+        if(quadrantY == 0)
+        {
+            childIndex = quadrantX;
+        }
+        else
+        {
+            childIndex = 3 - quadrantX;
+        }
+
+        filename += "-" + QString::number(childIndex).toStdString();
+    }
+
+    filename += ".jpg";
+
+    return filename;
+}
+
+void ImagePyramidBuilder::updateProgress(int numTiles)
+{
+    numTiles_ = numTiles;
+
+    emit(progress(numTiles_, totalTiles_));
+
+    int percent = (int)(100. * (double)numTiles_ / (double)totalTiles_);
+
+    if(percent != lastProgressPercent_)
+    {
+        put_flog(LOG_INFO, "%i%% (%i / %i tiles)", percent, numTiles_, totalTiles_);
+
+        lastProgressPercent_ = percent;
+    }
+}
+
+ImagePyramidTileJob::ImagePyramidTileJob(std::string filename, QImage image, int tileSize, int jpegQuality)
+{
+    // defaults
+    success = false;
+
+    // assign values
+    filename_ = filename;
+    image_ = image;
+    tileSize_ = tileSize;
+    jpegQuality_ = jpegQuality;
+}
+
+void ImagePyramidTileJob::run()
+{
+    QImage tile;
+
+    // reuse an existing tile, e.g. when resuming an interrupted build
+    if(QFile::exists(filename_.c_str()) == true)
+    {
+        tile.load(filename_.c_str());
+    }
+
+    if(tile.isNull() == true)
+    {
+        if(image_.isNull() == true)
+        {
+            put_flog(LOG_ERROR, "could not read tile %s", filename_.c_str());
+            return;
+        }
+
+        tile = image_;
+
+        if(tile.width() != tileSize_ || tile.height() != tileSize_)
+        {
+            tile = tile.scaled(tileSize_, tileSize_, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+
+        // write to a temporary file first, so an interrupted build never leaves a partial tile
+        QString temporaryFilename = QString(filename_.c_str()) + ".tmp";
+
+        if(tile.save(temporaryFilename, "jpg", jpegQuality_) != true)
+        {
+            put_flog(LOG_ERROR, "error writing tile %s", filename_.c_str());
+            return;
+        }
+
+        QFile::remove(filename_.c_str());
+
+        if(QFile::rename(temporaryFilename, filename_.c_str()) != true)
+        {
+            put_flog(LOG_ERROR, "error renaming tile %s", filename_.c_str());
+            return;
+        }
+    }
+
+    // no longer need the source image
+    image_ = QImage();
+
+    halfImage = tile.scaled(tileSize_ / 2, tileSize_ / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    success = true;
+}
@@ -0,0 +1,170 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef IMAGE_PYRAMID_BUILDER_H
+#define IMAGE_PYRAMID_BUILDER_H
+
+// tile size if not given; tile sizes are 256, 512, 1024 or 2048
+#define IMAGE_PYRAMID_BUILDER_DEFAULT_TILE_SIZE 512
+
+// maximum size of a strip of the source image read at once
+#define IMAGE_PYRAMID_BUILDER_MAX_STRIP_BYTES (512 * 1024 * 1024)
+
+#include <QtGui>
+#include <string>
+#include <vector>
+
+class ImagePyramidTileJob;
+
+// builds an image pyramid for DynamicTexture: a quadtree of tiles, each a region
+// of the image scaled to tileSize x tileSize, named by their path through the tree
+// (0.jpg, 0-0.jpg, ..., quadrants ordered top-left, top-right, bottom-right,
+// bottom-left) along with a .pyr metadata file.
+//
+// the source image is read in strips of one or more rows of leaf tiles, and the
+// levels are built bottom-up by downsampling the tiles of the level below, so only
+// a strip of the image and one row of tiles per level are in memory. tiles are scaled and
+// encoded in parallel. existing tiles are reused, so an interrupted build can be
+// resumed.
+class ImagePyramidBuilder : public QObject {
+    Q_OBJECT
+
+    public:
+
+        ImagePyramidBuilder(std::string imageFilename, std::string imagePyramidPath, int tileSize=IMAGE_PYRAMID_BUILDER_DEFAULT_TILE_SIZE);
+        ~ImagePyramidBuilder();
+
+        // JPEG quality (0-100), or -1 for the default
+        void setJpegQuality(int quality);
+
+        // number of threads used to scale and encode tiles
+        void setMaxThreads(int maxThreads);
+
+        // build the pyramid; returns false on error or if canceled
+        bool build();
+
+    public slots:
+
+        // stop the build after the tiles in progress
+        void cancel();
+
+    signals:
+
+        // numTiles of totalTiles tiles have been written (or found to exist already)
+        void progress(int numTiles, int totalTiles);
+
+    private:
+
+        std::string imageFilename_;
+        std::string imagePyramidPath_;
+        int tileSize_;
+        int jpegQuality_;
+
+        QThreadPool threadPool_;
+
+        bool canceled_;
+
+        // source image dimensions
+        int imageWidth_;
+        int imageHeight_;
+
+        // depth of the leaf tiles, and number of leaf tiles per row / column (2^depth)
+        int depth_;
+        int numLeafTiles_;
+
+        // full image, if the image format doesn't allow reading strips
+        bool readFullImage_;
+        QImage fullImage_;
+
+        // current strip of the image, and the range of leaf rows it contains
+        QImage strip_;
+        int stripFirstRow_;
+        int stripNumRows_;
+
+        // for each level above the leaves, the row of tiles being assembled from the level below
+        std::vector<std::vector<QImage> > levelRows_;
+
+        // progress
+        int numTiles_;
+        int totalTiles_;
+        int lastProgressPercent_;
+
+        bool writeMetadata();
+
+        // make sure strip_ contains the given leaf row
+        bool readStrip(int row);
+
+        // image rows [y0, y1) of a leaf row
+        void getLeafRowBounds(int row, int & y0, int & y1);
+
+        // process a row of leaf tiles, and then levels above as rows are completed
+        bool processLeafRow(int row);
+        bool processLevelRow(int level, int row);
+
+        // run the jobs for a row of tiles at level, and add their half-size images to the level above
+        bool runJobs(int level, int row, std::vector<ImagePyramidTileJob *> & jobs);
+
+        std::string getTileFilename(int level, int x, int y);
+
+        void updateProgress(int numTiles);
+};
+
+class ImagePyramidTileJob : public QRunnable {
+
+    public:
+
+        ImagePyramidTileJob(std::string filename, QImage image, int tileSize, int jpegQuality);
+
+        void run();
+
+        // after run(): whether the tile was written or already existed, and the tile at half size
+        bool success;
+        QImage halfImage;
+
+    private:
+
+        std::string filename_;
+
+        // image to be scaled to the tile size
+        QImage image_;
+
+        int tileSize_;
+        int jpegQuality_;
+};
+
+#endif
@@ -0,0 +1,468 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ImagePyramidContainer.h"
+#include "log.h"
+#include <algorithm>
+#include <fstream>
+#include <boost/tokenizer.hpp>
+
+// tiles of an image pyramid directory, as (key, filename)
+typedef std::pair<quint64, std::string> ImagePyramidContainerTile;
+
+static void collectTiles(std::string imagePyramidPath, std::vector<int> & treePath, std::vector<ImagePyramidContainerTile> & tiles)
+{
+    std::string filename = imagePyramidPath + '/';
+
+    for(unsigned int i=0; i<treePath.size(); i++)
+    {
+        filename += QString::number(treePath[i]).toStdString();
+
+        if(i != treePath.size() - 1)
+        {
+            filename += "-";
+        }
+    }
+
+    filename += ".jpg";
+
+    if(QFile::exists(filename.c_str()) != true)
+    {
+        return;
+    }
+
+    tiles.push_back(ImagePyramidContainerTile(ImagePyramidContainer::getKey(treePath), filename));
+
+    if((int)treePath.size() > IMAGE_PYRAMID_CONTAINER_MAX_DEPTH)
+    {
+        return;
+    }
+
+    for(int i=0; i<4; i++)
+    {
+        treePath.push_back(i);
+        collectTiles(imagePyramidPath, treePath, tiles);
+        treePath.pop_back();
+    }
+}
+
+ImagePyramidContainer::ImagePyramidContainer(std::string filename) : file_(filename.c_str())
+{
+    // defaults
+    map_ = NULL;
+    mapSize_ = 0;
+    imageWidth_ = 0;
+    imageHeight_ = 0;
+    numTiles_ = 0;
+    tileSize_ = IMAGE_PYRAMID_DEFAULT_TILE_SIZE;
+    index_ = NULL;
+
+    // assign values
+    filename_ = filename;
+
+    if(open() != true)
+    {
+        put_flog(LOG_ERROR, "could not open image pyramid container %s", filename_.c_str());
+
+        if(map_ != NULL)
+        {
+            file_.unmap(map_);
+            map_ = NULL;
+        }
+
+        file_.close();
+    }
+}
+
+ImagePyramidContainer::~ImagePyramidContainer()
+{
+    if(map_ != NULL)
+    {
+        file_.unmap(map_);
+        map_ = NULL;
+    }
+
+    file_.close();
+}
+
+bool ImagePyramidContainer::isValid()
+{
+    return (map_ != NULL);
+}
+
+int ImagePyramidContainer::getImageWidth()
+{
+    return imageWidth_;
+}
+
+int ImagePyramidContainer::getImageHeight()
+{
+    return imageHeight_;
+}
+
+int ImagePyramidContainer::getNumTiles()
+{
+    return numTiles_;
+}
+
+int ImagePyramidContainer::getTileSize()
+{
+    return tileSize_;
+}
+
+bool ImagePyramidContainer::getTile(const std::vector<int> & treePath, const uchar * & data, int & size)
+{
+    if(map_ == NULL || treePath.size() == 0)
+    {
+        return false;
+    }
+
+    quint64 key = getKey(treePath);
+
+    // binary search of the index
+    int low = 0;
+    int high = numTiles_ - 1;
+
+    while(low <= high)
+    {
+        int middle = low + (high - low) / 2;
+
+        const uchar * entry = index_ + (qint64)middle * IMAGE_PYRAMID_CONTAINER_INDEX_ENTRY_SIZE;
+        quint64 entryKey = qFromLittleEndian<quint64>(entry);
+
+        if(entryKey < key)
+        {
+            low = middle + 1;
+        }
+        else if(entryKey > key)
+        {
+            high = middle - 1;
+        }
+        else
+        {
+            quint64 offset = qFromLittleEndian<quint64>(entry + 8);
+            quint32 tileSize = qFromLittleEndian<quint32>(entry + 16);
+
+            if(offset > (quint64)mapSize_ || (quint64)tileSize > (quint64)mapSize_ - offset)
+            {
+                put_flog(LOG_ERROR, "tile data out of range in %s", filename_.c_str());
+                return false;
+            }
+
+            data = map_ + offset;
+            size = (int)tileSize;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ImagePyramidContainer::loadTile(const std::vector<int> & treePath, QImage & image)
+{
+    const uchar * data;
+    int size;
+
+    if(getTile(treePath, data, size) != true)
+    {
+        return false;
+    }
+
+    return image.loadFromData(data, size, "jpg");
+}
+
+quint64 ImagePyramidContainer::getKey(const std::vector<int> & treePath)
+{
+    // the root's path is always 0, so it only contributes the leading 1
+    quint64 key = 1;
+
+    for(unsigned int i=1; i<treePath.size(); i++)
+    {
+        key = (key << 2) | (quint64)(treePath[i] & 3);
+    }
+
+    return key;
+}
+
+bool ImagePyramidContainer::readMetadata(std::string metadataFilename, std::string & imagePyramidPath, int & imageWidth, int & imageHeight, int & tileSize)
+{
+    std::ifstream ifs(metadataFilename.c_str());
+
+    if(ifs.good() != true)
+    {
+        put_flog(LOG_ERROR, "could not read %s", metadataFilename.c_str());
+        return false;
+    }
+
+    // read the whole line
+    std::string lineString;
+    getline(ifs, lineString);
+
+    // parse the arguments, allowing escaped characters, quotes, etc., and assign them to a vector
+    std::string separator1("\\"); // allow escaped characters
+    std::string separator2(" "); // split on spaces
+    std::string separator3("\"\'"); // allow quoted arguments
+
+    boost::escaped_list_separator<char> els(separator1, separator2, separator3);
+    boost::tokenizer<boost::escaped_list_separator<char> > tok(lineString, els);
+
+    std::vector<std::string> tokVector;
+    tokVector.assign(tok.begin(), tok.end());
+
+    if(tokVector.size() < 3)
+    {
+        put_flog(LOG_ERROR, "require 3 arguments, got %i", tokVector.size());
+        return false;
+    }
+
+    imagePyramidPath = tokVector[0];
+    imageWidth = atoi(tokVector[1].c_str());
+    imageHeight = atoi(tokVector[2].c_str());
+
+    // optional tile size
+    tileSize = IMAGE_PYRAMID_DEFAULT_TILE_SIZE;
+
+    if(tokVector.size() >= 4)
+    {
+        tileSize = atoi(tokVector[3].c_str());
+
+        if(isValidTileSize(tileSize) != true)
+        {
+            put_flog(LOG_ERROR, "unsupported tile size %i", tileSize);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ImagePyramidContainer::isValidTileSize(int tileSize)
+{
+    return (tileSize == 256 || tileSize == 512 || tileSize == 1024 || tileSize == 2048);
+}
+
+bool ImagePyramidContainer::convert(std::string metadataFilename, std::string containerFilename)
+{
+    std::string imagePyramidPath;
+    int imageWidth, imageHeight, tileSize;
+
+    if(readMetadata(metadataFilename, imagePyramidPath, imageWidth, imageHeight, tileSize) != true)
+    {
+        return false;
+    }
+
+    std::vector<ImagePyramidContainerTile> tiles;
+    std::vector<int> treePath(1, 0);
+
+    collectTiles(imagePyramidPath, treePath, tiles);
+
+    if(tiles.size() == 0)
+    {
+        put_flog(LOG_ERROR, "no tiles found in %s", imagePyramidPath.c_str());
+        return false;
+    }
+
+    std::sort(tiles.begin(), tiles.end());
+
+    put_flog(LOG_INFO, "writing %i tiles from %s to %s", (int)tiles.size(), imagePyramidPath.c_str(), containerFilename.c_str());
+
+    // header and index
+    qint64 indexOffset = IMAGE_PYRAMID_CONTAINER_HEADER_SIZE;
+    qint64 tileOffset = indexOffset + (qint64)tiles.size() * IMAGE_PYRAMID_CONTAINER_INDEX_ENTRY_SIZE;
+
+    QByteArray header(tileOffset, 0);
+    uchar * headerData = (uchar *)header.data();
+
+    memcpy(headerData, IMAGE_PYRAMID_CONTAINER_MAGIC, IMAGE_PYRAMID_CONTAINER_MAGIC_SIZE);
+    qToLittleEndian<quint32>(IMAGE_PYRAMID_CONTAINER_VERSION, headerData + 8);
+    qToLittleEndian<quint32>(imageWidth, headerData + 12);
+    qToLittleEndian<quint32>(imageHeight, headerData + 16);
+    qToLittleEndian<quint32>(tiles.size(), headerData + 20);
+    qToLittleEndian<quint64>(indexOffset, headerData + 24);
+
+    for(unsigned int i=0; i<tiles.size(); i++)
+    {
+        qint64 tileSize = QFileInfo(tiles[i].second.c_str()).size();
+
+        uchar * entry = headerData + indexOffset + (qint64)i * IMAGE_PYRAMID_CONTAINER_INDEX_ENTRY_SIZE;
+
+        qToLittleEndian<quint64>(tiles[i].first, entry);
+        qToLittleEndian<quint64>(tileOffset, entry + 8);
+        qToLittleEndian<quint32>(tileSize, entry + 16);
+
+        tileOffset += tileSize;
+    }
+
+    // write to a temporary file first, so an interrupted conversion never leaves a partial container
+    QString temporaryFilename = QString(containerFilename.c_str()) + ".tmp";
+    QFile file(temporaryFilename);
+
+    if(file.open(QIODevice::WriteOnly | QIODevice::Truncate) != true)
+    {
+        put_flog(LOG_ERROR, "could not open %s for writing", temporaryFilename.toStdString().c_str());
+        return false;
+    }
+
+    bool success = (file.write(header) == header.size());
+
+    for(unsigned int i=0; i<tiles.size() && success == true; i++)
+    {
+        const uchar * entry = headerData + indexOffset + (qint64)i * IMAGE_PYRAMID_CONTAINER_INDEX_ENTRY_SIZE;
+
+        QFile tileFile(tiles[i].second.c_str());
+
+        if(tileFile.open(QIODevice::ReadOnly) != true)
+        {
+            put_flog(LOG_ERROR, "could not read tile %s", tiles[i].second.c_str());
+            success = false;
+            break;
+        }
+
+        QByteArray tileData = tileFile.readAll();
+
+        // the tile must not have changed since the index was written
+        if((quint32)tileData.size() != qFromLittleEndian<quint32>(entry + 16))
+        {
+            put_flog(LOG_ERROR, "tile %s changed size during conversion", tiles[i].second.c_str());
+            success = false;
+            break;
+        }
+
+        success = (file.write(tileData) == tileData.size());
+    }
+
+    file.close();
+
+    if(success != true)
+    {
+        put_flog(LOG_ERROR, "error writing %s", temporaryFilename.toStdString().c_str());
+        QFile::remove(temporaryFilename);
+        return false;
+    }
+
+    QFile::remove(containerFilename.c_str());
+
+    if(QFile::rename(temporaryFilename, containerFilename.c_str()) != true)
+    {
+        put_flog(LOG_ERROR, "error renaming %s", temporaryFilename.toStdString().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ImagePyramidContainer::open()
+{
+    if(file_.open(QIODevice::ReadOnly) != true)
+    {
+        return false;
+    }
+
+    mapSize_ = file_.size();
+
+    if(mapSize_ < IMAGE_PYRAMID_CONTAINER_HEADER_SIZE)
+    {
+        put_flog(LOG_ERROR, "file too small");
+        return false;
+    }
+
+    // the pages are shared by all DynamicTextures (and processes) reading the file, and
+    // only the tiles actually rendered are ever read from disk
+    map_ = file_.map(0, mapSize_);
+
+    if(map_ == NULL)
+    {
+        put_flog(LOG_ERROR, "could not map file");
+        return false;
+    }
+
+    if(memcmp(map_, IMAGE_PYRAMID_CONTAINER_MAGIC, IMAGE_PYRAMID_CONTAINER_MAGIC_SIZE) != 0)
+    {
+        put_flog(LOG_ERROR, "not an image pyramid container");
+        return false;
+    }
+
+    quint32 version = qFromLittleEndian<quint32>(map_ + 8);
+
+    if(version != IMAGE_PYRAMID_CONTAINER_VERSION)
+    {
+        put_flog(LOG_ERROR, "unsupported version %u", version);
+        return false;
+    }
+
+    imageWidth_ = qFromLittleEndian<quint32>(map_ + 12);
+    imageHeight_ = qFromLittleEndian<quint32>(map_ + 16);
+    numTiles_ = qFromLittleEndian<quint32>(map_ + 20);
+
+    quint64 indexOffset = qFromLittleEndian<quint64>(map_ + 24);
+
+    if(numTiles_ < 0 || indexOffset > (quint64)mapSize_ || (quint64)numTiles_ * IMAGE_PYRAMID_CONTAINER_INDEX_ENTRY_SIZE > (quint64)mapSize_ - indexOffset)
+    {
+        put_flog(LOG_ERROR, "index out of range");
+        return false;
+    }
+
+    index_ = map_ + indexOffset;
+
+    // the tile size is that of the root tile, read from its header without decoding it
+    const uchar * data;
+    int size;
+
+    if(getTile(std::vector<int>(1, 0), data, size) == true)
+    {
+        QByteArray byteArray = QByteArray::fromRawData((const char *)data, size);
+        QBuffer buffer(&byteArray);
+
+        QImageReader imageReader(&buffer, "jpg");
+        QSize tileSize = imageReader.size();
+
+        if(tileSize.isValid() == true && isValidTileSize(tileSize.width()) == true && tileSize.width() == tileSize.height())
+        {
+            tileSize_ = tileSize.width();
+        }
+        else
+        {
+            put_flog(LOG_WARN, "unexpected root tile size, using %i", tileSize_);
+        }
+    }
+
+    put_flog(LOG_DEBUG, "opened %s: imageWidth = %i, imageHeight = %i, tileSize = %i, %i tiles", filename_.c_str(), imageWidth_, imageHeight_, tileSize_, numTiles_);
+
+    return true;
+}
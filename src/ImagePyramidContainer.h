@@ -0,0 +1,129 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef IMAGE_PYRAMID_CONTAINER_H
+#define IMAGE_PYRAMID_CONTAINER_H
+
+#define IMAGE_PYRAMID_CONTAINER_MAGIC "DCPYR\0\0\0"
+#define IMAGE_PYRAMID_CONTAINER_MAGIC_SIZE 8
+#define IMAGE_PYRAMID_CONTAINER_VERSION 1
+#define IMAGE_PYRAMID_CONTAINER_HEADER_SIZE 32
+#define IMAGE_PYRAMID_CONTAINER_INDEX_ENTRY_SIZE 24
+
+// the tree path is packed two bits per level into a 64 bit key
+#define IMAGE_PYRAMID_CONTAINER_MAX_DEPTH 31
+
+// tile width and height of pyramids that don't specify it
+#define IMAGE_PYRAMID_DEFAULT_TILE_SIZE 512
+
+#include <QtGui>
+#include <string>
+#include <vector>
+
+// single-file image pyramid (.dcpyr): the tiles of an image pyramid directory
+// concatenated into one file, so opening a tile costs no filesystem metadata
+// operations. the file is memory-mapped, and tiles are found by binary search of
+// the index.
+//
+// layout (all integers little-endian):
+//
+// header (32 bytes):  magic[8], uint32 version, uint32 image width, uint32 image height,
+//                     uint32 number of tiles, uint64 index offset
+// index (24 bytes per tile, sorted by key):
+//                     uint64 key, uint64 tile offset, uint32 tile size, uint32 reserved
+// tiles:              JPEG data
+//
+// the key of a tree path (0, c1, c2, ...) is 1 followed by two bits for each child
+// index c1, c2, ..., so the index is ordered coarsest level first.
+class ImagePyramidContainer {
+
+    public:
+
+        ImagePyramidContainer(std::string filename);
+        ~ImagePyramidContainer();
+
+        bool isValid();
+
+        int getImageWidth();
+        int getImageHeight();
+        int getNumTiles();
+
+        // width and height of the tiles, from the root tile
+        int getTileSize();
+
+        // get the encoded tile data, pointing into the mapped file
+        // returns false if the tile does not exist
+        bool getTile(const std::vector<int> & treePath, const uchar * & data, int & size);
+
+        // decode a tile; thread-safe
+        bool loadTile(const std::vector<int> & treePath, QImage & image);
+
+        static quint64 getKey(const std::vector<int> & treePath);
+
+        // read a .pyr metadata file: "image pyramid path" width height [tile size]
+        // the tile size is IMAGE_PYRAMID_DEFAULT_TILE_SIZE if not given
+        static bool readMetadata(std::string metadataFilename, std::string & imagePyramidPath, int & imageWidth, int & imageHeight, int & tileSize);
+
+        // tile sizes supported: 256, 512, 1024 or 2048
+        static bool isValidTileSize(int tileSize);
+
+        // write a container from an image pyramid directory, given its .pyr metadata file
+        static bool convert(std::string metadataFilename, std::string containerFilename);
+
+    private:
+
+        // not copyable
+        ImagePyramidContainer(const ImagePyramidContainer &);
+        ImagePyramidContainer & operator=(const ImagePyramidContainer &);
+
+        std::string filename_;
+
+        QFile file_;
+        uchar * map_;
+        qint64 mapSize_;
+
+        int imageWidth_;
+        int imageHeight_;
+        int numTiles_;
+        int tileSize_;
+        const uchar * index_;
+
+        bool open();
+};
+
+#endif
@@ -0,0 +1,239 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ImageRegionReader.h"
+#include "main.h"
+#include "log.h"
+
+QMutex ImageRegionReader::memoryMutex_;
+QWaitCondition ImageRegionReader::memoryCondition_;
+qint64 ImageRegionReader::memoryBudget_ = -1;
+qint64 ImageRegionReader::memoryInUse_ = 0;
+qint64 ImageRegionReader::memoryReserved_ = 0;
+
+ImageRegionReader::ImageRegionReader(std::string filename)
+{
+    // defaults
+    width_ = 0;
+    height_ = 0;
+    supportsClipRect_ = false;
+    supportsScaledSize_ = false;
+    reservedBytes_ = 0;
+
+    // assign values
+    filename_ = filename;
+
+    // the size is read from the header, without decoding the image
+    QImageReader imageReader(filename.c_str());
+
+    if(imageReader.canRead() != true)
+    {
+        put_flog(LOG_ERROR, "cannot read %s", filename.c_str());
+        return;
+    }
+
+    QSize size = imageReader.size();
+
+    if(size.isValid() != true)
+    {
+        put_flog(LOG_ERROR, "could not get dimensions of %s", filename.c_str());
+        return;
+    }
+
+    width_ = size.width();
+    height_ = size.height();
+
+    supportsClipRect_ = imageReader.supportsOption(QImageIOHandler::ClipRect);
+    supportsScaledSize_ = imageReader.supportsOption(QImageIOHandler::ScaledSize);
+
+    put_flog(LOG_DEBUG, "%s: format %s, width = %i, height = %i, region reads = %i", filename.c_str(), imageReader.format().constData(), width_, height_, supportsClipRect_);
+}
+
+ImageRegionReader::~ImageRegionReader()
+{
+    if(reservedBytes_ > 0)
+    {
+        releaseMemory(reservedBytes_, true);
+    }
+}
+
+bool ImageRegionReader::isValid()
+{
+    return (width_ > 0 && height_ > 0);
+}
+
+int ImageRegionReader::getWidth()
+{
+    return width_;
+}
+
+int ImageRegionReader::getHeight()
+{
+    return height_;
+}
+
+bool ImageRegionReader::supportsRegions()
+{
+    return supportsClipRect_;
+}
+
+qint64 ImageRegionReader::getDecodeBytes(QRect region, QSize scaledSize)
+{
+    // the resulting image
+    qint64 bytes = (qint64)scaledSize.width() * (qint64)scaledSize.height() * 4;
+
+    if(supportsClipRect_ != true)
+    {
+        // the whole image is decoded and then clipped
+        return bytes + (qint64)width_ * (qint64)height_ * 4;
+    }
+
+    // the region, reduced by any scaling done while decoding
+    int scale = 1;
+
+    if(supportsScaledSize_ == true)
+    {
+        while(scale < IMAGE_REGION_READER_MAX_DECODE_SCALE && region.width() / (2*scale) >= scaledSize.width() && region.height() / (2*scale) >= scaledSize.height())
+        {
+            scale *= 2;
+        }
+    }
+
+    return bytes + (qint64)(region.width() / scale + 1) * (qint64)(region.height() / scale + 1) * 4;
+}
+
+bool ImageRegionReader::read(QRect region, QSize scaledSize, QImage & image)
+{
+    qint64 bytes = getDecodeBytes(region, scaledSize);
+
+    if(acquireMemory(bytes, false) != true)
+    {
+        put_flog(LOG_ERROR, "reading region (%i, %i, %i, %i) of %s needs %i MB, more than the available memory cap", region.x(), region.y(), region.width(), region.height(), filename_.c_str(), (int)(bytes / (1024*1024)));
+        return false;
+    }
+
+    QImageReader imageReader(filename_.c_str());
+
+    // the clip rectangle is in full resolution coordinates, and is applied before scaling
+    imageReader.setClipRect(region);
+    imageReader.setScaledSize(scaledSize);
+
+    image = imageReader.read();
+
+    releaseMemory(bytes, false);
+
+    if(image.isNull() == true)
+    {
+        put_flog(LOG_ERROR, "error reading region (%i, %i, %i, %i) of %s: %s", region.x(), region.y(), region.width(), region.height(), filename_.c_str(), imageReader.errorString().toStdString().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageRegionReader::readImage(QImage & image)
+{
+    qint64 bytes = (qint64)width_ * (qint64)height_ * 4;
+
+    if(acquireMemory(bytes, true) != true)
+    {
+        put_flog(LOG_ERROR, "reading %s needs %i MB, more than the available memory cap", filename_.c_str(), (int)(bytes / (1024*1024)));
+        return false;
+    }
+
+    if(image.load(filename_.c_str()) != true)
+    {
+        releaseMemory(bytes, true);
+
+        put_flog(LOG_ERROR, "error loading %s", filename_.c_str());
+        return false;
+    }
+
+    reservedBytes_ += bytes;
+
+    return true;
+}
+
+bool ImageRegionReader::acquireMemory(qint64 bytes, bool reserve)
+{
+    QMutexLocker locker(&memoryMutex_);
+
+    if(memoryBudget_ < 0)
+    {
+        memoryBudget_ = (qint64)IMAGE_READER_DEFAULT_MEMORY_BUDGET_MB * 1024 * 1024;
+
+        if(g_configuration != NULL)
+        {
+            memoryBudget_ = g_configuration->getImageReaderMemoryBudget();
+        }
+    }
+
+    while(memoryInUse_ + bytes > memoryBudget_)
+    {
+        // reserved memory is only released when readers are destroyed, so don't wait on it
+        if(bytes > memoryBudget_ - memoryReserved_)
+        {
+            return false;
+        }
+
+        memoryCondition_.wait(&memoryMutex_);
+    }
+
+    memoryInUse_ += bytes;
+
+    if(reserve == true)
+    {
+        memoryReserved_ += bytes;
+    }
+
+    return true;
+}
+
+void ImageRegionReader::releaseMemory(qint64 bytes, bool reserved)
+{
+    QMutexLocker locker(&memoryMutex_);
+
+    memoryInUse_ -= bytes;
+
+    if(reserved == true)
+    {
+        memoryReserved_ -= bytes;
+    }
+
+    memoryCondition_.wakeAll();
+}
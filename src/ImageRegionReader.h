@@ -0,0 +1,113 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef IMAGE_REGION_READER_H
+#define IMAGE_REGION_READER_H
+
+// handlers that scale while decoding (JPEG) reduce each dimension by at most this factor
+#define IMAGE_REGION_READER_MAX_DECODE_SCALE 8
+
+#include <QtGui>
+#include <string>
+
+// reads regions of an image file at reduced resolution, without decoding the whole
+// image where the format allows it.
+//
+// formats whose Qt handler supports clip rectangles (JPEG) decode only the requested
+// region, scaling while decoding. other formats must be decoded whole to read any part
+// of them; for these readImage() decodes the whole image once, to be kept by the caller.
+//
+// all decoding, in all readers, is under a per-process memory cap: a read waits until
+// its estimated decode memory is available, and fails if it could never be.
+class ImageRegionReader {
+
+    public:
+
+        ImageRegionReader(std::string filename);
+        ~ImageRegionReader();
+
+        bool isValid();
+
+        int getWidth();
+        int getHeight();
+
+        // whether regions can be read without decoding the whole image
+        bool supportsRegions();
+
+        // estimated bytes needed to decode region scaled to scaledSize
+        qint64 getDecodeBytes(QRect region, QSize scaledSize);
+
+        // read region of the image scaled to scaledSize; thread-safe
+        bool read(QRect region, QSize scaledSize, QImage & image);
+
+        // read the whole image at full resolution. its memory stays reserved against the
+        // cap until the reader is destroyed
+        bool readImage(QImage & image);
+
+    private:
+
+        // not copyable
+        ImageRegionReader(const ImageRegionReader &);
+        ImageRegionReader & operator=(const ImageRegionReader &);
+
+        std::string filename_;
+
+        int width_;
+        int height_;
+
+        bool supportsClipRect_;
+        bool supportsScaledSize_;
+
+        // bytes reserved by readImage()
+        qint64 reservedBytes_;
+
+        // per-process memory cap, shared by all readers
+        static QMutex memoryMutex_;
+        static QWaitCondition memoryCondition_;
+        static qint64 memoryBudget_;
+        static qint64 memoryInUse_;
+
+        // memory held until readers are destroyed, included in memoryInUse_
+        static qint64 memoryReserved_;
+
+        // reserve: hold the memory until the reader is destroyed
+        static bool acquireMemory(qint64 bytes, bool reserve);
+        static void releaseMemory(qint64 bytes, bool reserved);
+};
+
+#endif
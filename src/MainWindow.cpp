@@ -43,6 +43,11 @@
 #include "log.h"
 #include "DisplayGroupGraphicsViewProxy.h"
 #include "DisplayGroupListWidgetProxy.h"
+#include "ImagePyramidBuilder.h"
+#include "DynamicTextureLoader.h"
+#include "FrameStatistics.h"
+#include <algorithm>
+#include <sstream>
 
 #if ENABLE_PYTHON_SUPPORT
     #include "PythonConsole.h"
@@ -56,6 +61,10 @@ MainWindow::MainWindow()
 {
     // defaults
     constrainAspectRatio_ = true;
+    imagePyramidProgressDialog_ = NULL;
+    frameTimeCount_ = 0;
+    frameTimeTotal_ = 0.;
+    frameTimeMax_ = 0;
 
     // make application quit when last window is closed
     QObject::connect(g_app, SIGNAL(lastWindowClosed()), g_app, SLOT(quit()));
@@ -115,6 +124,11 @@ MainWindow::MainWindow()
         computeImagePyramidAction->setStatusTip("Compute image pyramid");
         connect(computeImagePyramidAction, SIGNAL(triggered()), this, SLOT(computeImagePyramid()));
 
+        // save frame trace action
+        QAction * saveFrameTraceAction = new QAction("Save Frame Trace", this);
+        saveFrameTraceAction->setStatusTip("Save frame timing trace of the render processes");
+        connect(saveFrameTraceAction, SIGNAL(triggered()), this, SLOT(saveFrameTrace()));
+
 #if ENABLE_PYTHON_SUPPORT
         // Python console action
         QAction * pythonConsoleAction = new QAction("Open Python Console", this);
@@ -162,6 +176,20 @@ MainWindow::MainWindow()
         showZoomContextAction->setChecked(g_displayGroupManager->getOptions()->getShowZoomContext());
         connect(showZoomContextAction, SIGNAL(toggled(bool)), g_displayGroupManager->getOptions().get(), SLOT(setShowZoomContext(bool)));
 
+        // enable retained rendering action
+        QAction * enableRetainedRenderingAction = new QAction("Enable Retained Rendering", this);
+        enableRetainedRenderingAction->setStatusTip("Enable retained rendering");
+        enableRetainedRenderingAction->setCheckable(true);
+        enableRetainedRenderingAction->setChecked(g_displayGroupManager->getOptions()->getEnableRetainedRendering());
+        connect(enableRetainedRenderingAction, SIGNAL(toggled(bool)), g_displayGroupManager->getOptions().get(), SLOT(setEnableRetainedRendering(bool)));
+
+        // show frame statistics action
+        QAction * showFrameStatisticsAction = new QAction("Show Frame Statistics", this);
+        showFrameStatisticsAction->setStatusTip("Show frame times of the render processes on their tiles");
+        showFrameStatisticsAction->setCheckable(true);
+        showFrameStatisticsAction->setChecked(g_displayGroupManager->getOptions()->getShowFrameStatistics());
+        connect(showFrameStatisticsAction, SIGNAL(toggled(bool)), g_displayGroupManager->getOptions().get(), SLOT(setShowFrameStatistics(bool)));
+
         // enable streaming synchronization action
         QAction * enableStreamingSynchronizationAction = new QAction("Enable Streaming Synchronization", this);
         enableStreamingSynchronizationAction->setStatusTip("Enable streaming synchronization");
@@ -209,12 +237,15 @@ MainWindow::MainWindow()
         fileMenu->addAction(saveStateAction);
         fileMenu->addAction(loadStateAction);
         fileMenu->addAction(computeImagePyramidAction);
+        fileMenu->addAction(saveFrameTraceAction);
         fileMenu->addAction(quitAction);
         viewMenu->addAction(constrainAspectRatioAction);
         viewMenu->addAction(showWindowBordersAction);
         viewMenu->addAction(showTestPatternAction);
         viewMenu->addAction(enableMullionCompensationAction);
         viewMenu->addAction(showZoomContextAction);
+        viewMenu->addAction(enableRetainedRenderingAction);
+        viewMenu->addAction(showFrameStatisticsAction);
         viewStreamingMenu->addAction(enableStreamingSynchronizationAction);
         viewStreamingMenu->addAction(showStreamingSegmentsAction);
         viewStreamingMenu->addAction(showStreamingStatisticsAction);
@@ -261,6 +292,9 @@ MainWindow::MainWindow()
         // timer will trigger polling of ParallelPixelStreams
         connect(&parallelPixelStreamTimer_, SIGNAL(timeout()), g_displayGroupManager.get(), SLOT(sendParallelPixelStreams()));
 
+        // the same timer polls for frame statistics reports from the render processes
+        connect(&parallelPixelStreamTimer_, SIGNAL(timeout()), g_frameStatistics, SLOT(receiveReports()));
+
         // start the timer
         parallelPixelStreamTimer_.start(1000 / 30); // 30 fps
 
@@ -270,6 +304,7 @@ MainWindow::MainWindow()
     {
         // setup OpenGL windows
         // if we have just one tile for this process, make the GL window the central widget
+        // in single context mode, create one window spanning all tiles, rendering each to its own viewport
         // otherwise, create multiple windows
         if(g_configuration->getMyNumTiles() == 1)
         {
@@ -290,8 +325,36 @@ MainWindow::MainWindow()
                 show();
             }
         }
+        else if(g_configuration->getMySingleContext() == true && getTilesSingleWindowCompatible() == true)
+        {
+            std::vector<int> tileIndices;
+            QRect windowRect;
+
+            for(int i=0; i<g_configuration->getMyNumTiles(); i++)
+            {
+                tileIndices.push_back(i);
+                windowRect = windowRect.united(QRect(g_configuration->getTileX(i), g_configuration->getTileY(i), g_configuration->getScreenWidth(), g_configuration->getScreenHeight()));
+            }
+
+            boost::shared_ptr<GLWindow> glw(new GLWindow(tileIndices, windowRect));
+            glWindows_.push_back(glw);
+
+            // a full screen window would only cover one screen, so use a frameless window covering all tiles
+            if(g_configuration->getFullscreen() == true)
+            {
+                glw->setWindowFlags(Qt::FramelessWindowHint);
+                glw->setGeometry(windowRect);
+            }
+
+            glw->show();
+        }
         else
         {
+            if(g_configuration->getMySingleContext() == true)
+            {
+                put_flog(LOG_WARN, "tiles are not contiguous on one screen, using a window per tile instead of a single context");
+            }
+
             for(int i=0; i<g_configuration->getMyNumTiles(); i++)
             {
                 QRect windowRect = QRect(g_configuration->getTileX(i), g_configuration->getTileY(i), g_configuration->getScreenWidth(), g_configuration->getScreenHeight());
@@ -472,13 +535,62 @@ void MainWindow::computeImagePyramid()
 
         put_flog(LOG_DEBUG, "got image pyramid path %s", imagePyramidPath.c_str());
 
-        boost::shared_ptr<DynamicTexture> dt(new DynamicTexture(imageFilename.toStdString()));
-        dt->computeImagePyramid(imagePyramidPath);
+        ImagePyramidBuilder imagePyramidBuilder(imageFilename.toStdString(), imagePyramidPath, g_configuration->getDynamicTextureTileSize());
+
+        // show progress, and allow the build to be canceled
+        QProgressDialog progressDialog("Computing image pyramid...", "Cancel", 0, 1, this);
+        progressDialog.setWindowModality(Qt::WindowModal);
+        progressDialog.setMinimumDuration(0);
+
+        connect(&imagePyramidBuilder, SIGNAL(progress(int, int)), this, SLOT(imagePyramidProgress(int, int)));
+        connect(&progressDialog, SIGNAL(canceled()), &imagePyramidBuilder, SLOT(cancel()));
+
+        imagePyramidProgressDialog_ = &progressDialog;
+
+        bool success = imagePyramidBuilder.build();
+
+        imagePyramidProgressDialog_ = NULL;
+
+        if(success != true && progressDialog.wasCanceled() != true)
+        {
+            QMessageBox::warning(this, "Error", "Could not compute image pyramid.", QMessageBox::Ok, QMessageBox::Ok);
+        }
 
         put_flog(LOG_DEBUG, "done");
     }
 }
 
+void MainWindow::saveFrameTrace()
+{
+    QString filename = QFileDialog::getSaveFileName(this, "Save Frame Trace", "", "Trace files (*.json)");
+
+    if(!filename.isEmpty())
+    {
+        // make sure filename has .json extension
+        if(filename.endsWith(".json") != true)
+        {
+            put_flog(LOG_DEBUG, "appended .json filename extension");
+            filename.append(".json");
+        }
+
+        bool success = g_frameStatistics->saveTrace(filename.toStdString());
+
+        if(success != true)
+        {
+            QMessageBox::warning(this, "Error", "Could not save frame trace.", QMessageBox::Ok, QMessageBox::Ok);
+        }
+    }
+}
+
+void MainWindow::imagePyramidProgress(int numTiles, int totalTiles)
+{
+    if(imagePyramidProgressDialog_ != NULL)
+    {
+        imagePyramidProgressDialog_->setMaximum(totalTiles);
+        imagePyramidProgressDialog_->setValue(numTiles);
+    }
+}
+
 void MainWindow::constrainAspectRatio(bool set)
 {
     constrainAspectRatio_ = set;
@@ -513,6 +625,20 @@ void MainWindow::setEnableSkeletonTracking(bool enable)
 
 void MainWindow::updateGLWindows()
 {
+    // time since the last frame
+    if(frameTimer_.isNull() == true)
+    {
+        frameTimer_.start();
+    }
+    else
+    {
+        int frameTime = frameTimer_.restart();
+
+        frameTimeCount_++;
+        frameTimeTotal_ += (double)frameTime;
+        frameTimeMax_ = std::max(frameTimeMax_, frameTime);
+    }
+
     // receive any waiting messages
     g_displayGroupManager->receiveMessages();
 
@@ -527,43 +653,169 @@ void MainWindow::updateGLWindows()
         g_displayGroupManager->receiveFrameClockUpdate();
     }
 
-    // render all GLWindows
+    // time to barrier is measured from the synchronized clock update, so the collectives above don't count
+    qint64 frameClockTime = FrameStatistics::getTimestamp();
+
+    // start synchronizing parallel pixel streams; this overlaps with rendering
+    parallelPixelStreamSynchronizer_.start();
+
+    // textures uploaded to pixel buffers in the last frame are specified before they're drawn
+    if(glWindows_.size() > 0)
+    {
+        glWindows_[0]->makeCurrent();
+        glWindows_[0]->getPixelBufferUploader().update();
+    }
+
+    // render all GLWindows, flushing each window's commands behind a fence
     for(unsigned int i=0; i<glWindows_.size(); i++)
     {
         activeGLWindow_ = glWindows_[i];
         glWindows_[i]->updateGL();
+        glWindows_[i]->insertFrameFence();
     }
 
-    // all render processes render simultaneously
-    MPI_Barrier(g_mpiRenderComm);
+    // finish synchronizing parallel pixel streams, updating them for the next frame
+    parallelPixelStreamSynchronizer_.finish();
 
-    // swap buffers on all windows
-    for(unsigned int i=0; i<glWindows_.size(); i++)
+    // advance all contents while the GPU executes this frame's rendering, e.g. decoding the next movie frames
+    g_displayGroupManager->advanceContents();
+
+    // this process is ready to swap once the GPU has finished the frame
     {
-        glWindows_[i]->swapBuffers();
+        FrameStatisticsTimer timer(FRAME_PHASE_GPU);
+
+        for(unsigned int i=0; i<glWindows_.size(); i++)
+        {
+            glWindows_[i]->waitFrameFence();
+        }
     }
 
-    // advance all contents
-    g_displayGroupManager->advanceContents();
+    {
+        FrameStatisticsTimer timer(FRAME_PHASE_CLEANUP);
+
+        // clear old factory objects and purge any textures
+        if(glWindows_.size() > 0)
+        {
+            glWindows_[0]->getTextureFactory().clearStaleObjects();
+            glWindows_[0]->getDynamicTextureFactory().clearStaleObjects();
+            glWindows_[0]->getSVGFactory().clearStaleObjects();
+            glWindows_[0]->getMovieFactory().clearStaleObjects();
+            glWindows_[0]->getPixelStreamFactory().clearStaleObjects();
+
+            glWindows_[0]->purgeTextures();
+        }
+
+        // drop requests for tiles that weren't rendered in this frame
+        if(g_dynamicTextureLoader != NULL)
+        {
+            g_dynamicTextureLoader->prune(g_frameCount);
+        }
+    }
+
+    // all render processes swap simultaneously
+    // the barrier is only entered once this process can swap at once, so that no process swaps while another is still
+    // working on the frame. when it is nonblocking, the statistics logs, which nothing displayed depends on, are
+    // written while the other render processes catch up
+    g_frameStatistics->recordTimeToBarrier((double)(FrameStatistics::getTimestamp() - frameClockTime) / 1000.);
+
+#if MPI_VERSION >= 3
+    MPI_Request barrierRequest;
+    MPI_Ibarrier(g_mpiRenderComm, &barrierRequest);
+
+    logStatistics();
+#endif
 
-    // clear old factory objects and purge any textures
-    if(glWindows_.size() > 0)
     {
-        glWindows_[0]->getTextureFactory().clearStaleObjects();
-        glWindows_[0]->getDynamicTextureFactory().clearStaleObjects();
-        glWindows_[0]->getSVGFactory().clearStaleObjects();
-        glWindows_[0]->getMovieFactory().clearStaleObjects();
-        glWindows_[0]->getPixelStreamFactory().clearStaleObjects();
+        FrameStatisticsTimer timer(FRAME_PHASE_BARRIER);
 
-        glWindows_[0]->purgeTextures();
+#if MPI_VERSION >= 3
+        MPI_Wait(&barrierRequest, MPI_STATUS_IGNORE);
+#else
+        MPI_Barrier(g_mpiRenderComm);
+#endif
     }
 
+    // swap buffers on all windows
+    {
+        FrameStatisticsTimer timer(FRAME_PHASE_SWAP);
+
+        for(unsigned int i=0; i<glWindows_.size(); i++)
+        {
+            glWindows_[i]->swapBuffers();
+        }
+    }
+
+#if MPI_VERSION < 3
+    logStatistics();
+#endif
+
+    g_frameStatistics->update(g_frameCount);
+
     // increment frame counter
     g_frameCount = g_frameCount + 1;
 
     emit(updateGLWindowsFinished());
 }
 
+void MainWindow::logStatistics()
+{
+    if(glWindows_.size() > 0)
+    {
+        glWindows_[0]->getDynamicTextureCache().logStatistics(g_frameCount);
+
+        DynamicTexture::logTraversalStatistics(g_frameCount);
+
+        SVG::logStatistics(g_frameCount);
+
+        if(g_frameCount % DYNAMIC_TEXTURE_TRAVERSAL_STATISTICS_INTERVAL == 0 && frameTimeCount_ > 0)
+        {
+            // content windows rendered and culled over all GLWindows, in the last frame
+            int numVisible = 0;
+            int numCulled = 0;
+            int numTiles = 0;
+
+            for(unsigned int i=0; i<glWindows_.size(); i++)
+            {
+                numVisible += glWindows_[i]->getNumVisibleContentWindows();
+                numCulled += glWindows_[i]->getNumCulledContentWindows();
+                numTiles += glWindows_[i]->getNumTiles();
+            }
+
+            // the number of GLWindows for the tiles distinguishes single context from multiple window mode
+            put_flog(LOG_DEBUG, "frame time: mean %f ms, max %i ms (dynamic texture tile size %i, mipmaps %i, %i tiles in %i GLWindows)", frameTimeTotal_ / (double)frameTimeCount_, frameTimeMax_, g_configuration->getDynamicTextureTileSize(), g_configuration->getDynamicTextureMipmaps(), numTiles, (int)glWindows_.size());
+
+            put_flog(LOG_DEBUG, "content windows: %i visible, %i culled over %i GLWindows", numVisible, numCulled, (int)glWindows_.size());
+
+            // mean time per frame in each phase, over the last frame statistics report interval
+            std::ostringstream phases;
+
+            for(int i=0; i<FRAME_PHASE_COUNT; i++)
+            {
+                phases << (i > 0 ? ", " : "") << FrameStatistics::getPhaseName((FRAME_PHASE)i) << " " << g_frameStatistics->getPhaseTime((FRAME_PHASE)i) << " ms";
+            }
+
+            put_flog(LOG_DEBUG, "frame phases: %s", phases.str().c_str());
+
+            // factory lookups and shard lock contention of the first GLWindow, since the last report
+            put_flog(LOG_DEBUG, "texture factory: %s", glWindows_[0]->getTextureFactory().getStatistics().c_str());
+            put_flog(LOG_DEBUG, "dynamic texture factory: %s", glWindows_[0]->getDynamicTextureFactory().getStatistics().c_str());
+            put_flog(LOG_DEBUG, "SVG factory: %s", glWindows_[0]->getSVGFactory().getStatistics().c_str());
+            put_flog(LOG_DEBUG, "movie factory: %s", glWindows_[0]->getMovieFactory().getStatistics().c_str());
+            put_flog(LOG_DEBUG, "pixel stream factory: %s", glWindows_[0]->getPixelStreamFactory().getStatistics().c_str());
+            put_flog(LOG_DEBUG, "parallel pixel stream factory: %s", glWindows_[0]->getParallelPixelStreamFactory().getStatistics().c_str());
+
+            frameTimeCount_ = 0;
+            frameTimeTotal_ = 0.;
+            frameTimeMax_ = 0;
+        }
+    }
+
+    if(g_dynamicTextureLoader != NULL)
+    {
+        g_dynamicTextureLoader->logStatistics(g_frameCount);
+    }
+}
+
 void MainWindow::finalize()
 {
     for(unsigned int i=0; i<glWindows_.size(); i++)
@@ -571,3 +823,52 @@ void MainWindow::finalize()
         glWindows_[i]->finalize();
     }
 }
+
+bool MainWindow::getTilesSingleWindowCompatible()
+{
+    int numTiles = g_configuration->getMyNumTiles();
+
+    std::vector<QRect> tileRects;
+    QRect unionRect;
+
+    for(int i=0; i<numTiles; i++)
+    {
+        tileRects.push_back(QRect(g_configuration->getTileX(i), g_configuration->getTileY(i), g_configuration->getScreenWidth(), g_configuration->getScreenHeight()));
+        unionRect = unionRect.united(tileRects[i]);
+    }
+
+    // non-overlapping tiles with the area of their bounding rectangle cover it exactly
+    for(int i=0; i<numTiles; i++)
+    {
+        for(int j=i+1; j<numTiles; j++)
+        {
+            if(tileRects[i].intersects(tileRects[j]) == true)
+            {
+                return false;
+            }
+        }
+    }
+
+    if((qint64)unionRect.width() * (qint64)unionRect.height() != (qint64)numTiles * (qint64)g_configuration->getScreenWidth() * (qint64)g_configuration->getScreenHeight())
+    {
+        return false;
+    }
+
+    // a window can't span separate X screens, but can span the monitors of a virtual desktop (e.g. Xinerama)
+    QDesktopWidget * desktop = QApplication::desktop();
+
+    if(desktop->isVirtualDesktop() != true)
+    {
+        int screen = desktop->screenNumber(tileRects[0].center());
+
+        for(int i=1; i<numTiles; i++)
+        {
+            if(desktop->screenNumber(tileRects[i].center()) != screen)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
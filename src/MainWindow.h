@@ -44,6 +44,7 @@
 
 #include "config.h"
 #include "GLWindow.h"
+#include "ParallelPixelStreamSynchronizer.h"
 #include <QtGui>
 #include <QGLWidget>
 #include <boost/shared_ptr.hpp>
@@ -69,6 +70,8 @@ class MainWindow : public QMainWindow {
         void saveState();
         void loadState();
         void computeImagePyramid();
+        void saveFrameTrace();
+        void imagePyramidProgress(int numTiles, int totalTiles);
         void constrainAspectRatio(bool set);
 
 #if ENABLE_SKELETON_SUPPORT
@@ -95,8 +98,27 @@ class MainWindow : public QMainWindow {
 
         bool constrainAspectRatio_;
 
+        // progress dialog while computing an image pyramid
+        QProgressDialog * imagePyramidProgressDialog_;
+
         // polling timer for updating parallel pixel streams
         QTimer parallelPixelStreamTimer_;
+
+        // frame synchronization of parallel pixel streams (render processes only)
+        ParallelPixelStreamSynchronizer parallelPixelStreamSynchronizer_;
+
+        // time between frames in milliseconds (render processes only), logged with the DynamicTexture statistics
+        QTime frameTimer_;
+        long frameTimeCount_;
+        double frameTimeTotal_;
+        int frameTimeMax_;
+
+        // log the periodic render process statistics for this frame
+        void logStatistics();
+
+        // whether this process's tiles can be rendered by one window: the tiles must cover a rectangle
+        // without gaps or overlaps, on one X screen
+        bool getTilesSingleWindowCompatible();
 };
 
 #endif
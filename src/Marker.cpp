@@ -105,6 +105,15 @@ void Marker::render()
     float tiledDisplayAspect = (float)g_configuration->getTotalWidth() / (float)g_configuration->getTotalHeight();
     float markerHeight = markerWidth * tiledDisplayAspect;
 
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+
+    if(glWindow->getRetainedRendering() == true)
+    {
+        // blended, without depth testing
+        glWindow->getRenderList().addTexturedQuad(textureId_, QRectF(x_-markerWidth, y_-markerHeight, 2.*markerWidth, 2.*markerHeight), QRectF(0.,0.,1.,1.), true, false);
+        return;
+    }
+
     // draw the texture
     glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
 
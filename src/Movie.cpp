@@ -137,6 +137,11 @@ Movie::Movie(std::string uri)
     image.fill(0);
 
     textureId_ = g_mainWindow->getGLWindow()->bindTexture(image, GL_TEXTURE_2D, GL_RGBA, QGLContext::LinearFilteringBindOption);
+
+    // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated); bindTexture() leaves the texture bound
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
     textureBound_ = true;
 
     // allocate video frame for video decoding
@@ -200,6 +205,14 @@ void Movie::render(float tX, float tY, float tW, float tH)
         return;
     }
 
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+
+    if(glWindow->getRetainedRendering() == true)
+    {
+        glWindow->getRenderList().addTexturedQuad(textureId_, QRectF(0.,0.,1.,1.), QRectF(tX,tY,tW,tH));
+        return;
+    }
+
     // draw the texture
     glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
 
@@ -53,6 +53,11 @@ void MovieContent::getFactoryObjectDimensions(int &width, int &height)
     g_mainWindow->getGLWindow()->getMovieFactory().getObject(getURI())->getDimensions(width, height);
 }
 
+void MovieContent::touchFactoryObject()
+{
+    g_mainWindow->getGLWindow()->getMovieFactory().touchObject(getURI());
+}
+
 void MovieContent::advance(boost::shared_ptr<ContentWindowManager> window)
 {
     // skip a frame if the Content rectangle is not visible in ANY windows; otherwise decode normally
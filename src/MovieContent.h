@@ -51,6 +51,7 @@ class MovieContent : public Content {
         CONTENT_TYPE getType();
 
         void getFactoryObjectDimensions(int &width, int &height);
+        void touchFactoryObject();
 
     private:
         friend class boost::serialization::access;
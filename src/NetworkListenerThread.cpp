@@ -43,6 +43,7 @@
 #include "ParallelPixelStream.h"
 #include "SVGStreamSource.h"
 #include "ContentWindowManager.h"
+#include "StreamStatus.h"
 #include <stdint.h>
 
 NetworkListenerThread::NetworkListenerThread(int socketDescriptor)
@@ -178,11 +179,44 @@ void NetworkListenerThread::socketReceiveMessage()
         }
     }
 
+    // SVG patches are applied before they are acknowledged, so a rejection reaches the client before the acknowledgment
+    if(mh->type == MESSAGE_TYPE_SVG_STREAM_PATCH)
+    {
+        handleMessage(*mh, messageByteArray);
+    }
+
     // send acknowledgment
     MessageHeader mhAck;
     mhAck.size = 0;
     mhAck.type = MESSAGE_TYPE_ACK;
 
+    // parallel pixel stream acknowledgments include the stream status, so clients can adapt their rate
+    StreamStatus streamStatus;
+
+    if(mh->type == MESSAGE_TYPE_PARALLEL_PIXELSTREAM)
+    {
+        boost::shared_ptr<ParallelPixelStream> parallelPixelStreamSource = g_parallelPixelStreamSourceFactory.getObject(std::string(mh->uri));
+
+        // with the block-sender policy, hold back the acknowledgment while the stream is over its budget
+        bool timedOut = false;
+
+        if(parallelPixelStreamSource->getBufferPolicy() == STREAM_BUFFER_BLOCK_SENDER && parallelPixelStreamSource->waitForBufferSpace(PARALLEL_PIXEL_STREAM_BLOCK_SENDER_TIMEOUT) != true)
+        {
+            timedOut = true;
+        }
+
+        streamStatus = parallelPixelStreamSource->getStreamStatus();
+
+        if(timedOut == true)
+        {
+            put_flog(LOG_WARN, "timed out waiting for buffer space for stream %s", mh->uri);
+
+            streamStatus.throttle = 1;
+        }
+
+        mhAck.size = sizeof(StreamStatus);
+    }
+
     int sent = tcpSocket_->write((const char *)&mhAck, sizeof(MessageHeader));
 
     while(sent < (int)sizeof(MessageHeader))
@@ -190,6 +224,16 @@ void NetworkListenerThread::socketReceiveMessage()
         sent += tcpSocket_->write((const char *)&mhAck + sent, sizeof(MessageHeader) - sent);
     }
 
+    if(mhAck.size > 0)
+    {
+        sent = tcpSocket_->write((const char *)&streamStatus, sizeof(StreamStatus));
+
+        while(sent < (int)sizeof(StreamStatus))
+        {
+            sent += tcpSocket_->write((const char *)&streamStatus + sent, sizeof(StreamStatus) - sent);
+        }
+    }
+
     // we want the ack to be sent immediately
     tcpSocket_->flush();
 
@@ -199,7 +243,10 @@ void NetworkListenerThread::socketReceiveMessage()
     }
 
     // got the message
-    handleMessage(*mh, messageByteArray);
+    if(mh->type != MESSAGE_TYPE_SVG_STREAM_PATCH)
+    {
+        handleMessage(*mh, messageByteArray);
+    }
 }
 
 void NetworkListenerThread::setInteractionState(InteractionState interactionState)
@@ -258,9 +305,27 @@ void NetworkListenerThread::handleMessage(MessageHeader messageHeader, QByteArra
         // similar to pixel streaming above
         std::string uri(messageHeader.uri);
 
-        g_SVGStreamSourceFactory.getObject(uri)->setImageData(byteArray);
+        // identical image data is skipped
+        if(g_SVGStreamSourceFactory.getObject(uri)->setImageData(byteArray) == true)
+        {
+            emit(updatedSVGStreamSource());
+        }
+    }
+    else if(messageHeader.type == MESSAGE_TYPE_SVG_STREAM_PATCH)
+    {
+        // update SVG stream source with a change to its current image data
+        std::string uri(messageHeader.uri);
+
+        bool rejected = false;
 
-        emit(updatedSVGStreamSource());
+        if(g_SVGStreamSourceFactory.getObject(uri)->applyPatch(byteArray, rejected) == true)
+        {
+            emit(updatedSVGStreamSource());
+        }
+        else if(rejected == true)
+        {
+            sendSVGPatchRejected(uri);
+        }
     }
     else if(messageHeader.type == MESSAGE_TYPE_BIND_INTERACTION)
     {
@@ -329,3 +394,22 @@ void NetworkListenerThread::sendInteractionState()
         tcpSocket_->waitForBytesWritten();
     }
 }
+
+void NetworkListenerThread::sendSVGPatchRejected(std::string uri)
+{
+    MessageHeader mh;
+    mh.size = 0;
+    mh.type = MESSAGE_TYPE_SVG_STREAM_PATCH_REJECTED;
+
+    size_t len = uri.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
+    mh.uri[len] = '\0';
+
+    int sent = tcpSocket_->write((const char *)&mh, sizeof(MessageHeader));
+
+    while(sent < (int)sizeof(MessageHeader))
+    {
+        sent += tcpSocket_->write((const char *)&mh + sent, sizeof(MessageHeader) - sent);
+    }
+
+    // flushed along with the acknowledgment that follows
+}
@@ -91,6 +91,9 @@ class NetworkListenerThread : public QObject {
 
         bool bindInteraction();
         void sendInteractionState();
+
+        // tell the client an SVG patch didn't apply, so it sends the whole document
+        void sendSVGPatchRejected(std::string uri);
 };
 
 #endif
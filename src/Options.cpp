@@ -47,6 +47,8 @@ Options::Options()
     enableStreamingSynchronization_ = false;
     showStreamingSegments_ = false;
     showStreamingStatistics_ = false;
+    enableRetainedRendering_ = false;
+    showFrameStatistics_ = false;
 
 #if ENABLE_SKELETON_SUPPORT
     showSkeletons_ = true;
@@ -88,6 +90,16 @@ bool Options::getShowStreamingStatistics()
     return showStreamingStatistics_;
 }
 
+bool Options::getEnableRetainedRendering()
+{
+    return enableRetainedRendering_;
+}
+
+bool Options::getShowFrameStatistics()
+{
+    return showFrameStatistics_;
+}
+
 #if ENABLE_SKELETON_SUPPORT
 bool Options::getShowSkeletons()
 {
@@ -144,6 +156,20 @@ void Options::setShowStreamingStatistics(bool set)
     emit(updated());
 }
 
+void Options::setEnableRetainedRendering(bool set)
+{
+    enableRetainedRendering_ = set;
+
+    emit(updated());
+}
+
+void Options::setShowFrameStatistics(bool set)
+{
+    showFrameStatistics_ = set;
+
+    emit(updated());
+}
+
 #if ENABLE_SKELETON_SUPPORT
 void Options::setShowSkeletons(bool set)
 {
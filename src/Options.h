@@ -57,6 +57,8 @@ class Options : public QObject {
         bool getEnableStreamingSynchronization();
         bool getShowStreamingSegments();
         bool getShowStreamingStatistics();
+        bool getEnableRetainedRendering();
+        bool getShowFrameStatistics();
 
 #if ENABLE_SKELETON_SUPPORT
         bool getShowSkeletons();
@@ -70,6 +72,8 @@ class Options : public QObject {
         void setEnableStreamingSynchronization(bool set);
         void setShowStreamingSegments(bool set);
         void setShowStreamingStatistics(bool set);
+        void setEnableRetainedRendering(bool set);
+        void setShowFrameStatistics(bool set);
 
 #if ENABLE_SKELETON_SUPPORT
         void setShowSkeletons(bool set);
@@ -91,6 +95,8 @@ class Options : public QObject {
             ar & enableStreamingSynchronization_;
             ar & showStreamingSegments_;
             ar & showStreamingStatistics_;
+            ar & enableRetainedRendering_;
+            ar & showFrameStatistics_;
 
 #if ENABLE_SKELETON_SUPPORT
             ar & showSkeletons_;
@@ -104,6 +110,8 @@ class Options : public QObject {
         bool enableStreamingSynchronization_;
         bool showStreamingSegments_;
         bool showStreamingStatistics_;
+        bool enableRetainedRendering_;
+        bool showFrameStatistics_;
 
 #if ENABLE_SKELETON_SUPPORT
         bool showSkeletons_;
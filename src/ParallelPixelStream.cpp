@@ -40,23 +40,50 @@
 #include "main.h"
 #include "ContentWindowManager.h"
 #include "log.h"
+#include <algorithm>
 
 ParallelPixelStream::ParallelPixelStream(std::string uri)
 {
     // defaults
     width_ = 0;
     height_ = 0;
+    segmentConsumptionMode_ = SEGMENT_CONSUMPTION_ALL;
+    numSources_ = 0;
+    bufferBudget_ = STREAM_BUFFER_DEFAULT_BUDGET_MB * 1024 * 1024;
+    bufferPolicy_ = STREAM_BUFFER_DROP_OLDEST;
+    bufferedBytes_ = 0;
+    numDroppedSegments_ = 0;
+    numDroppedSegmentsLogged_ = 0;
+    renderBufferedBytes_ = 0;
+    renderSegmentBacklog_ = 0;
 
     // assign values
     uri_ = uri;
+
+    if(g_configuration != NULL)
+    {
+        bufferBudget_ = g_configuration->getStreamBufferBudget();
+        bufferPolicy_ = g_configuration->getStreamBufferPolicy();
+    }
 }
 
-void ParallelPixelStream::getDimensions(int &width, int &height)
+ParallelPixelStream::~ParallelPixelStream()
 {
-    QMutexLocker locker(&segmentsMutex_);
+    for(int i=0; i<PARALLEL_PIXEL_STREAM_MAX_SOURCES; i++)
+    {
+        delete segmentBuffers_[i].fetchAndStoreOrdered(NULL);
+    }
+}
 
-    width = width_;
-    height = height_;
+std::string ParallelPixelStream::getURI()
+{
+    return uri_;
+}
+
+void ParallelPixelStream::getDimensions(int &width, int &height)
+{
+    width = width_.fetchAndAddAcquire(0);
+    height = height_.fetchAndAddAcquire(0);
 }
 
 void ParallelPixelStream::render(float tX, float tY, float tW, float tH)
@@ -141,30 +168,50 @@ void ParallelPixelStream::render(float tX, float tY, float tW, float tH)
     clearStalePixelStreams();
 }
 
+void ParallelPixelStream::setSegmentConsumptionMode(SEGMENT_CONSUMPTION_MODE mode)
+{
+    segmentConsumptionMode_.fetchAndStoreRelease((int)mode);
+}
+
 void ParallelPixelStream::insertSegment(ParallelPixelStreamSegment segment)
 {
-    QMutexLocker locker(&segmentsMutex_);
+    int sourceIndex = segment.parameters.sourceIndex;
+
+    if(sourceIndex < 0 || sourceIndex >= PARALLEL_PIXEL_STREAM_MAX_SOURCES)
+    {
+        put_flog(LOG_ERROR, "invalid source index %i", sourceIndex);
+        return;
+    }
 
     // update total dimensions if we have non-blank parameters
     if(segment.parameters.totalWidth != 0 && segment.parameters.totalHeight != 0)
     {
-        width_ = segment.parameters.totalWidth;
-        height_ = segment.parameters.totalHeight;
+        width_.fetchAndStoreRelease(segment.parameters.totalWidth);
+        height_.fetchAndStoreRelease(segment.parameters.totalHeight);
     }
 
-    // update parameters
-    pixelStreamParameters_[segment.parameters.sourceIndex] = segment.parameters;
-
     // delete any blank segments
     // filter out segments that are not visible (only for rank != 0)
+    // on these processes segments are inserted and retrieved on the main thread
     if(g_mpiRank != 0)
     {
+        // update parameters
+        pixelStreamParameters_[sourceIndex] = segment.parameters;
+
         if(segment.parameters.totalWidth == 0 && segment.parameters.totalHeight == 0)
         {
             // this is a blank segment, clear out everything for its sourceIndex...
-            segments_.erase(segment.parameters.sourceIndex);
-            pixelStreams_.erase(segment.parameters.sourceIndex);
-            pixelStreamParameters_.erase(segment.parameters.sourceIndex);
+            ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(sourceIndex);
+
+            if(segmentBuffer != NULL)
+            {
+                takeOverflowSegments(segmentBuffer);
+                popSegments(segmentBuffer, segmentBuffer->segments.size());
+                delete takeLatestSegment(segmentBuffer);
+            }
+
+            pixelStreams_.erase(sourceIndex);
+            pixelStreamParameters_.erase(sourceIndex);
 
             // drop the segment
             return;
@@ -172,9 +219,13 @@ void ParallelPixelStream::insertSegment(ParallelPixelStreamSegment segment)
         else if(isSegmentVisible(segment.parameters) == false)
         {
             // clear any unprocessed segments for this source index
-            if(segments_.count(segment.parameters.sourceIndex) != 0)
+            ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(sourceIndex);
+
+            if(segmentBuffer != NULL)
             {
-                segments_.erase(segment.parameters.sourceIndex);
+                takeOverflowSegments(segmentBuffer);
+                popSegments(segmentBuffer, segmentBuffer->segments.size());
+                delete takeLatestSegment(segmentBuffer);
             }
 
             // drop the segment
@@ -182,161 +233,444 @@ void ParallelPixelStream::insertSegment(ParallelPixelStreamSegment segment)
         }
     }
 
-    segments_[(int)segment.parameters.sourceIndex].push_back(segment);
+    ParallelPixelStreamSegmentBuffer * segmentBuffer = getOrCreateSegmentBuffer(sourceIndex);
+
+    int segmentBytes = segment.imageData.size();
+
+    // with the drop-non-keyframe policy, segments are dropped here rather than by the consumer
+    bool keyframe = isKeyframe(segmentBuffer, segment.parameters);
+
+    segmentBuffer->lastParameters = segment.parameters;
+    segmentBuffer->hasLastParameters = true;
+
+    if(bufferPolicy_ == STREAM_BUFFER_DROP_NON_KEYFRAME && keyframe != true && bufferedBytes_.fetchAndAddAcquire(0) + segmentBytes > bufferBudget_)
+    {
+        numDroppedSegments_.fetchAndAddRelaxed(1);
+
+        return;
+    }
+
+    // count the bytes before the segment is visible to the consumer, so the counter can't go negative
+    bufferedBytes_.fetchAndAddOrdered(segmentBytes);
+
+    if(segmentConsumptionMode_.fetchAndAddAcquire(0) == SEGMENT_CONSUMPTION_LATEST)
+    {
+        // replace the latest segment; an older one not yet retrieved is discarded
+        ParallelPixelStreamSegment * oldSegment = segmentBuffer->latestSegment.fetchAndStoreOrdered(new ParallelPixelStreamSegment(segment));
+
+        if(oldSegment != NULL)
+        {
+            bufferedBytes_.fetchAndAddOrdered(-oldSegment->imageData.size());
+            delete oldSegment;
+        }
+    }
+    else if(segmentBuffer->overflowing.fetchAndAddAcquire(0) != 0 || segmentBuffer->segments.push(segment) != true)
+    {
+        // a full ring buffer counts as being over the budget. with the drop-non-keyframe policy the new segment
+        // is dropped unless it is a keyframe; otherwise the consumer drops the oldest segments to make room
+        if(bufferPolicy_ == STREAM_BUFFER_DROP_NON_KEYFRAME && keyframe != true)
+        {
+            bufferedBytes_.fetchAndAddOrdered(-segmentBytes);
+            numDroppedSegments_.fetchAndAddRelaxed(1);
+
+            return;
+        }
+
+        QMutexLocker locker(&segmentBuffer->overflowMutex);
+
+        // the consumer may have moved the overflowed segments into the ring buffer meanwhile
+        if(segmentBuffer->overflowing.fetchAndAddAcquire(0) != 0 || segmentBuffer->segments.push(segment) != true)
+        {
+            segmentBuffer->overflowSegments.push_back(segment);
+            segmentBuffer->overflowing.fetchAndStoreRelease(1);
+        }
+    }
 }
 
 std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopLatestSegments()
 {
-    QMutexLocker locker(&segmentsMutex_);
-
     std::vector<ParallelPixelStreamSegment> latestSegments;
 
-    for(std::map<int, std::vector<ParallelPixelStreamSegment> >::iterator it=segments_.begin(); it != segments_.end(); it++)
+    int numSources = numSources_.fetchAndAddAcquire(0);
+
+    for(int i=0; i<numSources; i++)
     {
-        if((*it).second.size() > 0)
+        ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(i);
+
+        if(segmentBuffer == NULL)
         {
-            latestSegments.push_back((*it).second.back());
+            continue;
         }
+
+        takeOverflowSegments(segmentBuffer);
+
+        // segments may have been queued before switching to the latest-only mode
+        // anything in the latest segment slot is newer
+        ParallelPixelStreamSegment * latestSegment = takeLatestSegment(segmentBuffer);
+
+        unsigned int size = segmentBuffer->segments.size();
+
+        if(latestSegment != NULL)
+        {
+            latestSegments.push_back(*latestSegment);
+            delete latestSegment;
+        }
+        else if(size > 0)
+        {
+            latestSegments.push_back(segmentBuffer->segments.peek(size - 1));
+        }
+
+        popSegments(segmentBuffer, size);
     }
 
-    // clear the map since we got all the latest segments
-    segments_.clear();
+    bufferSpaceAvailable();
 
     return latestSegments;
 }
 
 std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopAllSegments()
 {
-    QMutexLocker locker(&segmentsMutex_);
-
     std::vector<ParallelPixelStreamSegment> allSegments;
 
-    for(std::map<int, std::vector<ParallelPixelStreamSegment> >::iterator it=segments_.begin(); it != segments_.end(); it++)
+    int numSources = numSources_.fetchAndAddAcquire(0);
+
+    for(int i=0; i<numSources; i++)
     {
-        if((*it).second.size() > 0)
+        ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(i);
+
+        if(segmentBuffer == NULL)
         {
-            allSegments.insert(allSegments.end(), (*it).second.begin(), (*it).second.end());
+            continue;
         }
+
+        takeOverflowSegments(segmentBuffer);
+
+        // a segment may have been left in the latest segment slot before switching to
+        // the keep-all mode; it is older than anything in the ring buffer
+        ParallelPixelStreamSegment * latestSegment = takeLatestSegment(segmentBuffer);
+
+        if(latestSegment != NULL)
+        {
+            allSegments.push_back(*latestSegment);
+            delete latestSegment;
+        }
+
+        unsigned int size = segmentBuffer->segments.size();
+
+        for(unsigned int j=0; j<size; j++)
+        {
+            allSegments.push_back(segmentBuffer->segments.peek(j));
+        }
+
+        popSegments(segmentBuffer, size);
     }
 
-    // clear the map since we got all the segments
-    segments_.clear();
+    bufferSpaceAvailable();
 
     return allSegments;
 }
 
 std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopSegments(int frameIndex)
 {
-    QMutexLocker locker(&segmentsMutex_);
-
     std::vector<ParallelPixelStreamSegment> frameIndexSegments;
 
-    for(std::map<int, std::vector<ParallelPixelStreamSegment> >::iterator it=segments_.begin(); it != segments_.end(); it++)
+    int numSources = numSources_.fetchAndAddAcquire(0);
+
+    for(int i=0; i<numSources; i++)
     {
-        for(unsigned int i=0; i<(*it).second.size(); i++)
+        ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(i);
+
+        if(segmentBuffer == NULL)
         {
-            if((*it).second[i].parameters.frameIndex == frameIndex)
+            continue;
+        }
+
+        takeOverflowSegments(segmentBuffer);
+
+        unsigned int size = segmentBuffer->segments.size();
+
+        for(unsigned int j=0; j<size; j++)
+        {
+            if(segmentBuffer->segments.peek(j).parameters.frameIndex == frameIndex)
             {
-                frameIndexSegments.push_back((*it).second[i]);
+                frameIndexSegments.push_back(segmentBuffer->segments.peek(j));
 
-                // erase this segment and the earlier segments (i+1 segments will be erased)
-                (*it).second.erase((*it).second.begin(), (*it).second.begin() + i+1);
+                // pop this segment and the earlier segments (j+1 segments will be popped)
+                popSegments(segmentBuffer, j+1);
 
-                // continue to next source index in the map (breaking from this for loop)
+                // continue to next source index (breaking from this for loop)
                 break;
             }
         }
     }
 
+    bufferSpaceAvailable();
+
     return frameIndexSegments;
 }
 
-void ParallelPixelStream::updatePixelStreams()
+int ParallelPixelStream::getSegmentBacklog()
 {
-    // segments we want to process
-    std::vector<ParallelPixelStreamSegment> segments;
+    int segmentBacklog = 0;
 
-    // process differently depending on synchronization option
-    bool enableStreamingSynchronization = g_displayGroupManager->getOptions()->getEnableStreamingSynchronization();
+    int numSources = numSources_.fetchAndAddAcquire(0);
 
-    // make sure all of our segments have a valid frame index
-    // if this is not the case, then we can't have synchronization
-    if(enableStreamingSynchronization == true && getValidFrameIndices() != true)
+    for(int i=0; i<numSources; i++)
     {
-        enableStreamingSynchronization = false;
+        ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(i);
+
+        if(segmentBuffer != NULL)
+        {
+            segmentBacklog += segmentBuffer->segments.size();
+
+            if(segmentBuffer->latestSegment.fetchAndAddAcquire(0) != NULL)
+            {
+                segmentBacklog++;
+            }
+
+            if(segmentBuffer->overflowing.fetchAndAddAcquire(0) != 0)
+            {
+                QMutexLocker locker(&segmentBuffer->overflowMutex);
+
+                segmentBacklog += segmentBuffer->overflowSegments.size();
+            }
+        }
     }
 
-    if(enableStreamingSynchronization == true)
+    return segmentBacklog;
+}
+
+int ParallelPixelStream::getBufferedBytes()
+{
+    return bufferedBytes_.fetchAndAddAcquire(0);
+}
+
+int ParallelPixelStream::getNumDroppedSegments()
+{
+    return numDroppedSegments_.fetchAndAddAcquire(0);
+}
+
+STREAM_BUFFER_POLICY ParallelPixelStream::getBufferPolicy()
+{
+    return bufferPolicy_;
+}
+
+void ParallelPixelStream::enforceBufferBudget()
+{
+    int numSources = numSources_.fetchAndAddAcquire(0);
+
+    // overflowed segments are dropped, oldest first, under all policies
+    for(int i=0; i<numSources; i++)
     {
-        // determine if threads are running on any processes for this ParallelPixelStream
+        ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(i);
 
-        // first, for this local process
-        int localThreadsRunning = 0;
+        if(segmentBuffer != NULL)
+        {
+            takeOverflowSegments(segmentBuffer);
+        }
+    }
 
-        std::map<int, boost::shared_ptr<PixelStream> >::iterator it = pixelStreams_.begin();
+    // with drop-non-keyframe, segments are dropped on insertion. with block-sender, the sender
+    // is throttled instead, but only the master process has a sender
+    if(bufferPolicy_ != STREAM_BUFFER_DROP_NON_KEYFRAME && (bufferPolicy_ != STREAM_BUFFER_BLOCK_SENDER || g_mpiRank != 0))
+    {
+        int numDroppedSegments = 0;
 
-        while(it != pixelStreams_.end())
+        // drop the oldest segment of each source in turn, so sources stay consistent with each other
+        while(bufferedBytes_.fetchAndAddAcquire(0) > bufferBudget_)
         {
-            localThreadsRunning += (int)(*it).second->getLoadImageDataThreadRunning();
-            it++;
+            int numDroppedSegmentsPass = 0;
+
+            for(int i=0; i<numSources && bufferedBytes_.fetchAndAddAcquire(0) > bufferBudget_; i++)
+            {
+                ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(i);
+
+                if(segmentBuffer != NULL && segmentBuffer->segments.size() > 0)
+                {
+                    popSegments(segmentBuffer, 1);
+                    numDroppedSegmentsPass++;
+                }
+            }
+
+            if(numDroppedSegmentsPass == 0)
+            {
+                // only latest segments are left, nothing more to drop
+                break;
+            }
+
+            numDroppedSegments += numDroppedSegmentsPass;
         }
 
-        // now, globally for all render processes
-        int globalThreadsRunning;
+        numDroppedSegments_.fetchAndAddRelaxed(numDroppedSegments);
+    }
+
+    // log drops from all causes, at most every PARALLEL_PIXEL_STREAM_DROP_LOG_INTERVAL ms
+    int numDroppedSegments = numDroppedSegments_.fetchAndAddAcquire(0);
+
+    if(numDroppedSegments != numDroppedSegmentsLogged_ && (dropLogTime_.isNull() == true || dropLogTime_.elapsed() >= PARALLEL_PIXEL_STREAM_DROP_LOG_INTERVAL))
+    {
+        put_flog(LOG_WARN, "stream %s over buffer budget, dropped %i segments (%i total, %i buffered bytes)", uri_.c_str(), numDroppedSegments - numDroppedSegmentsLogged_, numDroppedSegments, getBufferedBytes());
+
+        numDroppedSegmentsLogged_ = numDroppedSegments;
+        dropLogTime_.start();
+    }
+}
+
+bool ParallelPixelStream::waitForBufferSpace(int timeout)
+{
+    if(bufferedBytes_.fetchAndAddAcquire(0) <= bufferBudget_)
+    {
+        return true;
+    }
+
+    QTime time;
+    time.start();
 
-        MPI_Allreduce((void *)&localThreadsRunning, (void *)&globalThreadsRunning, 1, MPI_INT, MPI_SUM, g_mpiRenderComm);
+    QMutexLocker locker(&bufferSpaceMutex_);
 
-        // do nothing if threads are still running
-        if(globalThreadsRunning > 0)
+    while(bufferedBytes_.fetchAndAddAcquire(0) > bufferBudget_)
+    {
+        int remaining = timeout - time.elapsed();
+
+        if(remaining <= 0)
         {
-            return;
+            return false;
         }
 
-        // if no threads are running, attempt to update textures (this will be synchronous across all streams!)
-        it = pixelStreams_.begin();
+        bufferSpaceCondition_.wait(&bufferSpaceMutex_, remaining);
+    }
+
+    return true;
+}
+
+void ParallelPixelStream::setRenderStatus(int bufferedBytes, int segmentBacklog)
+{
+    renderBufferedBytes_.fetchAndStoreRelease(bufferedBytes);
+    renderSegmentBacklog_.fetchAndStoreRelease(segmentBacklog);
+}
+
+StreamStatus ParallelPixelStream::getStreamStatus()
+{
+    StreamStatus streamStatus;
+
+    // in synchronized mode segments are buffered on the render processes rather than here
+    streamStatus.segmentBacklog = std::max(getSegmentBacklog(), renderSegmentBacklog_.fetchAndAddAcquire(0));
+    streamStatus.bufferedBytes = std::max(getBufferedBytes(), renderBufferedBytes_.fetchAndAddAcquire(0));
+    streamStatus.bufferBudget = bufferBudget_;
+
+    if((float)streamStatus.bufferedBytes > PARALLEL_PIXEL_STREAM_THROTTLE_FRACTION * (float)bufferBudget_)
+    {
+        streamStatus.throttle = 1;
+    }
+
+    return streamStatus;
+}
 
-        while(it != pixelStreams_.end())
+void ParallelPixelStream::updatePixelStreams()
+{
+    // synchronized streams are updated once per frame by the ParallelPixelStreamSynchronizer
+    if(getSynchronizationEnabled() == true)
+    {
+        return;
+    }
+
+    // synchronization disabled: process the latest segments
+    std::vector<ParallelPixelStreamSegment> segments = getAndPopLatestSegments();
+
+    for(unsigned int i=0; i<segments.size(); i++)
+    {
+        int sourceIndex = segments[i].parameters.sourceIndex;
+
+        if(pixelStreams_[sourceIndex] == NULL)
         {
-            (*it).second->updateTextureIfAvailable();
-            it++;
+            boost::shared_ptr<PixelStream> ps(new PixelStream("ParallelPixelStreamSegment"));
+            pixelStreams_[sourceIndex] = ps;
         }
 
-        // find the latest frame index we have locally for all visible parameters
+        // upload textures automatically since we're not synchronizing
+        pixelStreams_[sourceIndex]->setAutoUpdateTexture(true);
+
+        bool success = pixelStreams_[sourceIndex]->setImageData(segments[i].imageData, getSegmentArea(segments[i].parameters));
+
+        if(success == true)
+        {
+            frameUpdated(sourceIndex);
+        }
+    }
+}
 
-        // the visible source indices
-        std::vector<int> visibleSourceIndices = getSourceIndicesVisible();
+bool ParallelPixelStream::getSynchronizationEnabled()
+{
+    // make sure we have segments and all of them have a valid frame index
+    // if this is not the case, then we can't have synchronization
+    return g_displayGroupManager->getOptions()->getEnableStreamingSynchronization() == true && pixelStreamParameters_.size() > 0 && getValidFrameIndices() == true;
+}
 
-        // the latest frame index we have for all visible source indices
-        int latestFrameIndex = INT_MAX;
+void ParallelPixelStream::getSynchronizationState(bool & loadingImageData, int & latestFrameIndex)
+{
+    // determine if threads are running for this local process
+    loadingImageData = false;
 
-        for(unsigned int i=0; i<visibleSourceIndices.size(); i++)
+    for(std::map<int, boost::shared_ptr<PixelStream> >::iterator it=pixelStreams_.begin(); it != pixelStreams_.end(); it++)
+    {
+        if((*it).second->getLoadImageDataThreadRunning() == true)
         {
-            if(segments_.count(visibleSourceIndices[i]) == 0 || segments_[visibleSourceIndices[i]].size() == 0)
-            {
-                latestFrameIndex = -1;
-            }
-            else
-            {
-                latestFrameIndex = std::min(latestFrameIndex, segments_[visibleSourceIndices[i]].back().parameters.frameIndex);
-            }
+            loadingImageData = true;
+            break;
         }
+    }
+
+    // find the latest frame index we have locally for all visible parameters
+
+    // the visible source indices
+    std::vector<int> visibleSourceIndices = getSourceIndicesVisible();
 
-        // now, find the latest frame index for visible source indices across all nodes
-        int globalLatestFrameIndex;
+    // the latest frame index we have for all visible source indices
+    latestFrameIndex = INT_MAX;
+
+    for(unsigned int i=0; i<visibleSourceIndices.size(); i++)
+    {
+        ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(visibleSourceIndices[i]);
 
-        MPI_Allreduce((void *)&latestFrameIndex, (void *)&globalLatestFrameIndex, 1, MPI_INT, MPI_MIN, g_mpiRenderComm);
+        unsigned int size = 0;
 
-        if(globalLatestFrameIndex > 0 && globalLatestFrameIndex != INT_MAX)
+        if(segmentBuffer != NULL)
         {
-            segments = getAndPopSegments(globalLatestFrameIndex);
+            size = segmentBuffer->segments.size();
+        }
+
+        if(size == 0)
+        {
+            latestFrameIndex = -1;
+        }
+        else
+        {
+            latestFrameIndex = std::min(latestFrameIndex, segmentBuffer->segments.peek(size - 1).parameters.frameIndex);
         }
     }
-    else
+}
+
+void ParallelPixelStream::synchronize(bool globalLoadingImageData, int globalLatestFrameIndex)
+{
+    // do nothing if threads are still running on any process
+    if(globalLoadingImageData == true)
+    {
+        return;
+    }
+
+    // if no threads are running, attempt to update textures (this will be synchronous across all streams!)
+    for(std::map<int, boost::shared_ptr<PixelStream> >::iterator it=pixelStreams_.begin(); it != pixelStreams_.end(); it++)
     {
-        // synchronization disabled
-        segments = getAndPopLatestSegments();
+        (*it).second->updateTextureIfAvailable();
     }
 
+    if(globalLatestFrameIndex <= 0 || globalLatestFrameIndex == INT_MAX)
+    {
+        return;
+    }
+
+    std::vector<ParallelPixelStreamSegment> segments = getAndPopSegments(globalLatestFrameIndex);
+
     for(unsigned int i=0; i<segments.size(); i++)
     {
         int sourceIndex = segments[i].parameters.sourceIndex;
@@ -347,10 +681,10 @@ void ParallelPixelStream::updatePixelStreams()
             pixelStreams_[sourceIndex] = ps;
         }
 
-        // auto texture uploading depending on synchronous setting
-        pixelStreams_[sourceIndex]->setAutoUpdateTexture(!enableStreamingSynchronization);
+        // textures are uploaded in the next synchronize() call, once all processes have loaded their images
+        pixelStreams_[sourceIndex]->setAutoUpdateTexture(false);
 
-        bool success = pixelStreams_[sourceIndex]->setImageData(segments[i].imageData);
+        bool success = pixelStreams_[sourceIndex]->setImageData(segments[i].imageData, getSegmentArea(segments[i].parameters));
 
         if(success == true)
         {
@@ -359,6 +693,139 @@ void ParallelPixelStream::updatePixelStreams()
     }
 }
 
+ParallelPixelStreamSegmentBuffer * ParallelPixelStream::getOrCreateSegmentBuffer(int sourceIndex)
+{
+    ParallelPixelStreamSegmentBuffer * segmentBuffer = getSegmentBuffer(sourceIndex);
+
+    if(segmentBuffer != NULL)
+    {
+        return segmentBuffer;
+    }
+
+    // only the producer for this source index allocates its buffer, but use a
+    // compare-and-swap anyway in case of a misbehaving client
+    segmentBuffer = new ParallelPixelStreamSegmentBuffer();
+
+    if(segmentBuffers_[sourceIndex].testAndSetOrdered(NULL, segmentBuffer) != true)
+    {
+        delete segmentBuffer;
+        segmentBuffer = getSegmentBuffer(sourceIndex);
+    }
+
+    // raise the number of sources if needed
+    int numSources = numSources_.fetchAndAddAcquire(0);
+
+    while(numSources < sourceIndex + 1 && numSources_.testAndSetOrdered(numSources, sourceIndex + 1) != true)
+    {
+        numSources = numSources_.fetchAndAddAcquire(0);
+    }
+
+    return segmentBuffer;
+}
+
+ParallelPixelStreamSegmentBuffer * ParallelPixelStream::getSegmentBuffer(int sourceIndex)
+{
+    return segmentBuffers_[sourceIndex].fetchAndAddAcquire(0);
+}
+
+bool ParallelPixelStream::isKeyframe(ParallelPixelStreamSegmentBuffer * segmentBuffer, ParallelPixelStreamSegmentParameters parameters)
+{
+    // segments are independently compressed images, so the only segments that can't be
+    // dropped are the first of a source and those changing the layout of the stream
+    if(segmentBuffer->hasLastParameters != true)
+    {
+        return true;
+    }
+
+    ParallelPixelStreamSegmentParameters & last = segmentBuffer->lastParameters;
+
+    return parameters.x != last.x || parameters.y != last.y || parameters.width != last.width || parameters.height != last.height || parameters.totalWidth != last.totalWidth || parameters.totalHeight != last.totalHeight;
+}
+
+void ParallelPixelStream::popSegments(ParallelPixelStreamSegmentBuffer * segmentBuffer, unsigned int count)
+{
+    int bytes = 0;
+
+    for(unsigned int i=0; i<count; i++)
+    {
+        bytes += segmentBuffer->segments.peek(i).imageData.size();
+    }
+
+    segmentBuffer->segments.pop(count);
+
+    bufferedBytes_.fetchAndAddOrdered(-bytes);
+}
+
+void ParallelPixelStream::takeOverflowSegments(ParallelPixelStreamSegmentBuffer * segmentBuffer)
+{
+    if(segmentBuffer->overflowing.fetchAndAddAcquire(0) == 0)
+    {
+        return;
+    }
+
+    QMutexLocker locker(&segmentBuffer->overflowMutex);
+
+    std::deque<ParallelPixelStreamSegment> & overflowSegments = segmentBuffer->overflowSegments;
+
+    unsigned int capacity = segmentBuffer->segments.getCapacity();
+
+    int numDroppedSegments = 0;
+
+    // drop the oldest segments, overflowed ones first if they alone don't fit
+    while(overflowSegments.size() > capacity)
+    {
+        bufferedBytes_.fetchAndAddOrdered(-overflowSegments.front().imageData.size());
+        overflowSegments.pop_front();
+
+        numDroppedSegments++;
+    }
+
+    unsigned int size = segmentBuffer->segments.size();
+
+    if(size + overflowSegments.size() > capacity)
+    {
+        unsigned int count = size + overflowSegments.size() - capacity;
+
+        popSegments(segmentBuffer, count);
+
+        numDroppedSegments += count;
+    }
+
+    // the producer doesn't push while overflowing is set, so these fit
+    for(unsigned int i=0; i<overflowSegments.size(); i++)
+    {
+        segmentBuffer->segments.push(overflowSegments[i]);
+    }
+
+    overflowSegments.clear();
+
+    segmentBuffer->overflowing.fetchAndStoreRelease(0);
+
+    numDroppedSegments_.fetchAndAddRelaxed(numDroppedSegments);
+}
+
+ParallelPixelStreamSegment * ParallelPixelStream::takeLatestSegment(ParallelPixelStreamSegmentBuffer * segmentBuffer)
+{
+    ParallelPixelStreamSegment * latestSegment = segmentBuffer->latestSegment.fetchAndStoreOrdered(NULL);
+
+    if(latestSegment != NULL)
+    {
+        bufferedBytes_.fetchAndAddOrdered(-latestSegment->imageData.size());
+    }
+
+    return latestSegment;
+}
+
+void ParallelPixelStream::bufferSpaceAvailable()
+{
+    if(bufferPolicy_ == STREAM_BUFFER_BLOCK_SENDER)
+    {
+        QMutexLocker locker(&bufferSpaceMutex_);
+
+        bufferSpaceCondition_.wakeAll();
+    }
+}
+
 bool ParallelPixelStream::isSegmentVisible(ParallelPixelStreamSegmentParameters parameters)
 {
     boost::shared_ptr<ContentWindowManager> cwm = g_displayGroupManager->getContentWindowManager(uri_, CONTENT_TYPE_PARALLEL_PIXEL_STREAM);
@@ -400,6 +867,21 @@ bool ParallelPixelStream::isSegmentVisible(ParallelPixelStreamSegmentParameters
     }
 }
 
+float ParallelPixelStream::getSegmentArea(ParallelPixelStreamSegmentParameters parameters)
+{
+    boost::shared_ptr<ContentWindowManager> cwm = g_displayGroupManager->getContentWindowManager(uri_, CONTENT_TYPE_PARALLEL_PIXEL_STREAM);
+
+    if(cwm == NULL || parameters.totalWidth == 0 || parameters.totalHeight == 0)
+    {
+        return 1.;
+    }
+
+    double x, y, w, h;
+    cwm->getCoordinates(x, y, w, h);
+
+    return (float)((double)parameters.width / (double)parameters.totalWidth * w * (double)parameters.height / (double)parameters.totalHeight * h);
+}
+
 std::vector<int> ParallelPixelStream::getSourceIndicesVisible()
 {
     std::vector<int> sourceIndices;
@@ -481,6 +963,10 @@ std::string ParallelPixelStream::getStatistics(int sourceIndex)
         result += " fps";
     }
 
+    // memory counters for the entire stream
+    result += ", " + QString::number((float)getBufferedBytes() / (1024. * 1024.), 'f', 1) + " MB buffered";
+    result += ", " + QString::number(getNumDroppedSegments()) + " dropped";
+
     return result.toStdString();
 }
 
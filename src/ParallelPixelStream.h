@@ -40,9 +40,12 @@
 #define PARALLEL_PIXEL_STREAM_H
 
 #include "ParallelPixelStreamSegmentParameters.h"
+#include "Configuration.h"
+#include "StreamStatus.h"
 #include "FactoryObject.h"
 #include "PixelStream.h"
 #include "Factory.hpp"
+#include "RingBuffer.hpp"
 #include <QtGui>
 #include <boost/shared_ptr.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -52,6 +55,24 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
+
+// maximum number of segment sources (source indices 0 to PARALLEL_PIXEL_STREAM_MAX_SOURCES - 1)
+#define PARALLEL_PIXEL_STREAM_MAX_SOURCES 4096
+
+// number of segments buffered per source; a full buffer counts as being over the buffer budget
+#define PARALLEL_PIXEL_STREAM_SEGMENT_BUFFER_SIZE 64
+
+// minimum time (ms) between warnings about dropped segments
+#define PARALLEL_PIXEL_STREAM_DROP_LOG_INTERVAL 5000
+
+// fraction of the buffer budget above which clients are asked to throttle
+#define PARALLEL_PIXEL_STREAM_THROTTLE_FRACTION 0.5
+
+// maximum time (ms) an acknowledgment is held back with the block-sender buffer policy
+#define PARALLEL_PIXEL_STREAM_BLOCK_SENDER_TIMEOUT 1000
+
+enum SEGMENT_CONSUMPTION_MODE { SEGMENT_CONSUMPTION_LATEST, SEGMENT_CONSUMPTION_ALL };
 
 // define serialize method separately from ParallelPixelStreamSegmentParameters definition
 // so other (external) code can more easily include that header
@@ -111,52 +132,176 @@ struct ParallelPixelStreamSegment {
         BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
+// segments for a single source. the inserting thread is the only producer and
+// the thread retrieving segments the only consumer, so no locking is needed
+// unless the ring buffer overflows
+struct ParallelPixelStreamSegmentBuffer {
+
+    ParallelPixelStreamSegmentBuffer() : segments(PARALLEL_PIXEL_STREAM_SEGMENT_BUFFER_SIZE), hasLastParameters(false) { }
+
+    ~ParallelPixelStreamSegmentBuffer()
+    {
+        delete latestSegment.fetchAndStoreOrdered(NULL);
+    }
+
+    // all segments, in order (SEGMENT_CONSUMPTION_ALL)
+    RingBuffer<ParallelPixelStreamSegment> segments;
+
+    // only the latest segment; replaced on every insert (SEGMENT_CONSUMPTION_LATEST)
+    QAtomicPointer<ParallelPixelStreamSegment> latestSegment;
+
+    // segments that didn't fit in the ring buffer. the consumer drops the oldest segments to make room
+    // and moves these into it. while overflowing is set, segments are only pushed to the ring buffer
+    // with overflowMutex held, by either thread
+    QAtomicInt overflowing;
+    QMutex overflowMutex;
+    std::deque<ParallelPixelStreamSegment> overflowSegments;
+
+    // parameters of the last segment inserted (producer only)
+    bool hasLastParameters;
+    ParallelPixelStreamSegmentParameters lastParameters;
+};
+
 class ParallelPixelStream : public FactoryObject {
 
     public:
 
         ParallelPixelStream(std::string uri);
+        ~ParallelPixelStream();
+
+        std::string getURI();
 
         void getDimensions(int &width, int &height);
         void render(float tX, float tY, float tW, float tH);
 
+        // whether only the latest segment or all segments are kept for each source
+        // should be set by the consumer, consistently with the getAndPop*() method used
+        void setSegmentConsumptionMode(SEGMENT_CONSUMPTION_MODE mode);
+
+        // wait-free; for each source index only one thread may insert segments
         void insertSegment(ParallelPixelStreamSegment segment);
 
-        // retrieve latest segments and remove them (and older segments) from the map
+        // retrieve latest segments and remove them (and older segments) from the buffers
         std::vector<ParallelPixelStreamSegment> getAndPopLatestSegments();
 
-        // retrieve all segments and clear the map
+        // retrieve all segments and clear the buffers
         std::vector<ParallelPixelStreamSegment> getAndPopAllSegments();
 
-        // retrieve all segments for the given frame index and clear older entries in the map
+        // retrieve all segments for the given frame index and clear older entries in the buffers
         std::vector<ParallelPixelStreamSegment> getAndPopSegments(int frameIndex);
 
         // update pixel streams corresponding to latest segments
+        // if synchronization is enabled, updates are instead done through synchronize()
         void updatePixelStreams();
 
+        // whether or not this stream should be updated through synchronize(). this is
+        // consistent across all render processes
+        bool getSynchronizationEnabled();
+
+        // get the local state needed for frame synchronization: whether any segment
+        // images are still being loaded, and the latest frame index available for
+        // all visible segments (INT_MAX if none are visible, -1 if one is missing)
+        void getSynchronizationState(bool & loadingImageData, int & latestFrameIndex);
+
+        // update pixel streams given the synchronization state reduced over all
+        // render processes
+        void synchronize(bool globalLoadingImageData, int globalLatestFrameIndex);
+
+        // get the number of segments inserted but not yet retrieved
+        int getSegmentBacklog();
+
+        // memory counters
+        int getBufferedBytes();
+        int getNumDroppedSegments();
+
+        STREAM_BUFFER_POLICY getBufferPolicy();
+
+        // drop the oldest segments until the buffered bytes are within the budget, according
+        // to the buffer policy. this should be called by the thread retrieving segments.
+        // with the block-sender policy only rank 0 blocks the sender; the render processes
+        // drop the oldest segments, which only happens after their buffered bytes, reported
+        // to rank 0, have raised the throttle in the stream status
+        void enforceBufferBudget();
+
+        // wait until the buffered bytes are within the budget or timeout ms have passed.
+        // returns false on timeout
+        bool waitForBufferSpace(int timeout);
+
+        // on rank 0: the largest buffered bytes and segment backlog of this stream over the render processes
+        void setRenderStatus(int bufferedBytes, int segmentBacklog);
+
+        // status reported to the streaming client, including the render processes' buffers
+        StreamStatus getStreamStatus();
+
     private:
 
         // parallel pixel stream identifier
         std::string uri_;
 
         // dimensions of entire parallel pixel stream
-        int width_;
-        int height_;
+        QAtomicInt width_;
+        QAtomicInt height_;
+
+        // SEGMENT_CONSUMPTION_MODE
+        QAtomicInt segmentConsumptionMode_;
+
+        // buffer budget (bytes) and policy when exceeded
+        int bufferBudget_;
+        STREAM_BUFFER_POLICY bufferPolicy_;
+
+        // memory counters
+        QAtomicInt bufferedBytes_;
+        QAtomicInt numDroppedSegments_;
+
+        // on rank 0: largest buffered bytes and segment backlog over the render processes
+        QAtomicInt renderBufferedBytes_;
+        QAtomicInt renderSegmentBacklog_;
 
-        // segments mutex
-        QMutex segmentsMutex_;
+        // dropped segments already logged and when (consumer only), so drops are logged at most every
+        // PARALLEL_PIXEL_STREAM_DROP_LOG_INTERVAL ms
+        int numDroppedSegmentsLogged_;
+        QTime dropLogTime_;
 
-        // for each source, vector of pixel stream segments
-        // use a vector here since it may allow for easier frame synchronization later
-        std::map<int, std::vector<ParallelPixelStreamSegment> > segments_;
+        // used to wake threads waiting for buffer space (block-sender policy)
+        QMutex bufferSpaceMutex_;
+        QWaitCondition bufferSpaceCondition_;
+
+        // for each source index, segment buffer; allocated on first insert
+        QAtomicPointer<ParallelPixelStreamSegmentBuffer> segmentBuffers_[PARALLEL_PIXEL_STREAM_MAX_SOURCES];
+
+        // one more than the highest source index inserted
+        QAtomicInt numSources_;
+
+        // get the segment buffer for a source index, allocating it if needed (producer only)
+        ParallelPixelStreamSegmentBuffer * getOrCreateSegmentBuffer(int sourceIndex);
+
+        // get the segment buffer for a source index, or NULL if none exists
+        ParallelPixelStreamSegmentBuffer * getSegmentBuffer(int sourceIndex);
+
+        // whether a segment starts a new layout for its source and so can't be dropped (producer only)
+        bool isKeyframe(ParallelPixelStreamSegmentBuffer * segmentBuffer, ParallelPixelStreamSegmentParameters parameters);
+
+        // move overflowed segments into the ring buffer, dropping the oldest segments to make room (consumer only)
+        void takeOverflowSegments(ParallelPixelStreamSegmentBuffer * segmentBuffer);
+
+        // remove segments, updating the memory counters (consumer only)
+        void popSegments(ParallelPixelStreamSegmentBuffer * segmentBuffer, unsigned int count);
+        ParallelPixelStreamSegment * takeLatestSegment(ParallelPixelStreamSegmentBuffer * segmentBuffer);
+
+        // wake threads waiting for buffer space
+        void bufferSpaceAvailable();
 
         // for each source, pixel stream object for image decoding and parameters
+        // these are only used by the rendering processes, on the main thread
         std::map<int, boost::shared_ptr<PixelStream> > pixelStreams_;
         std::map<int, ParallelPixelStreamSegmentParameters> pixelStreamParameters_;
 
         // determine if segment is visible on any of the screens of this process
         bool isSegmentVisible(ParallelPixelStreamSegmentParameters parameters);
 
+        // get the area of a segment as a fraction of the display, used to prioritize decoding
+        float getSegmentArea(ParallelPixelStreamSegmentParameters parameters);
+
         // get vector of source indices visible on any of the screens of this process
         std::vector<int> getSourceIndicesVisible();
 
@@ -52,6 +52,13 @@ void ParallelPixelStreamContent::getFactoryObjectDimensions(int &width, int &hei
     g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(getURI())->getDimensions(width, height);
 }
 
+void ParallelPixelStreamContent::touchFactoryObject()
+{
+    // the stream is created even if its window is culled on this process, since the ParallelPixelStreamSynchronizer
+    // requires all processes to have the same streams
+    g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(getURI())->updateRenderedFrameCount();
+}
+
 void ParallelPixelStreamContent::renderFactoryObject(float tX, float tY, float tW, float tH)
 {
     g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(getURI())->render(tX, tY, tW, tH);
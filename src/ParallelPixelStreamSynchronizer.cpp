@@ -0,0 +1,339 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ParallelPixelStreamSynchronizer.h"
+#include "main.h"
+#include "log.h"
+#include <boost/functional/hash.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/string.hpp>
+#include <sstream>
+#include <algorithm>
+
+// layout of the reduction buffer. everything is reduced with MPI_MAX; minimums
+// are found by negating values
+//
+// header:
+// [0] number of streams, [1] negated number of streams
+// [2] hash of the stream URIs, [3] negated hash of the stream URIs
+// (so mismatched stream sets are detected)
+//
+// followed by PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS streams, unused ones zeroed:
+// [0] 1 if loading image data, otherwise 0
+// [1] negated latest frame index
+// [2] buffered bytes
+// [3] segment backlog
+
+#define SYNCHRONIZER_HEADER_SIZE 4
+#define SYNCHRONIZER_STREAM_SIZE 4
+#define SYNCHRONIZER_BUFFER_SIZE (SYNCHRONIZER_HEADER_SIZE + SYNCHRONIZER_STREAM_SIZE * PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS)
+
+ParallelPixelStreamSynchronizer::ParallelPixelStreamSynchronizer()
+{
+    // defaults
+    active_ = false;
+    request_ = MPI_REQUEST_NULL;
+    tooManyStreams_ = false;
+    sendingStatus_ = false;
+    statusHadStreams_ = false;
+
+    localBuffer_.resize(SYNCHRONIZER_BUFFER_SIZE);
+    globalBuffer_.resize(SYNCHRONIZER_BUFFER_SIZE);
+}
+
+ParallelPixelStreamSynchronizer::~ParallelPixelStreamSynchronizer()
+{
+    // the buffers must outlive any outstanding reduction
+    if(active_ == true)
+    {
+        MPI_Wait(&request_, MPI_STATUS_IGNORE);
+    }
+
+    // rank 0 may no longer be receiving
+    if(sendingStatus_ == true)
+    {
+        for(int i=0; i<2; i++)
+        {
+            MPI_Cancel(&statusRequests_[i]);
+            MPI_Wait(&statusRequests_[i], MPI_STATUS_IGNORE);
+        }
+    }
+}
+
+void ParallelPixelStreamSynchronizer::start()
+{
+    if(active_ == true)
+    {
+        put_flog(LOG_WARN, "previous synchronization not finished");
+
+        finish();
+    }
+
+    parallelPixelStreams_.clear();
+
+    // the factory snapshot is ordered by URI hash and then URI, so all processes have streams in the same order
+    FactorySnapshot<ParallelPixelStream> snapshot = g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getSnapshot();
+
+    // identifies the set of streams, so processes with different streams are detected
+    size_t uriHash = 0;
+
+    int numSynchronizedStreams = 0;
+
+    for(FactorySnapshot<ParallelPixelStream>::const_iterator it=snapshot.begin(); it != snapshot.end(); it++)
+    {
+        if((*it).second->getSynchronizationEnabled() == true)
+        {
+            numSynchronizedStreams++;
+
+            // all processes have the streams in the same order, so they all leave out the same ones
+            if(parallelPixelStreams_.size() < PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS)
+            {
+                parallelPixelStreams_.push_back((*it).second);
+
+                boost::hash_combine(uriHash, (*it).first);
+            }
+        }
+    }
+
+    if(numSynchronizedStreams > PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS && tooManyStreams_ != true)
+    {
+        put_flog(LOG_WARN, "%i synchronized streams, only synchronizing the first %i", numSynchronizedStreams, PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS);
+    }
+
+    tooManyStreams_ = (numSynchronizedStreams > PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS);
+
+    int numStreams = parallelPixelStreams_.size();
+
+    localBuffer_[0] = numStreams;
+    localBuffer_[1] = -numStreams;
+
+    // masked so the hash can be negated
+    localBuffer_[2] = (int)(uriHash & 0x7fffffff);
+    localBuffer_[3] = -localBuffer_[2];
+
+    std::fill(localBuffer_.begin() + SYNCHRONIZER_HEADER_SIZE, localBuffer_.end(), 0);
+
+    for(int i=0; i<numStreams; i++)
+    {
+        bool loadingImageData;
+        int latestFrameIndex;
+
+        parallelPixelStreams_[i]->getSynchronizationState(loadingImageData, latestFrameIndex);
+
+        int * state = &localBuffer_[SYNCHRONIZER_HEADER_SIZE + SYNCHRONIZER_STREAM_SIZE*i];
+
+        state[0] = (int)loadingImageData;
+        state[1] = -latestFrameIndex;
+        state[2] = parallelPixelStreams_[i]->getBufferedBytes();
+        state[3] = parallelPixelStreams_[i]->getSegmentBacklog();
+    }
+
+    // the buffer has the same size on all processes, so it can always be reduced
+    MPI_Iallreduce((void *)&localBuffer_[0], (void *)&globalBuffer_[0], SYNCHRONIZER_BUFFER_SIZE, MPI_INT, MPI_MAX, g_mpiRenderComm, &request_);
+
+    active_ = true;
+}
+
+void ParallelPixelStreamSynchronizer::finish()
+{
+    if(active_ != true)
+    {
+        return;
+    }
+
+    MPI_Wait(&request_, MPI_STATUS_IGNORE);
+
+    active_ = false;
+
+    // make sure all processes agreed on the set of streams; all processes see the same header, so they all skip
+    // the same frames
+    if(globalBuffer_[0] != -globalBuffer_[1] || globalBuffer_[2] != -globalBuffer_[3])
+    {
+        put_flog(LOG_WARN, "mismatched synchronized streams across processes, skipping synchronization");
+
+        parallelPixelStreams_.clear();
+        return;
+    }
+
+    for(unsigned int i=0; i<parallelPixelStreams_.size(); i++)
+    {
+        const int * state = &globalBuffer_[SYNCHRONIZER_HEADER_SIZE + SYNCHRONIZER_STREAM_SIZE*i];
+
+        bool globalLoadingImageData = (state[0] != 0);
+        int globalLatestFrameIndex = -state[1];
+
+        parallelPixelStreams_[i]->synchronize(globalLoadingImageData, globalLatestFrameIndex);
+    }
+
+    int renderRank;
+    MPI_Comm_rank(g_mpiRenderComm, &renderRank);
+
+    if(renderRank == 0)
+    {
+        sendStreamStatus();
+    }
+
+    parallelPixelStreams_.clear();
+}
+
+void ParallelPixelStreamSynchronizer::receiveStreamStatus()
+{
+    std::vector<std::string> uris;
+    std::vector<int> bufferedBytes;
+    std::vector<int> segmentBacklogs;
+
+    bool received = false;
+
+    // only the latest status matters
+    while(true)
+    {
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MPI_TAG, MPI_COMM_WORLD, &flag, &status);
+
+        if(flag == 0)
+        {
+            break;
+        }
+
+        int source = status.MPI_SOURCE;
+
+        MessageHeader mh;
+        MPI_Recv((void *)&mh, sizeof(MessageHeader), MPI_BYTE, source, PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MPI_TAG, MPI_COMM_WORLD, &status);
+
+        std::string buf(mh.size, '\0');
+        MPI_Recv((void *)buf.data(), mh.size, MPI_BYTE, source, PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MPI_TAG, MPI_COMM_WORLD, &status);
+
+        // de-serialize...
+        std::istringstream iss(buf, std::istringstream::binary);
+
+        {
+            boost::archive::binary_iarchive ia(iss);
+            ia >> uris;
+            ia >> bufferedBytes;
+            ia >> segmentBacklogs;
+        }
+
+        received = true;
+    }
+
+    if(received != true)
+    {
+        return;
+    }
+
+    // streams not in the status have nothing buffered on the render processes
+    FactorySnapshot<ParallelPixelStream> snapshot = g_parallelPixelStreamSourceFactory.getSnapshot();
+
+    for(FactorySnapshot<ParallelPixelStream>::const_iterator it=snapshot.begin(); it != snapshot.end(); it++)
+    {
+        std::vector<std::string>::iterator uri = std::find(uris.begin(), uris.end(), (*it).first);
+
+        if(uri != uris.end())
+        {
+            int i = uri - uris.begin();
+
+            (*it).second->setRenderStatus(bufferedBytes[i], segmentBacklogs[i]);
+        }
+        else
+        {
+            (*it).second->setRenderStatus(0, 0);
+        }
+    }
+}
+
+void ParallelPixelStreamSynchronizer::sendStreamStatus()
+{
+    // don't wait for rank 0; if it hasn't received the last status yet, skip this one
+    if(sendingStatus_ == true)
+    {
+        int done;
+        MPI_Testall(2, statusRequests_, &done, MPI_STATUSES_IGNORE);
+
+        if(done == 0)
+        {
+            return;
+        }
+
+        sendingStatus_ = false;
+    }
+
+    if(parallelPixelStreams_.size() == 0 && statusHadStreams_ != true)
+    {
+        return;
+    }
+
+    std::vector<std::string> uris;
+    std::vector<int> bufferedBytes;
+    std::vector<int> segmentBacklogs;
+
+    for(unsigned int i=0; i<parallelPixelStreams_.size(); i++)
+    {
+        const int * state = &globalBuffer_[SYNCHRONIZER_HEADER_SIZE + SYNCHRONIZER_STREAM_SIZE*i];
+
+        uris.push_back(parallelPixelStreams_[i]->getURI());
+        bufferedBytes.push_back(state[2]);
+        segmentBacklogs.push_back(state[3]);
+    }
+
+    statusHadStreams_ = (uris.size() > 0);
+
+    // serialize
+    std::ostringstream oss(std::ostringstream::binary);
+
+    // brace this so destructor is called on archive before we use the stream
+    {
+        boost::archive::binary_oarchive oa(oss);
+        oa << uris;
+        oa << bufferedBytes;
+        oa << segmentBacklogs;
+    }
+
+    statusBuffer_ = oss.str();
+
+    // send the header and the message
+    statusHeader_.size = statusBuffer_.size();
+    statusHeader_.type = MESSAGE_TYPE_PARALLEL_PIXELSTREAM_STATUS;
+
+    MPI_Isend((void *)&statusHeader_, sizeof(MessageHeader), MPI_BYTE, 0, PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MPI_TAG, MPI_COMM_WORLD, &statusRequests_[0]);
+    MPI_Isend((void *)statusBuffer_.data(), statusHeader_.size, MPI_BYTE, 0, PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MPI_TAG, MPI_COMM_WORLD, &statusRequests_[1]);
+
+    sendingStatus_ = true;
+}
@@ -0,0 +1,114 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef PARALLEL_PIXEL_STREAM_SYNCHRONIZER_H
+#define PARALLEL_PIXEL_STREAM_SYNCHRONIZER_H
+
+#include "ParallelPixelStream.h"
+#include "MessageHeader.h"
+#include <boost/shared_ptr.hpp>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+// maximum number of streams synchronized per frame; the reduction buffer is sized
+// for this many, so it is the same size on all processes
+#define PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS 256
+
+// tag of the stream status messages sent to rank 0
+#define PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MPI_TAG 2
+
+// frame synchronization for all synchronized parallel pixel streams. start() is
+// called before rendering and finish() after. a fixed-size buffer, holding a header
+// identifying the streams followed by the state of each stream, is reduced over the
+// render processes with a single nonblocking collective that overlaps with
+// rendering. if the processes turn out to have different streams, that frame's
+// synchronization is skipped.
+//
+// the reduction also finds the largest buffered bytes and segment backlog of each
+// stream over the render processes. the first render process sends these to rank
+// 0, which reports them to the streaming clients, since in synchronized mode rank
+// 0 forwards all segments every tick and doesn't buffer them itself.
+
+class ParallelPixelStreamSynchronizer {
+
+    public:
+
+        ParallelPixelStreamSynchronizer();
+        ~ParallelPixelStreamSynchronizer();
+
+        // gather the local state of all synchronized streams and start the reduction
+        void start();
+
+        // complete the reduction and update the synchronized streams
+        void finish();
+
+        // on rank 0: apply the latest stream status received from the render processes, without blocking
+        static void receiveStreamStatus();
+
+    private:
+
+        // true if a reduction has been started and not yet finished
+        bool active_;
+
+        MPI_Request request_;
+
+        // the streams included in the current reduction, in the same order on all processes
+        std::vector<boost::shared_ptr<ParallelPixelStream> > parallelPixelStreams_;
+
+        // reduction buffers; these must remain valid until the reduction completes
+        std::vector<int> localBuffer_;
+        std::vector<int> globalBuffer_;
+
+        // whether there were more streams than PARALLEL_PIXEL_STREAM_SYNCHRONIZER_MAX_STREAMS, so this is only logged once
+        bool tooManyStreams_;
+
+        // stream status message to rank 0; these must remain valid until the sends complete
+        MessageHeader statusHeader_;
+        std::string statusBuffer_;
+        MPI_Request statusRequests_[2];
+        bool sendingStatus_;
+
+        // whether the last stream status sent had any streams, so empty ones are only sent once
+        bool statusHadStreams_;
+
+        // send the reduced stream status to rank 0, unless the last one hasn't been received yet
+        void sendStreamStatus();
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "PixelBufferUploader.h"
+#include "main.h"
+#include "log.h"
+
+PixelBufferUploader::PixelBufferUploader()
+{
+    // defaults
+    nextBuffer_ = 0;
+    numPending_ = 0;
+    initialized_ = false;
+}
+
+PixelBufferUploader::~PixelBufferUploader()
+{
+
+}
+
+bool PixelBufferUploader::canUpload()
+{
+    if(initialized_ != true)
+    {
+        initialize();
+    }
+
+    // direct uploads
+    if(buffers_.size() == 0)
+    {
+        return true;
+    }
+
+    PixelBufferUploaderBuffer & buffer = buffers_[nextBuffer_];
+
+    return buffer.pending != true && buffer.frameCount < g_frameCount - 1;
+}
+
+void PixelBufferUploader::upload(GLuint textureId, const QImage & image)
+{
+    int numBytes = image.byteCount();
+
+    void * data = NULL;
+
+    if(buffers_.size() > 0)
+    {
+        PixelBufferUploaderBuffer & buffer = buffers_[nextBuffer_];
+
+        buffer.buffer.bind();
+
+        // buffers keep their storage while images are the same size, e.g. SVG tiles
+        if(buffer.numBytes != numBytes)
+        {
+            buffer.buffer.allocate(numBytes);
+            buffer.numBytes = numBytes;
+        }
+
+        data = buffer.buffer.map(QGLBuffer::WriteOnly);
+
+        if(data != NULL)
+        {
+            memcpy(data, image.constBits(), numBytes);
+            buffer.buffer.unmap();
+
+            buffer.pending = true;
+            buffer.textureId = textureId;
+            buffer.width = image.width();
+            buffer.height = image.height();
+            buffer.frameCount = g_frameCount;
+
+            numPending_++;
+
+            nextBuffer_ = (nextBuffer_ + 1) % (int)buffers_.size();
+        }
+
+        buffer.buffer.release();
+    }
+
+    if(data == NULL)
+    {
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+    }
+}
+
+bool PixelBufferUploader::isPending(GLuint textureId)
+{
+    if(numPending_ == 0)
+    {
+        return false;
+    }
+
+    for(unsigned int i=0; i<buffers_.size(); i++)
+    {
+        if(buffers_[i].pending == true && buffers_[i].textureId == textureId)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void PixelBufferUploader::cancel(GLuint textureId)
+{
+    for(unsigned int i=0; i<buffers_.size() && numPending_ > 0; i++)
+    {
+        if(buffers_[i].pending == true && buffers_[i].textureId == textureId)
+        {
+            buffers_[i].pending = false;
+            numPending_--;
+        }
+    }
+}
+
+void PixelBufferUploader::update()
+{
+    for(unsigned int i=0; i<buffers_.size() && numPending_ > 0; i++)
+    {
+        PixelBufferUploaderBuffer & buffer = buffers_[i];
+
+        if(buffer.pending != true || buffer.frameCount >= g_frameCount)
+        {
+            continue;
+        }
+
+        // the data pointer is an offset into the bound buffer
+        buffer.buffer.bind();
+
+        glBindTexture(GL_TEXTURE_2D, buffer.textureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, buffer.width, buffer.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+        buffer.buffer.release();
+
+        buffer.pending = false;
+        numPending_--;
+    }
+}
+
+void PixelBufferUploader::clear()
+{
+    for(unsigned int i=0; i<buffers_.size(); i++)
+    {
+        buffers_[i].buffer.destroy();
+    }
+
+    buffers_.clear();
+    nextBuffer_ = 0;
+    numPending_ = 0;
+    initialized_ = false;
+}
+
+void PixelBufferUploader::initialize()
+{
+    initialized_ = true;
+
+    for(int i=0; i<PIXEL_BUFFER_UPLOADER_RING_SIZE; i++)
+    {
+        PixelBufferUploaderBuffer buffer;
+        buffer.buffer.setUsagePattern(QGLBuffer::StreamDraw);
+
+        if(buffer.buffer.create() != true)
+        {
+            put_flog(LOG_INFO, "pixel buffer objects not supported, uploading textures directly");
+
+            clear();
+            initialized_ = true;
+
+            return;
+        }
+
+        buffers_.push_back(buffer);
+    }
+}
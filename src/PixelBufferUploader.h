@@ -0,0 +1,111 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef PIXEL_BUFFER_UPLOADER_H
+#define PIXEL_BUFFER_UPLOADER_H
+
+// number of pixel buffers in the ring; each is refilled at most every other frame
+#define PIXEL_BUFFER_UPLOADER_RING_SIZE 16
+
+#include <QtGui>
+#include <QGLWidget>
+#include <QGLBuffer>
+#include <vector>
+
+struct PixelBufferUploaderBuffer {
+
+    PixelBufferUploaderBuffer() : buffer(QGLBuffer::PixelUnpackBuffer), numBytes(0), pending(false), textureId(0), width(0), height(0), frameCount(-2) { }
+
+    QGLBuffer buffer;
+    int numBytes;
+
+    // texture waiting to be specified from the buffer
+    bool pending;
+    GLuint textureId;
+    int width;
+    int height;
+
+    // frame the buffer was last filled in
+    long frameCount;
+};
+
+// uploads images to textures through a persistent ring of pixel unpack buffers, so the
+// driver can transfer images to the GPU asynchronously. an image is copied into a buffer
+// when it is uploaded, and the texture is specified from the buffer at the start of the
+// next frame; a buffer isn't refilled until the frame after that, so mapping it doesn't
+// wait for the transfer. without pixel buffer object support, images are uploaded directly.
+//
+// used by Texture and SVG. must be called in the OpenGL thread.
+class PixelBufferUploader {
+
+    public:
+
+        PixelBufferUploader();
+        ~PixelBufferUploader();
+
+        // whether a buffer is free for an upload in this frame
+        bool canUpload();
+
+        // upload an image in OpenGL format to the level 0 of the texture; the texture's parameters are
+        // set by the caller. requires canUpload(). the texture can be drawn once isPending() is false
+        void upload(GLuint textureId, const QImage & image);
+
+        bool isPending(GLuint textureId);
+
+        // drop a pending upload, before the texture is deleted
+        void cancel(GLuint textureId);
+
+        // specify the textures of the images uploaded in previous frames; called once per frame before rendering
+        void update();
+
+        // delete the buffers
+        void clear();
+
+    private:
+
+        std::vector<PixelBufferUploaderBuffer> buffers_;
+        int nextBuffer_;
+        int numPending_;
+
+        // whether buffers were created, or pixel buffer objects aren't supported
+        bool initialized_;
+
+        void initialize();
+};
+
+#endif
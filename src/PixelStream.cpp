@@ -37,6 +37,7 @@
 /*********************************************************************/
 
 #include "PixelStream.h"
+#include "PixelStreamDecoderPool.h"
 #include "main.h"
 #include "log.h"
 
@@ -49,12 +50,12 @@ PixelStream::PixelStream(std::string uri)
     textureBound_ = false;
     imageReady_ = false;
     autoUpdateTexture_ = true;
+    decodeState_ = DECODE_IDLE;
+    hasPendingImageData_ = false;
+    pendingPriority_ = 0.;
 
     // assign values
     uri_ = uri;
-
-    // initialize libjpeg-turbo handle
-    handle_ = tjInitDecompress();
 }
 
 PixelStream::~PixelStream()
@@ -67,9 +68,6 @@ PixelStream::~PixelStream()
 
         textureBound_ = false;
     }
-
-    // destroy libjpeg-turbo handle
-    tjDestroy(handle_);
 }
 
 void PixelStream::getDimensions(int &width, int &height)
@@ -93,6 +91,14 @@ bool PixelStream::render(float tX, float tY, float tW, float tH)
         return false;
     }
 
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+
+    if(glWindow->getRetainedRendering() == true)
+    {
+        glWindow->getRenderList().addTexturedQuad(textureId_, QRectF(0.,0.,1.,1.), QRectF(tX,tY,tW,tH));
+        return true;
+    }
+
     // draw the texture
     glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
 
@@ -124,22 +130,27 @@ bool PixelStream::render(float tX, float tY, float tW, float tH)
     return true;
 }
 
-bool PixelStream::setImageData(QByteArray imageData)
+bool PixelStream::setImageData(QByteArray imageData, float priority)
 {
-    // drop frames if we're currently processing
-    if(loadImageDataThread_.isRunning() == true)
+    if(g_pixelStreamDecoderPool == NULL)
     {
+        put_flog(LOG_ERROR, "no decoder pool");
         return false;
     }
 
-    loadImageDataThread_ = QtConcurrent::run(loadImageDataThread, shared_from_this(), imageData);
+    g_pixelStreamDecoderPool->decode(shared_from_this(), imageData, priority);
 
     return true;
 }
 
 bool PixelStream::getLoadImageDataThreadRunning()
 {
-    return loadImageDataThread_.isRunning();
+    if(g_pixelStreamDecoderPool == NULL)
+    {
+        return false;
+    }
+
+    return g_pixelStreamDecoderPool->isDecoding(this);
 }
 
 void PixelStream::setAutoUpdateTexture(bool set)
@@ -159,11 +170,6 @@ void PixelStream::updateTextureIfAvailable()
     }
 }
 
-tjhandle PixelStream::getHandle()
-{
-    return handle_;
-}
-
 void PixelStream::imageReady(QImage image)
 {
     QMutexLocker locker(&imageReadyMutex_);
@@ -179,6 +185,11 @@ void PixelStream::updateTexture(QImage & image)
     {
         // want mipmaps disabled
         textureId_ = g_mainWindow->getGLWindow()->bindTexture(image, GL_TEXTURE_2D, GL_RGBA, QGLContext::LinearFilteringBindOption);
+
+        // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated); bindTexture() leaves the texture bound
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
         textureWidth_ = image.width();
         textureHeight_ = image.height();
         textureBound_ = true;
@@ -197,6 +208,11 @@ void PixelStream::updateTexture(QImage & image)
             g_mainWindow->getGLWindow()->deleteTexture(textureId_);
 
             textureId_ = g_mainWindow->getGLWindow()->bindTexture(image, GL_TEXTURE_2D, GL_RGBA, QGLContext::LinearFilteringBindOption);
+
+            // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated); bindTexture() leaves the texture bound
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
             textureWidth_ = image.width();
             textureHeight_ = image.height();
         }
@@ -207,36 +223,3 @@ void PixelStream::updateTexture(QImage & image)
         }
     }
 }
-
-void loadImageDataThread(boost::shared_ptr<PixelStream> pixelStream, QByteArray imageData)
-{
-    // use libjpeg-turbo for JPEG conversion
-    tjhandle handle = pixelStream->getHandle();
-
-    // get information from header
-    int width, height, jpegSubsamp;
-    int success =  tjDecompressHeader2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), &width, &height, &jpegSubsamp);
-
-    if(success != 0)
-    {
-        put_flog(LOG_ERROR, "libjpeg-turbo header decompression failure");
-        return;
-    }
-
-    // decompress image data
-    int pixelFormat = TJPF_BGRX;
-    int pitch = width * tjPixelSize[pixelFormat];
-    int flags = TJ_FASTUPSAMPLE;
-
-    QImage image = QImage(width, height, QImage::Format_RGB32);
-
-    success = tjDecompress2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), (unsigned char *)image.scanLine(0), width, pitch, height, pixelFormat, flags);
-
-    if(success != 0)
-    {
-        put_flog(LOG_ERROR, "libjpeg-turbo image decompression failure");
-        return;
-    }
-
-    pixelStream->imageReady(image);
-}
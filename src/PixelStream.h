@@ -42,8 +42,8 @@
 #include "FactoryObject.h"
 #include <boost/enable_shared_from_this.hpp>
 #include <QGLWidget>
-#include <QtConcurrentRun>
-#include <turbojpeg.h>
+
+enum PIXEL_STREAM_DECODE_STATE { DECODE_IDLE, DECODE_QUEUED, DECODE_RUNNING };
 
 class PixelStream : public boost::enable_shared_from_this<PixelStream>, public FactoryObject {
 
@@ -54,13 +54,17 @@ class PixelStream : public boost::enable_shared_from_this<PixelStream>, public F
 
         void getDimensions(int &width, int &height);
         bool render(float tX, float tY, float tW, float tH); // return true on successful render; false if no texture available
-        bool setImageData(QByteArray imageData); // returns true if load image thread was spawned; false if frame was dropped
+        // decode the image data in the decoder pool, replacing any image data still waiting to be decoded
+        // priority is the on-screen area of the image as a fraction of the display
+        // returns true if the image data was queued for decoding
+        bool setImageData(QByteArray imageData, float priority=1.);
+
+        // whether image data is being decoded or waiting to be decoded
         bool getLoadImageDataThreadRunning();
         void setAutoUpdateTexture(bool set);
         void updateTextureIfAvailable();
 
-        // for use by loadImageDataThread()
-        tjhandle getHandle();
+        // for use by PixelStreamDecoderPool
         void imageReady(QImage image);
 
     private:
@@ -74,11 +78,15 @@ class PixelStream : public boost::enable_shared_from_this<PixelStream>, public F
         int textureHeight_;
         bool textureBound_;
 
-        // thread for generating images from image data
-        QFuture<void> loadImageDataThread_;
+        // decoding state and image data waiting to be decoded, with its priority and age
+        // these are managed by the decoder pool, protected by its mutex
+        friend class PixelStreamDecoderPool;
 
-        // libjpeg-turbo handle for decompression
-        tjhandle handle_;
+        PIXEL_STREAM_DECODE_STATE decodeState_;
+        bool hasPendingImageData_;
+        QByteArray pendingImageData_;
+        float pendingPriority_;
+        QTime pendingTime_;
 
         // image, mutex, and ready status
         QMutex imageReadyMutex_;
@@ -92,6 +100,4 @@ class PixelStream : public boost::enable_shared_from_this<PixelStream>, public F
         void updateTexture(QImage & image);
 };
 
-extern void loadImageDataThread(boost::shared_ptr<PixelStream> pixelStream, QByteArray imageData);
-
 #endif
@@ -52,6 +52,11 @@ void PixelStreamContent::getFactoryObjectDimensions(int &width, int &height)
     g_mainWindow->getGLWindow()->getPixelStreamFactory().getObject(getURI())->getDimensions(width, height);
 }
 
+void PixelStreamContent::touchFactoryObject()
+{
+    g_mainWindow->getGLWindow()->getPixelStreamFactory().touchObject(getURI());
+}
+
 void PixelStreamContent::renderFactoryObject(float tX, float tY, float tW, float tH)
 {
     g_mainWindow->getGLWindow()->getPixelStreamFactory().getObject(getURI())->render(tX, tY, tW, tH);
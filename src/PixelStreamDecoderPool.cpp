@@ -0,0 +1,361 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "PixelStreamDecoderPool.h"
+#include "PixelStream.h"
+#include "main.h"
+#include "log.h"
+#include <turbojpeg.h>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+PixelStreamDecoderThread::PixelStreamDecoderThread(PixelStreamDecoderPool * pool)
+{
+    pool_ = pool;
+}
+
+void PixelStreamDecoderThread::run()
+{
+    pool_->runThread();
+}
+
+PixelStreamDecoderPool::PixelStreamDecoderPool()
+{
+    // defaults
+    stopping_ = false;
+    numDecoded_ = 0;
+    numSuperseded_ = 0;
+    numBatches_ = 0;
+
+    // by default, leave half of the cores for the global thread pool
+    int numThreads = std::max(QThread::idealThreadCount() / 2, 1);
+
+    if(g_configuration != NULL)
+    {
+        if(g_configuration->getDecoderThreads() > 0)
+        {
+            numThreads = g_configuration->getDecoderThreads();
+        }
+
+        cpus_ = g_configuration->getDecoderCpus();
+    }
+
+    put_flog(LOG_INFO, "starting %i pixel stream decoder threads", numThreads);
+
+    for(int i=0; i<numThreads; i++)
+    {
+        PixelStreamDecoderThread * thread = new PixelStreamDecoderThread(this);
+        thread->start();
+
+        threads_.push_back(thread);
+    }
+}
+
+PixelStreamDecoderPool::~PixelStreamDecoderPool()
+{
+    {
+        QMutexLocker locker(&mutex_);
+
+        stopping_ = true;
+        condition_.wakeAll();
+    }
+
+    for(unsigned int i=0; i<threads_.size(); i++)
+    {
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+
+    put_flog(LOG_DEBUG, "decoded %li images in %li batches, %li images superseded", numDecoded_, numBatches_, numSuperseded_);
+}
+
+void PixelStreamDecoderPool::decode(boost::shared_ptr<PixelStream> pixelStream, QByteArray imageData, float priority)
+{
+    QMutexLocker locker(&mutex_);
+
+    // a waiting image is replaced by the newer one
+    if(pixelStream->hasPendingImageData_ == true)
+    {
+        numSuperseded_++;
+    }
+    else
+    {
+        // the age is that of the oldest image waiting
+        pixelStream->pendingTime_.start();
+    }
+
+    pixelStream->pendingImageData_ = imageData;
+    pixelStream->pendingPriority_ = priority;
+    pixelStream->hasPendingImageData_ = true;
+
+    // if an image is being decoded, the waiting image is queued when it's done
+    if(pixelStream->decodeState_ == DECODE_IDLE)
+    {
+        pixelStream->decodeState_ = DECODE_QUEUED;
+        queue_.push_back(pixelStream);
+
+        condition_.wakeOne();
+    }
+}
+
+bool PixelStreamDecoderPool::isDecoding(PixelStream * pixelStream)
+{
+    QMutexLocker locker(&mutex_);
+
+    return pixelStream->decodeState_ != DECODE_IDLE;
+}
+
+long PixelStreamDecoderPool::getNumDecoded()
+{
+    QMutexLocker locker(&mutex_);
+
+    return numDecoded_;
+}
+
+long PixelStreamDecoderPool::getNumSuperseded()
+{
+    QMutexLocker locker(&mutex_);
+
+    return numSuperseded_;
+}
+
+long PixelStreamDecoderPool::getNumBatches()
+{
+    QMutexLocker locker(&mutex_);
+
+    return numBatches_;
+}
+
+// decode JPEG imageData into image, returning true on success
+static bool decodeImage(tjhandle handle, QByteArray & imageData, QImage & image)
+{
+    // get information from header
+    int width, height, jpegSubsamp;
+    int success = tjDecompressHeader2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), &width, &height, &jpegSubsamp);
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo header decompression failure");
+        return false;
+    }
+
+    // decompress image data
+    int pixelFormat = TJPF_BGRX;
+    int pitch = width * tjPixelSize[pixelFormat];
+    int flags = TJ_FASTUPSAMPLE;
+
+    image = QImage(width, height, QImage::Format_RGB32);
+
+    success = tjDecompress2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), (unsigned char *)image.scanLine(0), width, pitch, height, pixelFormat, flags);
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo image decompression failure");
+        return false;
+    }
+
+    return true;
+}
+
+void PixelStreamDecoderPool::runThread()
+{
+    setAffinity();
+
+    // each thread has its own libjpeg-turbo handle
+    tjhandle handle = tjInitDecompress();
+
+    QMutexLocker locker(&mutex_);
+
+    while(true)
+    {
+        while(queue_.size() == 0 && stopping_ != true)
+        {
+            condition_.wait(&mutex_);
+        }
+
+        if(stopping_ == true)
+        {
+            break;
+        }
+
+        std::vector<boost::shared_ptr<PixelStream> > batch = getBatch();
+        std::vector<QByteArray> batchImageData;
+
+        for(unsigned int i=0; i<batch.size(); i++)
+        {
+            batchImageData.push_back(batch[i]->pendingImageData_);
+
+            batch[i]->pendingImageData_ = QByteArray();
+            batch[i]->hasPendingImageData_ = false;
+            batch[i]->decodeState_ = DECODE_RUNNING;
+        }
+
+        numBatches_++;
+
+        // decode without holding the lock
+        locker.unlock();
+
+        for(unsigned int i=0; i<batch.size(); i++)
+        {
+            QImage image;
+
+            if(decodeImage(handle, batchImageData[i], image) == true)
+            {
+                batch[i]->imageReady(image);
+            }
+        }
+
+        locker.relock();
+
+        numDecoded_ += batch.size();
+
+        // queue any images that arrived while decoding
+        for(unsigned int i=0; i<batch.size(); i++)
+        {
+            if(batch[i]->hasPendingImageData_ == true)
+            {
+                batch[i]->decodeState_ = DECODE_QUEUED;
+                queue_.push_back(batch[i]);
+
+                condition_.wakeOne();
+            }
+            else
+            {
+                batch[i]->decodeState_ = DECODE_IDLE;
+            }
+        }
+    }
+
+    locker.unlock();
+
+    tjDestroy(handle);
+}
+
+std::vector<boost::shared_ptr<PixelStream> > PixelStreamDecoderPool::getBatch()
+{
+    // score each waiting image by its on-screen area and age
+    std::vector<std::pair<float, int> > scores;
+
+    for(unsigned int i=0; i<queue_.size(); i++)
+    {
+        float age = (float)queue_[i]->pendingTime_.elapsed() / PIXEL_STREAM_DECODER_AGE_INTERVAL;
+        float score = queue_[i]->pendingPriority_ * pow(2.f, std::min(age, 32.f));
+
+        scores.push_back(std::pair<float, int>(score, i));
+    }
+
+    // highest scores first
+    std::sort(scores.begin(), scores.end());
+    std::reverse(scores.begin(), scores.end());
+
+    std::vector<boost::shared_ptr<PixelStream> > batch;
+    std::vector<bool> taken(queue_.size(), false);
+
+    // the highest priority image, followed by other small images if it is small
+    int batchBytes = 0;
+
+    for(unsigned int i=0; i<scores.size(); i++)
+    {
+        int index = scores[i].second;
+        int bytes = queue_[index]->pendingImageData_.size();
+
+        if(i > 0 && (bytes >= PIXEL_STREAM_DECODER_SMALL_IMAGE_BYTES || batchBytes + bytes > PIXEL_STREAM_DECODER_MAX_BATCH_BYTES))
+        {
+            continue;
+        }
+
+        batch.push_back(queue_[index]);
+        taken[index] = true;
+        batchBytes += bytes;
+
+        if(bytes >= PIXEL_STREAM_DECODER_SMALL_IMAGE_BYTES || (int)batch.size() >= PIXEL_STREAM_DECODER_MAX_BATCH_SIZE)
+        {
+            break;
+        }
+    }
+
+    // remove the batch from the queue
+    std::vector<boost::shared_ptr<PixelStream> > queue;
+
+    for(unsigned int i=0; i<queue_.size(); i++)
+    {
+        if(taken[i] != true)
+        {
+            queue.push_back(queue_[i]);
+        }
+    }
+
+    queue_ = queue;
+
+    return batch;
+}
+
+void PixelStreamDecoderPool::setAffinity()
+{
+    if(cpus_.size() == 0)
+    {
+        return;
+    }
+
+#ifdef __linux__
+    // keeping the decoder threads on the CPUs of one NUMA node (e.g. the one attached to
+    // the GPU) keeps the decoded images in that node's memory
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+
+    for(unsigned int i=0; i<cpus_.size(); i++)
+    {
+        if(cpus_[i] < CPU_SETSIZE)
+        {
+            CPU_SET(cpus_[i], &cpuSet);
+        }
+    }
+
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0)
+    {
+        put_flog(LOG_WARN, "could not set decoder thread CPU affinity");
+    }
+#else
+    put_flog(LOG_WARN, "decoder thread CPU affinity not supported on this platform");
+#endif
+}
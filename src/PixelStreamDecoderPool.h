@@ -0,0 +1,129 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef PIXEL_STREAM_DECODER_POOL_H
+#define PIXEL_STREAM_DECODER_POOL_H
+
+// images with less compressed data than this are batched with other small images
+#define PIXEL_STREAM_DECODER_SMALL_IMAGE_BYTES (64 * 1024)
+
+// limits on the size of a batch
+#define PIXEL_STREAM_DECODER_MAX_BATCH_BYTES (256 * 1024)
+#define PIXEL_STREAM_DECODER_MAX_BATCH_SIZE 8
+
+// a waiting image's priority is doubled for each interval (ms) it has waited
+#define PIXEL_STREAM_DECODER_AGE_INTERVAL 33.
+
+#include <QtGui>
+#include <QThread>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+class PixelStream;
+class PixelStreamDecoderPool;
+
+class PixelStreamDecoderThread : public QThread {
+
+    public:
+
+        PixelStreamDecoderThread(PixelStreamDecoderPool * pool);
+
+    protected:
+
+        void run();
+
+    private:
+
+        PixelStreamDecoderPool * pool_;
+};
+
+// decodes pixel stream images on a dedicated set of threads, separate from the
+// global QThreadPool used for other content. each pixel stream has at most one
+// image being decoded and one waiting; a newer image replaces the waiting one.
+// waiting images are decoded in order of their on-screen area and age, and small
+// images are decoded in batches to reduce per-task overhead.
+class PixelStreamDecoderPool {
+
+    public:
+
+        // threads and cpus are taken from the configuration
+        PixelStreamDecoderPool();
+        ~PixelStreamDecoderPool();
+
+        // decode imageData for pixelStream; priority is the on-screen area of the
+        // image as a fraction of the display
+        void decode(boost::shared_ptr<PixelStream> pixelStream, QByteArray imageData, float priority);
+
+        // whether an image is being decoded or waiting to be decoded for pixelStream
+        bool isDecoding(PixelStream * pixelStream);
+
+        // statistics
+        long getNumDecoded();
+        long getNumSuperseded();
+        long getNumBatches();
+
+        // for use by PixelStreamDecoderThread
+        void runThread();
+
+    private:
+
+        QMutex mutex_;
+        QWaitCondition condition_;
+
+        bool stopping_;
+
+        std::vector<PixelStreamDecoderThread *> threads_;
+
+        // CPUs the threads are restricted to
+        std::vector<int> cpus_;
+
+        // pixel streams with an image waiting to be decoded
+        std::vector<boost::shared_ptr<PixelStream> > queue_;
+
+        long numDecoded_;
+        long numSuperseded_;
+        long numBatches_;
+
+        // remove the next batch from the queue; called with mutex_ locked
+        std::vector<boost::shared_ptr<PixelStream> > getBatch();
+
+        // restrict the calling thread to cpus_
+        void setAffinity();
+};
+
+#endif
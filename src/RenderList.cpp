@@ -0,0 +1,470 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "RenderList.h"
+#include "log.h"
+#include <algorithm>
+
+static const char * vertexShaderSource =
+    "uniform mat4 projection;\n"
+    "attribute vec3 vertex;\n"
+    "attribute vec2 texCoord;\n"
+    "attribute vec4 color;\n"
+    "varying vec2 texCoordVarying;\n"
+    "varying vec4 colorVarying;\n"
+    "void main()\n"
+    "{\n"
+    "    texCoordVarying = texCoord;\n"
+    "    colorVarying = color;\n"
+    "    gl_Position = projection * vec4(vertex, 1.);\n"
+    "}\n";
+
+// textured primitives are modulated by their color, as with the default texture environment
+static const char * fragmentShaderSource =
+    "uniform sampler2D texture;\n"
+    "uniform bool textured;\n"
+    "varying vec2 texCoordVarying;\n"
+    "varying vec4 colorVarying;\n"
+    "void main()\n"
+    "{\n"
+    "    if(textured)\n"
+    "        gl_FragColor = colorVarying * texture2D(texture, texCoordVarying);\n"
+    "    else\n"
+    "        gl_FragColor = colorVarying;\n"
+    "}\n";
+
+// floats per vertex: x, y, z, s, t, r, g, b, a
+#define RENDER_LIST_VERTEX_SIZE 9
+
+RenderListState::RenderListState()
+{
+    // defaults
+    primitive = GL_TRIANGLES;
+    textureId = 0;
+    lineWidth = 1.;
+    blend = false;
+    depthTest = true;
+    depthWrite = true;
+}
+
+bool RenderListState::operator<(const RenderListState & state) const
+{
+    if(textureId != state.textureId)
+    {
+        return textureId < state.textureId;
+    }
+
+    if(primitive != state.primitive)
+    {
+        return primitive < state.primitive;
+    }
+
+    if(lineWidth != state.lineWidth)
+    {
+        return lineWidth < state.lineWidth;
+    }
+
+    if(blend != state.blend)
+    {
+        return blend < state.blend;
+    }
+
+    if(depthTest != state.depthTest)
+    {
+        return depthTest < state.depthTest;
+    }
+
+    return depthWrite < state.depthWrite;
+}
+
+bool RenderListState::operator==(const RenderListState & state) const
+{
+    return (textureId == state.textureId && primitive == state.primitive && lineWidth == state.lineWidth && blend == state.blend && depthTest == state.depthTest && depthWrite == state.depthWrite);
+}
+
+RenderList::RenderList() : vertexBuffer_(QGLBuffer::VertexBuffer)
+{
+    // defaults
+    numDrawCalls_ = 0;
+    numVertices_ = 0;
+    initialized_ = false;
+    shaderValid_ = false;
+
+    vertexBuffer_.setUsagePattern(QGLBuffer::StreamDraw);
+
+    clear();
+}
+
+RenderList::~RenderList()
+{
+
+}
+
+void RenderList::setTransform(const QRectF & rect, double depth)
+{
+    transform_ = rect;
+    depth_ = depth;
+}
+
+void RenderList::setColor(float r, float g, float b, float a)
+{
+    color_[0] = r;
+    color_[1] = g;
+    color_[2] = b;
+    color_[3] = a;
+}
+
+void RenderList::addQuad(const QRectF & rect, bool blend, bool depthWrite)
+{
+    RenderListState state;
+    state.blend = blend;
+    state.depthWrite = depthWrite;
+
+    double z;
+    std::vector<GLfloat> & vertices = getVertices(state, z);
+
+    QPointF p0 = map(rect.left(), rect.top());
+    QPointF p1 = map(rect.right(), rect.top());
+    QPointF p2 = map(rect.right(), rect.bottom());
+    QPointF p3 = map(rect.left(), rect.bottom());
+
+    // split as GL_QUADS are: (0,1,2), (0,2,3)
+    appendVertex(vertices, p0.x(), p0.y(), z, 0., 0., color_);
+    appendVertex(vertices, p1.x(), p1.y(), z, 0., 0., color_);
+    appendVertex(vertices, p2.x(), p2.y(), z, 0., 0., color_);
+
+    appendVertex(vertices, p0.x(), p0.y(), z, 0., 0., color_);
+    appendVertex(vertices, p2.x(), p2.y(), z, 0., 0., color_);
+    appendVertex(vertices, p3.x(), p3.y(), z, 0., 0., color_);
+}
+
+void RenderList::addTexturedQuad(GLuint textureId, const QRectF & rect, const QRectF & textureRect, bool blend, bool depthTest)
+{
+    RenderListState state;
+    state.textureId = textureId;
+    state.blend = blend;
+    state.depthTest = depthTest;
+
+    double z;
+    std::vector<GLfloat> & vertices = getVertices(state, z);
+
+    // textures are drawn unmodulated
+    static const GLfloat white[4] = { 1., 1., 1., 1. };
+
+    QPointF p0 = map(rect.left(), rect.top());
+    QPointF p1 = map(rect.right(), rect.top());
+    QPointF p2 = map(rect.right(), rect.bottom());
+    QPointF p3 = map(rect.left(), rect.bottom());
+
+    double s0 = textureRect.x();
+    double s1 = textureRect.x() + textureRect.width();
+    double t0 = textureRect.y();
+    double t1 = textureRect.y() + textureRect.height();
+
+    appendVertex(vertices, p0.x(), p0.y(), z, s0, t0, white);
+    appendVertex(vertices, p1.x(), p1.y(), z, s1, t0, white);
+    appendVertex(vertices, p2.x(), p2.y(), z, s1, t1, white);
+
+    appendVertex(vertices, p0.x(), p0.y(), z, s0, t0, white);
+    appendVertex(vertices, p2.x(), p2.y(), z, s1, t1, white);
+    appendVertex(vertices, p3.x(), p3.y(), z, s0, t1, white);
+}
+
+void RenderList::addLineLoop(const QRectF & rect, float lineWidth)
+{
+    QPointF p0(rect.left(), rect.top());
+    QPointF p1(rect.right(), rect.top());
+    QPointF p2(rect.right(), rect.bottom());
+    QPointF p3(rect.left(), rect.bottom());
+
+    addLine(p0, p1, lineWidth);
+    addLine(p1, p2, lineWidth);
+    addLine(p2, p3, lineWidth);
+    addLine(p3, p0, lineWidth);
+}
+
+void RenderList::addLine(const QPointF & p1, const QPointF & p2, float lineWidth)
+{
+    RenderListState state;
+    state.primitive = GL_LINES;
+    state.lineWidth = lineWidth;
+
+    double z;
+    std::vector<GLfloat> & vertices = getVertices(state, z);
+
+    QPointF q1 = map(p1.x(), p1.y());
+    QPointF q2 = map(p2.x(), p2.y());
+
+    appendVertex(vertices, q1.x(), q1.y(), z, 0., 0., color_);
+    appendVertex(vertices, q2.x(), q2.y(), z, 0., 0., color_);
+}
+
+void RenderList::draw(double left, double right, double bottom, double top)
+{
+    numDrawCalls_ = 0;
+    numVertices_ = 0;
+
+    if(opaqueBatches_.size() == 0 && blendedBatches_.size() == 0)
+    {
+        return;
+    }
+
+    if(initialized_ != true)
+    {
+        initialize();
+    }
+
+    if(shaderValid_ != true)
+    {
+        return;
+    }
+
+    // gather all vertices into one buffer: opaque batches by state, then blended batches in order
+    std::vector<RenderListState> states;
+    std::vector<int> firsts;
+    std::vector<int> counts;
+
+    std::vector<GLfloat> vertices;
+
+    for(std::map<RenderListState, std::vector<GLfloat> >::iterator it=opaqueBatches_.begin(); it!=opaqueBatches_.end(); it++)
+    {
+        states.push_back(it->first);
+        firsts.push_back((int)(vertices.size() / RENDER_LIST_VERTEX_SIZE));
+        counts.push_back((int)(it->second.size() / RENDER_LIST_VERTEX_SIZE));
+
+        vertices.insert(vertices.end(), it->second.begin(), it->second.end());
+    }
+
+    for(unsigned int i=0; i<blendedBatches_.size(); i++)
+    {
+        states.push_back(blendedBatches_[i].state);
+        firsts.push_back((int)(vertices.size() / RENDER_LIST_VERTEX_SIZE));
+        counts.push_back((int)(blendedBatches_[i].vertices.size() / RENDER_LIST_VERTEX_SIZE));
+
+        vertices.insert(vertices.end(), blendedBatches_[i].vertices.begin(), blendedBatches_[i].vertices.end());
+    }
+
+    if(vertices.size() == 0)
+    {
+        return;
+    }
+
+    // same projection as the orthographic view: y-axis inverted, then gluOrtho2D()
+    QMatrix4x4 projection;
+    projection.scale(1., -1., 1.);
+    projection.ortho(left, right, bottom, top, -1., 1.);
+
+    glPushAttrib(GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_LINE_BIT | GL_TEXTURE_BIT);
+
+    vertexBuffer_.bind();
+    vertexBuffer_.allocate(&vertices[0], (int)(vertices.size() * sizeof(GLfloat)));
+
+    shaderProgram_.bind();
+    shaderProgram_.setUniformValue("projection", projection);
+    shaderProgram_.setUniformValue("texture", (GLint)0);
+
+    int vertexLocation = shaderProgram_.attributeLocation("vertex");
+    int texCoordLocation = shaderProgram_.attributeLocation("texCoord");
+    int colorLocation = shaderProgram_.attributeLocation("color");
+
+    shaderProgram_.enableAttributeArray(vertexLocation);
+    shaderProgram_.enableAttributeArray(texCoordLocation);
+    shaderProgram_.enableAttributeArray(colorLocation);
+
+    shaderProgram_.setAttributeBuffer(vertexLocation, GL_FLOAT, 0, 3, RENDER_LIST_VERTEX_SIZE * sizeof(GLfloat));
+    shaderProgram_.setAttributeBuffer(texCoordLocation, GL_FLOAT, 3 * sizeof(GLfloat), 2, RENDER_LIST_VERTEX_SIZE * sizeof(GLfloat));
+    shaderProgram_.setAttributeBuffer(colorLocation, GL_FLOAT, 5 * sizeof(GLfloat), 4, RENDER_LIST_VERTEX_SIZE * sizeof(GLfloat));
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // only change state between batches when it differs
+    for(unsigned int i=0; i<states.size(); i++)
+    {
+        RenderListState & state = states[i];
+
+        if(i == 0 || state.textureId != states[i-1].textureId)
+        {
+            glBindTexture(GL_TEXTURE_2D, state.textureId);
+            shaderProgram_.setUniformValue("textured", (GLint)(state.textureId != 0 ? 1 : 0));
+        }
+
+        if(i == 0 || state.blend != states[i-1].blend)
+        {
+            if(state.blend == true)
+            {
+                glEnable(GL_BLEND);
+            }
+            else
+            {
+                glDisable(GL_BLEND);
+            }
+        }
+
+        if(i == 0 || state.depthTest != states[i-1].depthTest)
+        {
+            if(state.depthTest == true)
+            {
+                glEnable(GL_DEPTH_TEST);
+            }
+            else
+            {
+                glDisable(GL_DEPTH_TEST);
+            }
+        }
+
+        if(i == 0 || state.depthWrite != states[i-1].depthWrite)
+        {
+            glDepthMask(state.depthWrite == true ? GL_TRUE : GL_FALSE);
+        }
+
+        if(state.primitive == GL_LINES && (i == 0 || state.lineWidth != states[i-1].lineWidth))
+        {
+            glLineWidth(state.lineWidth);
+        }
+
+        glDrawArrays(state.primitive, firsts[i], counts[i]);
+
+        numDrawCalls_++;
+    }
+
+    numVertices_ = (int)(vertices.size() / RENDER_LIST_VERTEX_SIZE);
+
+    shaderProgram_.disableAttributeArray(vertexLocation);
+    shaderProgram_.disableAttributeArray(texCoordLocation);
+    shaderProgram_.disableAttributeArray(colorLocation);
+
+    shaderProgram_.release();
+    vertexBuffer_.release();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glPopAttrib();
+}
+
+void RenderList::clear()
+{
+    transform_ = QRectF(0., 0., 1., 1.);
+    depth_ = 0.;
+
+    setColor(1., 1., 1., 1.);
+
+    opaqueBatches_.clear();
+    blendedBatches_.clear();
+    layers_.clear();
+}
+
+int RenderList::getNumDrawCalls()
+{
+    return numDrawCalls_;
+}
+
+int RenderList::getNumVertices()
+{
+    return numVertices_;
+}
+
+void RenderList::initialize()
+{
+    initialized_ = true;
+
+    if(vertexBuffer_.create() != true)
+    {
+        put_flog(LOG_ERROR, "could not create vertex buffer");
+        return;
+    }
+
+    if(shaderProgram_.addShaderFromSourceCode(QGLShader::Vertex, vertexShaderSource) != true || shaderProgram_.addShaderFromSourceCode(QGLShader::Fragment, fragmentShaderSource) != true || shaderProgram_.link() != true)
+    {
+        put_flog(LOG_ERROR, "could not build shader program: %s", shaderProgram_.log().toStdString().c_str());
+        return;
+    }
+
+    shaderValid_ = true;
+}
+
+std::vector<GLfloat> & RenderList::getVertices(const RenderListState & state, double & z)
+{
+    z = depth_;
+
+    if(state.blend == true)
+    {
+        // blended primitives keep their order; merge with the last batch if it has the same state
+        if(blendedBatches_.size() == 0 || !(blendedBatches_.back().state == state))
+        {
+            RenderListBatch batch;
+            batch.state = state;
+
+            blendedBatches_.push_back(batch);
+        }
+
+        return blendedBatches_.back().vertices;
+    }
+
+    // opaque primitives are reordered by state. the depth test keeps the first primitive drawn at
+    // equal depths, so later state runs in a layer are moved slightly away from the viewer
+    std::map<double, std::pair<RenderListState, int> >::iterator it = layers_.find(depth_);
+
+    if(it == layers_.end())
+    {
+        layers_[depth_] = std::pair<RenderListState, int>(state, 0);
+    }
+    else
+    {
+        if(!(it->second.first == state))
+        {
+            it->second.first = state;
+            it->second.second = std::min(it->second.second + 1, RENDER_LIST_MAX_LAYER_RUNS);
+        }
+
+        z = depth_ - (double)it->second.second * RENDER_LIST_LAYER_DEPTH_OFFSET;
+    }
+
+    return opaqueBatches_[state];
+}
+
+void RenderList::appendVertex(std::vector<GLfloat> & vertices, double x, double y, double z, double s, double t, const GLfloat * color)
+{
+    GLfloat vertex[RENDER_LIST_VERTEX_SIZE] = { (GLfloat)x, (GLfloat)y, (GLfloat)z, (GLfloat)s, (GLfloat)t, color[0], color[1], color[2], color[3] };
+
+    vertices.insert(vertices.end(), vertex, vertex + RENDER_LIST_VERTEX_SIZE);
+}
+
+QPointF RenderList::map(double x, double y)
+{
+    return QPointF(transform_.x() + x * transform_.width(), transform_.y() + y * transform_.height());
+}
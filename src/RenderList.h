@@ -0,0 +1,154 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef RENDER_LIST_H
+#define RENDER_LIST_H
+
+// depth offset between successive state runs in the same depth layer, and the maximum number of runs offset
+#define RENDER_LIST_LAYER_DEPTH_OFFSET 0.000001
+#define RENDER_LIST_MAX_LAYER_RUNS 500
+
+#include <QtGui>
+#include <QGLWidget>
+#include <QGLBuffer>
+#include <QGLShaderProgram>
+#include <map>
+#include <vector>
+
+// OpenGL state of a batch of primitives
+struct RenderListState {
+
+    // GL_TRIANGLES or GL_LINES
+    GLenum primitive;
+
+    // 0 for untextured primitives
+    GLuint textureId;
+
+    float lineWidth;
+    bool blend;
+    bool depthTest;
+    bool depthWrite;
+
+    RenderListState();
+
+    // ordered by texture first, so batches sharing a texture are drawn together
+    bool operator<(const RenderListState & state) const;
+    bool operator==(const RenderListState & state) const;
+};
+
+struct RenderListBatch {
+
+    RenderListState state;
+
+    // x, y, z, s, t, r, g, b, a per vertex
+    std::vector<GLfloat> vertices;
+};
+
+// retained-mode renderer: contents add textured quads, quads and lines for a frame, which
+// are then sorted by state and drawn from one vertex buffer with a minimal shader.
+//
+// primitives are given in the (0,0,1,1) coordinate system of the current content transform,
+// set by the GLWindow. opaque primitives are sorted by state; to keep the result of the depth
+// test the same as drawing in order, primitives in the same depth layer are offset slightly
+// away from the viewer for each change of state within that layer. blended primitives are drawn
+// after all opaque primitives, in the order they were added.
+class RenderList {
+
+    public:
+
+        RenderList();
+        ~RenderList();
+
+        // rectangle in the (0,0,1,1) display coordinate system and depth of the current content's (0,0,1,1) rectangle
+        void setTransform(const QRectF & rect, double depth);
+
+        // color of subsequent untextured primitives
+        void setColor(float r, float g, float b, float a);
+
+        void addQuad(const QRectF & rect, bool blend=false, bool depthWrite=true);
+
+        // textureRect gives the texture coordinates of rect's corners: (x, y) at rect's (x, y)
+        void addTexturedQuad(GLuint textureId, const QRectF & rect, const QRectF & textureRect, bool blend=false, bool depthTest=true);
+
+        void addLineLoop(const QRectF & rect, float lineWidth=1.);
+        void addLine(const QPointF & p1, const QPointF & p2, float lineWidth=1.);
+
+        // draw everything added since the last clear() in the orthographic view (left, right, bottom, top)
+        // must be called in the OpenGL thread
+        void draw(double left, double right, double bottom, double top);
+
+        void clear();
+
+        int getNumDrawCalls();
+        int getNumVertices();
+
+    private:
+
+        QRectF transform_;
+        double depth_;
+
+        GLfloat color_[4];
+
+        // opaque primitives, by state
+        std::map<RenderListState, std::vector<GLfloat> > opaqueBatches_;
+
+        // blended primitives, in order
+        std::vector<RenderListBatch> blendedBatches_;
+
+        // last state and number of state runs in each opaque depth layer
+        std::map<double, std::pair<RenderListState, int> > layers_;
+
+        // statistics of the last draw()
+        int numDrawCalls_;
+        int numVertices_;
+
+        // created in the first draw()
+        bool initialized_;
+        bool shaderValid_;
+        QGLShaderProgram shaderProgram_;
+        QGLBuffer vertexBuffer_;
+
+        void initialize();
+
+        // vertices for a primitive with the given state, and the depth to draw it at
+        std::vector<GLfloat> & getVertices(const RenderListState & state, double & z);
+        void appendVertex(std::vector<GLfloat> & vertices, double x, double y, double z, double s, double t, const GLfloat * color);
+        QPointF map(double x, double y);
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <QtCore>
+
+// a bounded single-producer / single-consumer queue. push() may only be called
+// from one (producer) thread, and the other methods from one (consumer) thread.
+// neither side takes a lock or waits for the other.
+//
+// head_ is only written by the producer and tail_ only by the consumer. the
+// counters increase monotonically; the slot of a counter is counter & mask_.
+
+template <class T>
+class RingBuffer {
+
+    public:
+
+        // capacity is rounded up to a power of two
+        RingBuffer(unsigned int capacity)
+        {
+            capacity_ = 1;
+
+            while(capacity_ < capacity)
+            {
+                capacity_ *= 2;
+            }
+
+            mask_ = capacity_ - 1;
+
+            items_ = new T[capacity_];
+        }
+
+        ~RingBuffer()
+        {
+            delete [] items_;
+        }
+
+        unsigned int getCapacity()
+        {
+            return capacity_;
+        }
+
+        // producer: add an item, returning false if the buffer is full
+        bool push(const T & item)
+        {
+            unsigned int head = (unsigned int)(int)head_;
+            unsigned int tail = (unsigned int)tail_.fetchAndAddAcquire(0);
+
+            if(head - tail >= capacity_)
+            {
+                return false;
+            }
+
+            items_[head & mask_] = item;
+
+            // publish the item
+            head_.fetchAndStoreRelease((int)(head + 1));
+
+            return true;
+        }
+
+        // consumer: number of items available
+        // may also be called from the producer thread, giving an upper bound
+        unsigned int size()
+        {
+            // read the tail first so the difference can't be negative
+            unsigned int tail = (unsigned int)tail_.fetchAndAddAcquire(0);
+
+            return (unsigned int)head_.fetchAndAddAcquire(0) - tail;
+        }
+
+        // consumer: access the item at position i (0 is the oldest); i must be < size()
+        T & peek(unsigned int i)
+        {
+            return items_[((unsigned int)(int)tail_ + i) & mask_];
+        }
+
+        // consumer: remove the count oldest items; count must be <= size()
+        void pop(unsigned int count=1)
+        {
+            unsigned int tail = (unsigned int)(int)tail_;
+
+            // release the items' resources here rather than when the slots are reused
+            for(unsigned int i=0; i<count; i++)
+            {
+                items_[(tail + i) & mask_] = T();
+            }
+
+            tail_.fetchAndStoreRelease((int)(tail + count));
+        }
+
+        // consumer: remove all items
+        void clear()
+        {
+            pop(size());
+        }
+
+    private:
+
+        unsigned int capacity_;
+        unsigned int mask_;
+
+        T * items_;
+
+        // next slot to write (producer) and next slot to read (consumer)
+        QAtomicInt head_;
+        QAtomicInt tail_;
+};
+
+#endif
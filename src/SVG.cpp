@@ -39,6 +39,8 @@
 #include "SVG.h"
 #include "main.h"
 #include "log.h"
+#include <algorithm>
+#include <math.h>
 
 #ifdef __APPLE__
     #include <OpenGL/glu.h>
@@ -46,14 +48,103 @@
     #include <GL/glu.h>
 #endif
 
+long SVG::uploadFrameCount_ = -1;
+int SVG::uploadBytes_ = 0;
+
+long SVG::numVersionsDisplayed_ = 0;
+long SVG::numVersionsSuperseded_ = 0;
+double SVG::totalVersionLag_ = 0.;
+int SVG::maxVersionLag_ = 0;
+
+SVGRasterizeJob::SVGRasterizeJob(boost::shared_ptr<SVGRasterization> rasterization)
+{
+    rasterization_ = rasterization;
+}
+
+void SVGRasterizeJob::run()
+{
+    // each job has its own renderer, so setting the view box doesn't affect other jobs or the render thread
+    QSvgRenderer svgRenderer;
+    int rendererVersion = -1;
+
+    while(true)
+    {
+        SVGTileIndex index;
+        QByteArray imageData;
+        QRectF svgExtents;
+        int version;
+
+        {
+            QMutexLocker locker(&rasterization_->mutex);
+
+            if(rasterization_->queue.empty() == true)
+            {
+                rasterization_->numJobs--;
+                return;
+            }
+
+            index = rasterization_->queue.front();
+            rasterization_->queue.erase(rasterization_->queue.begin());
+            rasterization_->rasterizing.push_back(index);
+
+            imageData = rasterization_->imageData;
+            svgExtents = rasterization_->svgExtents;
+            version = rasterization_->version;
+        }
+
+        if(version != rendererVersion)
+        {
+            if(svgRenderer.load(imageData) != true || svgRenderer.isValid() == false)
+            {
+                put_flog(LOG_ERROR, "error loading %s", rasterization_->uri.c_str());
+            }
+
+            rendererVersion = version;
+        }
+
+        // view box of the tile in logical coordinates
+        double size = 1. / (double)(1 << index.level);
+
+        QRectF viewbox(svgExtents.x() + (double)index.i * size * svgExtents.width(), svgExtents.y() + (double)index.j * size * svgExtents.height(), size * svgExtents.width(), size * svgExtents.height());
+
+        svgRenderer.setViewBox(viewbox);
+
+        QImage image(SVG_TILE_SIZE, SVG_TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+        image.fill(0);
+
+        QPainter painter(&image);
+        svgRenderer.render(&painter);
+        painter.end();
+
+        // convert here rather than on the render thread
+        SVGRasterizedTile tile;
+        tile.index = index;
+        tile.image = QGLWidget::convertToGLFormat(image);
+        tile.version = version;
+
+        QMutexLocker locker(&rasterization_->mutex);
+
+        rasterization_->rasterizedTiles.push_back(tile);
+        rasterization_->rasterizing.erase(std::find(rasterization_->rasterizing.begin(), rasterization_->rasterizing.end(), index));
+    }
+}
+
 SVG::SVG(std::string uri)
 {
     // defaults
     imageWidth_ = 0;
     imageHeight_ = 0;
+    queueFrameCount_ = -1;
+    version_ = 0;
+    displayedVersion_ = 0;
+
+    rasterization_ = boost::shared_ptr<SVGRasterization>(new SVGRasterization());
+    rasterization_->version = 0;
+    rasterization_->numJobs = 0;
 
     // assign values
     uri_ = uri;
+    rasterization_->uri = uri;
 
     // open file corresponding to URI
     QFile file(uri.c_str());
@@ -72,7 +163,23 @@ SVG::SVG(std::string uri)
 
 SVG::~SVG()
 {
-    // no need to delete textures, that's handled in FBO destructor
+    // jobs stop after the tiles in progress, holding the shared state until then
+    {
+        QMutexLocker locker(&rasterization_->mutex);
+        rasterization_->queue.clear();
+    }
+
+    // the textures are deleted by the OpenGL window
+    for(std::map<SVGTileIndex, SVGTile>::iterator it=tiles_.begin(); it!=tiles_.end(); it++)
+    {
+        g_mainWindow->getGLWindow()->insertPurgeTextureId(it->second.textureId);
+    }
+
+    for(unsigned int i=0; i<pendingTiles_.size(); i++)
+    {
+        g_mainWindow->getGLWindow()->getPixelBufferUploader().cancel(pendingTiles_[i].second.textureId);
+        g_mainWindow->getGLWindow()->insertPurgeTextureId(pendingTiles_[i].second.textureId);
+    }
 }
 
 void SVG::getDimensions(int &width, int &height)
@@ -85,136 +192,504 @@ void SVG::render(float tX, float tY, float tW, float tH)
 {
     updateRenderedFrameCount();
 
+    // upload tiles rasterized since the last render
+    uploadTiles();
+
     // get on-screen and full rectangle corresponding to the window
     QRectF screenRect = getProjectedPixelRect(true);
     QRectF fullRect = getProjectedPixelRect(false); // corresponds to original [tX, tY, tW, tH]
 
     // if we're not visible or we don't have a valid SVG, we're done...
-    if(screenRect.isEmpty() == true || svgRenderer_.isValid() != true)
+    if(screenRect.isEmpty() == true || version_ == 0)
     {
-        // clear existing FBO for this OpenGL window
-        fbos_.erase(g_mainWindow->getActiveGLWindow());
+        return;
+    }
+
+    // figure out what visible [tX, tY, tW, tH] is for screenRect, within the image
+    double tXp = tX + (screenRect.x() - fullRect.x()) / fullRect.width() * tW;
+    double tYp = tY + (screenRect.y() - fullRect.y()) / fullRect.height() * tH;
+    double tWp = screenRect.width() / fullRect.width() * tW;
+    double tHp = screenRect.height() / fullRect.height() * tH;
+
+    QRectF visibleRect = QRectF(tXp, tYp, tWp, tHp).intersected(QRectF(0., 0., 1., 1.));
 
+    if(visibleRect.isEmpty() == true)
+    {
         return;
     }
 
-    // generate texture corresponding to the visible part of these texture coordinates
-    generateTexture(screenRect, fullRect, tX, tY, tW, tH);
+    // use the coarsest level with at least as many pixels as the whole image has on screen
+    double imagePixels = std::max(fullRect.width() / tW, fullRect.height() / tH);
+
+    int level = 0;
+
+    while(level < SVG_MAX_LEVEL && (double)(SVG_TILE_SIZE << level) < imagePixels)
+    {
+        level++;
+    }
+
+    // the queue is rebuilt every frame, so tiles no longer visible aren't rasterized
+    if(queueFrameCount_ != g_frameCount)
+    {
+        QMutexLocker locker(&rasterization_->mutex);
+
+        rasterization_->queue.clear();
+        queueFrameCount_ = g_frameCount;
+    }
+
+    // the whole image at level 0 is the fallback for all other tiles, and is also what the zoom context shows
+    SVGTileIndex rootIndex;
+    rootIndex.level = 0;
+    rootIndex.i = 0;
+    rootIndex.j = 0;
 
-    // we'll now render the entire generated texture
-    tX = tY = 0.;
-    tW = tH = 1.;
+    requestTile(rootIndex);
 
-    // figure out what visible region is for screenRect, a subregion of [0, 0, 1, 1]
-    double xp = (screenRect.x() - fullRect.x()) / fullRect.width();
-    double yp = (screenRect.y() - fullRect.y()) / fullRect.height();
-    double wp = screenRect.width() / fullRect.width();
-    double hp = screenRect.height() / fullRect.height();
+    int numTiles = 1 << level;
 
-    // draw the texture
-    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+    int iMin = std::max(0, (int)floor(visibleRect.left() * (double)numTiles));
+    int iMax = std::min(numTiles - 1, (int)ceil(visibleRect.right() * (double)numTiles) - 1);
+    int jMin = std::max(0, (int)floor(visibleRect.top() * (double)numTiles));
+    int jMax = std::min(numTiles - 1, (int)ceil(visibleRect.bottom() * (double)numTiles) - 1);
 
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, textureId_);
+    // whether all tiles drawn are of the latest image data
+    bool current = true;
 
-    // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    for(int i=iMin; i<=iMax; i++)
+    {
+        for(int j=jMin; j<=jMax; j++)
+        {
+            SVGTileIndex index;
+            index.level = level;
+            index.i = i;
+            index.j = j;
 
-    glBegin(GL_QUADS);
+            QRectF tileRect((double)i / (double)numTiles, (double)j / (double)numTiles, 1. / (double)numTiles, 1. / (double)numTiles);
+            QRectF textureRect = tileRect.intersected(visibleRect);
 
-    // note we need to flip the y coordinate since the textures are loaded upside down
-    glTexCoord2f(tX,1.-tY);
-    glVertex2f(xp, yp);
+            if(textureRect.isEmpty() == true)
+            {
+                continue;
+            }
 
-    glTexCoord2f(tX+tW,1.-tY);
-    glVertex2f(xp+wp,yp);
+            requestTile(index);
+
+            if(drawTile(index, textureRect, tX, tY, tW, tH) != true)
+            {
+                current = false;
+            }
+        }
+    }
 
-    glTexCoord2f(tX+tW,1.-(tY+tH));
-    glVertex2f(xp+wp,yp+hp);
+    // the display lags the latest image data until it is drawn everywhere on screen
+    if(current == true && displayedVersion_ != version_)
+    {
+        int lag = versionTime_.elapsed();
 
-    glTexCoord2f(tX,1.-(tY+tH));
-    glVertex2f(xp,yp+hp);
+        numVersionsDisplayed_++;
+        totalVersionLag_ += (double)lag;
+        maxVersionLag_ = std::max(maxVersionLag_, lag);
 
-    glEnd();
+        displayedVersion_ = version_;
+    }
 
-    glPopAttrib();
+    startJobs();
 }
 
 bool SVG::setImageData(QByteArray imageData)
 {
-    if(svgRenderer_.load(imageData) != true || svgRenderer_.isValid() == false)
+    // the whole document is parsed by the rasterization jobs
+    QRectF svgExtents;
+
+    if(getImageInfo(imageData, imageWidth_, imageHeight_, svgExtents) != true)
     {
         put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
         return false;
     }
 
-    // save logical coordinates
-    svgExtents_ = svgRenderer_.viewBoxF();
+    // the previous version was replaced before it was displayed
+    if(version_ > 0 && displayedVersion_ != version_)
+    {
+        numVersionsSuperseded_++;
+    }
+
+    // tiles of the previous image data are drawn until they are replaced;
+    // tiles queued or rasterized for it are dropped, and any being rasterized are dropped on upload
+    {
+        QMutexLocker locker(&rasterization_->mutex);
 
-    // save image dimensions
-    imageWidth_ = svgRenderer_.defaultSize().width();
-    imageHeight_ = svgRenderer_.defaultSize().height();
+        rasterization_->imageData = imageData;
+        rasterization_->svgExtents = svgExtents;
+        rasterization_->version++;
+
+        rasterization_->queue.clear();
+        rasterization_->rasterizedTiles.clear();
+
+        version_ = rasterization_->version;
+    }
 
-    // reset rendered texture information
-    textureRect_ = QRectF();
-    textureSize_ = QSizeF(0,0);
+    versionTime_.start();
 
     return true;
 }
 
-void SVG::generateTexture(QRectF screenRect, QRectF fullRect, float tX, float tY, float tW, float tH)
+void SVG::logStatistics(long frameCount)
 {
-    // figure out what visible [tX, tY, tW, tH] is for screenRect
-    double tXp = tX + (screenRect.x() - fullRect.x()) / fullRect.width() * tW;
-    double tYp = tY + (screenRect.y() - fullRect.y()) / fullRect.height() * tH;
-    double tWp = screenRect.width() / fullRect.width() * tW;
-    double tHp = screenRect.height() / fullRect.height() * tH;
+    if(frameCount % SVG_STATISTICS_INTERVAL != 0)
+    {
+        return;
+    }
+
+    if(numVersionsDisplayed_ > 0 || numVersionsSuperseded_ > 0)
+    {
+        put_flog(LOG_DEBUG, "svg: %li versions displayed, lag mean %f ms, max %i ms; %li versions superseded before they were displayed", numVersionsDisplayed_, numVersionsDisplayed_ > 0 ? totalVersionLag_ / (double)numVersionsDisplayed_ : 0., maxVersionLag_, numVersionsSuperseded_);
+    }
+
+    numVersionsDisplayed_ = 0;
+    numVersionsSuperseded_ = 0;
+    totalVersionLag_ = 0.;
+    maxVersionLag_ = 0;
+}
+
+bool SVG::getImageInfo(const QByteArray & imageData, int & width, int & height, QRectF & viewBox)
+{
+    QXmlStreamReader reader(imageData);
+
+    // the root element is the first start element
+    while(reader.atEnd() != true && reader.isStartElement() != true)
+    {
+        reader.readNext();
+    }
+
+    if(reader.isStartElement() == true && reader.name() == "svg")
+    {
+        QXmlStreamAttributes attributes = reader.attributes();
+
+        viewBox = QRectF();
+
+        QStringList values = attributes.value("viewBox").toString().split(QRegExp("[\\s,]+"), QString::SkipEmptyParts);
+
+        if(values.size() == 4)
+        {
+            viewBox = QRectF(values[0].toDouble(), values[1].toDouble(), values[2].toDouble(), values[3].toDouble());
+        }
+
+        double w = getLength(attributes.value("width").toString(), viewBox.width());
+        double h = getLength(attributes.value("height").toString(), viewBox.height());
+
+        // without a view box, the logical coordinates are the pixel coordinates
+        if(viewBox.isEmpty() == true)
+        {
+            viewBox = QRectF(0., 0., w, h);
+        }
+
+        width = qRound(w);
+        height = qRound(h);
+
+        if(width > 0 && height > 0)
+        {
+            return true;
+        }
+    }
+
+    // lengths in units we don't handle, or an unusual document; parse the whole document
+    QSvgRenderer svgRenderer;
+
+    if(svgRenderer.load(imageData) != true || svgRenderer.isValid() == false)
+    {
+        return false;
+    }
+
+    width = svgRenderer.defaultSize().width();
+    height = svgRenderer.defaultSize().height();
+    viewBox = svgRenderer.viewBoxF();
+
+    return true;
+}
 
-    QRectF textureRect(tXp, tYp, tWp, tHp);
+double SVG::getLength(QString length, double relativeLength)
+{
+    length = length.trimmed();
+
+    if(length.isEmpty() == true)
+    {
+        return relativeLength;
+    }
+
+    if(length.endsWith("%") == true)
+    {
+        return length.left(length.size() - 1).toDouble() / 100. * relativeLength;
+    }
+
+    // units in pixels, at the 90 dpi QSvgRenderer assumes
+    const char * units[] = { "px", "pt", "pc", "mm", "cm", "in" };
+    double pixels[] = { 1., 1.25, 15., 3.543307, 35.43307, 90. };
+
+    double factor = 1.;
+
+    for(unsigned int i=0; i<sizeof(pixels) / sizeof(double); i++)
+    {
+        if(length.endsWith(units[i]) == true)
+        {
+            length.chop(2);
+            factor = pixels[i];
+            break;
+        }
+    }
+
+    bool ok;
+    double value = length.toDouble(&ok);
+
+    // unhandled units are caught by the caller as an invalid size
+    if(ok != true)
+    {
+        return 0.;
+    }
+
+    return value * factor;
+}
+
+void SVG::uploadTiles()
+{
+    PixelBufferUploader & uploader = g_mainWindow->getGLWindow()->getPixelBufferUploader();
+
+    // tiles uploaded in previous frames replace the tiles of previous image data, if any
+    std::vector<std::pair<SVGTileIndex, SVGTile> > pendingTiles;
+
+    for(unsigned int i=0; i<pendingTiles_.size(); i++)
+    {
+        SVGTile & tile = pendingTiles_[i].second;
+
+        if(uploader.isPending(tile.textureId) == true)
+        {
+            pendingTiles.push_back(pendingTiles_[i]);
+            continue;
+        }
+
+        std::map<SVGTileIndex, SVGTile>::iterator it = tiles_.find(pendingTiles_[i].first);
+
+        if(it != tiles_.end())
+        {
+            g_mainWindow->getGLWindow()->insertPurgeTextureId(it->second.textureId);
+        }
+
+        tile.frameCount = g_frameCount;
+
+        tiles_[pendingTiles_[i].first] = tile;
+    }
+
+    pendingTiles_.swap(pendingTiles);
+
+    if(uploadFrameCount_ != g_frameCount)
+    {
+        uploadFrameCount_ = g_frameCount;
+        uploadBytes_ = 0;
+    }
+
+    while(true)
+    {
+        SVGRasterizedTile rasterizedTile;
+
+        {
+            QMutexLocker locker(&rasterization_->mutex);
+
+            // skip tiles of previous image data
+            while(rasterization_->rasterizedTiles.empty() != true && rasterization_->rasterizedTiles.front().version != version_)
+            {
+                rasterization_->rasterizedTiles.erase(rasterization_->rasterizedTiles.begin());
+            }
+
+            if(rasterization_->rasterizedTiles.empty() == true)
+            {
+                break;
+            }
+
+            // limit the bytes uploaded per frame so many tiles finishing at once don't stall a frame;
+            // the first upload of a frame is always allowed
+            if(uploadBytes_ > 0 && uploadBytes_ + rasterization_->rasterizedTiles.front().image.byteCount() > SVG_MAX_UPLOAD_BYTES_PER_FRAME)
+            {
+                break;
+            }
+
+            if(uploader.canUpload() != true)
+            {
+                break;
+            }
+
+            rasterizedTile = rasterization_->rasterizedTiles.front();
+            rasterization_->rasterizedTiles.erase(rasterization_->rasterizedTiles.begin());
+        }
+
+        QImage & image = rasterizedTile.image;
+
+        int numBytes = image.byteCount();
+        uploadBytes_ += numBytes;
+
+        SVGTile tile;
+        tile.version = rasterizedTile.version;
+        tile.frameCount = g_frameCount;
+
+        glGenTextures(1, &tile.textureId);
+        glBindTexture(GL_TEXTURE_2D, tile.textureId);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // clamp to edge, so tiles don't pick up texels from their opposite edge
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // note that the image is already in the GL format
+        uploader.upload(tile.textureId, image);
+
+        pendingTiles_.push_back(std::pair<SVGTileIndex, SVGTile>(rasterizedTile.index, tile));
+    }
+
+    evictTiles();
+}
+
+void SVG::evictTiles()
+{
+    if(tiles_.size() <= SVG_MAX_TILES)
+    {
+        return;
+    }
+
+    // least recently drawn first
+    std::vector<std::pair<long, SVGTileIndex> > tiles;
+
+    for(std::map<SVGTileIndex, SVGTile>::iterator it=tiles_.begin(); it!=tiles_.end(); it++)
+    {
+        tiles.push_back(std::pair<long, SVGTileIndex>(it->second.frameCount, it->first));
+    }
+
+    std::sort(tiles.begin(), tiles.end());
 
-    if(textureRect == textureRect_ && screenRect.size() == textureSize_)
+    for(unsigned int i=0; i<tiles.size() && tiles_.size() > SVG_MAX_TILES; i++)
+    {
+        // keep tiles drawn in this frame
+        if(tiles[i].first == g_frameCount)
+        {
+            break;
+        }
+
+        g_mainWindow->getGLWindow()->insertPurgeTextureId(tiles_[tiles[i].second].textureId);
+        tiles_.erase(tiles[i].second);
+    }
+}
+
+void SVG::requestTile(SVGTileIndex index)
+{
+    std::map<SVGTileIndex, SVGTile>::iterator it = tiles_.find(index);
+
+    if(it != tiles_.end())
+    {
+        it->second.frameCount = g_frameCount;
+
+        if(it->second.version == version_)
+        {
+            return;
+        }
+    }
+
+    QMutexLocker locker(&rasterization_->mutex);
+
+    if(std::find(rasterization_->rasterizing.begin(), rasterization_->rasterizing.end(), index) != rasterization_->rasterizing.end() || std::find(rasterization_->queue.begin(), rasterization_->queue.end(), index) != rasterization_->queue.end())
     {
-        // no need to regenerate texture
         return;
     }
 
-    // keep rendered texture information so we know when to rerender
-    // todo: this works great when the SVG is only rendered once per GLWindow
-    // however, it will rerender every time otherwise, for example if the zoom context is shown
-    textureRect_ = textureRect;
-    textureSize_ = screenRect.size();
+    for(unsigned int i=0; i<rasterization_->rasterizedTiles.size(); i++)
+    {
+        if(rasterization_->rasterizedTiles[i].index == index)
+        {
+            return;
+        }
+    }
 
-    // generate and set view box in logical coordinates
-    QRectF viewbox(svgExtents_.x() + tXp * svgExtents_.width(), svgExtents_.y() + tYp * svgExtents_.height(), tWp * svgExtents_.width(), tHp * svgExtents_.height());
+    rasterization_->queue.push_back(index);
+}
 
-    svgRenderer_.setViewBox(viewbox);
+void SVG::startJobs()
+{
+    // leave threads for decoding other contents
+    int maxJobs = std::max(QThread::idealThreadCount() / 2, 1);
+
+    QMutexLocker locker(&rasterization_->mutex);
+
+    while(rasterization_->numJobs < maxJobs && rasterization_->numJobs < (int)rasterization_->queue.size())
+    {
+        rasterization_->numJobs++;
+
+        QThreadPool::globalInstance()->start(new SVGRasterizeJob(rasterization_));
+    }
+}
+
+bool SVG::drawTile(SVGTileIndex index, QRectF textureRect, float tX, float tY, float tW, float tH)
+{
+    // use the tile of previous image data, or the nearest coarser tile, until this one is uploaded
+    while(tiles_.count(index) == 0)
+    {
+        if(index.level == 0)
+        {
+            return false;
+        }
+
+        index.level--;
+        index.i /= 2;
+        index.j /= 2;
+    }
 
-    // save OpenGL state
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
+    SVGTile & tile = tiles_[index];
+    tile.frameCount = g_frameCount;
 
-    // generate new texture
-    boost::shared_ptr<QGLFramebufferObject> fbo(new QGLFramebufferObject(screenRect.width(), screenRect.height(), QGLFramebufferObject::CombinedDepthStencil));
+    double size = 1. / (double)(1 << index.level);
 
-    // keep fbos in a map so they stick around -- they're needed for the texture to be rendered
-    fbos_[g_mainWindow->getActiveGLWindow()] = fbo;
+    // rectangle within the window's (0,0,1,1) rectangle, and texture coordinates within the tile
+    QRectF rect((textureRect.x() - tX) / tW, (textureRect.y() - tY) / tH, textureRect.width() / tW, textureRect.height() / tH);
 
-    QPainter painter(fbo.get());
-    svgRenderer_.render(&painter);
-    painter.end();
+    float tileX = (textureRect.x() - (double)index.i * size) / size;
+    float tileY = (textureRect.y() - (double)index.j * size) / size;
+    float tileW = textureRect.width() / size;
+    float tileH = textureRect.height() / size;
 
-    // restore OpenGL state
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-    glPopAttrib();
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
 
-    textureId_ = fbo->texture();
+    if(glWindow->getRetainedRendering() == true)
+    {
+        // note we need to flip the y coordinate since the textures are loaded upside down
+        glWindow->getRenderList().addTexturedQuad(tile.textureId, rect, QRectF(tileX, 1.-tileY, tileW, -tileH));
+    }
+    else
+    {
+        // draw the texture
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+
+        // filtering and wrapping were set on upload
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, tile.textureId);
+
+        glBegin(GL_QUADS);
+
+        // note we need to flip the y coordinate since the textures are loaded upside down
+        glTexCoord2f(tileX,1.-tileY);
+        glVertex2f(rect.left(), rect.top());
+
+        glTexCoord2f(tileX+tileW,1.-tileY);
+        glVertex2f(rect.right(), rect.top());
+
+        glTexCoord2f(tileX+tileW,1.-(tileY+tileH));
+        glVertex2f(rect.right(), rect.bottom());
+
+        glTexCoord2f(tileX,1.-(tileY+tileH));
+        glVertex2f(rect.left(), rect.bottom());
+
+        glEnd();
+
+        glPopAttrib();
+    }
+
+    return tile.version == version_;
 }
 
 QRectF SVG::getProjectedPixelRect(bool onScreenOnly)
@@ -254,22 +729,26 @@ QRectF SVG::getProjectedPixelRect(bool onScreenOnly)
     {
         gluProject(x[i][0], x[i][1], x[i][2], modelview, projection, viewport, &xWin[i][0], &xWin[i][1], &xWin[i][2]);
 
+        // relative to the viewport, which is offset in the window when it renders several tiles
+        xWin[i][0] -= (double)viewport[0];
+        xWin[i][1] -= (double)viewport[1];
+
         if(onScreenOnly == true)
         {
             // clamp to on-screen portion
             if(xWin[i][0] < 0.)
                 xWin[i][0] = 0.;
 
-            if(xWin[i][0] > (double)g_mainWindow->getGLWindow()->width())
-                xWin[i][0] = (double)g_mainWindow->getGLWindow()->width();
+            if(xWin[i][0] > (double)viewport[2])
+                xWin[i][0] = (double)viewport[2];
 
             if(xWin[i][1] < 0.)
                 xWin[i][1] = 0.;
 
-            if(xWin[i][1] > (double)g_mainWindow->getGLWindow()->height())
-                xWin[i][1] = (double)g_mainWindow->getGLWindow()->height();
+            if(xWin[i][1] > (double)viewport[3])
+                xWin[i][1] = (double)viewport[3];
         }
     }
 
-    return QRectF(QPointF(xWin[0][0], (double)g_mainWindow->getGLWindow()->height() - xWin[0][1]), QPointF(xWin[2][0], (double)g_mainWindow->getGLWindow()->height() - xWin[2][1]));
+    return QRectF(QPointF(xWin[0][0], (double)viewport[3] - xWin[0][1]), QPointF(xWin[2][0], (double)viewport[3] - xWin[2][1]));
 }
@@ -39,15 +39,111 @@
 #ifndef SVG_H
 #define SVG_H
 
+// width and height in pixels of rasterized tiles
+#define SVG_TILE_SIZE 512
+
+// deepest zoom level; level l has 2^l x 2^l tiles over the whole image
+#define SVG_MAX_LEVEL 10
+
+// rasterized tiles kept on the GPU per SVG; the least recently drawn are deleted beyond this
+#define SVG_MAX_TILES 64
+
+// maximum number of bytes of tiles uploaded to the GPU per frame (at least one tile is always uploaded)
+#define SVG_MAX_UPLOAD_BYTES_PER_FRAME (8*1024*1024)
+
+// log statistics every this many frames
+#define SVG_STATISTICS_INTERVAL 600
+
 #include "FactoryObject.h"
 #include <QtSvg>
 #include <QGLWidget>
-#include <QGLFramebufferObject>
+#include <QtCore>
 #include <boost/shared_ptr.hpp>
 #include <map>
+#include <vector>
+
+// zoom level and tile coordinates of a tile
+struct SVGTileIndex {
+
+    int level;
+    int i;
+    int j;
+
+    bool operator<(const SVGTileIndex & other) const
+    {
+        if(level != other.level)
+            return level < other.level;
+
+        if(i != other.i)
+            return i < other.i;
+
+        return j < other.j;
+    }
+
+    bool operator==(const SVGTileIndex & other) const
+    {
+        return level == other.level && i == other.i && j == other.j;
+    }
+};
+
+struct SVGTile {
+
+    GLuint textureId;
+
+    // image data version the tile was rasterized from
+    int version;
+
+    // last frame the tile was drawn in
+    long frameCount;
+};
+
+// a tile rasterized by a job, waiting to be uploaded
+struct SVGRasterizedTile {
+
+    SVGTileIndex index;
+    QImage image;
+    int version;
+};
+
+// rasterization state shared between an SVG and its jobs, so jobs can outlive the SVG
+struct SVGRasterization {
+
+    QMutex mutex;
+
+    // image data and logical coordinates tiles are rasterized from; the version is incremented on each update
+    std::string uri;
+    QByteArray imageData;
+    QRectF svgExtents;
+    int version;
+
+    // tiles to rasterize, coarsest first, and tiles being rasterized
+    std::vector<SVGTileIndex> queue;
+    std::vector<SVGTileIndex> rasterizing;
 
-class GLWindow;
+    // tiles rasterized but not yet uploaded
+    std::vector<SVGRasterizedTile> rasterizedTiles;
 
+    int numJobs;
+};
+
+// rasterizes queued tiles until there are none left
+class SVGRasterizeJob : public QRunnable {
+
+    public:
+
+        SVGRasterizeJob(boost::shared_ptr<SVGRasterization> rasterization);
+
+        void run();
+
+    private:
+
+        boost::shared_ptr<SVGRasterization> rasterization_;
+};
+
+// SVG images are rasterized into a cache of tiles by zoom level and tile coordinates, shared by all
+// windows showing the image and by the zoom context. tiles are rasterized with QPainter on a QImage
+// by jobs on the global thread pool, and uploaded as textures by the render thread. until a tile is
+// ready, the region is drawn from the tile of the previous image data, or from the nearest coarser tile.
 class SVG : public FactoryObject {
 
     public:
@@ -59,28 +155,60 @@ class SVG : public FactoryObject {
         void render(float tX, float tY, float tW, float tH);
         bool setImageData(QByteArray imageData);
 
+        // log statistics every SVG_STATISTICS_INTERVAL frames
+        static void logStatistics(long frameCount);
+
+        // get the dimensions and view box from the attributes of the root element, without parsing the whole
+        // document; the whole document is only parsed if they can't be read
+        static bool getImageInfo(const QByteArray & imageData, int & width, int & height, QRectF & viewBox);
+
     private:
 
         // image location
         std::string uri_;
 
-        // SVG renderer
-        QRectF svgExtents_;
-        QSvgRenderer svgRenderer_;
-
-        std::map<boost::shared_ptr<GLWindow>, boost::shared_ptr<QGLFramebufferObject> > fbos_;
-
-        // current rasterized image dimensions
+        // current image dimensions
         int imageWidth_;
         int imageHeight_;
 
-        // texture information
-        QRectF textureRect_;
-        QSizeF textureSize_;
-        GLuint textureId_;
+        // uploaded tiles
+        std::map<SVGTileIndex, SVGTile> tiles_;
+
+        // tiles uploaded to pixel buffers, drawable from the next frame
+        std::vector<std::pair<SVGTileIndex, SVGTile> > pendingTiles_;
+
+        boost::shared_ptr<SVGRasterization> rasterization_;
+
+        // frame the rasterization queue was last rebuilt in
+        long queueFrameCount_;
+
+        // latest image data version (0 if there is no valid image data), the last version fully displayed, and the time since the latest version was set
+        int version_;
+        int displayedVersion_;
+        QTime versionTime_;
+
+        // per-frame upload budget, shared by all SVGs
+        static long uploadFrameCount_;
+        static int uploadBytes_;
+
+        // statistics, shared by all SVGs; times in milliseconds
+        static long numVersionsDisplayed_;
+        static long numVersionsSuperseded_;
+        static double totalVersionLag_;
+        static int maxVersionLag_;
+
+        void uploadTiles();
+        void evictTiles();
+        void requestTile(SVGTileIndex index);
+        void startJobs();
+
+        // returns true if the tile drawn is of the latest image data
+        bool drawTile(SVGTileIndex index, QRectF textureRect, float tX, float tY, float tW, float tH);
 
-        void generateTexture(QRectF screenRect, QRectF fullRect, float tX, float tY, float tW, float tH);
         QRectF getProjectedPixelRect(bool onScreenOnly);
+
+        // length of an attribute in pixels; percentages and missing lengths are relative to relativeLength
+        static double getLength(QString length, double relativeLength);
 };
 
 #endif
@@ -52,6 +52,11 @@ void SVGContent::getFactoryObjectDimensions(int &width, int &height)
     g_mainWindow->getGLWindow()->getSVGFactory().getObject(getURI())->getDimensions(width, height);
 }
 
+void SVGContent::touchFactoryObject()
+{
+    g_mainWindow->getGLWindow()->getSVGFactory().touchObject(getURI());
+}
+
 void SVGContent::renderFactoryObject(float tX, float tY, float tW, float tH)
 {
     g_mainWindow->getGLWindow()->getSVGFactory().getObject(getURI())->render(tX, tY, tW, tH);
@@ -37,10 +37,16 @@
 /*********************************************************************/
 
 #include "SVGStreamSource.h"
+#include "SVGStreamPatch.h"
+#include "SVG.h"
+#include "log.h"
 
 SVGStreamSource::SVGStreamSource(std::string uri)
 {
     // defaults
+    imageDataHash_ = 0;
+    width_ = 0;
+    height_ = 0;
     imageDataCount_ = 0;
     getImageDataCount_ = 0;
 
@@ -48,7 +54,7 @@ SVGStreamSource::SVGStreamSource(std::string uri)
     uri_ = uri;
 }
 
-QByteArray SVGStreamSource::getImageData(bool & updated)
+QByteArray SVGStreamSource::getImageData(bool & updated, int & width, int & height)
 {
     QMutexLocker locker(&imageDataMutex_);
 
@@ -64,19 +70,80 @@ QByteArray SVGStreamSource::getImageData(bool & updated)
 
     getImageDataCount_ = imageDataCount_;
 
+    width = width_;
+    height = height_;
+
     return imageData_;
 }
 
-void SVGStreamSource::setImageData(QByteArray imageData)
+bool SVGStreamSource::setImageData(QByteArray imageData)
 {
     QMutexLocker locker(&imageDataMutex_);
 
-    // only take the update if the image data has changed
-    if(imageData_ != imageData)
+    return updateImageData(imageData, qHash(imageData));
+}
+
+bool SVGStreamSource::applyPatch(QByteArray patchData, bool & rejected)
+{
+    rejected = true;
+
+    if(patchData.size() < (int)sizeof(SVGStreamPatch))
     {
-        imageData_ = imageData;
-        imageDataCount_++;
+        put_flog(LOG_ERROR, "invalid patch for %s", uri_.c_str());
+        return false;
     }
+
+    SVGStreamPatch * patch = (SVGStreamPatch *)patchData.data();
+
+    QMutexLocker locker(&imageDataMutex_);
+
+    // the patch must be made from the current image data
+    if(patch->baseHash != imageDataHash_ || patch->offset < 0 || patch->removeLength < 0 || patch->offset + patch->removeLength > imageData_.size())
+    {
+        put_flog(LOG_ERROR, "patch for %s does not apply to the current image data", uri_.c_str());
+        return false;
+    }
+
+    QByteArray imageData = imageData_.left(patch->offset) + patchData.mid(sizeof(SVGStreamPatch)) + imageData_.mid(patch->offset + patch->removeLength);
+
+    uint imageDataHash = qHash(imageData);
+
+    if(imageDataHash != patch->hash)
+    {
+        put_flog(LOG_ERROR, "patched image data for %s does not match its hash", uri_.c_str());
+        return false;
+    }
+
+    rejected = false;
+
+    return updateImageData(imageData, imageDataHash);
+}
+
+bool SVGStreamSource::updateImageData(QByteArray imageData, uint imageDataHash)
+{
+    // only take the update if the image data has changed; the hash rules out most changes without comparing the data
+    if(imageDataHash == imageDataHash_ && imageData == imageData_)
+    {
+        return false;
+    }
+
+    // the dimensions are read here, in the network thread, from the root element only
+    int width, height;
+    QRectF viewBox;
+
+    if(SVG::getImageInfo(imageData, width, height, viewBox) != true)
+    {
+        put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
+        return false;
+    }
+
+    imageData_ = imageData;
+    imageDataHash_ = imageDataHash;
+    width_ = width;
+    height_ = height;
+    imageDataCount_++;
+
+    return true;
 }
 
 Factory<SVGStreamSource> g_SVGStreamSourceFactory;
@@ -48,21 +48,32 @@ class SVGStreamSource {
 
         SVGStreamSource(std::string uri);
 
-        QByteArray getImageData(bool & updated);
-        void setImageData(QByteArray imageData);
+        // image data and its dimensions
+        QByteArray getImageData(bool & updated, int & width, int & height);
+
+        // these return false if the update was not taken
+        // applyPatch() sets rejected if the patch does not apply to the current image data
+        bool setImageData(QByteArray imageData);
+        bool applyPatch(QByteArray patchData, bool & rejected);
 
     private:
 
         // SVG stream source identifier
         std::string uri_;
 
-        // image data, mutex for accessing it, and counter for updates
+        // image data, its hash and dimensions, mutex for accessing them, and counter for updates
         QMutex imageDataMutex_;
         QByteArray imageData_;
+        uint imageDataHash_;
+        int width_;
+        int height_;
         long imageDataCount_;
 
         // imageDataCount of last retrieval via getImageData()
         long getImageDataCount_;
+
+        // called with imageDataMutex_ locked
+        bool updateImageData(QByteArray imageData, uint imageDataHash);
 };
 
 // global SVG stream source factory
@@ -40,29 +40,75 @@
 #include "main.h"
 #include "log.h"
 
+long Texture::uploadFrameCount_ = -1;
+int Texture::uploadBytes_ = 0;
+
+TextureLoadJob::TextureLoadJob(boost::shared_ptr<TextureLoad> load)
+{
+    load_ = load;
+}
+
+void TextureLoadJob::run()
+{
+    // the same load may be queued more than once (at a higher priority when it comes on screen); only the first job to run decodes
+    if(load_->state.testAndSetOrdered(TEXTURE_LOAD_QUEUED, TEXTURE_LOAD_RUNNING) != true)
+    {
+        return;
+    }
+
+    QImage image(load_->uri.c_str());
+
+    if(image.isNull() == true)
+    {
+        put_flog(LOG_ERROR, "error loading %s", load_->uri.c_str());
+        load_->state.fetchAndStoreRelease(TEXTURE_LOAD_FAILED);
+        return;
+    }
+
+    // convert here rather than on the render thread
+    load_->image = QGLWidget::convertToGLFormat(image);
+
+    load_->state.fetchAndStoreRelease(TEXTURE_LOAD_DONE);
+}
+
 Texture::Texture(std::string uri)
 {
     // defaults
+    imageWidth_ = 0;
+    imageHeight_ = 0;
     textureBound_ = false;
+    textureId_ = 0;
+    onScreenLoadStarted_ = false;
 
     // assign values
     uri_ = uri;
 
-    QImage image(uri_.c_str());
+    load_ = boost::shared_ptr<TextureLoad>(new TextureLoad());
+    load_->uri = uri;
 
-    if(image.isNull() == true)
+    // only read the image dimensions here; the image is decoded in the background once it's rendered
+    QImageReader imageReader(uri_.c_str());
+
+    QSize size = imageReader.size();
+
+    if(size.isValid() != true)
     {
-        put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
-        return;
+        // not all formats report their size without decoding
+        QImage image(uri_.c_str());
+
+        if(image.isNull() == true)
+        {
+            put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
+            load_->state.fetchAndStoreRelease(TEXTURE_LOAD_FAILED);
+            return;
+        }
+
+        size = image.size();
     }
 
     // save image dimensions
-    imageWidth_ = image.width();
-    imageHeight_ = image.height();
-
-    // generate new texture
-    textureId_ = g_mainWindow->getGLWindow()->bindTexture(image, GL_TEXTURE_2D, GL_RGBA, QGLContext::DefaultBindOption);
-    textureBound_ = true;
+    imageWidth_ = size.width();
+    imageHeight_ = size.height();
 }
 
 Texture::~Texture()
@@ -70,8 +116,9 @@ Texture::~Texture()
     // delete bound texture
     if(textureBound_ == true)
     {
-        glDeleteTextures(1, &textureId_); // it appears deleteTexture() below is not actually deleting the texture from the GPU...
-        g_mainWindow->getGLWindow()->deleteTexture(textureId_);
+        g_mainWindow->getGLWindow()->getPixelBufferUploader().cancel(textureId_);
+
+        glDeleteTextures(1, &textureId_);
         textureBound_ = false;
     }
 }
@@ -86,35 +133,166 @@ void Texture::render(float tX, float tY, float tW, float tH)
 {
     updateRenderedFrameCount();
 
-    if(textureBound_ == true)
+    if(textureBound_ != true)
     {
-        // draw the texture
-        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+        int state = load_->state.fetchAndAddAcquire(0);
 
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, textureId_);
+        if(state == TEXTURE_LOAD_FAILED)
+        {
+            return;
+        }
 
-        // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if(state == TEXTURE_LOAD_DONE && uploadTexture() == true)
+        {
+            // fall through and draw the texture
+        }
+        else
+        {
+            if(state == TEXTURE_LOAD_IDLE || state == TEXTURE_LOAD_QUEUED)
+            {
+                boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
 
-        glBegin(GL_QUADS);
+                QRectF windowRect(0., 0., (double)glWindow->getViewportWidth(), (double)glWindow->getViewportHeight());
 
+                startLoad(glWindow->getContentPixelRect().normalized().intersects(windowRect));
+            }
+
+            drawPlaceholder();
+            return;
+        }
+    }
+
+    // the texture is specified from its pixel buffer in the next frame
+    if(g_mainWindow->getGLWindow()->getPixelBufferUploader().isPending(textureId_) == true)
+    {
+        drawPlaceholder();
+        return;
+    }
+
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+
+    if(glWindow->getRetainedRendering() == true)
+    {
         // note we need to flip the y coordinate since the textures are loaded upside down
-        glTexCoord2f(tX,1.-tY);
-        glVertex2f(0.,0.);
+        glWindow->getRenderList().addTexturedQuad(textureId_, QRectF(0.,0.,1.,1.), QRectF(tX, 1.-tY, tW, -tH));
+        return;
+    }
+
+    // draw the texture
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, textureId_);
+
+    glBegin(GL_QUADS);
+
+    // note we need to flip the y coordinate since the textures are loaded upside down
+    glTexCoord2f(tX,1.-tY);
+    glVertex2f(0.,0.);
 
-        glTexCoord2f(tX+tW,1.-tY);
-        glVertex2f(1.,0.);
+    glTexCoord2f(tX+tW,1.-tY);
+    glVertex2f(1.,0.);
 
-        glTexCoord2f(tX+tW,1.-(tY+tH));
-        glVertex2f(1.,1.);
+    glTexCoord2f(tX+tW,1.-(tY+tH));
+    glVertex2f(1.,1.);
 
-        glTexCoord2f(tX,1.-(tY+tH));
-        glVertex2f(0.,1.);
+    glTexCoord2f(tX,1.-(tY+tH));
+    glVertex2f(0.,1.);
 
-        glEnd();
+    glEnd();
 
-        glPopAttrib();
+    glPopAttrib();
+}
+
+void Texture::startLoad(bool onScreen)
+{
+    if(load_->state.testAndSetOrdered(TEXTURE_LOAD_IDLE, TEXTURE_LOAD_QUEUED) == true)
+    {
+        onScreenLoadStarted_ = onScreen;
+
+        QThreadPool::globalInstance()->start(new TextureLoadJob(load_), onScreen == true ? TEXTURE_ON_SCREEN_LOAD_PRIORITY : TEXTURE_OFF_SCREEN_LOAD_PRIORITY);
+    }
+    else if(onScreen == true && onScreenLoadStarted_ != true)
+    {
+        // the image was queued while off screen; queue it again at the on-screen priority, and whichever job runs first does the decode
+        onScreenLoadStarted_ = true;
+
+        QThreadPool::globalInstance()->start(new TextureLoadJob(load_), TEXTURE_ON_SCREEN_LOAD_PRIORITY);
+    }
+}
+
+bool Texture::uploadTexture()
+{
+    int numBytes = load_->image.byteCount();
+
+    // limit the bytes uploaded per frame so many images finishing at once don't stall a frame;
+    // the first upload of a frame is always allowed
+    if(uploadFrameCount_ != g_frameCount)
+    {
+        uploadFrameCount_ = g_frameCount;
+        uploadBytes_ = 0;
+    }
+    else if(uploadBytes_ + numBytes > TEXTURE_MAX_UPLOAD_BYTES_PER_FRAME)
+    {
+        return false;
+    }
+
+    PixelBufferUploader & uploader = g_mainWindow->getGLWindow()->getPixelBufferUploader();
+
+    if(uploader.canUpload() != true)
+    {
+        return false;
+    }
+
+    uploadBytes_ += numBytes;
+
+    glGenTextures(1, &textureId_);
+    glBindTexture(GL_TEXTURE_2D, textureId_);
+
+    // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // same filtering as the default bindTexture() options
+    glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // the driver can transfer the image asynchronously
+    uploader.upload(textureId_, load_->image);
+
+    textureBound_ = true;
+
+    // the decoded image is no longer needed
+    load_->image = QImage();
+
+    return true;
+}
+
+void Texture::drawPlaceholder()
+{
+    // drawn until the image has been decoded and uploaded
+    boost::shared_ptr<GLWindow> glWindow = g_mainWindow->getActiveGLWindow();
+
+    if(glWindow->getRetainedRendering() == true)
+    {
+        glWindow->getRenderList().setColor(0.25,0.25,0.25,1.);
+        glWindow->getRenderList().addQuad(QRectF(0.,0.,1.,1.));
+        return;
     }
+
+    glPushAttrib(GL_CURRENT_BIT);
+
+    glColor4f(0.25,0.25,0.25,1.);
+
+    glBegin(GL_QUADS);
+
+    glVertex2f(0.,0.);
+    glVertex2f(1.,0.);
+    glVertex2f(1.,1.);
+    glVertex2f(0.,1.);
+
+    glEnd();
+
+    glPopAttrib();
 }
@@ -41,6 +41,42 @@
 
 #include "FactoryObject.h"
 #include <QGLWidget>
+#include <QtCore>
+#include <boost/shared_ptr.hpp>
+
+// thread pool priorities for decoding images; images visible on the screen are decoded first
+#define TEXTURE_ON_SCREEN_LOAD_PRIORITY 1
+#define TEXTURE_OFF_SCREEN_LOAD_PRIORITY 0
+
+// maximum number of bytes uploaded to the GPU per frame (at least one image is always uploaded)
+#define TEXTURE_MAX_UPLOAD_BYTES_PER_FRAME (32*1024*1024)
+
+enum TEXTURE_LOAD_STATE { TEXTURE_LOAD_IDLE, TEXTURE_LOAD_QUEUED, TEXTURE_LOAD_RUNNING, TEXTURE_LOAD_DONE, TEXTURE_LOAD_FAILED };
+
+// image decode state shared between a texture and its decode jobs, so jobs can outlive the texture
+struct TextureLoad {
+
+    std::string uri;
+
+    // TEXTURE_LOAD_STATE
+    QAtomicInt state;
+
+    // decoded image, already converted to OpenGL format; valid once state is TEXTURE_LOAD_DONE
+    QImage image;
+};
+
+class TextureLoadJob : public QRunnable {
+
+    public:
+
+        TextureLoadJob(boost::shared_ptr<TextureLoad> load);
+
+        void run();
+
+    private:
+
+        boost::shared_ptr<TextureLoad> load_;
+};
 
 class Texture : public FactoryObject {
 
@@ -64,6 +100,18 @@ class Texture : public FactoryObject {
         // texture information
         bool textureBound_;
         GLuint textureId_;
+
+        // background image decode
+        boost::shared_ptr<TextureLoad> load_;
+        bool onScreenLoadStarted_;
+
+        // per-frame upload budget, shared by all textures
+        static long uploadFrameCount_;
+        static int uploadBytes_;
+
+        void startLoad(bool onScreen);
+        bool uploadTexture();
+        void drawPlaceholder();
 };
 
 #endif
@@ -52,6 +52,11 @@ void TextureContent::getFactoryObjectDimensions(int &width, int &height)
     g_mainWindow->getGLWindow()->getTextureFactory().getObject(getURI())->getDimensions(width, height);
 }
 
+void TextureContent::touchFactoryObject()
+{
+    g_mainWindow->getGLWindow()->getTextureFactory().touchObject(getURI());
+}
+
 void TextureContent::renderFactoryObject(float tX, float tY, float tW, float tH)
 {
     g_mainWindow->getGLWindow()->getTextureFactory().getObject(getURI())->render(tX, tY, tW, tH);
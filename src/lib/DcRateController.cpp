@@ -0,0 +1,271 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DcRateController.h"
+#include "../log.h"
+#include <algorithm>
+
+DcRateController::DcRateController()
+{
+    // defaults
+    statistics_.enabled = false;
+    statistics_.targetFrameRate = 30.;
+
+    statistics_.jpegQuality = DC_RATE_CONTROLLER_DEFAULT_JPEG_QUALITY;
+    statistics_.chromaSubsampling = DC_RATE_CONTROLLER_DEFAULT_CHROMA_SUBSAMPLING;
+    statistics_.segmentSizeFactor = 1;
+
+    statistics_.frameTime = 0.;
+    statistics_.ackLatency = 0.;
+    statistics_.bytesPerFrame = 0.;
+    statistics_.segmentsPerFrame = 0.;
+    statistics_.segmentBacklog = 0;
+    statistics_.bufferedBytes = 0;
+    statistics_.bufferBudget = 0;
+    statistics_.throttled = false;
+
+    statistics_.numFrames = 0;
+    statistics_.numDecreases = 0;
+    statistics_.numIncreases = 0;
+    statistics_.lastDecision = RATE_CONTROL_HOLD;
+
+    framesSinceDecision_ = 0;
+}
+
+void DcRateController::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&mutex_);
+
+    statistics_.enabled = enabled;
+
+    // start over from the default settings either way
+    statistics_.jpegQuality = DC_RATE_CONTROLLER_DEFAULT_JPEG_QUALITY;
+    statistics_.chromaSubsampling = DC_RATE_CONTROLLER_DEFAULT_CHROMA_SUBSAMPLING;
+    statistics_.segmentSizeFactor = 1;
+    statistics_.lastDecision = RATE_CONTROL_HOLD;
+
+    framesSinceDecision_ = 0;
+}
+
+void DcRateController::setTargetFrameRate(float targetFrameRate)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(targetFrameRate <= 0.)
+    {
+        put_flog(LOG_ERROR, "invalid target frame rate %f", targetFrameRate);
+        return;
+    }
+
+    statistics_.targetFrameRate = targetFrameRate;
+}
+
+void DcRateController::recordAck(int latency, StreamStatus * streamStatus)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(statistics_.ackLatency == 0.)
+    {
+        statistics_.ackLatency = latency;
+    }
+    else
+    {
+        statistics_.ackLatency = (1. - DC_RATE_CONTROLLER_SMOOTHING) * statistics_.ackLatency + DC_RATE_CONTROLLER_SMOOTHING * (float)latency;
+    }
+
+    if(streamStatus != NULL)
+    {
+        statistics_.segmentBacklog = streamStatus->segmentBacklog;
+        statistics_.bufferedBytes = streamStatus->bufferedBytes;
+        statistics_.bufferBudget = streamStatus->bufferBudget;
+        statistics_.throttled = (streamStatus->throttle != 0);
+    }
+}
+
+void DcRateController::recordFrame(int elapsed, int numBytes, int numSegments, bool waitedForAcks)
+{
+    QMutexLocker locker(&mutex_);
+
+    // if we didn't wait for acknowledgments, the frame isn't done until they arrive
+    float frameTime = (float)elapsed;
+
+    if(waitedForAcks != true)
+    {
+        frameTime = std::max(frameTime, statistics_.ackLatency);
+    }
+
+    if(statistics_.numFrames == 0)
+    {
+        statistics_.frameTime = frameTime;
+        statistics_.bytesPerFrame = (float)numBytes;
+        statistics_.segmentsPerFrame = (float)numSegments;
+    }
+    else
+    {
+        statistics_.frameTime = (1. - DC_RATE_CONTROLLER_SMOOTHING) * statistics_.frameTime + DC_RATE_CONTROLLER_SMOOTHING * frameTime;
+        statistics_.bytesPerFrame = (1. - DC_RATE_CONTROLLER_SMOOTHING) * statistics_.bytesPerFrame + DC_RATE_CONTROLLER_SMOOTHING * (float)numBytes;
+        statistics_.segmentsPerFrame = (1. - DC_RATE_CONTROLLER_SMOOTHING) * statistics_.segmentsPerFrame + DC_RATE_CONTROLLER_SMOOTHING * (float)numSegments;
+    }
+
+    statistics_.numFrames++;
+    framesSinceDecision_++;
+
+    if(statistics_.enabled == true && framesSinceDecision_ >= DC_RATE_CONTROLLER_DECISION_INTERVAL)
+    {
+        decide();
+
+        framesSinceDecision_ = 0;
+    }
+}
+
+int DcRateController::getJpegQuality()
+{
+    QMutexLocker locker(&mutex_);
+
+    return statistics_.jpegQuality;
+}
+
+CHROMA_SUBSAMPLING DcRateController::getChromaSubsampling()
+{
+    QMutexLocker locker(&mutex_);
+
+    return statistics_.chromaSubsampling;
+}
+
+int DcRateController::getSegmentSizeFactor()
+{
+    QMutexLocker locker(&mutex_);
+
+    return statistics_.segmentSizeFactor;
+}
+
+DcStreamRateStatistics DcRateController::getStatistics()
+{
+    QMutexLocker locker(&mutex_);
+
+    return statistics_;
+}
+
+void DcRateController::decide()
+{
+    float targetFrameTime = 1000. / statistics_.targetFrameRate;
+
+    // the server backlog, in frames
+    float backlogFrames = (float)statistics_.segmentBacklog / std::max(statistics_.segmentsPerFrame, 1.f);
+
+    statistics_.lastDecision = RATE_CONTROL_HOLD;
+
+    if(statistics_.frameTime > DC_RATE_CONTROLLER_DECREASE_THRESHOLD * targetFrameTime || backlogFrames > DC_RATE_CONTROLLER_MAX_BACKLOG_FRAMES || statistics_.throttled == true)
+    {
+        if(decrease() == true)
+        {
+            statistics_.lastDecision = RATE_CONTROL_DECREASE;
+            statistics_.numDecreases++;
+        }
+    }
+    else if(statistics_.frameTime < DC_RATE_CONTROLLER_INCREASE_THRESHOLD * targetFrameTime && backlogFrames <= 1. && statistics_.throttled != true)
+    {
+        if(increase() == true)
+        {
+            statistics_.lastDecision = RATE_CONTROL_INCREASE;
+            statistics_.numIncreases++;
+        }
+    }
+
+    if(statistics_.lastDecision != RATE_CONTROL_HOLD)
+    {
+        put_flog(LOG_DEBUG, "%s: frame time %f ms (target %f ms), ack latency %f ms, %f bytes / frame, backlog %f frames, throttled %i. quality = %i, subsampling = %i, segment size factor = %i", statistics_.lastDecision == RATE_CONTROL_DECREASE ? "decrease" : "increase", statistics_.frameTime, targetFrameTime, statistics_.ackLatency, statistics_.bytesPerFrame, backlogFrames, (int)statistics_.throttled, statistics_.jpegQuality, statistics_.chromaSubsampling, statistics_.segmentSizeFactor);
+    }
+}
+
+bool DcRateController::decrease()
+{
+    // reduce quality first, then chroma resolution, then quality again, and
+    // finally use larger segments to reduce per-message overhead
+    if(statistics_.jpegQuality > DC_RATE_CONTROLLER_SUBSAMPLING_JPEG_QUALITY)
+    {
+        statistics_.jpegQuality = std::max(statistics_.jpegQuality - DC_RATE_CONTROLLER_JPEG_QUALITY_STEP, DC_RATE_CONTROLLER_SUBSAMPLING_JPEG_QUALITY);
+    }
+    else if(statistics_.chromaSubsampling != SUBSAMPLING_420)
+    {
+        statistics_.chromaSubsampling = (CHROMA_SUBSAMPLING)(statistics_.chromaSubsampling + 1);
+    }
+    else if(statistics_.jpegQuality > DC_RATE_CONTROLLER_MIN_JPEG_QUALITY)
+    {
+        statistics_.jpegQuality = std::max(statistics_.jpegQuality - DC_RATE_CONTROLLER_JPEG_QUALITY_STEP, DC_RATE_CONTROLLER_MIN_JPEG_QUALITY);
+    }
+    else if(statistics_.segmentSizeFactor < DC_RATE_CONTROLLER_MAX_SEGMENT_SIZE_FACTOR)
+    {
+        statistics_.segmentSizeFactor *= 2;
+    }
+    else
+    {
+        // nothing left to reduce
+        return false;
+    }
+
+    return true;
+}
+
+bool DcRateController::increase()
+{
+    // the reverse of decrease()
+    if(statistics_.segmentSizeFactor > 1)
+    {
+        statistics_.segmentSizeFactor /= 2;
+    }
+    else if(statistics_.chromaSubsampling == SUBSAMPLING_420 && statistics_.jpegQuality < DC_RATE_CONTROLLER_SUBSAMPLING_JPEG_QUALITY)
+    {
+        statistics_.jpegQuality = std::min(statistics_.jpegQuality + DC_RATE_CONTROLLER_JPEG_QUALITY_STEP, DC_RATE_CONTROLLER_SUBSAMPLING_JPEG_QUALITY);
+    }
+    else if(statistics_.chromaSubsampling != SUBSAMPLING_444)
+    {
+        statistics_.chromaSubsampling = (CHROMA_SUBSAMPLING)(statistics_.chromaSubsampling - 1);
+    }
+    else if(statistics_.jpegQuality < DC_RATE_CONTROLLER_MAX_JPEG_QUALITY)
+    {
+        statistics_.jpegQuality = std::min(statistics_.jpegQuality + DC_RATE_CONTROLLER_JPEG_QUALITY_STEP, DC_RATE_CONTROLLER_MAX_JPEG_QUALITY);
+    }
+    else
+    {
+        // already at the best settings
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,114 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DC_RATE_CONTROLLER_H
+#define DC_RATE_CONTROLLER_H
+
+#include "dcStream.h"
+#include "../StreamStatus.h"
+#include <QtCore>
+
+// settings used when rate control is disabled, and the starting point when it is enabled
+#define DC_RATE_CONTROLLER_DEFAULT_JPEG_QUALITY 75
+#define DC_RATE_CONTROLLER_DEFAULT_CHROMA_SUBSAMPLING SUBSAMPLING_444
+
+// bounds of the controlled settings
+#define DC_RATE_CONTROLLER_MIN_JPEG_QUALITY 30
+#define DC_RATE_CONTROLLER_MAX_JPEG_QUALITY 90
+#define DC_RATE_CONTROLLER_JPEG_QUALITY_STEP 5
+#define DC_RATE_CONTROLLER_MAX_SEGMENT_SIZE_FACTOR 4
+
+// quality is only lowered past this point after chroma subsampling has been maximized
+#define DC_RATE_CONTROLLER_SUBSAMPLING_JPEG_QUALITY 60
+
+// number of frames between decisions; allows the effect of the last decision to be measured
+#define DC_RATE_CONTROLLER_DECISION_INTERVAL 10
+
+// weight of a new sample in the moving averages
+#define DC_RATE_CONTROLLER_SMOOTHING 0.2
+
+// frame time thresholds, relative to the target frame time
+#define DC_RATE_CONTROLLER_DECREASE_THRESHOLD 1.1
+#define DC_RATE_CONTROLLER_INCREASE_THRESHOLD 0.7
+
+// backlog (in frames) reported by the server above which we reduce our bandwidth
+#define DC_RATE_CONTROLLER_MAX_BACKLOG_FRAMES 2.
+
+// the rate controller is fed measurements by the socket thread (acknowledgments)
+// and the sending thread (frames), so all access is protected by a mutex.
+
+class DcRateController {
+
+    public:
+
+        DcRateController();
+
+        void setEnabled(bool enabled);
+        void setTargetFrameRate(float targetFrameRate);
+
+        // record an acknowledgment received latency milliseconds after its message was queued,
+        // with the stream status reported with it (NULL if none was reported).
+        void recordAck(int latency, StreamStatus * streamStatus);
+
+        // record a frame of numSegments segments and numBytes compressed bytes, which took
+        // elapsed milliseconds to compress and send. waitedForAcks indicates whether elapsed
+        // includes waiting for the acknowledgments.
+        void recordFrame(int elapsed, int numBytes, int numSegments, bool waitedForAcks);
+
+        int getJpegQuality();
+        CHROMA_SUBSAMPLING getChromaSubsampling();
+        int getSegmentSizeFactor();
+
+        DcStreamRateStatistics getStatistics();
+
+    private:
+
+        QMutex mutex_;
+
+        // current settings, averages and decisions
+        DcStreamRateStatistics statistics_;
+
+        int framesSinceDecision_;
+
+        // these are called with mutex_ locked
+        void decide();
+        bool decrease();
+        bool increase();
+};
+
+#endif
@@ -38,6 +38,7 @@
 
 #include "DcSocket.h"
 #include "../NetworkProtocol.h"
+#include "../StreamStatus.h"
 #include "../log.h"
 #include <QtNetwork/QTcpSocket>
 
@@ -76,6 +77,12 @@ bool DcSocket::queueMessage(QByteArray message)
     {
         QMutexLocker locker(&sendMessagesQueueMutex_);
         sendMessagesQueue_.push(message);
+
+        // every message is acknowledged
+        QTime ackTime;
+        ackTime.start();
+
+        ackTimes_.push(ackTime);
     }
 
     return true;
@@ -101,6 +108,18 @@ InteractionState DcSocket::getInteractionState()
     return interactionState_;
 }
 
+bool DcSocket::takeSVGPatchRejected(std::string name)
+{
+    QMutexLocker locker(&svgPatchRejectedMutex_);
+
+    return svgPatchRejected_.erase(name) > 0;
+}
+
+DcRateController & DcSocket::getRateController()
+{
+    return rateController_;
+}
+
 bool DcSocket::connect(const char * hostname)
 {
     // make sure we're disconnected
@@ -108,6 +127,7 @@ bool DcSocket::connect(const char * hostname)
 
     // reset everything
     sendMessagesQueue_ = std::queue<QByteArray>();
+    ackTimes_ = std::queue<QTime>();
     ackSemaphore_.acquire(ackSemaphore_.available()); // should reset semaphore to 0
     disconnectFlag_ = false;
 
@@ -239,6 +259,29 @@ void DcSocket::run()
                 // handle the message
                 if(messageHeader.type == MESSAGE_TYPE_ACK)
                 {
+                    // acknowledgment latency
+                    int latency = 0;
+
+                    {
+                        QMutexLocker locker(&sendMessagesQueueMutex_);
+
+                        if(ackTimes_.size() > 0)
+                        {
+                            latency = ackTimes_.front().elapsed();
+                            ackTimes_.pop();
+                        }
+                    }
+
+                    // the stream status is only included for some message types
+                    StreamStatus * streamStatus = NULL;
+
+                    if(message.size() >= (int)sizeof(StreamStatus))
+                    {
+                        streamStatus = (StreamStatus *)(message.data());
+                    }
+
+                    rateController_.recordAck(latency, streamStatus);
+
                     ackSemaphore_.release(1);
                 }
                 else if(messageHeader.type == MESSAGE_TYPE_INTERACTION)
@@ -246,6 +289,12 @@ void DcSocket::run()
                     QMutexLocker locker(&interactionStateMutex_);
                     interactionState_ = *(InteractionState *)(message.data());
                 }
+                else if(messageHeader.type == MESSAGE_TYPE_SVG_STREAM_PATCH_REJECTED)
+                {
+                    // received before the acknowledgment of the rejected patch
+                    QMutexLocker locker(&svgPatchRejectedMutex_);
+                    svgPatchRejected_.insert(std::string(messageHeader.uri));
+                }
                 else
                 {
                     put_flog(LOG_ERROR, "unknown message header type");
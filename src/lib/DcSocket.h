@@ -41,8 +41,11 @@
 
 #include "../MessageHeader.h"
 #include "../InteractionState.h"
+#include "DcRateController.h"
 #include <QtCore>
 #include <queue>
+#include <set>
+#include <string>
 
 class QTcpSocket;
 
@@ -66,6 +69,11 @@ class DcSocket : public QThread {
 
         InteractionState getInteractionState();
 
+        // returns true (once) if the server rejected an SVG patch for the stream name since the last call
+        bool takeSVGPatchRejected(std::string name);
+
+        DcRateController & getRateController();
+
     protected:
 
         QTcpSocket * socket_;
@@ -74,6 +82,9 @@ class DcSocket : public QThread {
         QMutex sendMessagesQueueMutex_;
         std::queue<QByteArray> sendMessagesQueue_;
 
+        // times at which messages awaiting acknowledgment were queued (also protected by sendMessagesQueueMutex_)
+        std::queue<QTime> ackTimes_;
+
         // semaphore for ack count
         QSemaphore ackSemaphore_;
 
@@ -85,6 +96,13 @@ class DcSocket : public QThread {
         QMutex interactionStateMutex_;
         InteractionState interactionState_;
 
+        // names of SVG streams whose patches were rejected by the server
+        QMutex svgPatchRejectedMutex_;
+        std::set<std::string> svgPatchRejected_;
+
+        // rate controller, fed with acknowledgment latencies and stream status from the server
+        DcRateController rateController_;
+
         // socket connections
         bool connect(const char * hostname);
         void disconnect();
@@ -40,6 +40,7 @@
 #include "DcSocket.h"
 #include "../MessageHeader.h"
 #include "../ParallelPixelStreamSegmentParameters.h"
+#include "../SVGStreamPatch.h"
 #include "../log.h"
 #include <QtCore>
 #include <cmath>
@@ -59,15 +60,32 @@ struct DcImage {
     int pitch;
     int height;
     PIXEL_FORMAT pixelFormat;
+    int jpegQuality;
+    CHROMA_SUBSAMPLING chromaSubsampling;
     char * jpegData;
     int jpegSize;
 };
 
+// the whole document is sent after this many consecutive patches, in case the host has lost track of it
+#define DC_STREAM_SVG_MAX_CONSECUTIVE_PATCHES 100
+
+// last SVG document sent for a stream name, its hash, and the number of patches sent since the whole document was
+struct DcSVGDocument {
+    QByteArray document;
+    uint hash;
+    int numPatches;
+};
+
+// last SVG documents sent over each socket for each stream name, for skipping identical documents and computing patches
+std::map<DcSocket *, std::map<std::string, DcSVGDocument> > g_dcStreamSVGDocuments;
+
 // enum PIXEL_FORMAT { RGB, RGBA, ARGB, BGR, BGRA, ABGR };
 int dcBytesPerPixel[] = { 3, 4, 4, 3, 4, 4 };
 
 DcImage dcStreamComputeJpegMapped(const DcImage & dcImage);
 
+bool dcStreamSendSVGDocument(DcSocket * socket, std::string name, const char * svgData, int svgSize, bool allowPatch);
+
 
 DcSocket * dcStreamConnect(const char * hostname)
 {
@@ -87,6 +105,9 @@ DcSocket * dcStreamConnect(const char * hostname)
 
 void dcStreamDisconnect(DcSocket * socket)
 {
+    // a new socket may be allocated at the same address, and its host won't have these documents
+    g_dcStreamSVGDocuments.erase(socket);
+
     delete socket;
 
     socket = NULL;
@@ -179,7 +200,20 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
     char * jpegData = NULL;
     int jpegSize = 0;
 
-    bool success = dcStreamComputeJpeg(segmentImageBuffer, parameters.width, imagePitch, parameters.height, pixelFormat, &jpegData, jpegSize);
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return false;
+    }
+
+    // time the frame for rate control
+    QTime frameTime;
+    frameTime.start();
+
+    DcRateController & rateController = socket->getRateController();
+
+    bool success = dcStreamComputeJpeg(segmentImageBuffer, parameters.width, imagePitch, parameters.height, pixelFormat, &jpegData, jpegSize, rateController.getJpegQuality(), rateController.getChromaSubsampling());
 
     if(success == false)
     {
@@ -189,6 +223,9 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
 
     success = dcStreamSendJpeg(socket, parameters, jpegData, jpegSize, false);
 
+    // we didn't wait for the acknowledgment, so the rate controller accounts for its latency separately
+    rateController.recordFrame(frameTime.elapsed(), jpegSize, 1, false);
+
     free(jpegData);
     return success;
 }
@@ -201,6 +238,22 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
         imagePitch = imageWidth * dcBytesPerPixel[pixelFormat];
     }
 
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return false;
+    }
+
+    // time the frame for rate control
+    QTime frameTime;
+    frameTime.start();
+
+    DcRateController & rateController = socket->getRateController();
+
+    int jpegQuality = rateController.getJpegQuality();
+    CHROMA_SUBSAMPLING chromaSubsampling = rateController.getChromaSubsampling();
+
     // compute JPEGs from imageBuffer corresponding to parameters vector
     std::vector<DcImage> dcImages;
 
@@ -217,6 +270,8 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
         d.pitch = imagePitch;
         d.height = parameters[i].height;
         d.pixelFormat = pixelFormat;
+        d.jpegQuality = jpegQuality;
+        d.chromaSubsampling = chromaSubsampling;
         d.jpegData = NULL;
         d.jpegSize = 0;
 
@@ -230,6 +285,8 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
     // send each segment, and return true if we were successful for all segments
     bool allSuccess = true;
 
+    int frameBytes = 0;
+
     for(unsigned int i=0; i<dcImages.size(); i++)
     {
         // jpegSize == 0 indicates an error
@@ -239,6 +296,8 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
         }
         else
         {
+            frameBytes += dcImages[i].jpegSize;
+
             bool sendSuccess = dcStreamSendJpeg(socket, parameters[i], dcImages[i].jpegData, dcImages[i].jpegSize, false);
 
             if(sendSuccess == false)
@@ -253,6 +312,8 @@ bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, in
     // wait for acks for all segments
     socket->waitForAck(dcImages.size());
 
+    rateController.recordFrame(frameTime.elapsed(), frameBytes, dcImages.size(), true);
+
     return allSuccess;
 }
 
@@ -324,7 +385,7 @@ bool dcStreamSendJpeg(DcSocket * socket, DcStreamParameters parameters, const ch
     return success;
 }
 
-bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize)
+bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize, int jpegQuality, CHROMA_SUBSAMPLING chromaSubsampling)
 {
     // use libjpeg-turbo for JPEG conversion
 
@@ -363,6 +424,27 @@ bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int
             break;
         default:
             put_flog(LOG_ERROR, "unknown pixel format");
+            tjDestroy(tjHandle);
+            return false;
+    }
+
+    // map chroma subsampling to the libjpeg-turbo equivalent
+    int tjJpegSubsamp;
+
+    switch(chromaSubsampling)
+    {
+        case SUBSAMPLING_444:
+            tjJpegSubsamp = TJSAMP_444;
+            break;
+        case SUBSAMPLING_422:
+            tjJpegSubsamp = TJSAMP_422;
+            break;
+        case SUBSAMPLING_420:
+            tjJpegSubsamp = TJSAMP_420;
+            break;
+        default:
+            put_flog(LOG_ERROR, "unknown chroma subsampling");
+            tjDestroy(tjHandle);
             return false;
     }
 
@@ -370,8 +452,7 @@ bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int
     unsigned char * tjJpegBufPtr = NULL;
     tjJpegBuf = &tjJpegBufPtr;
     unsigned long tjJpegSize = 0;
-    int tjJpegSubsamp = TJSAMP_444;
-    int tjJpegQual = 75;
+    int tjJpegQual = jpegQuality;
     int tjFlags = TJFLAG_BOTTOMUP;
 
     int success = tjCompress2(tjHandle, imageBuffer, width, pitch, height, tjPixelFormat, tjJpegBuf, &tjJpegSize, tjJpegSubsamp, tjJpegQual, tjFlags);
@@ -412,6 +493,16 @@ void dcStreamSetFrameIndex(int frameIndex)
 }
 
 bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData, int svgSize)
+{
+    return dcStreamSendSVGDocument(socket, name, svgData, svgSize, false);
+}
+
+bool dcStreamSendSVGPatch(DcSocket * socket, std::string name, const char * svgData, int svgSize)
+{
+    return dcStreamSendSVGDocument(socket, name, svgData, svgSize, true);
+}
+
+bool dcStreamSendSVGDocument(DcSocket * socket, std::string name, const char * svgData, int svgSize, bool allowPatch)
 {
     if(socket == NULL)
     {
@@ -427,6 +518,19 @@ bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData,
         return false;
     }
 
+    QByteArray document(svgData, svgSize);
+    uint hash = qHash(document);
+
+    std::map<std::string, DcSVGDocument> & documents = g_dcStreamSVGDocuments[socket];
+
+    // identical documents aren't sent; the hash rules out most changes without comparing the documents
+    std::map<std::string, DcSVGDocument>::iterator it = documents.find(name);
+
+    if(it != documents.end() && it->second.hash == hash && it->second.document == document)
+    {
+        return true;
+    }
+
     // this byte array will hold the entire message to be sent over the socket
     QByteArray message;
 
@@ -439,11 +543,62 @@ bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData,
     size_t len = name.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
     mh.uri[len] = '\0';
 
+    SVGStreamPatch patch;
+    int insertLength = 0;
+
+    if(allowPatch == true && it != documents.end() && it->second.numPatches < DC_STREAM_SVG_MAX_CONSECUTIVE_PATCHES)
+    {
+        const char * base = it->second.document.constData();
+        int baseSize = it->second.document.size();
+
+        // the change is everything between the common prefix and the common suffix
+        int maxLength = std::min(baseSize, svgSize);
+
+        int prefixLength = 0;
+
+        while(prefixLength < maxLength && base[prefixLength] == svgData[prefixLength])
+        {
+            prefixLength++;
+        }
+
+        int suffixLength = 0;
+
+        while(suffixLength < maxLength - prefixLength && base[baseSize - 1 - suffixLength] == svgData[svgSize - 1 - suffixLength])
+        {
+            suffixLength++;
+        }
+
+        insertLength = svgSize - prefixLength - suffixLength;
+
+        // only send the patch if it is smaller than the document
+        if((int)sizeof(SVGStreamPatch) + insertLength < svgSize)
+        {
+            patch.baseHash = it->second.hash;
+            patch.hash = hash;
+            patch.offset = prefixLength;
+            patch.removeLength = baseSize - prefixLength - suffixLength;
+
+            mh.size = sizeof(SVGStreamPatch) + insertLength;
+            mh.type = MESSAGE_TYPE_SVG_STREAM_PATCH;
+        }
+    }
+
     message.append((const char *)&mh, sizeof(MessageHeader));
 
-    // message part 1: image data
-    if(svgSize > 0)
+    if(mh.type == MESSAGE_TYPE_SVG_STREAM_PATCH)
     {
+        // message part 1: patch
+        message.append((const char *)&patch, sizeof(SVGStreamPatch));
+
+        // message part 2: inserted image data
+        if(insertLength > 0)
+        {
+            message.append(svgData + patch.offset, insertLength);
+        }
+    }
+    else if(svgSize > 0)
+    {
+        // message part 1: image data
         message.append(svgData, svgSize);
     }
 
@@ -452,7 +607,35 @@ bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData,
 
     socket->waitForAck();
 
-    return success;
+    if(success != true)
+    {
+        return false;
+    }
+
+    // the host reports a rejected patch before acknowledging it
+    if(mh.type == MESSAGE_TYPE_SVG_STREAM_PATCH && socket->takeSVGPatchRejected(std::string(mh.uri)) == true)
+    {
+        put_flog(LOG_WARN, "patch for %s was rejected, sending the whole document", name.c_str());
+
+        documents.erase(name);
+
+        return dcStreamSendSVGDocument(socket, name, svgData, svgSize, false);
+    }
+
+    DcSVGDocument & sentDocument = documents[name];
+    sentDocument.document = document;
+    sentDocument.hash = hash;
+
+    if(mh.type == MESSAGE_TYPE_SVG_STREAM_PATCH)
+    {
+        sentDocument.numPatches++;
+    }
+    else
+    {
+        sentDocument.numPatches = 0;
+    }
+
+    return true;
 }
 
 bool dcStreamBindInteraction(DcSocket * socket, std::string name)
@@ -505,11 +688,48 @@ InteractionState dcStreamGetInteractionState(DcSocket * socket)
     return socket->getInteractionState();
 }
 
+void dcStreamSetRateControl(DcSocket * socket, bool enable, float targetFrameRate)
+{
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return;
+    }
+
+    socket->getRateController().setTargetFrameRate(targetFrameRate);
+    socket->getRateController().setEnabled(enable);
+}
+
+int dcStreamGetRecommendedSegmentSize(DcSocket * socket, int nominalSegmentSize)
+{
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return nominalSegmentSize;
+    }
+
+    return nominalSegmentSize * socket->getRateController().getSegmentSizeFactor();
+}
+
+DcStreamRateStatistics dcStreamGetRateStatistics(DcSocket * socket)
+{
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return DcRateController().getStatistics();
+    }
+
+    return socket->getRateController().getStatistics();
+}
+
 DcImage dcStreamComputeJpegMapped(const DcImage & dcImage)
 {
     DcImage newDcImage = dcImage;
 
-    dcStreamComputeJpeg(newDcImage.imageBuffer, newDcImage.width, newDcImage.pitch, newDcImage.height, newDcImage.pixelFormat, &newDcImage.jpegData, newDcImage.jpegSize);
+    dcStreamComputeJpeg(newDcImage.imageBuffer, newDcImage.width, newDcImage.pitch, newDcImage.height, newDcImage.pixelFormat, &newDcImage.jpegData, newDcImage.jpegSize, newDcImage.jpegQuality, newDcImage.chromaSubsampling);
 
     return newDcImage;
 }
@@ -58,6 +58,47 @@ struct DcStreamParameters  {
 
 enum PIXEL_FORMAT { RGB=0, RGBA=1, ARGB=2, BGR=3, BGRA=4, ABGR=5 };
 
+enum CHROMA_SUBSAMPLING { SUBSAMPLING_444=0, SUBSAMPLING_422=1, SUBSAMPLING_420=2 };
+
+enum RATE_CONTROL_DECISION { RATE_CONTROL_HOLD=0, RATE_CONTROL_DECREASE=1, RATE_CONTROL_INCREASE=2 };
+
+// current settings, measurements and decisions of the rate controller for a
+// connection. times are in milliseconds.
+struct DcStreamRateStatistics {
+
+    // whether rate control is enabled, and the frame rate it is aiming for
+    bool enabled;
+    float targetFrameRate;
+
+    // current compression settings
+    int jpegQuality;
+    CHROMA_SUBSAMPLING chromaSubsampling;
+
+    // recommended segments are segmentSizeFactor times the nominal segment size
+    int segmentSizeFactor;
+
+    // moving averages of the measurements
+    float frameTime;
+    float ackLatency;
+    float bytesPerFrame;
+    float segmentsPerFrame;
+
+    // latest segment backlog reported by the DisplayCluster instance
+    int segmentBacklog;
+
+    // latest buffer usage reported by the DisplayCluster instance, and whether
+    // it asked us to reduce our bandwidth
+    int bufferedBytes;
+    int bufferBudget;
+    bool throttled;
+
+    // decision history
+    long numFrames;
+    int numDecreases;
+    int numIncreases;
+    RATE_CONTROL_DECISION lastDecision;
+};
+
 // make a new connection to the DisplayCluster instance on hostname, and
 // returns a DcSocket. the user is responsible for closing the socket using
 // dcStreamDisconnect().
@@ -98,8 +139,8 @@ extern bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int ima
 extern bool dcStreamSendJpeg(DcSocket * socket, DcStreamParameters parameters, const char * jpegData, int jpegSize, bool waitForAck=true);
 
 // computes a compressed JPEG image corresponding to imageBuffer. results are
-// stored in jpegData and jpegSize.
-extern bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize);
+// stored in jpegData and jpegSize. jpegQuality ranges from 1 to 100.
+extern bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize, int jpegQuality=75, CHROMA_SUBSAMPLING chromaSubsampling=SUBSAMPLING_444);
 
 // increment the frame index for all segments sent by this process. this is
 // used for frame synchronization.
@@ -111,11 +152,35 @@ extern void dcStreamSetFrameIndex(int frameIndex);
 
 // sends an SVG image with a given name to a DisplayCluster instance over a
 // socket. different from the pixel streaming capability, this allows for
-// streaming vector-based graphics.
+// streaming vector-based graphics. a document identical to the last one sent
+// with the same name is not sent again.
 extern bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData, int svgSize);
 
+// the same as above, except only the change from the last document sent with
+// the same name over the same socket is sent, when that is smaller than the
+// whole document. this suits documents that change by small amounts between
+// updates, such as live dashboards. the whole document is sent instead if the
+// DisplayCluster instance rejects the patch, and periodically after a number of
+// consecutive patches.
+extern bool dcStreamSendSVGPatch(DcSocket * socket, std::string name, const char * svgData, int svgSize);
+
 extern bool dcStreamBindInteraction(DcSocket * socket, std::string name);
 
 extern InteractionState dcStreamGetInteractionState(DcSocket * socket);
 
+// enables or disables adaptive rate control for segments sent over socket. when
+// enabled, JPEG quality and chroma subsampling are adjusted from the measured
+// acknowledgment latency, bytes per frame, and the segment backlog reported by
+// the DisplayCluster instance, in order to reach targetFrameRate. when disabled,
+// the defaults (quality 75, 4:4:4 subsampling) are used.
+extern void dcStreamSetRateControl(DcSocket * socket, bool enable, float targetFrameRate=30.);
+
+// returns the segment size the rate controller recommends, given the nominal
+// segment size the application would otherwise use. the result can be passed
+// to dcStreamGenerateParameters(); call dcStreamReset() first when it changes.
+extern int dcStreamGetRecommendedSegmentSize(DcSocket * socket, int nominalSegmentSize);
+
+// returns the current state of the rate controller for socket.
+extern DcStreamRateStatistics dcStreamGetRateStatistics(DcSocket * socket);
+
 #endif
@@ -39,6 +39,9 @@
 #include "main.h"
 #include "config.h"
 #include "log.h"
+#include "PixelStreamDecoderPool.h"
+#include "DynamicTextureLoader.h"
+#include "FrameStatistics.h"
 #include <mpi.h>
 #include <unistd.h>
 
@@ -66,6 +69,9 @@ Configuration * g_configuration = NULL;
 boost::shared_ptr<DisplayGroupManager> g_displayGroupManager;
 MainWindow * g_mainWindow = NULL;
 NetworkListener * g_networkListener = NULL;
+PixelStreamDecoderPool * g_pixelStreamDecoderPool = NULL;
+DynamicTextureLoader * g_dynamicTextureLoader = NULL;
+FrameStatistics * g_frameStatistics = NULL;
 long g_frameCount = 0;
 
 int main(int argc, char * argv[])
@@ -103,6 +109,9 @@ int main(int argc, char * argv[])
     // calibrate timestamp offset between rank 0 and rank 1 clocks
     g_displayGroupManager->calibrateTimestampOffset();
 
+    // frame timing, recorded on the render processes and reported to rank 0
+    g_frameStatistics = new FrameStatistics();
+
 #if ENABLE_TUIO_TOUCH_LISTENER
     if(g_mpiRank == 0)
     {
@@ -151,6 +160,14 @@ int main(int argc, char * argv[])
     {
         g_networkListener = new NetworkListener();
     }
+    else
+    {
+        // pixel streams are only decoded on the render processes
+        g_pixelStreamDecoderPool = new PixelStreamDecoderPool();
+
+        // as are dynamic texture tiles
+        g_dynamicTextureLoader = new DynamicTextureLoader();
+    }
 
     g_mainWindow = new MainWindow();
 
@@ -162,12 +179,21 @@ int main(int argc, char * argv[])
     // wait for all threads to finish
     QThreadPool::globalInstance()->waitForDone();
 
+    delete g_pixelStreamDecoderPool;
+    g_pixelStreamDecoderPool = NULL;
+
+    delete g_dynamicTextureLoader;
+    g_dynamicTextureLoader = NULL;
+
     // call finalize cleanup actions
     g_mainWindow->finalize();
 
     // destruct the main window
     delete g_mainWindow;
 
+    delete g_frameStatistics;
+    g_frameStatistics = NULL;
+
     if(g_mpiRank == 0)
     {
         g_displayGroupManager->sendQuit();
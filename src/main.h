@@ -58,6 +58,18 @@ extern MainWindow * g_mainWindow;
 extern NetworkListener * g_networkListener;
 extern long g_frameCount;
 
+class PixelStreamDecoderPool;
+
+extern PixelStreamDecoderPool * g_pixelStreamDecoderPool;
+
+class DynamicTextureLoader;
+
+extern DynamicTextureLoader * g_dynamicTextureLoader;
+
+class FrameStatistics;
+
+extern FrameStatistics * g_frameStatistics;
+
 #if ENABLE_SKELETON_SUPPORT
     class SkeletonThread;
 